@@ -1,6 +1,7 @@
 ﻿#include "CmpareMode.h"
 #include "Encode.h"
 #include "rcglobal.h"
+#include "texttranscoder.h"
 
 
 #include <QFile>
@@ -132,72 +133,18 @@ CODE_ID CmpareMode::getTextFileEncodeType(uchar* fileFpr, int fileLength, QStrin
 //是否跳过前面的LE头。默认不跳过。只有文件块开头第一块，才需要跳过。
 bool CmpareMode::tranUnicodeLeToUtf8Bytes(uchar* fileFpr, const int fileLength, QString &outUtf8Bytes, bool isSkipHead)
 {
-	CODE_ID code = CODE_ID::UNICODE_LE;
+	int lineStartPos = ((isSkipHead && fileLength >= 2) ? 2:0); //uicode_le前面有2个特殊标识，故跳过2
 
-	int lineStartPos = (isSkipHead ? 2:0); //uicode_le前面有2个特殊标识，故跳过2
+	//不再按行拼接补\0，解码器会把尾部单独的字节补0，即情况A
+	TextDecoder decoder(CODE_ID::UNICODE_LE, false);
 
-	//获取一行在文件中
-	auto getOneLineFromFile = [fileFpr](int& startPos, const int fileLength, QByteArray& ret)->bool {
+	outUtf8Bytes.clear();
+	outUtf8Bytes.reserve((fileLength - lineStartPos) / 2 + 1);
 
-		if (startPos < fileLength)
-		{
-			ret.clear();
-
-			int lineLens = 0;
-
-			bool isFindLine = false;
-
-			for (int i = startPos; i < fileLength; ++i, ++lineLens)
-			{
-				//遇到换行符号
-				if (fileFpr[i] == 0x0A)
-				{
-					//lineLens需要加2，因为当前这个没有加，而且后面还有一个\0,这是le格式规定的。
-					//特殊对待A。如果后续还要一个\0，及长度足够，则+2，否则只能加1
-					if (startPos + lineLens + 2 < fileLength)
-					{
-						ret.append((char*)(fileFpr + startPos), lineLens + 2);
-						startPos += lineLens + 2;
-					}
-					else
-					{
-						//这里就是特殊情况，尾部后面没有\0，只能前进1个。
-						ret.append((char*)(fileFpr + startPos), lineLens + 1);
-						//必须手动补上一个\0。避免格式残缺
-						ret.append('\0');
-						startPos += lineLens + 1;
-					}
-					isFindLine = true;
-					break;
-				}
-			}
-
-			//没有找到一行
-			if (!isFindLine)
-			{
-				//最后一行，可能没有带\r\0直接返回
-				ret.append((char*)(fileFpr + startPos), fileLength - startPos);
-
-				startPos = fileLength;
-			}
-
-			return true;
-
-		}
-
-		return false;
-	};
-
-	QByteArray line;
-
-	QByteArray tempUtf8Bytes;
-	tempUtf8Bytes.reserve(fileLength+1);
-
-	while (getOneLineFromFile(lineStartPos, fileLength, line)) {
-		tempUtf8Bytes.append(line);
-	}
+	decoder.decode((const char*)fileFpr + lineStartPos, fileLength - lineStartPos, outUtf8Bytes);
+	decoder.finish(outUtf8Bytes);
 
-	return Encode::tranStrToUNICODE(code, tempUtf8Bytes.data(), tempUtf8Bytes.count(), outUtf8Bytes);
+	return (decoder.invalidChars() == 0);
 }
 
 //20210802：发现如果是CODE_ID::UNICODE_LE，\r\n变成了\r\0\n\0，读取readLine遇到\n就结束了，而且toUnicode也会变成乱码失败
@@ -1103,11 +1050,12 @@ CODE_ID CmpareMode::scanFileOutPut(CODE_ID code, QString filePath, QList<LineFil
 //bytes charsNums:文件字符个数，不是文件大小
 //20220908 自动判断是否是二进制文件。isHexFile 是输出
 //20230304 新增，一次性读取文件，不检测每行文本，加快速度。existGrbledCode 是否存在乱码
+//按块读取解码，不再先把整个文件读到内存
 CODE_ID CmpareMode::scanFileOutPut(QFile& pFile, CODE_ID code, QString filePath, QString& outText, bool & existGrbledCode)
 {
-	QByteArray outTextBytes = pFile.readAll();
+	qint64 startPos = pFile.pos();
 
-	if (outTextBytes.size() == 0)
+	if (pFile.size() - startPos <= 0)
 	{
 		outText = "";
 		existGrbledCode = false;
@@ -1116,7 +1064,8 @@ CODE_ID CmpareMode::scanFileOutPut(QFile& pFile, CODE_ID code, QString filePath,
 
 	if (code == UNKOWN)
 	{
-		code = getTextFileEncodeType((uchar * )outTextBytes.data(), pFile.size(), filePath);
+		QByteArray head = pFile.peek(4);
+		code = getTextFileEncodeType((uchar * )head.data(), head.size(), filePath);
 
 		//编码还是检测失败，这里概率是比较小的。
 		if (code == CODE_ID::UNKOWN)
@@ -1137,14 +1086,16 @@ CODE_ID CmpareMode::scanFileOutPut(QFile& pFile, CODE_ID code, QString filePath,
 		lineStartPos = 3;
 	}
 		
-	bool codeSucess = Encode::tranStrToUNICODE(code, outTextBytes.data()+ lineStartPos, outTextBytes.size()- lineStartPos, outText);
+	bool isGrbled = true;
+	outText.clear();
+	bool codeSucess = pFile.seek(startPos + lineStartPos) && TextTranscoder::decodeDevice(pFile, code, outText, isGrbled, false) && !isGrbled;
 
 	//如果存在乱码，而且不是以gbk编码打开，再无条件尝试ASNI/GBK编码打开。如果是国际版，后续还得完善策略，得无条件以ASNI本地编码打开。
 	if (!codeSucess && (code != CODE_ID::GBK))
 	{
 		code = CODE_ID::GBK;
 		outText.clear();
-		codeSucess = Encode::tranStrToUNICODE(code, outTextBytes.data() + lineStartPos, outTextBytes.size() - lineStartPos, outText);
+		codeSucess = pFile.seek(startPos + lineStartPos) && TextTranscoder::decodeDevice(pFile, code, outText, isGrbled, false) && !isGrbled;
 	}
 	existGrbledCode = !codeSucess;
 
@@ -1,4 +1,5 @@
 ﻿#include "Encode.h"
+#include "texttranscoder.h"
 #include <QTextCodec>
 #include <QtDebug>
 
@@ -311,31 +312,16 @@ bool Encode::tranStrToUNICODE(CODE_ID code, const char* pText, int length, QStri
 		return false;
 	}
 
-	QTextCodec::ConverterState state;
-	QTextCodec *codec = nullptr;
+	//对于其它非识别编码，统一转换为utf8。减去让用户选择的麻烦
+	//这里其实是有问题的。先这样简单处理
+	//与QTextCodec一样，开头的BOM会被丢弃
+	TextDecoder decoder(code);
 
-	QString textCodeName = getQtCodecNameById(code);
-	if (textCodeName.isEmpty() || textCodeName == "unknown")
-	{
-		//对于其它非识别编码，统一转换为utf8。减去让用户选择的麻烦
-		//这里其实是有问题的。先这样简单处理
-		codec = QTextCodec::codecForName("UTF-8");
-	}
-	else
-	{
-		codec = QTextCodec::codecForName(textCodeName.toStdString().c_str());
-	}
-	
-	if (codec == nullptr)
-	{
-		return false;
-	}
+	out.clear();
+	decoder.decode(pText, length, out);
+	decoder.finish(out);
 
-	out = codec->toUnicode((const char *)pText, length, &state);
-	if (state.invalidChars > 0) {
-		return false;
-	}
-	return true;
+	return (decoder.invalidChars() == 0);
 }
 
 /* 这里其实是穷举字符串的字符编码；ASNI utf8。目前只检测GBK和utf8;其它语种没有穷举
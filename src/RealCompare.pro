@@ -27,6 +27,7 @@ RESOURCES += RealCompare.qrc
 INCLUDEPATH	+= qscint/src
 INCLUDEPATH	+= qscint/src/Qsci
 INCLUDEPATH	+= qscint/scintilla/include
+INCLUDEPATH	+= qscint/scintilla/boostregex
 INCLUDEPATH += cceditor
 
 #DEFINES +=  QSCINTILLA_DLL
@@ -0,0 +1,256 @@
+﻿#include "benchcorpus.h"
+
+#include <QFile>
+#include <QFileInfo>
+#include <QDir>
+#include <QTextCodec>
+#include <QTextEncoder>
+#include <QScopedPointer>
+#include <random>
+
+//每段文本的大小。文件由同一段重复写入，生成2G的文件时不用每次都生成内容
+static const int CHUNK_CHARS = 1024 * 1024;
+
+static const char* s_asciiWords[] = {
+	"the", "file", "open", "save", "line", "text", "search", "replace", "encode", "index",
+	"block", "editor", "needle", "buffer", "Needle", "notepad", "compare", "sort", "view", "tab",
+};
+
+static const char* s_cjkWords[] = {
+	"文件", "编码", "查找", "替换", "记事本", "对比", "排序", "行号", "缓冲区", "索引",
+	"打开", "保存", "大文本", "插件", "主题", "needle", "text", "line", "中文", "测试",
+};
+
+QString BenchCorpusMaker::typeName(BENCH_CORPUS_TYPE type)
+{
+	switch (type)
+	{
+	case CORPUS_ASCII:
+		return QString("ascii");
+	case CORPUS_UTF8_CJK:
+		return QString("utf8-cjk");
+	case CORPUS_GBK:
+		return QString("gbk");
+	case CORPUS_UTF16_LE:
+		return QString("utf16le");
+	case CORPUS_LONG_LINE:
+		return QString("long-line");
+	case CORPUS_SHORT_LINES:
+		return QString("short-lines");
+	default:
+		break;
+	}
+	return QString("unknown");
+}
+
+QStringList BenchCorpusMaker::keywords()
+{
+	QStringList words;
+	for (const char* word : s_asciiWords)
+	{
+		words.append(QString::fromUtf8(word));
+	}
+	for (const char* word : s_cjkWords)
+	{
+		words.append(QString::fromUtf8(word));
+	}
+	words.removeDuplicates();
+	return words;
+}
+
+QString BenchCorpusMaker::makeChunkText(BENCH_CORPUS_TYPE type)
+{
+	//固定种子，同样的类型每次生成一样的内容，不同机器上的结果可以对比
+	std::mt19937 rand(20221018u + (unsigned int)type);
+
+	const bool isCjk = (type == CORPUS_UTF8_CJK || type == CORPUS_GBK || type == CORPUS_UTF16_LE);
+	const char** words = isCjk ? s_cjkWords : s_asciiWords;
+	const int wordNum = isCjk ? (int)(sizeof(s_cjkWords) / sizeof(s_cjkWords[0])) : (int)(sizeof(s_asciiWords) / sizeof(s_asciiWords[0]));
+	const QString lineEnd = (type == CORPUS_UTF16_LE) ? QString("\r\n") : QString("\n");
+
+	int minLine = 20;
+	int maxLine = 120;
+	if (type == CORPUS_LONG_LINE)
+	{
+		minLine = 64 * 1024;
+		maxLine = 256 * 1024;
+	}
+	else if (type == CORPUS_SHORT_LINES)
+	{
+		minLine = 1;
+		maxLine = 8;
+	}
+
+	QString text;
+	text.reserve(CHUNK_CHARS + maxLine + 16);
+
+	while (text.size() < CHUNK_CHARS)
+	{
+		int lineChars = minLine + (int)(rand() % (unsigned int)(maxLine - minLine + 1));
+		int lineStart = text.size();
+
+		if (type == CORPUS_SHORT_LINES)
+		{
+			//短行用单词的前几个字符，会有大量重复的行，也用于去重测试
+			QString word = QString::fromUtf8(words[rand() % wordNum]);
+			text.append(word.left(lineChars));
+		}
+		else
+		{
+			while (text.size() - lineStart < lineChars)
+			{
+				if (text.size() > lineStart)
+				{
+					text.append(QChar(' '));
+				}
+				text.append(QString::fromUtf8(words[rand() % wordNum]));
+				if (rand() % 16 == 0)
+				{
+					text.append(QString::number(rand() % 100000));
+				}
+			}
+		}
+		text.append(lineEnd);
+	}
+	return text;
+}
+
+QByteArray BenchCorpusMaker::encodeChunk(BENCH_CORPUS_TYPE type, const QString& text)
+{
+	const char* codecName = nullptr;
+	if (type == CORPUS_GBK)
+	{
+		codecName = "GBK";
+	}
+	else if (type == CORPUS_UTF16_LE)
+	{
+		codecName = "UTF-16LE";
+	}
+
+	if (codecName == nullptr)
+	{
+		return text.toUtf8();
+	}
+
+	QTextCodec* codec = QTextCodec::codecForName(codecName);
+	if (codec == nullptr)
+	{
+		return QByteArray();
+	}
+
+	//每段都不带BOM，BOM只在文件头写一次
+	QScopedPointer<QTextEncoder> encoder(codec->makeEncoder(QTextCodec::IgnoreHeader));
+	return encoder->fromUnicode(text);
+}
+
+bool BenchCorpusMaker::make(const QString& dir, BENCH_CORPUS_TYPE type, qint64 size, BenchCorpus& out, QString& error)
+{
+	out.type = type;
+	out.name = typeName(type);
+	out.filePath = QDir(dir).absoluteFilePath(QString("ndd-bench-%1-%2.txt").arg(out.name).arg(size));
+
+	switch (type)
+	{
+	case CORPUS_GBK:
+		out.code = CODE_ID::GBK;
+		break;
+	case CORPUS_UTF16_LE:
+		out.code = CODE_ID::UNICODE_LE;
+		break;
+	default:
+		out.code = CODE_ID::UTF8_NOBOM;
+		break;
+	}
+
+	QFileInfo fi(out.filePath);
+	if (fi.exists() && fi.size() > 0)
+	{
+		out.fileSize = fi.size();
+		return true;
+	}
+
+	QByteArray chunk = encodeChunk(type, makeChunkText(type));
+	if (chunk.isEmpty())
+	{
+		error = QString("can not encode the corpus text");
+		return false;
+	}
+
+	//UTF16中换行是两个字节，只在偶数位置截断
+	const bool isUtf16 = (type == CORPUS_UTF16_LE);
+	const QByteArray lineEnd = isUtf16 ? QByteArray("\n\0", 2) : QByteArray("\n");
+
+	//先写到临时文件，中途失败或者被中断时不会留下不完整的测试文件
+	QString tmpPath = out.filePath + ".tmp";
+	QFile file(tmpPath);
+	if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate))
+	{
+		error = file.errorString();
+		return false;
+	}
+
+	qint64 written = 0;
+
+	//磁盘满等写失败时write返回-1，不检查的话written不再增长，会一直循环下去。
+	//每次写的长度都大于0，返回0也当作失败
+	auto writeFailed = [&](qint64 ret) {
+		if (ret <= 0)
+		{
+			error = file.errorString();
+			file.close();
+			QFile::remove(tmpPath);
+			return true;
+		}
+		written += ret;
+		return false;
+	};
+
+	if (isUtf16 && writeFailed(file.write("\xFF\xFE", 2)))
+	{
+		return false;
+	}
+
+	while (written < size)
+	{
+		qint64 left = size - written;
+		if (left >= chunk.size())
+		{
+			if (writeFailed(file.write(chunk)))
+			{
+				return false;
+			}
+			continue;
+		}
+
+		//最后一段在行尾截断
+		int cut = (left > lineEnd.size()) ? chunk.lastIndexOf(lineEnd, (int)left - lineEnd.size()) : -1;
+		while (isUtf16 && cut > 0 && (cut % 2) != 0)
+		{
+			cut = chunk.lastIndexOf(lineEnd, cut - 1);
+		}
+		if (cut >= 0 && writeFailed(file.write(chunk.constData(), cut + lineEnd.size())))
+		{
+			return false;
+		}
+		break;
+	}
+
+	file.close();
+	if (written <= 0 || file.error() != QFileDevice::NoError)
+	{
+		error = (written <= 0) ? QString("size is too small for one line") : file.errorString();
+		QFile::remove(tmpPath);
+		return false;
+	}
+
+	QFile::remove(out.filePath);
+	if (!QFile::rename(tmpPath, out.filePath))
+	{
+		error = QString("can not rename %1 to %2").arg(tmpPath).arg(out.filePath);
+		QFile::remove(tmpPath);
+		return false;
+	}
+
+	out.fileSize = written;
+	return true;
+}
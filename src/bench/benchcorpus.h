@@ -0,0 +1,49 @@
+﻿#pragma once
+
+#include "rcglobal.h"
+
+#include <QString>
+#include <QStringList>
+#include <QByteArray>
+
+//ndd_bench使用的测试文件。内容是固定种子生成的，同样的类型和大小每次生成的内容一样
+enum BENCH_CORPUS_TYPE {
+	CORPUS_ASCII = 0,//英文单词，普通长度的行
+	CORPUS_UTF8_CJK,//中英文混合，UTF8
+	CORPUS_GBK,//和CORPUS_UTF8_CJK内容一样，GBK编码
+	CORPUS_UTF16_LE,//和CORPUS_UTF8_CJK内容一样，UTF16 LE带BOM，windows行尾
+	CORPUS_LONG_LINE,//很少的几行，每行上百K
+	CORPUS_SHORT_LINES,//大量几个字符的短行
+	CORPUS_TYPE_END
+};
+
+struct BenchCorpus {
+	BENCH_CORPUS_TYPE type;
+	QString name;
+	QString filePath;
+	qint64 fileSize;
+	CODE_ID code;
+
+	BenchCorpus() :type(CORPUS_ASCII), fileSize(0), code(CODE_ID::UTF8_NOBOM)
+	{
+	}
+};
+
+class BenchCorpusMaker
+{
+public:
+	//用于输出和--filter的名称
+	static QString typeName(BENCH_CORPUS_TYPE type);
+
+	//查找测试中要找的词，每种测试文件中都有
+	static QStringList keywords();
+
+	//在dir下生成大约size字节的测试文件，在行尾处截断，不会超过size。文件已经存在时直接使用。
+	//失败时error中是原因
+	static bool make(const QString& dir, BENCH_CORPUS_TYPE type, qint64 size, BenchCorpus& out, QString& error);
+
+private:
+	//生成大约1M的一段文本，大文件由它重复组成
+	static QString makeChunkText(BENCH_CORPUS_TYPE type);
+	static QByteArray encodeChunk(BENCH_CORPUS_TYPE type, const QString& text);
+};
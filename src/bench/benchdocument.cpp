@@ -0,0 +1,95 @@
+﻿#include "benchdocument.h"
+
+#include <cstddef>
+#include <cstdlib>
+#include <cassert>
+#include <cstring>
+
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include <map>
+#include <set>
+#include <forward_list>
+#include <algorithm>
+#include <memory>
+
+#include "Platform.h"
+
+#include "ILoader.h"
+#include "ILexer.h"
+#include "Scintilla.h"
+
+#include "CharacterSet.h"
+#include "CharacterCategory.h"
+#include "Position.h"
+#include "SplitVector.h"
+#include "Partitioning.h"
+#include "RunStyles.h"
+#include "CellBuffer.h"
+#include "PerLine.h"
+#include "CharClassify.h"
+#include "Decoration.h"
+#include "CaseFolder.h"
+#include "Document.h"
+
+using namespace Scintilla;
+
+BenchDocument::BenchDocument()
+{
+	m_doc = new Document(SC_DOCUMENTOPTION_DEFAULT);
+	m_doc->AddRef();
+	m_doc->SetDBCSCodePage(SC_CP_UTF8);
+	//只读查找，不需要撤销记录
+	m_doc->SetUndoCollection(false);
+	//不区分大小写的查找需要，编辑器中UTF8文档也是用的这个
+	m_doc->SetCaseFolder(new CaseFolderUnicode());
+}
+
+BenchDocument::~BenchDocument()
+{
+	m_doc->Release();
+}
+
+void BenchDocument::setText(const char* text, long long length)
+{
+	m_doc->DeleteChars(0, m_doc->Length());
+	m_doc->InsertString(0, text, static_cast<Sci::Position>(length));
+}
+
+long long BenchDocument::length() const
+{
+	return m_doc->Length();
+}
+
+long long BenchDocument::countMatches(const std::string& what, bool isRegex, bool isMatchCase)
+{
+	int flags = 0;
+	if (isRegex)
+	{
+		flags |= SCFIND_REGEXP;
+	}
+	if (isMatchCase)
+	{
+		flags |= SCFIND_MATCHCASE;
+	}
+
+	const Sci::Position docLength = m_doc->Length();
+	Sci::Position pos = 0;
+	long long count = 0;
+
+	while (pos < docLength)
+	{
+		Sci::Position matchLength = static_cast<Sci::Position>(what.size());
+		Sci::Position found = m_doc->FindText(pos, docLength, what.c_str(), flags, &matchLength);
+		if (found < 0)
+		{
+			break;
+		}
+		++count;
+
+		//正则可能匹配到空串，至少前进一个字符
+		pos = found + std::max<Sci::Position>(matchLength, 1);
+	}
+	return count;
+}
@@ -0,0 +1,30 @@
+﻿#pragma once
+
+#include <string>
+
+namespace Scintilla {
+	class Document;
+}
+
+//ndd_bench中查找用的文档。直接使用Scintilla的Document，和编辑器中的查找走同样的代码，但不创建控件。
+//只依赖Scintilla的内部头文件，和qscint使用同样的宏编译
+class BenchDocument
+{
+public:
+	BenchDocument();
+	~BenchDocument();
+
+	//替换全部内容，内容按UTF8处理
+	void setText(const char* text, long long length);
+
+	long long length() const;
+
+	//从头到尾查找what，返回匹配的个数。isRegex时使用Boost正则，和查找框的正则一致
+	long long countMatches(const std::string& what, bool isRegex, bool isMatchCase);
+
+private:
+	BenchDocument(const BenchDocument&) = delete;
+	BenchDocument& operator=(const BenchDocument&) = delete;
+
+	Scintilla::Document* m_doc;
+};
@@ -0,0 +1,569 @@
+﻿//ndd_bench：不打开界面，对文件加载、编码识别、查找、排序等热点代码计时。
+//在固定内容的测试文件上运行，每项测试输出一行json，方便脚本收集和比较不同版本的结果。
+//用法：ndd_bench [--sizes 1M,16M,256M] [--filter name] [--repeat 3] [--dir corpusdir] [--out result.jsonl]
+
+#include "benchcorpus.h"
+#include "benchdocument.h"
+#include "filemanager.h"
+#include "CmpareMode.h"
+#include "Encode.h"
+#include "texttranscoder.h"
+#include "openrequestchannel.h"
+
+#include <cassert>
+#include "Sorters.h"
+
+#include <QApplication>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QElapsedTimer>
+#include <QEventLoop>
+#include <QTimer>
+#include <QJsonObject>
+#include <QJsonDocument>
+#include <QVector>
+#include <QDateTime>
+#include <algorithm>
+#include <functional>
+#include <thread>
+#include <vector>
+#include <stdio.h>
+
+#ifdef Q_OS_WIN
+//主程序中在main.cpp定义，ndd_bench不包含main.cpp
+bool s_isAdminAuth = false;
+#endif
+
+//定义在scintillaeditview.cpp中，编辑器的去除重复行使用
+extern size_t vecRemoveDuplicates(QList<QString>& vec);
+
+//很多接口的长度是int，超过后不在内存中测试
+static const qint64 MAX_IN_MEMORY_SIZE = 512LL * 1024 * 1024;
+//排序和去重要把每一行转换成QString，内存占用是文件的好几倍
+static const qint64 MAX_LINES_SIZE = 64LL * 1024 * 1024;
+static const qint64 MAX_CORPUS_SIZE = 2048LL * 1024 * 1024;
+
+//转发测试的客户端线程数和每个线程的转发次数
+static const int FORWARD_CLIENTS = 4;
+static const int FORWARDS_PER_CLIENT = 50;
+static const int FORWARD_TIMEOUT_MS = 10000;
+
+struct BenchOptions {
+	QList<qint64> sizes;
+	QString filter;
+	int repeat;
+	QString dir;
+	QString outFile;
+
+	BenchOptions() :repeat(3)
+	{
+	}
+};
+
+//丢弃写入的数据，只统计字节数
+class NullDevice : public QIODevice
+{
+public:
+	NullDevice() : m_written(0) {}
+
+	bool isSequential() const override { return true; }
+	qint64 written() const { return m_written; }
+
+protected:
+	qint64 readData(char*, qint64) override { return -1; }
+	qint64 writeData(const char*, qint64 len) override
+	{
+		m_written += len;
+		return len;
+	}
+
+private:
+	qint64 m_written;
+};
+
+class BenchRunner
+{
+public:
+	BenchRunner(const BenchOptions& options, QFile* out) :m_options(options), m_out(out)
+	{
+	}
+
+	void runCorpus(const BenchCorpus& corpus);
+	void runOpenRequestForward();
+
+private:
+	bool isSelected(const QString& bench) const
+	{
+		return m_options.filter.isEmpty() || bench.contains(m_options.filter);
+	}
+
+	//func返回本次的结果，每次运行的结果应该一样，输出最后一次的
+	void measure(const QString& bench, const BenchCorpus& corpus, std::function<QString()> func);
+	void skip(const QString& bench, const BenchCorpus& corpus, const QString& reason);
+	void write(const QJsonObject& record);
+
+	const BenchOptions& m_options;
+	QFile* m_out;
+};
+
+void BenchRunner::write(const QJsonObject& record)
+{
+	m_out->write(QJsonDocument(record).toJson(QJsonDocument::Compact));
+	m_out->write("\n");
+	m_out->flush();
+}
+
+void BenchRunner::skip(const QString& bench, const BenchCorpus& corpus, const QString& reason)
+{
+	if (!isSelected(bench))
+	{
+		return;
+	}
+
+	QJsonObject record;
+	record.insert("bench", bench);
+	record.insert("corpus", corpus.name);
+	record.insert("bytes", corpus.fileSize);
+	record.insert("skipped", true);
+	record.insert("note", reason);
+	write(record);
+}
+
+void BenchRunner::measure(const QString& bench, const BenchCorpus& corpus, std::function<QString()> func)
+{
+	if (!isSelected(bench))
+	{
+		return;
+	}
+
+	QVector<double> times;
+	QString result;
+	QElapsedTimer timer;
+
+	for (int i = 0; i < m_options.repeat; ++i)
+	{
+		timer.start();
+		result = func();
+		times.append(timer.nsecsElapsed() / 1000000.0);
+	}
+
+	std::sort(times.begin(), times.end());
+	double minMs = times.first();
+	double medianMs = times.at(times.size() / 2);
+
+	QJsonObject record;
+	record.insert("bench", bench);
+	record.insert("corpus", corpus.name);
+	record.insert("bytes", corpus.fileSize);
+	record.insert("repeat", m_options.repeat);
+	record.insert("min_ms", minMs);
+	record.insert("median_ms", medianMs);
+	record.insert("mb_per_s", (minMs > 0) ? (corpus.fileSize / (1024.0 * 1024.0)) / (minMs / 1000.0) : 0.0);
+	record.insert("result", result);
+	write(record);
+}
+
+void BenchRunner::runCorpus(const BenchCorpus& corpus)
+{
+	const int lineEndType = (corpus.type == CORPUS_UTF16_LE) ? RC_LINE_FORM::DOS_LINE : RC_LINE_FORM::UNIX_LINE;
+
+	//大文本只读打开时建立块索引，和打开超过设置大小的文件一样
+	measure("filemanager.blockindex", corpus, [&corpus]() {
+		BigTextEditFileMgr* txtFile = nullptr;
+		if (!FileManager::getInstance().loadFileDataWithIndex(corpus.filePath, txtFile))
+		{
+			return QString("failed");
+		}
+		int blocks = txtFile->blocks.size();
+		FileManager::getInstance().closeBigTextRoFileHand(corpus.filePath);
+		return QString("blocks=%1").arg(blocks);
+	});
+
+	measure("cmparemode.scan", corpus, [&corpus]() {
+		return Encode::getCodeNameById(CmpareMode::scanFileRealCode(corpus.filePath));
+	});
+
+	QFile file(corpus.filePath);
+	if (!file.open(QIODevice::ReadOnly))
+	{
+		skip("filemanager.countlineends", corpus, QString("open failed"));
+		return;
+	}
+
+	const uchar* filePtr = file.map(0, file.size());
+	if (filePtr == nullptr)
+	{
+		skip("filemanager.countlineends", corpus, QString("map failed"));
+		return;
+	}
+
+	//超大文本后台建立行索引时的行尾计数
+	measure("filemanager.countlineends", corpus, [&]() {
+		return QString("lines=%1").arg(FileManager::countLineEnds((const char*)filePtr, file.size(), corpus.code, lineEndType));
+	});
+
+	//分块转码，内存固定，不受大小限制。输出丢弃，只计算转换本身
+	measure("encode.stream", corpus, [&corpus]() {
+		QFile in(corpus.filePath);
+		NullDevice out;
+		bool existGrbledCode = false;
+		if (!in.open(QIODevice::ReadOnly) || !out.open(QIODevice::WriteOnly)
+			|| !TextTranscoder::transcode(in, corpus.code, out, CODE_ID::UNICODE_LE, existGrbledCode))
+		{
+			return QString("failed");
+		}
+		return QString("bytes=%1 grbled=%2").arg(out.written()).arg(existGrbledCode);
+	});
+
+	QStringList inMemoryBenches;
+	inMemoryBenches << "encode.detect" << "encode.transcode" << "document.findtext" << "document.findtext.nocase" << "document.regex" << "document.batchfind";
+
+	if (corpus.fileSize > MAX_IN_MEMORY_SIZE)
+	{
+		for (const QString& bench : inMemoryBenches)
+		{
+			skip(bench, corpus, QString("size above %1M").arg(MAX_IN_MEMORY_SIZE / (1024 * 1024)));
+		}
+		skip("sort.lexicographic", corpus, QString("size above %1M").arg(MAX_LINES_SIZE / (1024 * 1024)));
+		skip("sort.lexicographic.nocase", corpus, QString("size above %1M").arg(MAX_LINES_SIZE / (1024 * 1024)));
+		skip("dedupe", corpus, QString("size above %1M").arg(MAX_LINES_SIZE / (1024 * 1024)));
+		return;
+	}
+
+	const int length = (int)file.size();
+
+	measure("encode.detect", corpus, [&]() {
+		int skipBytes = 0;
+		return Encode::getCodeNameById(Encode::DetectEncode(filePtr, length, skipBytes));
+	});
+
+	QString text;
+	measure("encode.transcode", corpus, [&]() {
+		int skipBytes = 0;
+		Encode::DetectEncode(filePtr, std::min(length, 4), skipBytes);
+		text.clear();
+		Encode::tranStrToUNICODE(corpus.code, (const char*)filePtr + skipBytes, length - skipBytes, text);
+		return QString("chars=%1").arg(text.size());
+	});
+
+	file.unmap((uchar*)filePtr);
+	file.close();
+
+	//后面的测试需要文本内容。只选了后面的测试时，上面的转换没有执行
+	if (text.isEmpty())
+	{
+		QFile textFile(corpus.filePath);
+		if (textFile.open(QIODevice::ReadOnly))
+		{
+			QByteArray bytes = textFile.readAll();
+			int skipBytes = 0;
+			Encode::DetectEncode((const uchar*)bytes.constData(), std::min(bytes.size(), 4), skipBytes);
+			Encode::tranStrToUNICODE(corpus.code, bytes.constData() + skipBytes, bytes.size() - skipBytes, text);
+		}
+	}
+
+	//编辑器中文档都是UTF8的，查找的是转换后的内容
+	{
+		BenchDocument doc;
+		QByteArray utf8 = text.toUtf8();
+		doc.setText(utf8.constData(), utf8.size());
+		utf8.clear();
+
+		measure("document.findtext", corpus, [&doc]() {
+			return QString("matches=%1").arg(doc.countMatches("needle", false, true));
+		});
+
+		measure("document.findtext.nocase", corpus, [&doc]() {
+			return QString("matches=%1").arg(doc.countMatches("needle", false, false));
+		});
+
+		measure("document.regex", corpus, [&doc]() {
+			return QString("matches=%1").arg(doc.countMatches("needle[0-9]+", true, true));
+		});
+
+		//批量查找：每个关键词都从头到尾查找一遍
+		const QStringList keywords = BenchCorpusMaker::keywords();
+		measure("document.batchfind", corpus, [&doc, &keywords]() {
+			qint64 total = 0;
+			for (const QString& word : keywords)
+			{
+				total += doc.countMatches(word.toUtf8().toStdString(), false, true);
+			}
+			return QString("keywords=%1 matches=%2").arg(keywords.size()).arg(total);
+		});
+	}
+
+	if (corpus.fileSize > MAX_LINES_SIZE)
+	{
+		skip("sort.lexicographic", corpus, QString("size above %1M").arg(MAX_LINES_SIZE / (1024 * 1024)));
+		skip("sort.lexicographic.nocase", corpus, QString("size above %1M").arg(MAX_LINES_SIZE / (1024 * 1024)));
+		skip("dedupe", corpus, QString("size above %1M").arg(MAX_LINES_SIZE / (1024 * 1024)));
+		return;
+	}
+
+	const QList<QString> lines = text.split(corpus.type == CORPUS_UTF16_LE ? QString("\r\n") : QString("\n"));
+	text.clear();
+
+	measure("sort.lexicographic", corpus, [&lines]() {
+		LexicographicSorter sorter(false, 0, 0);
+		return QString("lines=%1").arg(sorter.sort(lines).size());
+	});
+
+	measure("sort.lexicographic.nocase", corpus, [&lines]() {
+		LexicographicCaseInsensitiveSorter sorter(false, 0, 0);
+		return QString("lines=%1").arg(sorter.sort(lines).size());
+	});
+
+	measure("dedupe", corpus, [&lines]() {
+		QList<QString> copy = lines;
+		return QString("lines=%1").arg(vecRemoveDuplicates(copy));
+	});
+}
+
+//多个进程同时转发打开请求时，转发端等待确认的时间和请求送到界面的时间
+void BenchRunner::runOpenRequestForward()
+{
+	const QString bench("openrequest.forward");
+	if (!isSelected(bench))
+	{
+		return;
+	}
+
+	QJsonObject record;
+	record.insert("bench", bench);
+	record.insert("corpus", QString("none"));
+
+#if defined(Q_OS_UNIX) && !defined(Q_OS_MAC)
+	//不使用正在运行的ndd的socket
+	const QString socketPath = QDir(m_options.dir).absoluteFilePath(QString("ndd-bench-%1.sock").arg(QCoreApplication::applicationPid()));
+
+	OpenRequestChannel channel;
+	if (!channel.listen(socketPath))
+	{
+		record.insert("skipped", true);
+		record.insert("note", QString("listen failed"));
+		write(record);
+		return;
+	}
+
+	const int sent = FORWARD_CLIENTS * FORWARDS_PER_CLIENT;
+	int delivered = 0;
+	qint64 maxDeliveryMs = 0;
+
+	QEventLoop loop;
+	QObject::connect(&channel, &OpenRequestChannel::signOpenRequests, &loop, [&](const QList<OpenRequest>& requests) {
+		qint64 now = QDateTime::currentMSecsSinceEpoch();
+		for (const OpenRequest& request : requests)
+		{
+			maxDeliveryMs = qMax(maxDeliveryMs, now - request.sendTime);
+		}
+		//每次转发3个文件
+		delivered += requests.size() / 3;
+		if (delivered >= sent)
+		{
+			loop.quit();
+		}
+	});
+	QTimer::singleShot(FORWARD_TIMEOUT_MS, &loop, &QEventLoop::quit);
+
+	//每个客户端线程的耗时单独记录，结束后再合并
+	std::vector<std::vector<qint64>> clientTimes(FORWARD_CLIENTS);
+	std::vector<std::thread> clients;
+	QElapsedTimer total;
+	total.start();
+
+	for (int c = 0; c < FORWARD_CLIENTS; ++c)
+	{
+		clients.emplace_back([&clientTimes, &socketPath, c]() {
+			QStringList arguments;
+			arguments << QString("a%1.txt").arg(c) << QString("b%1.txt").arg(c) << QString("-n") << QString("10") << QString("c%1.txt").arg(c);
+			QElapsedTimer timer;
+			for (int i = 0; i < FORWARDS_PER_CLIENT; ++i)
+			{
+				timer.start();
+				if (OpenRequestChannel::forward(arguments, QString("/tmp"), socketPath))
+				{
+					clientTimes[c].push_back(timer.nsecsElapsed() / 1000);
+				}
+			}
+		});
+	}
+
+	loop.exec();
+
+	for (std::thread& client : clients)
+	{
+		client.join();
+	}
+
+	QVector<qint64> ackTimes;
+	for (const std::vector<qint64>& times : clientTimes)
+	{
+		for (qint64 time : times)
+		{
+			ackTimes.append(time);
+		}
+	}
+	std::sort(ackTimes.begin(), ackTimes.end());
+
+	record.insert("clients", FORWARD_CLIENTS);
+	record.insert("sent", sent);
+	record.insert("acked", ackTimes.size());
+	record.insert("delivered", delivered);
+	record.insert("total_ms", total.nsecsElapsed() / 1000000.0);
+	if (!ackTimes.isEmpty())
+	{
+		record.insert("ack_p50_us", ackTimes.at(ackTimes.size() / 2));
+		record.insert("ack_p99_us", ackTimes.at(qMin(ackTimes.size() - 1, ackTimes.size() * 99 / 100)));
+	}
+	record.insert("max_delivery_ms", maxDeliveryMs);
+	write(record);
+#else
+	record.insert("skipped", true);
+	record.insert("note", QString("linux only"));
+	write(record);
+#endif
+}
+
+//1M 16M 2G 这样的大小
+static qint64 parseSize(const QString& text)
+{
+	QString value = text.trimmed().toUpper();
+	qint64 unit = 1;
+	if (value.endsWith('K'))
+	{
+		unit = 1024;
+	}
+	else if (value.endsWith('M'))
+	{
+		unit = 1024 * 1024;
+	}
+	else if (value.endsWith('G'))
+	{
+		unit = 1024LL * 1024 * 1024;
+	}
+	if (unit != 1)
+	{
+		value.chop(1);
+	}
+
+	bool ok = false;
+	qint64 size = value.toLongLong(&ok) * unit;
+	return ok ? size : -1;
+}
+
+static void printUsage()
+{
+	fprintf(stderr, "usage: ndd_bench [--sizes 1M,16M,256M] [--filter name] [--repeat 3] [--dir corpusdir] [--out result.jsonl]\n");
+	fprintf(stderr, "  sizes up to 2G; corpus files are generated once in corpusdir and reused\n");
+}
+
+int main(int argc, char* argv[])
+{
+	//块索引在文件很大时会创建进度窗口，没有显示环境时也能运行
+	if (qgetenv("QT_QPA_PLATFORM").isEmpty())
+	{
+		qputenv("QT_QPA_PLATFORM", "offscreen");
+	}
+
+	QApplication a(argc, argv);
+
+	BenchOptions options;
+	options.dir = QDir::temp().absoluteFilePath("ndd-bench");
+
+	QStringList arguments = a.arguments();
+	for (int i = 1; i < arguments.size(); ++i)
+	{
+		const QString& arg = arguments.at(i);
+		const bool hasValue = (i + 1 < arguments.size());
+
+		if (arg == QString("--sizes") && hasValue)
+		{
+			for (const QString& item : arguments.at(++i).split(','))
+			{
+				if (item.isEmpty())
+				{
+					continue;
+				}
+				qint64 size = parseSize(item);
+				if (size <= 0 || size > MAX_CORPUS_SIZE)
+				{
+					fprintf(stderr, "invalid size: %s\n", qUtf8Printable(item));
+					return 1;
+				}
+				options.sizes.append(size);
+			}
+		}
+		else if (arg == QString("--filter") && hasValue)
+		{
+			options.filter = arguments.at(++i);
+		}
+		else if (arg == QString("--repeat") && hasValue)
+		{
+			options.repeat = qMax(1, arguments.at(++i).toInt());
+		}
+		else if (arg == QString("--dir") && hasValue)
+		{
+			options.dir = arguments.at(++i);
+		}
+		else if (arg == QString("--out") && hasValue)
+		{
+			options.outFile = arguments.at(++i);
+		}
+		else
+		{
+			printUsage();
+			return 1;
+		}
+	}
+
+	if (options.sizes.isEmpty())
+	{
+		options.sizes << 1024 * 1024 << 16 * 1024 * 1024;
+	}
+
+	if (!QDir().mkpath(options.dir))
+	{
+		fprintf(stderr, "can not create corpus dir: %s\n", qUtf8Printable(options.dir));
+		return 1;
+	}
+
+	QFile out;
+	bool isOpen = false;
+	if (options.outFile.isEmpty())
+	{
+		isOpen = out.open(stdout, QIODevice::WriteOnly);
+	}
+	else
+	{
+		out.setFileName(options.outFile);
+		isOpen = out.open(QIODevice::WriteOnly | QIODevice::Truncate);
+	}
+	if (!isOpen)
+	{
+		fprintf(stderr, "can not open output file\n");
+		return 1;
+	}
+
+	BenchRunner runner(options, &out);
+
+	for (qint64 size : options.sizes)
+	{
+		for (int type = CORPUS_ASCII; type < CORPUS_TYPE_END; ++type)
+		{
+			BenchCorpus corpus;
+			QString error;
+			if (!BenchCorpusMaker::make(options.dir, (BENCH_CORPUS_TYPE)type, size, corpus, error))
+			{
+				fprintf(stderr, "can not create corpus %s %lld: %s\n", qUtf8Printable(BenchCorpusMaker::typeName((BENCH_CORPUS_TYPE)type)), size, qUtf8Printable(error));
+				continue;
+			}
+			runner.runCorpus(corpus);
+		}
+	}
+
+	runner.runOpenRequestForward();
+
+	return 0;
+}
@@ -0,0 +1,604 @@
+﻿#include "bigfilesearcher.h"
+#include "filemanager.h"
+#include "rcglobal.h"
+#include "Encode.h"
+#include "nddtrace.h"
+
+#include <QFile>
+#include <QThread>
+#include <QTextCodec>
+#include <QByteArrayMatcher>
+#include <QtConcurrent>
+#include <boost/regex.hpp>
+#include <atomic>
+
+//并行查找时每一块的大小，块的边界会对齐到下一个行首
+static const qint64 SEARCH_CHUNK_SIZE = 8 * 1024 * 1024;
+//正则匹配可以越过块尾的最大长度
+static const qint64 REGEX_OVERLAP_SIZE = 64 * 1024;
+//结果窗口中一行最多显示的字节数。超长的行只显示命中位置附近的内容
+static const qint64 MAX_SHOW_LINE_BYTES = 1024;
+
+struct BigFileSearchTask {
+	int searchId;
+	QString filePath;
+	QByteArray needle;//已经转换为文件编码的查找内容
+	QSharedPointer<boost::regex> re;//正则、忽略大小写、全词匹配时使用；否则直接按字节查找needle
+	int code;
+	int lineEndType;
+	char eolChar;
+	int unitSize;//UNICODE_LE/BE是2，其它是1
+	bool isMultiByte;//GBK、BIG5、Shift_JIS等双字节编码，命中要从字符的首字节开始
+	QTextCodec* codec;
+	std::atomic<bool> isCancel;
+
+	BigFileSearchTask() :searchId(0), code(UNKOWN), lineEndType(UNKNOWN_LINE), eolChar('\n'), unitSize(1), isMultiByte(false), codec(nullptr), isCancel(false)
+	{
+	}
+};
+
+struct SearchChunk {
+	const char* base;//整个文件映射的首地址
+	qint64 fileSize;
+	qint64 start;
+	qint64 end;
+	qint64 bomLen;
+	const BigFileSearchTask* task;
+};
+
+struct ChunkResult {
+	qint64 lineCount;//块中行结束符的数量
+	QVector<FindRecord> records;//lineNum是块中的相对行号
+
+	ChunkResult() :lineCount(0)
+	{
+	}
+};
+
+static QTextCodec* getSearchCodec(int code)
+{
+	QTextCodec* codec = nullptr;
+
+	if (code == UNICODE_LE)
+	{
+		codec = QTextCodec::codecForName("UTF-16LE");
+	}
+	else if (code == UNICODE_BE)
+	{
+		codec = QTextCodec::codecForName("UTF-16BE");
+	}
+	else
+	{
+		QString codecName = Encode::getQtCodecNameById((CODE_ID)code);
+		if (!codecName.isEmpty() && codecName != "unknown")
+		{
+			codec = QTextCodec::codecForName(codecName.toUtf8());
+		}
+	}
+
+	//和打开文件时一样，不识别的编码统一按照utf8处理
+	return (codec != nullptr) ? codec : QTextCodec::codecForName("UTF-8");
+}
+
+static bool isUtf8Like(int code)
+{
+	return (code == UTF8_NOBOM || code == UTF8_BOM || code == UNKOWN || code == ANSI);
+}
+
+static bool isMultiByteLegacy(int code)
+{
+	return (code == GBK || code == BIG5 || code == Shift_JIS || code == EUC_KR || code == EUC_JP);
+}
+
+//双字节编码中，从p开始的一个字符的字节数。尾字节可能与ASCII或者其它字符的首字节相同，只能从字符边界往后数
+static int legacyCharLen(int code, const uchar* p, qint64 left)
+{
+	uchar c = p[0];
+	int len = 1;
+
+	if (code == Shift_JIS)
+	{
+		//0xA1-0xDF是半角片假名，单字节
+		len = ((c >= 0x81 && c <= 0x9F) || (c >= 0xE0 && c <= 0xFC)) ? 2 : 1;
+	}
+	else if (code == EUC_JP)
+	{
+		len = (c == 0x8F) ? 3 : ((c >= 0x80) ? 2 : 1);
+	}
+	else if (c >= 0x81 && c <= 0xFE)
+	{
+		len = 2;
+
+		//GB18030的四字节字符，第二个字节是数字
+		if (code == GBK && left >= 4 && p[1] >= 0x30 && p[1] <= 0x39)
+		{
+			len = 4;
+		}
+	}
+	return (int)qMin<qint64>(len, left);
+}
+
+//charPos是已知的字符边界，向后移动到不小于target的第一个字符边界。target本身是字符边界时返回true。
+//target必须单调递增；行首一定是字符边界，因为行结束符不会出现在尾字节中
+static bool isCharBoundary(const char* base, qint64 fileSize, qint64& charPos, qint64 target, const BigFileSearchTask* task)
+{
+	while (charPos < target)
+	{
+		charPos += legacyCharLen(task->code, (const uchar*)base + charPos, fileSize - charPos);
+	}
+	return charPos == target;
+}
+
+//普通文本转换为正则，用来做忽略大小写和全词匹配的查找
+static std::string escapeRegex(const QByteArray& text)
+{
+	static const char* specialChars = "\\^$.|?*+()[]{}";
+
+	std::string ret;
+	ret.reserve(text.size() * 2);
+
+	for (int i = 0; i < text.size(); ++i)
+	{
+		if (text.at(i) != '\0' && strchr(specialChars, text.at(i)) != nullptr)
+		{
+			ret.push_back('\\');
+		}
+		ret.push_back(text.at(i));
+	}
+	return ret;
+}
+
+//在[from, to)中查找行结束符，返回结束符所在的位置，没有找到返回-1。UNICODE模式下from必须是偶数
+static qint64 findEol(const char* base, qint64 from, qint64 to, const BigFileSearchTask* task)
+{
+	if (from >= to)
+	{
+		return -1;
+	}
+
+	if (task->unitSize == 1)
+	{
+		const char* p = (const char*)memchr(base + from, task->eolChar, to - from);
+		return (p == nullptr) ? -1 : (p - base);
+	}
+
+	char lo = (task->code == UNICODE_LE) ? task->eolChar : '\0';
+	char hi = (task->code == UNICODE_LE) ? '\0' : task->eolChar;
+
+	for (qint64 i = from; i + 1 < to; i += 2)
+	{
+		if (base[i] == lo && base[i + 1] == hi)
+		{
+			return i;
+		}
+	}
+	return -1;
+}
+
+//[from, to)转换为utf8后的长度。编辑框中的位置是按照utf8字节计算的
+static int utf8Length(const char* base, qint64 from, qint64 to, const BigFileSearchTask* task)
+{
+	if (to <= from)
+	{
+		return 0;
+	}
+
+	if (isUtf8Like(task->code))
+	{
+		return (int)(to - from);
+	}
+
+	QTextCodec::ConverterState state(QTextCodec::IgnoreHeader);
+	return task->codec->toUnicode(base + from, (int)(to - from), &state).toUtf8().size();
+}
+
+static QString decodeText(const char* base, qint64 from, qint64 to, const BigFileSearchTask* task)
+{
+	QTextCodec::ConverterState state(QTextCodec::IgnoreHeader);
+	QString text = task->codec->toUnicode(base + from, (int)(to - from), &state);
+
+	while (text.endsWith(QChar('\r')) || text.endsWith(QChar('\n')))
+	{
+		text.chop(1);
+	}
+	return text;
+}
+
+//在线程池中执行：查找一块，起点落在[start, end)中的命中才算这一块的，匹配的内容可以越过块尾
+static ChunkResult searchChunk(const SearchChunk& chunk)
+{
+	ChunkResult result;
+
+	const BigFileSearchTask* task = chunk.task;
+	const char* base = chunk.base;
+
+	if (task->isCancel)
+	{
+		return result;
+	}
+
+	QVector<QPair<qint64, qint64>> hits;
+
+	//块的起点是行首，是字符边界
+	qint64 charPos = chunk.start;
+
+	if (task->re.isNull())
+	{
+		qint64 scanEnd = qMin(chunk.end + task->needle.size() - 1, chunk.fileSize);
+		int scanLen = (int)(scanEnd - chunk.start);
+		int from = 0;
+
+		QByteArrayMatcher matcher(task->needle);
+
+		while (hits.size() < BigFileSearcher::MAX_HITS)
+		{
+			int index = matcher.indexIn(base + chunk.start, scanLen, from);
+			if (index < 0 || chunk.start + index >= chunk.end)
+			{
+				break;
+			}
+
+			//UNICODE模式下，命中必须从一个完整的字符开始
+			if ((index % task->unitSize) != 0)
+			{
+				from = index + 1;
+				continue;
+			}
+
+			//双字节编码中，从字符的尾字节开始的命中是误判
+			if (task->isMultiByte && !isCharBoundary(base, chunk.fileSize, charPos, chunk.start + index, task))
+			{
+				from = index + 1;
+				continue;
+			}
+
+			hits.append(qMakePair(chunk.start + index, chunk.start + index + task->needle.size()));
+			from = index + task->needle.size();
+		}
+	}
+	else
+	{
+		qint64 scanEnd = qMin(chunk.end + REGEX_OVERLAP_SIZE, chunk.fileSize);
+
+		boost::match_flag_type flags = boost::match_default | boost::match_not_dot_newline;
+		if (chunk.start > 0)
+		{
+			flags |= boost::match_prev_avail;
+		}
+		//扫描的尾部不是文件尾，不能当作行尾来匹配$
+		if (scanEnd < chunk.fileSize)
+		{
+			flags |= boost::match_not_eob | boost::match_not_eol;
+		}
+
+		try
+		{
+			boost::cregex_iterator it(base + chunk.start, base + scanEnd, *task->re, flags);
+			boost::cregex_iterator itEnd;
+
+			for (; it != itEnd && hits.size() < BigFileSearcher::MAX_HITS; ++it)
+			{
+				qint64 pos = (*it)[0].first - base;
+				if (pos >= chunk.end || task->isCancel)
+				{
+					break;
+				}
+
+				//空匹配在结果中没有意义
+				if ((*it)[0].length() == 0)
+				{
+					continue;
+				}
+
+				if (task->isMultiByte && !isCharBoundary(base, chunk.fileSize, charPos, pos, task))
+				{
+					continue;
+				}
+				hits.append(qMakePair(pos, (qint64)((*it)[0].second - base)));
+			}
+		}
+		catch (const std::exception&)
+		{
+			//正则过于复杂时boost会抛出异常，放弃这一块剩下的内容
+		}
+	}
+
+	//根据命中位置计算行号、行首和在编辑框中的列
+	qint64 lineNum = 0;
+	qint64 pos = chunk.start;
+	qint64 lineStart = qMax(chunk.start, chunk.bomLen);
+
+	//同一行中有多个命中时，列在上一个命中的基础上累加，避免超长的行反复从行首开始转换
+	qint64 colAddr = -1;
+	int colValue = 0;
+
+	result.records.reserve(hits.size());
+
+	for (int i = 0; i < hits.size(); ++i)
+	{
+		qint64 hitStart = hits.at(i).first;
+		qint64 hitEnd = hits.at(i).second;
+
+		qint64 eol = findEol(base, pos, hitStart, task);
+		while (eol >= 0)
+		{
+			++lineNum;
+			lineStart = eol + task->unitSize;
+			eol = findEol(base, lineStart, hitStart, task);
+		}
+		pos = hitStart;
+
+		if (colAddr < lineStart)
+		{
+			colAddr = lineStart;
+			colValue = 0;
+		}
+		colValue += utf8Length(base, colAddr, hitStart, task);
+		colAddr = hitStart;
+
+		qint64 showStart = lineStart;
+		if (hitStart - lineStart > MAX_SHOW_LINE_BYTES / 2)
+		{
+			showStart = hitStart - 128;
+
+			//utf8不能从一个字符的中间开始显示
+			if (isUtf8Like(task->code))
+			{
+				while (showStart < hitStart && (((uchar)base[showStart]) & 0xC0) == 0x80)
+				{
+					++showStart;
+				}
+			}
+		}
+
+		qint64 showLimit = qMin(showStart + MAX_SHOW_LINE_BYTES, chunk.fileSize);
+		qint64 showEnd = findEol(base, hitStart, showLimit, task);
+		if (showEnd < 0)
+		{
+			showEnd = showLimit;
+		}
+
+		FindRecord record;
+		record.lineNum = (int)lineNum;
+		record.lineAddr = lineStart;
+		record.pos = colValue;
+		record.end = colValue + utf8Length(base, hitStart, hitEnd, task);
+		record.lineStartPos = colValue - utf8Length(base, showStart, hitStart, task);
+		record.lineContents = decodeText(base, showStart, showEnd, task);
+
+		result.records.append(record);
+	}
+
+	result.lineCount = lineNum + FileManager::countLineEnds(base + pos, chunk.end - pos, task->code, task->lineEndType);
+
+	return result;
+}
+
+BigFileSearcher::BigFileSearcher(QObject* parent) : QObject(parent), m_searchId(0)
+{
+	qRegisterMetaType<QVector<FindRecord>>("QVector<FindRecord>");
+
+	connect(this, &BigFileSearcher::signInnerRecords, this, &BigFileSearcher::slot_innerRecords, Qt::QueuedConnection);
+	connect(this, &BigFileSearcher::signInnerProgress, this, &BigFileSearcher::slot_innerProgress, Qt::QueuedConnection);
+	connect(this, &BigFileSearcher::signInnerFinished, this, &BigFileSearcher::slot_innerFinished, Qt::QueuedConnection);
+}
+
+BigFileSearcher::~BigFileSearcher()
+{
+	cancel();
+	m_future.waitForFinished();
+}
+
+bool BigFileSearcher::start(QString filePath, QString whatFind, int code, int lineEndType, bool isRe, bool isCase, bool isWholeWord, QString& errMsg)
+{
+	cancel();
+
+	if (whatFind.isEmpty())
+	{
+		errMsg = tr("what find is null !");
+		return false;
+	}
+
+	QSharedPointer<BigFileSearchTask> task(new BigFileSearchTask());
+	task->filePath = filePath;
+	task->code = code;
+	task->lineEndType = lineEndType;
+	task->eolChar = (lineEndType == MAC_LINE) ? '\r' : '\n';
+	task->unitSize = (code == UNICODE_LE || code == UNICODE_BE) ? 2 : 1;
+	task->isMultiByte = isMultiByteLegacy(code);
+	task->codec = getSearchCodec(code);
+
+	QTextCodec::ConverterState state(QTextCodec::IgnoreHeader);
+	task->needle = task->codec->fromUnicode(whatFind.constData(), whatFind.size(), &state);
+
+	//忽略大小写和全词匹配，也转换为正则来查找
+	if (isRe || !isCase || isWholeWord)
+	{
+		if (task->unitSize != 1)
+		{
+			errMsg = tr("Regular expression, ignore case and whole word are not supported in UTF16 big text file !");
+			return false;
+		}
+
+		std::string pattern = isRe ? task->needle.toStdString() : escapeRegex(task->needle);
+		if (isWholeWord)
+		{
+			pattern = "\\b(?:" + pattern + ")\\b";
+		}
+
+		boost::regex::flag_type reFlags = boost::regex::perl;
+		if (!isCase)
+		{
+			reFlags |= boost::regex::icase;
+		}
+
+		try
+		{
+			task->re.reset(new boost::regex(pattern, reFlags));
+		}
+		catch (const std::exception& e)
+		{
+			errMsg = tr("Invalid regular expression : %1").arg(QString::fromLocal8Bit(e.what()));
+			return false;
+		}
+	}
+
+	task->searchId = ++m_searchId;
+
+	m_task = task;
+	m_filePath = filePath;
+	m_future = QtConcurrent::run(&BigFileSearcher::runSearch, task, this);
+
+	return true;
+}
+
+//取消后，已经排队的结果也不再发出
+void BigFileSearcher::cancel()
+{
+	if (!m_task.isNull())
+	{
+		m_task->isCancel = true;
+		m_task.clear();
+	}
+	++m_searchId;
+}
+
+bool BigFileSearcher::isRunning()
+{
+	return !m_task.isNull();
+}
+
+//后台线程中执行：映射整个文件，切分为对齐到行首的块，每次并行查找一批，再按顺序累加行号后发出
+void BigFileSearcher::runSearch(QSharedPointer<BigFileSearchTask> task, BigFileSearcher* searcher)
+{
+	NDD_TRACE_SPAN("BigFileSearcher::runSearch", task->filePath);
+
+	QFile file(task->filePath);
+
+	if (!file.open(QIODevice::ReadOnly | QIODevice::ExistingOnly))
+	{
+		emit searcher->signInnerFinished(task->searchId, 0, false);
+		return;
+	}
+
+	qint64 fileSize = file.size();
+	uchar* filePtr = (fileSize > 0) ? file.map(0, fileSize) : nullptr;
+
+	if (filePtr == nullptr)
+	{
+		file.close();
+		emit searcher->signInnerFinished(task->searchId, 0, false);
+		return;
+	}
+
+	const char* base = (const char*)filePtr;
+
+	//文件头的BOM不是第一行的内容，编辑框中也不显示
+	qint64 bomLen = 0;
+	if (task->code == UTF8_BOM && fileSize >= 3 && memcmp(base, "\xEF\xBB\xBF", 3) == 0)
+	{
+		bomLen = 3;
+	}
+	else if ((task->code == UNICODE_LE && fileSize >= 2 && memcmp(base, "\xFF\xFE", 2) == 0) || (task->code == UNICODE_BE && fileSize >= 2 && memcmp(base, "\xFE\xFF", 2) == 0))
+	{
+		bomLen = 2;
+	}
+
+	QList<SearchChunk> chunks;
+	qint64 start = 0;
+
+	while (start < fileSize)
+	{
+		qint64 end = start + SEARCH_CHUNK_SIZE;
+		if (end >= fileSize)
+		{
+			end = fileSize;
+		}
+		else
+		{
+			qint64 eol = findEol(base, end, fileSize, task.data());
+			end = (eol < 0) ? fileSize : (eol + task->unitSize);
+		}
+
+		SearchChunk chunk;
+		chunk.base = base;
+		chunk.fileSize = fileSize;
+		chunk.start = start;
+		chunk.end = end;
+		chunk.bomLen = bomLen;
+		chunk.task = task.data();
+		chunks.append(chunk);
+
+		start = end;
+	}
+
+	int batchSize = qMax(2, QThread::idealThreadCount());
+	qint64 lineBase = 0;
+	int hits = 0;
+	int lastPercent = -1;
+
+	for (int i = 0; i < chunks.size() && !task->isCancel && hits < MAX_HITS; i += batchSize)
+	{
+		QList<ChunkResult> results = QtConcurrent::blockingMapped(chunks.mid(i, batchSize), searchChunk);
+
+		QVector<FindRecord> records;
+
+		for (int j = 0; j < results.size(); ++j)
+		{
+			const ChunkResult& r = results.at(j);
+
+			for (int k = 0; k < r.records.size() && hits < MAX_HITS; ++k)
+			{
+				FindRecord record = r.records.at(k);
+				record.lineNum += (int)lineBase;
+				records.append(record);
+				++hits;
+			}
+			lineBase += r.lineCount;
+		}
+
+		if (!records.isEmpty())
+		{
+			emit searcher->signInnerRecords(task->searchId, records);
+		}
+
+		int percent = (int)(chunks.at(qMin(i + batchSize, chunks.size()) - 1).end * 100 / fileSize);
+		if (percent != lastPercent)
+		{
+			lastPercent = percent;
+			emit searcher->signInnerProgress(task->searchId, percent);
+		}
+	}
+
+	bool isCancel = task->isCancel;
+
+	file.unmap(filePtr);
+	file.close();
+
+	emit searcher->signInnerFinished(task->searchId, hits, isCancel);
+}
+
+void BigFileSearcher::slot_innerRecords(int searchId, QVector<FindRecord> records)
+{
+	if (searchId == m_searchId)
+	{
+		emit signFoundRecords(m_filePath, records);
+	}
+}
+
+void BigFileSearcher::slot_innerProgress(int searchId, int percent)
+{
+	if (searchId == m_searchId)
+	{
+		emit signProgress(m_filePath, percent);
+	}
+}
+
+void BigFileSearcher::slot_innerFinished(int searchId, int hits, bool isCancel)
+{
+	if (searchId == m_searchId)
+	{
+		m_task.clear();
+		emit signFinished(m_filePath, hits, isCancel);
+	}
+}
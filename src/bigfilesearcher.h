@@ -0,0 +1,55 @@
+﻿#pragma once
+
+#include <QObject>
+#include <QString>
+#include <QVector>
+#include <QFuture>
+#include <QSharedPointer>
+
+#include "findwin.h"
+
+struct BigFileSearchTask;
+
+//大文本（BIG_TEXT_RO_TYPE/SUPER_BIG_TEXT_RO_TYPE）的全文件查找。编辑框中只有当前块的内容，
+//这里直接在映射的整个文件上，分块并行查找。块边界对齐到行首，每批块查完后按顺序发出结果，结果中的行号是文件中的行号
+class BigFileSearcher : public QObject
+{
+	Q_OBJECT
+
+public:
+	BigFileSearcher(QObject* parent = nullptr);
+	virtual ~BigFileSearcher();
+
+	bool start(QString filePath, QString whatFind, int code, int lineEndType, bool isRe, bool isCase, bool isWholeWord, QString& errMsg);
+	void cancel();
+	bool isRunning();
+
+	//结果过多时停止查找，避免结果窗口过大
+	static const int MAX_HITS = 100000;
+
+signals:
+	void signFoundRecords(QString filePath, QVector<FindRecord> records);
+	void signProgress(QString filePath, int percent);
+	void signFinished(QString filePath, int hits, bool isCancel);
+
+	//下面三个是后台线程内部使用的，带上查找序号，过滤掉已经取消的查找发过来的结果
+	void signInnerRecords(int searchId, QVector<FindRecord> records);
+	void signInnerProgress(int searchId, int percent);
+	void signInnerFinished(int searchId, int hits, bool isCancel);
+
+private slots:
+	void slot_innerRecords(int searchId, QVector<FindRecord> records);
+	void slot_innerProgress(int searchId, int percent);
+	void slot_innerFinished(int searchId, int hits, bool isCancel);
+
+private:
+	static void runSearch(QSharedPointer<BigFileSearchTask> task, BigFileSearcher* searcher);
+
+	BigFileSearcher(const BigFileSearcher&) = delete;
+	BigFileSearcher& operator=(const BigFileSearcher&) = delete;
+
+	QSharedPointer<BigFileSearchTask> m_task;
+	QFuture<void> m_future;
+	QString m_filePath;
+	int m_searchId;
+};
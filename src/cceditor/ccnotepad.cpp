@@ -5,6 +5,11 @@
 #include "findwin.h"
 #include "nddsetting.h"
 #include "findresultwin.h"
+#include "bigfilesearcher.h"
+#include "textformatter.h"
+#include "plugintaskpool.h"
+#include "nddtrace.h"
+#include "progresswin.h"
 #include "scintillaeditview.h"
 #include "scintillahexeditview.h"
 #include "encodeconvert.h"
@@ -26,6 +31,7 @@
 #include "langextset.h"
 #include "shortcutkeymgr.h"
 #include "md5hash.h"
+#include "memoryoverviewwin.h"
 #include "CmpareMode.h"
 
 #ifdef NO_PLUGIN
@@ -67,6 +73,8 @@
 #include <QWidgetAction>
 #include <QListWidgetItem>
 #include <QLibrary>
+#include <QTemporaryFile>
+#include <algorithm>
 
 #include "Sorters.h"
 
@@ -127,6 +135,19 @@ static const char* Doc_Type = "type";
 //tail状态 0 关闭 1开启
 static const char* Tail_Status = "tail";
 
+//最后一次是当前标签页的时间，毫秒
+static const char* Tab_Last_Active = "lastactive";
+
+//后台时已经释放过缓存和样式 true false
+static const char* Tab_Trimmed = "trimmed";
+
+//文本已经释放，激活时从磁盘重新加载 true false
+static const char* Tab_Text_Released = "released";
+
+//释放文本时的光标位置和第一个可见行
+static const char* Tab_Released_Pos = "releasedpos";
+static const char* Tab_Released_Line = "releasedline";
+
 static const int MSG_EXIST_TIME = 8000;
 
 void setFileOpenAttrProperty(QWidget* pwidget, OpenAttr attr)
@@ -463,6 +484,7 @@ int CCNotePad::s_restoreLastFile = 1;//自动恢复上次打开的文件
 int CCNotePad::s_curStyleId = 0;
 int CCNotePad::s_curMarkColorId = SCE_UNIVERSAL_FOUND_STYLE_EXT5;
 int CCNotePad::s_hightWebAddr = 0;
+int CCNotePad::s_wordComplete = 1;
 
 //lexerName to index
 
@@ -1097,10 +1119,12 @@ LexerInfo CCNotePad::getLangLexerIdByFileExt(QString filePath)
 
 CCNotePad::CCNotePad(bool isMainWindows, QWidget *parent)
 	: QMainWindow(parent), m_cutFile(nullptr),m_copyFile(nullptr), m_dockSelectTreeWin(nullptr), \
-	m_pResultWin(nullptr),m_isQuitCancel(false), m_tabRightClickMenu(nullptr), m_shareMem(nullptr),m_isMainWindows(isMainWindows),\
-	m_openInNewWinAct(nullptr), m_showFileDirAct(nullptr), m_showCmdAct(nullptr), m_timerAutoSave(nullptr), m_curColorIndex(-1), \
+	m_pResultWin(nullptr), m_bigFileSearcher(nullptr), m_textFormatter(nullptr), m_formatInPlace(false), m_formatOutput(nullptr), m_isQuitCancel(false), m_tabRightClickMenu(nullptr), m_shareMem(nullptr),m_isMainWindows(isMainWindows),\
+	m_openInNewWinAct(nullptr), m_showFileDirAct(nullptr), m_showCmdAct(nullptr), m_timerAutoSave(nullptr), m_tabTrimTimer(nullptr), m_tabTrimMinutes(0), m_tabMemoryBudget(0), m_isTabTrimText(false), m_curColorIndex(-1), \
 	m_fileListView(nullptr), m_isInReloadFile(false), m_isToolMenuLoaded(false), m_isRecentFileLoaded(false)
 {
+	NDD_TRACE_SPAN("CCNotePad::CCNotePad");
+
 	ui.setupUi(this);
 
 #ifdef Q_OS_MAC
@@ -1198,6 +1222,8 @@ CCNotePad::CCNotePad(bool isMainWindows, QWidget *parent)
 	m_fileWatch = new QFileSystemWatcher(this);
 	connect(m_fileWatch,&QFileSystemWatcher::fileChanged,this, &CCNotePad::slot_fileChange);
 
+	initTabTrim();
+
 
 	//只有主窗口才监控openwith的文件
 	if (isMainWindows)
@@ -1231,6 +1257,8 @@ CCNotePad::~CCNotePad()
 //先快速让窗口展示处理，后续再去做复杂的初始化
 void CCNotePad::quickshow()
 {
+	NDD_TRACE_SPAN("CCNotePad::quickshow");
+
 	QByteArray lastGeo = NddSetting::getKeyByteArrayValue(WIN_POS);
 
 	if (!lastGeo.isEmpty())
@@ -1328,6 +1356,10 @@ void CCNotePad::quickshow()
 	}
 	connect(m_fileWatch, &QFileSystemWatcher::fileChanged, this, &CCNotePad::slot_fileChange);
 
+	//超大文本在后台建立行索引的进度和结果
+	connect(&FileManager::getInstance(), &FileManager::signLineIndexProgress, this, &CCNotePad::slot_superBigLineIndexProgress);
+	connect(&FileManager::getInstance(), &FileManager::signLineIndexFinished, this, &CCNotePad::slot_superBigLineIndexFinished);
+
 
 	//只有主窗口才监控openwith的文件
 	if (m_isMainWindows)
@@ -1370,6 +1402,9 @@ void CCNotePad::quickshow()
 		s_hightWebAddr = 1;
 		ui.actionShow_Web_Addr->setChecked(true);
 	}
+	//单词自动补全。默认开启
+	s_wordComplete = (1 == NddSetting::getKeyValueFromNumSets(WORD_COMPLETE_OFF)) ? 0 : 1;
+	ui.actionWord_Complete->setChecked(s_wordComplete == 1);
 
 	//恢复用户自定义快捷键
 	setUserDefShortcutKey();
@@ -1694,7 +1729,10 @@ void CCNotePad::slot_dynamicLoadToolMenu()
 
 		QMenu* formatMenu = new QMenu(tr("Format Language"), this);
 		m_formatXml = formatMenu->addAction(tr("Format Xml"), this, &CCNotePad::slot_formatXml);
+		formatMenu->addAction(tr("Minify Xml"), this, &CCNotePad::slot_minifyXml);
 		m_formatJson = formatMenu->addAction(tr("Format Json"), this, &CCNotePad::slot_formatJson);
+		formatMenu->addAction(tr("Minify Json"), this, &CCNotePad::slot_minifyJson);
+		formatMenu->addAction(tr("Format Json To New Tab"), this, &CCNotePad::slot_formatJsonToNewTab);
 		ui.menuTools->addMenu(formatMenu);
 
 		QAction* pAct = nullptr;
@@ -1721,6 +1759,191 @@ void  CCNotePad::slot_pluginMgr()
 #endif
 }
 
+//后台标签页的内存释放。没有配置时默认10分钟没有激活就释放，所有标签页超过1G时提前释放最久没有激活的
+void CCNotePad::initTabTrim()
+{
+	auto getNumSet = [](const QString& key, int defValue)->int {
+		QString v = NddSetting::getKeyValueFromDelaySets(key);
+		return v.isEmpty() ? defValue : v.toInt();
+	};
+
+	m_tabTrimMinutes = getNumSet(TAB_TRIM_MINUTES, 10);
+	m_tabMemoryBudget = (qint64)getNumSet(TAB_MEMORY_BUDGET, 1024) * 1024 * 1024;
+	m_isTabTrimText = (1 == getNumSet(TAB_TRIM_TEXT, 0));
+
+	if (m_tabTrimMinutes <= 0 && m_tabMemoryBudget <= 0)
+	{
+		return;
+	}
+
+	m_tabTrimTimer = new QTimer(this);
+	connect(m_tabTrimTimer, &QTimer::timeout, this, &CCNotePad::slot_trimBackgroundTabs);
+	m_tabTrimTimer->start(60 * 1000);
+}
+
+void CCNotePad::slot_trimBackgroundTabs()
+{
+	NDD_TRACE_SPAN("CCNotePad::slot_trimBackgroundTabs");
+
+	qint64 now = QDateTime::currentMSecsSinceEpoch();
+
+	//当前标签页一直算作刚激活，离开后从最后一次检查的时间开始计算
+	QWidget* curWidget = ui.editTabWidget->currentWidget();
+	if (curWidget != nullptr)
+	{
+		curWidget->setProperty(Tab_Last_Active, now);
+	}
+
+	QList<ScintillaEditView*> backTabs;
+	qint64 totalMemory = 0;
+
+	for (int i = 0; i < ui.editTabWidget->count(); ++i)
+	{
+		//十六进制标签页不是ScintillaEditView
+		ScintillaEditView* pEdit = qobject_cast<ScintillaEditView*>(ui.editTabWidget->widget(i));
+		if (pEdit == nullptr)
+		{
+			continue;
+		}
+
+		if (m_tabMemoryBudget > 0)
+		{
+			totalMemory += pEdit->memoryUsage().total();
+		}
+
+		//后台打开后还没有激活过的，从第一次检查开始计算
+		if (!pEdit->property(Tab_Last_Active).isValid())
+		{
+			pEdit->setProperty(Tab_Last_Active, now);
+		}
+
+		if (pEdit != curWidget && !pEdit->property(Tab_Trimmed).toBool())
+		{
+			backTabs.append(pEdit);
+		}
+	}
+
+	//最久没有激活的先释放
+	std::stable_sort(backTabs.begin(), backTabs.end(), [](ScintillaEditView* a, ScintillaEditView* b) {
+		return a->property(Tab_Last_Active).toLongLong() < b->property(Tab_Last_Active).toLongLong();
+	});
+
+	for (ScintillaEditView* pEdit : backTabs)
+	{
+		qint64 idleTime = now - pEdit->property(Tab_Last_Active).toLongLong();
+
+		bool isIdle = (m_tabTrimMinutes > 0) && (idleTime >= (qint64)m_tabTrimMinutes * 60 * 1000);
+		bool isOverBudget = (m_tabMemoryBudget > 0) && (totalMemory > m_tabMemoryBudget);
+
+		if (!isIdle && !isOverBudget)
+		{
+			continue;
+		}
+
+		qint64 before = (m_tabMemoryBudget > 0) ? pEdit->memoryUsage().total() : 0;
+		trimTabMemory(pEdit);
+		if (m_tabMemoryBudget > 0)
+		{
+			totalMemory -= before - pEdit->memoryUsage().total();
+		}
+	}
+}
+
+//释放可以重建的部分：布局和位置缓存、样式。激活后显示时重新着色
+void CCNotePad::trimTabMemory(ScintillaEditView* pEdit)
+{
+	pEdit->trimMemory(true);
+
+	if (m_isTabTrimText && canReleaseTabText(pEdit))
+	{
+		releaseTabText(pEdit);
+	}
+
+	pEdit->setProperty(Tab_Trimmed, true);
+}
+
+//只有磁盘上有一样内容的普通文本文件才释放文本
+bool CCNotePad::canReleaseTabText(ScintillaEditView* pEdit)
+{
+	if (TXT_TYPE != getDocTypeProperty(pEdit) || -1 != getFileNewIndexProperty(pEdit))
+	{
+		return false;
+	}
+
+	if (getTextChangeProperty(pEdit) || pEdit->property(Modify_Outside).toBool() || getFileTailProperty(pEdit) == 1)
+	{
+		return false;
+	}
+
+	if (pEdit->property(Tab_Text_Released).toBool() || !QFileInfo::exists(getFilePathProperty(pEdit)))
+	{
+		return false;
+	}
+
+	return pEdit->canReleaseText();
+}
+
+void CCNotePad::releaseTabText(ScintillaEditView* pEdit)
+{
+	pEdit->setProperty(Tab_Released_Pos, (qint64)pEdit->execute(SCI_GETCURRENTPOS));
+	pEdit->setProperty(Tab_Released_Line, (qint64)pEdit->execute(SCI_GETFIRSTVISIBLELINE));
+
+	bool isReadOnly = pEdit->isReadOnly();
+
+	//清空不算修改，不要改变脏状态
+	disEnableEditTextChangeSign(pEdit);
+	pEdit->setReadOnly(false);
+	pEdit->clear();
+	pEdit->execute(SCI_EMPTYUNDOBUFFER);
+	pEdit->execute(SCI_SETSAVEPOINT);
+	pEdit->setReadOnly(isReadOnly);
+	enableEditTextChangeSign(pEdit);
+
+	pEdit->trimMemory();
+	pEdit->setProperty(Tab_Text_Released, true);
+}
+
+void CCNotePad::restoreTabText(ScintillaEditView* pEdit)
+{
+	if (pEdit == nullptr)
+	{
+		return;
+	}
+
+	pEdit->setProperty(Tab_Text_Released, false);
+
+	QString filePath = getFilePathProperty(pEdit);
+	bool isReadOnly = pEdit->isReadOnly();
+
+	disEnableEditTextChangeSign(pEdit);
+	pEdit->setReadOnly(false);
+	int errCode = FileManager::getInstance().reloadFileText(pEdit, filePath, (CODE_ID)getCodeTypeProperty(pEdit));
+	pEdit->execute(SCI_EMPTYUNDOBUFFER);
+	pEdit->execute(SCI_SETSAVEPOINT);
+	pEdit->setReadOnly(isReadOnly);
+	enableEditTextChangeSign(pEdit);
+
+	if (errCode != 0)
+	{
+		ui.statusBar->showMessage(tr("reload file %1 failed").arg(filePath), MSG_EXIST_TIME);
+		QMessageBox::warning(this, tr("Error"), tr("The content of %1 was released from memory and can not be reloaded from the disk.").arg(filePath));
+		return;
+	}
+
+	pEdit->execute(SCI_SETFIRSTVISIBLELINE, pEdit->property(Tab_Released_Line).toLongLong());
+	pEdit->execute(SCI_GOTOPOS, pEdit->property(Tab_Released_Pos).toLongLong());
+	pEdit->execute(SCI_SETFIRSTVISIBLELINE, pEdit->property(Tab_Released_Line).toLongLong());
+}
+
+//各标签页的内存占用。查找窗口没有创建时，不统计它的后台编辑框
+void CCNotePad::slot_memoryOverview()
+{
+	MemoryOverviewWin* pWin = new MemoryOverviewWin(ui.editTabWidget, qobject_cast<FindWin*>(m_pFindWin.data()), this);
+	pWin->setWindowFlag(Qt::Window);
+	pWin->setAttribute(Qt::WA_DeleteOnClose);
+	pWin->show();
+}
+
 #ifdef NO_PLUGIN
 void CCNotePad::loadPluginLib()
 {
@@ -1743,7 +1966,7 @@ void CCNotePad::onPlugFound(NDD_PROC_DATA& procData, QMenu* pUserData)
 		return;
 	}
 
-	//创建action
+	//创建action。插件库在第一次点击菜单时才加载，启动时只用识别信息创建菜单
 	if (procData.m_menuType == 0)
 	{
 		QAction* pAction = new QAction(procData.m_strPlugName, pMenu);
@@ -1751,19 +1974,19 @@ void CCNotePad::onPlugFound(NDD_PROC_DATA& procData, QMenu* pUserData)
 	pAction->setText(procData.m_strPlugName);
 	pAction->setData(procData.m_strFilePath);
 		procData.m_pAction = pAction;
-		sendParaToPlugin(procData);
 
-		//connect(pAction, &QAction::triggered, this, &CCNotePad::onPlugWork);
+		connect(pAction, &QAction::triggered, this, &CCNotePad::onPlugWork);
 	}
 	else if (procData.m_menuType == 1)
 	{
 		//创建二级菜单
 		QMenu* pluginMenu = new QMenu(procData.m_strPlugName, pMenu);
 		pMenu->addMenu(pluginMenu);
+		pluginMenu->menuAction()->setData(procData.m_strFilePath);
 
-		//菜单句柄通过procData传递到插件中
+		//菜单句柄通过procData传递到插件中，二级菜单由插件在第一次展开时创建
 		procData.m_rootMenu = pluginMenu;
-		sendParaToPlugin(procData);
+		connect(pluginMenu, &QMenu::aboutToShow, this, &CCNotePad::slot_loadPluginMenu);
 	}
 	else
 	{
@@ -1808,43 +2031,58 @@ bool pluginInvoke(QWidget* parent, int cmdId, void* data)
 	return false;
 }
 
-//真正执行插件的工作。这是在不需要执行二级菜单的情况下，调用的插件执行函数
-void CCNotePad::onPlugWork(bool check)
+//真正执行插件的工作。这是在不需要执行二级菜单的情况下，第一次点击插件菜单时加载插件。
+//插件在NDD_PROC_MAIN中把自己的处理函数连接到菜单上，加载后再触发一次，执行这次点击
+void CCNotePad::onPlugWork(bool /*check*/)
 {
 	QAction* pAct = dynamic_cast<QAction*>(sender());
 	if (pAct != nullptr)
 	{
-		QString plugPath = pAct->data().toString();
-
-		QLibrary* pLib = new QLibrary(plugPath);
-
-		NDD_PROC_MAIN_CALLBACK pMainCallBack;
-		pMainCallBack = (NDD_PROC_MAIN_CALLBACK)pLib->resolve("NDD_PROC_MAIN");
+		disconnect(pAct, &QAction::triggered, this, &CCNotePad::onPlugWork);
 
-		if (pMainCallBack != NULL)
+		NDD_PROC_DATA* pProcData = findPluginData(pAct->data().toString());
+		if ((pProcData != nullptr) && sendParaToPlugin(*pProcData))
 		{
-			std::function<QsciScintilla* (QWidget*)> foundCallBack = std::bind(&::getCurEditView, std::placeholders::_1);
-			std::function<bool(QWidget* ,int, void*)> pluginCallBack = std::bind(&::pluginInvoke, std::placeholders::_1, std::placeholders::_2, std::placeholders::_3);
-
-			try {
-			pMainCallBack(this, plugPath, foundCallBack, pluginCallBack, nullptr);
-		}
-			catch (...)
-			{
-				ui.statusBar->showMessage(tr("plugin %1 load failed !").arg(plugPath));
-				QApplication::beep();
-			}
+			pAct->trigger();
 		}
 		else
 		{
-			ui.statusBar->showMessage(tr("plugin %1 load failed !").arg(plugPath), 10000);
+			//加载失败，下次点击时再试
+			connect(pAct, &QAction::triggered, this, &CCNotePad::onPlugWork);
+		}
+	}
+}
+
+//有二级菜单的插件，第一次展开菜单时加载插件，由插件创建二级菜单
+void CCNotePad::slot_loadPluginMenu()
+{
+	QMenu* pluginMenu = dynamic_cast<QMenu*>(sender());
+	if (pluginMenu != nullptr)
+	{
+		disconnect(pluginMenu, &QMenu::aboutToShow, this, &CCNotePad::slot_loadPluginMenu);
+
+		NDD_PROC_DATA* pProcData = findPluginData(pluginMenu->menuAction()->data().toString());
+		if ((pProcData == nullptr) || !sendParaToPlugin(*pProcData))
+		{
+			connect(pluginMenu, &QMenu::aboutToShow, this, &CCNotePad::slot_loadPluginMenu);
 		}
+	}
+}
 
+NDD_PROC_DATA* CCNotePad::findPluginData(const QString& plugPath)
+{
+	for (int i = 0; i < m_pluginList.size(); ++i)
+	{
+		if (m_pluginList.at(i).m_strFilePath == plugPath)
+		{
+			return &m_pluginList[i];
+		}
 	}
+	return nullptr;
 }
 
-//把插件需要的参数，传递到插件中去
-void CCNotePad::sendParaToPlugin(NDD_PROC_DATA& procData)
+//把插件需要的参数，传递到插件中去。这里才真正加载插件库
+bool CCNotePad::sendParaToPlugin(NDD_PROC_DATA& procData)
 {
 	QString plugPath = procData.m_strFilePath;
 
@@ -1860,6 +2098,7 @@ void CCNotePad::sendParaToPlugin(NDD_PROC_DATA& procData)
 
 			try {
 			pMainCallBack(this, plugPath, foundCallBack, pluginCallBack, &procData);
+			return true;
 		}
 			catch (...)
 			{
@@ -1871,13 +2110,17 @@ void CCNotePad::sendParaToPlugin(NDD_PROC_DATA& procData)
 		{
 			ui.statusBar->showMessage(tr("plugin %1 load failed !").arg(plugPath), 10000);
 		}
+	return false;
 }
 
 void CCNotePad::loadPluginProcs(QString strLibDir, QMenu* pMenu)
 {
 	std::function<void(NDD_PROC_DATA&, QMenu*)> foundCallBack = std::bind(&CCNotePad::onPlugFound, this, std::placeholders::_1, std::placeholders::_2);
 
-	int nRet = loadProc(strLibDir, foundCallBack, pMenu);
+	//自动语言时跟随系统语言
+	QString langTag = QString("%1_%2").arg(m_curSoftLangs).arg(QLocale::system().name());
+
+	int nRet = loadProc(strLibDir, foundCallBack, pMenu, langTag);
 	if (nRet > 0)
 	{
 		ui.statusBar->showMessage(tr("load plugin in dir %1 success, plugin num %2").arg(strLibDir).arg(nRet));
@@ -2705,6 +2948,14 @@ void CCNotePad::slot_tabCurrentChanged(int index)
 	QWidget* pw = ui.editTabWidget->widget(index);
 	if (pw != nullptr)
 	{
+		pw->setProperty(Tab_Last_Active, QDateTime::currentMSecsSinceEpoch());
+		pw->setProperty(Tab_Trimmed, false);
+
+		if (pw->property(Tab_Text_Released).toBool())
+		{
+			restoreTabText(dynamic_cast<ScintillaEditView*>(pw));
+		}
+
 		QString filePath = getFilePathProperty(pw);
 		//16进制的处理逻辑
 		int docType = getDocTypeProperty(pw);
@@ -2953,6 +3204,8 @@ void CCNotePad::setShoctIcon(int iconSize)
 
 void CCNotePad::initToolBar()
 {
+	NDD_TRACE_SPAN("CCNotePad::initToolBar");
+
 	int iconIndex = NddSetting::getKeyValueFromNumSets(ICON_SIZE);
 
 	int ICON_SIZE = 24;
@@ -3816,8 +4069,21 @@ void  CCNotePad::slot_LineNumIndexChange(int line, int index)
 	case BIG_EDIT_RW_TYPE:
 		break;//暂时没有
 	case SUPER_BIG_TEXT_RO_TYPE:
+	{
+		//超大文本在后台行索引建立完成后，才能显示真实的行号
+		TextFileMgr* fileMgr = FileManager::getInstance().getSuperBigFileMgr(getFilePathProperty(pEdit));
+		if (fileMgr != nullptr && fileMgr->curStartLineNum >= 0)
+		{
+			lineNums = tr("Ln: %1	Col: %2").arg(fileMgr->curStartLineNum + line + 1).arg(index);
+		}
+		else
+		{
+			lineNums = tr("Ln: %1	Col: %2").arg("unknown").arg(index);
+		}
+	}
+		break;
 	case HEX_TYPE:
-		//这两种是没有行号的，只有列号
+		//这种是没有行号的，只有列号
 		lineNums = tr("Ln: %1	Col: %2").arg("unknown").arg(index);
 		break;
 	default:
@@ -4352,6 +4618,9 @@ bool CCNotePad::reloadTextFileWithCode(CODE_ID code)
 				//如果切换了编码，可能乱码，把当前的行号缓存清空一下，因为旧行号已经没有意义了。
 				pEdit->clearSuperBitLineCache();
 
+				//UNICODE和单字节编码的换行识别方式不同，行索引要按新编码重新建立
+				FileManager::getInstance().startSuperBigLineIndex(fileMgr);
+
 				pEdit->showBigTextLineAddr(fileMgr->fileOffset - fileMgr->contentRealSize, fileMgr->fileOffset);
 
 			}
@@ -4493,6 +4762,9 @@ bool CCNotePad::openSuperBigTextFile(QString filePath)
 	showBigTextFile(pEdit, txtFile);
 	lineEnd = (RC_LINE_FORM)txtFile->lineEndType;
 
+	//编码和行尾在showBigTextFile中才确定下来，之后在后台建立行索引，用于行号显示和跳转
+	FileManager::getInstance().startSuperBigLineIndex(txtFile);
+
 	disconnect(ui.editTabWidget, &QTabWidget::currentChanged, this, &CCNotePad::slot_tabCurrentChanged);
 	int curIndex = ui.editTabWidget->addTab(pEdit, QIcon((StyleSet::getCurrentSytleId() != DEEP_BLACK) ? TabNoNeedSave : TabNoNeedSaveDark32), getShortName(fileLabel));
 
@@ -4577,6 +4849,8 @@ const quint64 MAX_TRY_OPEN_FILE_SIZE = 1024 * 1024 * 1024;
 //打开普通文本文件。
 bool CCNotePad::openTextFile(QString filePath, bool isCheckHex, CODE_ID code)
 {
+	NDD_TRACE_SPAN("CCNotePad::openTextFile", filePath);
+
 	getRegularFilePath(filePath);
 
 	//先检测交换文件是否存在，如果存在，说明上次崩溃了，提示用户恢复
@@ -4584,6 +4858,12 @@ bool CCNotePad::openTextFile(QString filePath, bool isCheckHex, CODE_ID code)
 
 	bool isNeedRestoreFile = false;
 
+	//大文件以可编辑方式打开时，先尝试映射文件，不读取整个文件
+	bool isTryMapped = false;
+
+	//1G以上的文件只有能映射时才编辑打开，不能映射时按大小只读打开
+	bool isMappedOnly = false;
+
 	QFileInfo fi(filePath);
 
 	//如果文件大于设定最大值,询问是否只读文件打开
@@ -4608,7 +4888,8 @@ bool CCNotePad::openTextFile(QString filePath, bool isCheckHex, CODE_ID code)
 			}
 			else if (openMode == TXT_TYPE)
 			{
-				//正常普通文本打开，不做什么，继续往下走
+				//正常普通文本打开，继续往下走
+				isTryMapped = true;
 			}
 			else if (openMode == BIG_TEXT_RO_TYPE)
 			{
@@ -4628,10 +4909,11 @@ bool CCNotePad::openTextFile(QString filePath, bool isCheckHex, CODE_ID code)
 		}
 		else
 		{
-			//如果小于8G，则大文本只读打开;反之则超大文本只读打开
+			//如果小于8G，先尝试映射编辑，不能映射的再大文本只读打开;反之则超大文本只读打开
 			if (fi.size() <= 8 * MAX_TRY_OPEN_FILE_SIZE)
 			{
-				return openBigTextRoFile(filePath);
+				isTryMapped = true;
+				isMappedOnly = true;
 		}
 			else
 			{
@@ -4674,7 +4956,17 @@ bool CCNotePad::openTextFile(QString filePath, bool isCheckHex, CODE_ID code)
 	bool isReadOnly = false;
 
 	//如果需要恢复，则加载交换文件的内容。
-	if (!isNeedRestoreFile)
+	if (!isNeedRestoreFile && isTryMapped && (0 == FileManager::getInstance().loadFileDataMapped(pEdit, filePath, code, lineEnd)))
+	{
+		//映射成功，文档直接引用文件内容
+	}
+	else if (!isNeedRestoreFile && isMappedOnly)
+	{
+		//目前只映射UTF8文件，其它编码的大文件还是只读打开
+		delete pEdit;
+		return openBigTextRoFile(filePath);
+	}
+	else if (!isNeedRestoreFile)
 	{
 		int ret = FileManager::getInstance().loadFileDataInText(pEdit, filePath, code, lineEnd, this, isCheckHex,this);
 		if (4 == ret)
@@ -4969,7 +5261,22 @@ bool CCNotePad::showBigTextFile(ScintillaEditView* pEdit, TextFileMgr* txtFile)
 
 	pEdit->setText(outUtf8Text);
 
-	if (tranSucess)
+	//后台行索引建立好后，可以精确计算出当前内容首行的行号
+	qint64 totalLines = 0;
+	txtFile->curStartLineNum = FileManager::getInstance().getSuperBigLineNumAt(txtFile->filePath, addr);
+
+	if (txtFile->curStartLineNum >= 0)
+	{
+		pEdit->addSuperBigLineCache(addr, txtFile->curStartLineNum + 1);
+		FileManager::getInstance().isSuperBigLineIndexReady(txtFile->filePath, &totalLines);
+	}
+
+	if (tranSucess && totalLines > 0)
+	{
+		ui.statusBar->showMessage(tr("Current offset is %1 , line nums is %2 - %3 of %4 (%5%), File Total Size is %6").arg(addr).arg(txtFile->curStartLineNum + 1)
+			.arg(txtFile->curStartLineNum + pEdit->lines()).arg(totalLines).arg((txtFile->curStartLineNum + pEdit->lines()) * 100 / totalLines).arg(txtFile->fileSize));
+	}
+	else if (tranSucess)
 	{
 	ui.statusBar->showMessage(tr("Current offset is %1 , load Contens Size is %2, File Total Size is %3").arg(addr).arg(txtFile->contentRealSize).arg(txtFile->fileSize));
 	}
@@ -5305,6 +5612,8 @@ bool CCNotePad::tryRestoreFile(QString filePath)
 }
 bool CCNotePad::openFile(QString filePath, int lineNum)
 {
+	NDD_TRACE_SPAN("CCNotePad::openFile", filePath);
+
 	s_padTimes++;
 	//如果是相对路径
 	getRegularFilePath(filePath);
@@ -5365,6 +5674,22 @@ bool CCNotePad::openFile(QString filePath, int lineNum)
 	return ret;
 }
 
+//其它ndd进程转发过来的一批打开请求。全部打开后只激活一次窗口
+void CCNotePad::slot_openRequests(const QList<OpenRequest>& requests)
+{
+	for (const OpenRequest& request : requests)
+	{
+		openFile(request.filePath, request.lineNum);
+	}
+
+	if (this->isMinimized())
+	{
+		this->showNormal();
+	}
+	this->raise();
+	this->activateWindow();
+}
+
 void CCNotePad::slot_slectionChanged()
 {
 	ScintillaEditView* pEdit = dynamic_cast<ScintillaEditView*>(sender());
@@ -5415,12 +5740,28 @@ void hide_file(const QString& szFile)
 #endif // _WIN32
 #endif
 
+//保存时使用的编码。如果编码是已知如下类型，则后续保存其它行时，不修改编码格式，继续按照原编码进行保存
+//对于其它非识别编码，统一转换为utf8。减去让用户选择的麻烦
+static CODE_ID getSaveTextCode(ScintillaEditView* pEdit)
+{
+	CODE_ID dstCode = static_cast<CODE_ID>(pEdit->property(Edit_Text_Code).toInt());
+
+	if (dstCode != CODE_ID::UNICODE_BE && dstCode != CODE_ID::UNICODE_LE && dstCode != CODE_ID::UTF8_BOM
+		&& dstCode != CODE_ID::GBK && dstCode != CODE_ID::BIG5)
+	{
+		dstCode = CODE_ID::UTF8_NOBOM;
+	}
+	return dstCode;
+}
+
 //bool isBakWrite:是否进行保护写，即先写swap文件，再写源文件。这样可以避免突然断电导致源文件被清空
 //isBakWrite 是否写保护swp文件，默认true。只有新文件时不需要，因为新文件不存在覆盖写的问题
 //isStatic 是否静默：不弹出对话框，在外部批量查找替换文件夹时使用，避免弹窗中断。默认false
 //isClearSwpFile:是否回收swp交换文件，在外部批量查找替换文件夹时使用，替换后直接删除swp文件。默认false
 bool  CCNotePad::saveFile(QString fileName, ScintillaEditView* pEdit, bool isBakWrite, bool isStatic, bool isClearSwpFile)
 {
+	NDD_TRACE_SPAN("CCNotePad::saveFile", fileName);
+
 	QFile srcfile(fileName);
 
 	//如果文件存在，说明是旧文件，检测是否能写，不能写则失败。
@@ -5449,6 +5790,17 @@ bool  CCNotePad::saveFile(QString fileName, ScintillaEditView* pEdit, bool isBak
 		isNewFile = true;
 	}
 
+	//映射打开的大文件不论保存成什么编码，都不能截断文档引用着的文件，单独处理
+	if (pEdit->execute(SCI_GETTEXTMAPPED))
+	{
+		//文本被删空后没有可映射的内容，复制出来不再引用文件，按普通文本保存
+		if (pEdit->execute(SCI_GETLENGTH) > 0)
+		{
+			return saveMappedFile(fileName, pEdit, isBakWrite, isStatic, isClearSwpFile);
+		}
+		pEdit->execute(SCI_GETCHARACTERPOINTER);
+	}
+
 	auto saveWork = [this, &pEdit,isStatic](QFile& file, QString &fileName, bool isSwapFile=false)->bool{
 
 	if (!file.open(QIODevice::ReadWrite | QIODevice::Truncate))
@@ -5486,56 +5838,12 @@ bool  CCNotePad::saveFile(QString fileName, ScintillaEditView* pEdit, bool isBak
 		return false;
 	}
 
-	QString textOut = pEdit->text();
-
-	CODE_ID dstCode = static_cast<CODE_ID>(pEdit->property(Edit_Text_Code).toInt());
-
-	//如果编码是已知如下类型，则后续保存其它行时，不修改编码格式，继续按照原编码进行保存
-	if (dstCode == CODE_ID::UNICODE_BE)
-	{
-		QTextCodec::setCodecForLocale(QTextCodec::codecForName("UTF-16BE"));
-	}
-	else if (dstCode == CODE_ID::UNICODE_LE)
-	{
-		QTextCodec::setCodecForLocale(QTextCodec::codecForName("UTF-16LE"));
-	}
-	else if (dstCode == CODE_ID::UTF8_BOM)
-	{
-		QTextCodec::setCodecForLocale(QTextCodec::codecForName("UTF-8"));
-
-		//自动转换不会带UTF-8 BOM，所以自己要在前面写个BOM头。这是一个例外。需要手动写入头
-		//其他编码BL LE则不需要。
-		QByteArray codeFlag = Encode::getEncodeStartFlagByte(dstCode);
-
-		if (!codeFlag.isEmpty())
-		{
-			//先写入标识头
-			file.write(codeFlag);
-		}
-	}
-	else if (dstCode == CODE_ID::GBK)
-	{
-		QTextCodec::setCodecForLocale(QTextCodec::codecForName("GBK"));
-	}
-	else if (dstCode == CODE_ID::BIG5)
-	{
-		QTextCodec::setCodecForLocale(QTextCodec::codecForName("BIG5-HKSCS"));
-	}
-	else
-	{
-		//对于其它非识别编码，统一转换为utf8。减去让用户选择的麻烦
-		QTextCodec::setCodecForLocale(QTextCodec::codecForName("UTF-8"));
-	}
-
+	CODE_ID dstCode = getSaveTextCode(pEdit);
 
-	if (textOut.length() > 0)
-	{
-		//保存时注意编码问题。这个tolocal已经带了字符BOM头了。只有UTF8_BOM不会带，其他BE LE都会带
-		QByteArray t = textOut.toLocal8Bit();
-		file.write(textOut.toLocal8Bit());
-	}
+	//编辑器的文本分块转码写入，不生成整个文本的QString，也不再修改全局的locale编码。BOM由编码器写入
+	bool success = FileManager::getInstance().writeEditText(pEdit, file, dstCode);
 	file.close();
-	return true;
+	return success;
 	};
 
 	//如果是新文件，第一次保存，直接保存
@@ -5582,6 +5890,75 @@ bool  CCNotePad::saveFile(QString fileName, ScintillaEditView* pEdit, bool isBak
 	return true;
 }
 
+//保存映射打开的文件。文档引用着的文件不能被截断，否则读取映射时崩溃。
+//要覆盖文档引用的文件或者保护写时，先把文档的UTF8文本写到交换文件，让文档改为引用交换文件，再写目标文件。
+//目标是UTF8时文档最后改为引用目标文件；其它编码的字节和文档不同，文档继续引用交换文件
+bool CCNotePad::saveMappedFile(QString fileName, ScintillaEditView* pEdit, bool isBakWrite, bool isStatic, bool isClearSwpFile)
+{
+	CODE_ID dstCode = getSaveTextCode(pEdit);
+	QFileInfo mappedFile(pEdit->property(Edit_Mapped_File).toString());
+
+	auto writeWork = [pEdit](QString filePath, CODE_ID code)->bool {
+		QFile file(filePath);
+		if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate))
+		{
+			return false;
+		}
+		bool success = FileManager::getInstance().writeEditText(pEdit, file, code);
+		file.close();
+		return success;
+	};
+
+	auto saveFailed = [this, isStatic](QString filePath)->bool {
+		QApplication::beep();
+		if (!isStatic)
+		{
+			QMessageBox::warning(this, tr("Error"), tr("Save File %1 failed. You may not have write privileges \nPlease save as a new file!").arg(filePath));
+		}
+		ui.statusBar->showMessage(tr("Save File %1 failed. You may not have write privileges \nPlease save as a new file!").arg(filePath), MSG_EXIST_TIME);
+		return false;
+	};
+
+	if ((mappedFile == QFileInfo(fileName)) || (isBakWrite && QFile::exists(fileName)))
+	{
+		QString swapFilePath = getSwapFilePath(fileName);
+
+		//文档可能还引用着上次保存留下的交换文件，同样不能截断，换一个名字。这个名字关闭时不会去删，用完即删
+		bool isOtherSwap = (mappedFile == QFileInfo(swapFilePath));
+		if (isOtherSwap)
+		{
+			swapFilePath += "~";
+		}
+
+		//和普通文件一样，windows下无条件删除交换文件，其它平台按isClearSwpFile。文档引用着时等不再引用再删
+#ifdef _WIN32
+		bool isRemoveSwap = true;
+#else
+		bool isRemoveSwap = isClearSwpFile || isOtherSwap;
+#endif
+
+		//交换文件写失败时，文档还引用着原来的文件，什么也没有改变
+		if (!writeWork(swapFilePath, CODE_ID::UTF8_NOBOM) || !FileManager::getInstance().remapEditText(pEdit, swapFilePath, false, isRemoveSwap))
+		{
+			QFile::remove(swapFilePath);
+			return saveFailed(swapFilePath);
+		}
+	}
+
+	//文档已经不引用目标文件，可以截断重写。失败时文档引用的文件还在，内容不会丢失
+	if (!writeWork(fileName, dstCode))
+	{
+		return saveFailed(fileName);
+	}
+
+	//UTF8文件的字节和文档相同，文档改为引用目标文件，释放交换文件。改引用失败时继续引用原来的文件，内容一样
+	if (dstCode == CODE_ID::UTF8_NOBOM || dstCode == CODE_ID::UTF8_BOM)
+	{
+		FileManager::getInstance().remapEditText(pEdit, fileName, (dstCode == CODE_ID::UTF8_BOM));
+	}
+	return true;
+}
+
 //bool isBakWrite:是否进行保护写，即先写swap文件，再写源文件。这样可以避免突然断电导致源文件被清空
 //外部替换后保存文件时调用的函数，主要不弹出messagebox
 void  CCNotePad::slot_saveFile(QString fileName, ScintillaEditView* pEdit)
@@ -7299,6 +7676,8 @@ void CCNotePad::slot_findResultPosChangeed(Qt::DockWidgetArea area)
 
 void  CCNotePad::initFindResultDockWin()
 {
+	NDD_TRACE_SPAN("CCNotePad::initFindResultDockWin");
+
 	//停靠窗口1
 	if (m_dockSelectTreeWin == nullptr)
 	{
@@ -7317,6 +7696,7 @@ void  CCNotePad::initFindResultDockWin()
 		m_pResultWin = new FindResultWin(m_dockSelectTreeWin);
 		//connect(m_pResultWin, &FindResultWin::itemDoubleClicked, this, &CCNotePad::slot_findResultItemDoubleClick);
 		connect(m_pResultWin, &FindResultWin::lineDoubleClicked, this, &CCNotePad::on_findResultlineDoubleClick);
+		connect(m_pResultWin, &FindResultWin::bigTextLineDoubleClicked, this, &CCNotePad::on_findResultBigTextLineDoubleClick);
 
 		connect(m_pResultWin, &FindResultWin::showMsg, this, [this](QString& msg) {
 			ui.statusBar->showMessage(msg,5000);
@@ -7475,6 +7855,162 @@ void CCNotePad::on_findResultlineDoubleClick(QString* pFilePath, int pos, int en
 	}	
 }
 
+//双击大文本全文件查找的结果。先加载结果所在的块，再定位到行中的位置
+void CCNotePad::on_findResultBigTextLineDoubleClick(QString* pFilePath, int lineNum, qint64 lineAddr, int pos, int end)
+{
+	QString filePath = *pFilePath;
+	getRegularFilePath(filePath);
+
+	//大文本的打开方式需要用户选择，已经关闭的不再自动打开
+	ScintillaEditView* pEdit = nullptr;
+
+	for (int i = 0; i < ui.editTabWidget->count(); ++i)
+	{
+		ScintillaEditView* pe = dynamic_cast<ScintillaEditView*>(ui.editTabWidget->widget(i));
+		if (pe != nullptr && (filePath == getFilePathProperty(pe)))
+		{
+			ui.editTabWidget->setCurrentIndex(i);
+			pEdit = pe;
+			break;
+		}
+	}
+
+	if (pEdit == nullptr)
+	{
+		ui.statusBar->showMessage(tr("file %1 was closed, please open it again !").arg(filePath), MSG_EXIST_TIME);
+		QApplication::beep();
+		return;
+	}
+
+	int docType = getDocTypeProperty(pEdit);
+
+	if (BIG_TEXT_RO_TYPE == docType)
+	{
+		int blockid = FileManager::getInstance().getBigFileBlockId(filePath, lineNum);
+		if (blockid == -1)
+		{
+			QApplication::beep();
+			return;
+		}
+
+		BigTextEditFileMgr* mgr = FileManager::getInstance().getBigFileEditMgr(filePath);
+
+		if (mgr->m_curBlockIndex != (quint32)blockid)
+		{
+			showBigTextFile(pEdit, mgr, blockid);
+		}
+
+		int lineStartPos = pEdit->execute(SCI_POSITIONFROMLINE, lineNum - mgr->blocks.at(blockid).lineNumStart);
+		pEdit->execute(SCI_SETSEL, lineStartPos + pos, lineStartPos + end);
+	}
+	else if (SUPER_BIG_TEXT_RO_TYPE == docType)
+	{
+		TextFileMgr* fileMgr = FileManager::getInstance().getSuperBigFileMgr(filePath);
+
+		//loadFileFromAddr会丢弃addr所在的不完整的行，所以这里从上一行的行尾开始加载
+		qint64 loadAddr = lineAddr;
+		if (lineAddr > 0)
+		{
+			loadAddr -= ((fileMgr->loadWithCode == UNICODE_LE) ? 2 : 1);
+		}
+
+		if (0 == FileManager::getInstance().loadFileFromAddr(filePath, loadAddr, fileMgr))
+		{
+			showBigTextFile(pEdit, fileMgr);
+			pEdit->showBigTextLineAddr(fileMgr->fileOffset - fileMgr->contentRealSize, fileMgr->fileOffset);
+			pEdit->execute(SCI_SETSEL, pos, end);
+		}
+	}
+}
+
+//大文本在整个文件上查找，结果分批流式显示在查找结果窗口中
+bool CCNotePad::findAllInBigText(QWidget* pw, QString whatFind, QString showText, bool isRe, bool isCase, bool isWholeWord, QString& errMsg)
+{
+	QString filePath = getFilePathProperty(pw);
+	int docType = getDocTypeProperty(pw);
+
+	int code = UNKOWN;
+	int lineEndType = UNKNOWN_LINE;
+
+	if (BIG_TEXT_RO_TYPE == docType)
+	{
+		BigTextEditFileMgr* mgr = FileManager::getInstance().getBigFileEditMgr(filePath);
+		if (mgr != nullptr)
+		{
+			code = mgr->loadWithCode;
+			lineEndType = mgr->lineEndType;
+		}
+	}
+	else if (SUPER_BIG_TEXT_RO_TYPE == docType)
+	{
+		TextFileMgr* mgr = FileManager::getInstance().getSuperBigFileMgr(filePath);
+		if (mgr != nullptr)
+		{
+			code = mgr->loadWithCode;
+			lineEndType = mgr->lineEndType;
+		}
+	}
+	else
+	{
+		errMsg = tr("The mode of the current document does not allow this operation.");
+		return false;
+	}
+
+	if (m_bigFileSearcher == nullptr)
+	{
+		m_bigFileSearcher = new BigFileSearcher(this);
+		connect(m_bigFileSearcher, &BigFileSearcher::signFoundRecords, this, &CCNotePad::slot_bigTextFindRecords);
+		connect(m_bigFileSearcher, &BigFileSearcher::signProgress, this, &CCNotePad::slot_bigTextFindProgress);
+		connect(m_bigFileSearcher, &BigFileSearcher::signFinished, this, &CCNotePad::slot_bigTextFindFinished);
+	}
+
+	if (!m_bigFileSearcher->start(filePath, whatFind, code, lineEndType, isRe, isCase, isWholeWord, errMsg))
+	{
+		return false;
+	}
+
+	initFindResultDockWin();
+
+	m_dockSelectTreeWin->setWindowTitle(tr("Find result - searching ..."));
+	m_pResultWin->beginStreamResults(filePath, showText);
+	m_dockSelectTreeWin->show();
+
+	return true;
+}
+
+void CCNotePad::slot_bigTextFindRecords(QString filePath, QVector<FindRecord> records)
+{
+	if (m_pResultWin != nullptr)
+	{
+		m_pResultWin->appendStreamResults(filePath, records);
+	}
+}
+
+void CCNotePad::slot_bigTextFindProgress(QString filePath, int percent)
+{
+	ui.statusBar->showMessage(tr("Searching in %1 , %2% ...").arg(filePath).arg(percent), 2000);
+}
+
+void CCNotePad::slot_bigTextFindFinished(QString filePath, int hits, bool isCancel)
+{
+	bool isFinished = (!isCancel && hits < BigFileSearcher::MAX_HITS);
+
+	if (m_pResultWin != nullptr)
+	{
+		m_pResultWin->endStreamResults(filePath, hits, isFinished);
+		m_dockSelectTreeWin->setWindowTitle(tr("Find result - %1 hit").arg(hits));
+	}
+
+	if (!isCancel && hits >= BigFileSearcher::MAX_HITS)
+	{
+		ui.statusBar->showMessage(tr("Find results are more than %1, the rest are skipped !").arg(BigFileSearcher::MAX_HITS), MSG_EXIST_TIME);
+	}
+	else
+	{
+		ui.statusBar->showMessage(tr("find finished, total %1 found!").arg(hits), MSG_EXIST_TIME);
+	}
+}
+
 #if 0
 void CCNotePad::slot_showFindAllInCurDocResult(FindRecords* record)
 {
@@ -7492,6 +8028,12 @@ void CCNotePad::slot_showfindAllInOpenDocResult(QVector<FindRecords*>* record, i
 {
 	initFindResultDockWin();
 
+	//结果窗口最前面插入新的结果，正在进行的大文本查找不再继续
+	if (m_bigFileSearcher != nullptr)
+	{
+		m_bigFileSearcher->cancel();
+	}
+
 	m_dockSelectTreeWin->setWindowTitle(tr("Find result - %1 hit").arg(hits));
 
 	m_pResultWin->appendResultsToShow(record, hits, whatFind);
@@ -7503,6 +8045,11 @@ void CCNotePad::slot_showfindAllInOpenDocResult(QVector<FindRecords*>* record, i
 void CCNotePad::slot_clearFindResult()
 {
 	initFindResultDockWin();
+
+	if (m_bigFileSearcher != nullptr)
+	{
+		m_bigFileSearcher->cancel();
+	}
 	m_pResultWin->slot_clearAllContents();
 }
 
@@ -7664,15 +8211,102 @@ void CCNotePad::slot_gotoline()
 					ui.statusBar->showMessage(tr("out of file line range,mar line num is %1 !").arg(v.lineNum + v.lineNumStart -1));
 }
 			}
-			else
+			else if (SUPER_BIG_TEXT_RO_TYPE == getDocTypeProperty(pw))
 			{
-				//超大文本不支持跳转行号，只支持跳转地址。先留着
+				//超大文本依赖后台建立的稀疏行索引进行跳转
+				QString filePath = getFilePathProperty(pw);
+				qint64 totalLines = 0;
+				qint64 lineAddr = 0;
+
+				if (!FileManager::getInstance().isSuperBigLineIndexReady(filePath, &totalLines))
+				{
+					TextFileMgr* fileMgr = FileManager::getInstance().getSuperBigFileMgr(filePath);
+					int percent = ((fileMgr != nullptr) && !fileMgr->lineIndex.isNull()) ? fileMgr->lineIndex->progress.load() : 0;
+
+					QApplication::beep();
+					ui.statusBar->showMessage(tr("Line index is being built in background (%1%), please try again later !").arg(percent), MSG_EXIST_TIME);
+				}
+				else if (!FileManager::getInstance().getSuperBigLineAddr(filePath, num - 1, lineAddr))
+				{
+					QApplication::beep();
+					ui.statusBar->showMessage(tr("out of file line range,mar line num is %1 !").arg(totalLines));
+				}
+				else
+				{
+					TextFileMgr* fileMgr = FileManager::getInstance().getSuperBigFileMgr(filePath);
+
+					//loadFileFromAddr会丢弃addr所在的不完整的行，所以这里从上一行的行尾开始加载
+					qint64 loadAddr = lineAddr;
+					if (lineAddr > 0)
+					{
+						loadAddr -= ((fileMgr->loadWithCode == UNICODE_LE) ? 2 : 1);
+					}
+
+					if (0 == FileManager::getInstance().loadFileFromAddr(filePath, loadAddr, fileMgr))
+					{
+						showBigTextFile(pEdit, fileMgr);
+						pEdit->showBigTextLineAddr(fileMgr->fileOffset - fileMgr->contentRealSize, fileMgr->fileOffset);
+						pEdit->execute(SCI_GOTOLINE, 0);
+					}
+				}
 			}
 
 		}
 	}
 }
 
+//超大文本后台建立行索引的进度，只在当前显示的就是该文件时提示
+void CCNotePad::slot_superBigLineIndexProgress(QString filePath, int percent)
+{
+	QWidget* pw = ui.editTabWidget->currentWidget();
+
+	if (pw != nullptr && (SUPER_BIG_TEXT_RO_TYPE == getDocTypeProperty(pw)) && (getFilePathProperty(pw) == filePath))
+	{
+		ui.statusBar->showMessage(tr("Building line index in background %1% ...").arg(percent), 2000);
+	}
+}
+
+//超大文本行索引建立完成，把已经打开的页面的地址显示，更新为行号显示
+void CCNotePad::slot_superBigLineIndexFinished(QString filePath, qint64 totalLines)
+{
+	TextFileMgr* fileMgr = FileManager::getInstance().getSuperBigFileMgr(filePath);
+	if (fileMgr == nullptr)
+	{
+		return;
+	}
+
+	for (int i = 0; i < ui.editTabWidget->count(); ++i)
+	{
+		QWidget* pw = ui.editTabWidget->widget(i);
+
+		if ((SUPER_BIG_TEXT_RO_TYPE != getDocTypeProperty(pw)) || (getFilePathProperty(pw) != filePath))
+		{
+			continue;
+		}
+
+		ScintillaEditView* pEdit = dynamic_cast<ScintillaEditView*>(pw);
+		if (pEdit == nullptr)
+		{
+			continue;
+		}
+
+		qint64 addr = fileMgr->fileOffset - fileMgr->contentRealSize;
+
+		fileMgr->curStartLineNum = FileManager::getInstance().getSuperBigLineNumAt(filePath, addr);
+
+		if (fileMgr->curStartLineNum >= 0)
+		{
+			pEdit->addSuperBigLineCache(addr, fileMgr->curStartLineNum + 1);
+			pEdit->showBigTextLineAddr(addr, fileMgr->fileOffset);
+		}
+
+		if (pw == ui.editTabWidget->currentWidget())
+		{
+			ui.statusBar->showMessage(tr("Line index finished, file %1 has %2 lines.").arg(filePath).arg(totalLines), MSG_EXIST_TIME);
+		}
+	}
+}
+
 void CCNotePad::slot_show_line_end(bool checked)
 {
 	int showblank = s_showblank;
@@ -8866,6 +9500,8 @@ bool CCNotePad::restoreDirtyExistFile(QString& filePath, QString& tempFilePath)
 //1:非脏新建文件 2 非脏的已存在文件 3 脏的新建文件 4 脏的老文件。
 int CCNotePad::restoreLastFiles()
 {
+	NDD_TRACE_SPAN("CCNotePad::restoreLastFiles");
+
 	if (s_restoreLastFile == 0)
 	{
 		return 0;
@@ -9151,7 +9787,7 @@ bool CCNotePad::pluginInvoke(int cmdId, void* data)
 	bool ret = false;
 	switch (cmdId)
 	{
-	case 1:
+	case NDD_CMD_NEW_FILE:
 	{
 		//新建一个文件。
 		slot_actionNewFile_toggle(true);
@@ -9171,7 +9807,7 @@ bool CCNotePad::pluginInvoke(int cmdId, void* data)
 		ret = true;
 	}
 		break;
-	case 2:
+	case NDD_CMD_SET_LANG:
 	{
 		//设定当前编辑器的语言。0 js 1 json 2 html
 		int lang = *((int*)data);
@@ -9191,11 +9827,123 @@ bool CCNotePad::pluginInvoke(int cmdId, void* data)
 		ret = true;
 	}
 	break;
+	case NDD_CMD_GET_SNAPSHOT:
+		ret = getPluginSnapshot((NDD_DOC_SNAPSHOT*)data);
+		break;
+	case NDD_CMD_RUN_TASK:
+	{
+		NDD_PLUGIN_TASK* pTask = (NDD_PLUGIN_TASK*)data;
+		if (pTask != nullptr && pTask->m_work)
+		{
+			pTask->m_taskId = PluginTaskPool::getInstance()->start(*pTask);
+			ret = true;
+		}
+	}
+	break;
+	case NDD_CMD_CANCEL_TASK:
+		if (data != nullptr)
+		{
+			ret = PluginTaskPool::getInstance()->cancel(*((int*)data));
+		}
+		break;
+	case NDD_CMD_APPLY_EDITS:
+		ret = applyPluginEdits((NDD_EDIT_BATCH*)data);
+		break;
+	case NDD_CMD_GET_API_VERSION:
+		if (data != nullptr)
+		{
+			*((int*)data) = NDD_PLUGIN_API_VERSION;
+			ret = true;
+		}
+		break;
 	default:
 		break;
 	}
 	return ret;
 }
+
+//给插件当前文档的快照。只复制这一次，插件之后在工作线程中读取快照，不再访问编辑框
+bool CCNotePad::getPluginSnapshot(NDD_DOC_SNAPSHOT* pSnapshot)
+{
+	ScintillaEditView* pEdit = getCurEditView();
+	if (pSnapshot == nullptr || pEdit == nullptr)
+	{
+		return false;
+	}
+
+	//大文本模式中编辑框里只是文件的一块
+	if (TXT_TYPE != getDocTypeProperty(pEdit))
+	{
+		return false;
+	}
+
+	qint64 length = pEdit->execute(SCI_GETLENGTH);
+	pSnapshot->m_text = QByteArray(length, Qt::Uninitialized);
+	if (length > 0)
+	{
+		pEdit->getText(pSnapshot->m_text.data(), 0, length);
+	}
+	pSnapshot->m_editor = pEdit;
+	pSnapshot->m_docId = pEdit->docId();
+	pSnapshot->m_version = pEdit->docVersion();
+	return true;
+}
+
+//把插件基于快照计算出来的修改一次应用到文档，只有一个撤销步骤和一次修改通知。
+//取快照以后文档被修改过，或者已经关闭，修改的位置已经不对了，不应用
+bool CCNotePad::applyPluginEdits(NDD_EDIT_BATCH* pBatch)
+{
+	if (pBatch == nullptr)
+	{
+		return false;
+	}
+
+	ScintillaEditView* pEdit = nullptr;
+	for (int i = 0; i < ui.editTabWidget->count(); ++i)
+	{
+		if (ui.editTabWidget->widget(i) == pBatch->m_snapshot.m_editor)
+		{
+			pEdit = dynamic_cast<ScintillaEditView*>(ui.editTabWidget->widget(i));
+			break;
+		}
+	}
+
+	//编辑框地址可能是关闭的文档释放后被新文档重用的，要同时比较文档编号
+	if (pEdit == nullptr || pEdit->isReadOnly() || pEdit->docId() != pBatch->m_snapshot.m_docId || pEdit->docVersion() != pBatch->m_snapshot.m_version)
+	{
+		return false;
+	}
+
+	qint64 endPrevious = 0;
+	std::vector<Sci_TextRange> ranges;
+	ranges.reserve(pBatch->m_edits.size());
+	for (const NDD_EDIT& edit : pBatch->m_edits)
+	{
+		if (edit.m_pos < endPrevious || edit.m_removeLength < 0 || edit.m_pos + edit.m_removeLength > pBatch->m_snapshot.size())
+		{
+			return false;
+		}
+
+		//SCI_REPLACERANGES按'\0'结尾计算文本长度，含有'\0'的文本会被截断，整批拒绝
+		if (edit.m_text.contains('\0'))
+		{
+			return false;
+		}
+		endPrevious = edit.m_pos + edit.m_removeLength;
+
+		Sci_TextRange tr;
+		tr.chrg.cpMin = static_cast<Sci_PositionCR>(edit.m_pos);
+		tr.chrg.cpMax = static_cast<Sci_PositionCR>(edit.m_pos + edit.m_removeLength);
+		tr.lpstrText = const_cast<char*>(edit.m_text.constData());
+		ranges.push_back(tr);
+	}
+
+	if (!ranges.empty())
+	{
+		pBatch->m_lengthChange = pEdit->execute(SCI_REPLACERANGES, ranges.size(), reinterpret_cast<sptr_t>(ranges.data()));
+	}
+	return true;
+}
 #endif
 
 //tab space 互转
@@ -9727,70 +10475,319 @@ void CCNotePad::slot_escQuit()
 //格式化xml语言
 void CCNotePad::slot_formatXml()
 {
-	ScintillaEditView* _pEditView = getCurEditView();
-	if (_pEditView == nullptr || _pEditView->isReadOnly())
+	startFormat(TextFormatter::XML_PRETTY, false);
+}
+
+void CCNotePad::slot_minifyXml()
+{
+	startFormat(TextFormatter::XML_MINIFY, false);
+}
+
+void CCNotePad::slot_formatJson()
+{
+	startFormat(TextFormatter::JSON_PRETTY, false);
+}
+
+void CCNotePad::slot_minifyJson()
+{
+	startFormat(TextFormatter::JSON_MINIFY, false);
+}
+
+void CCNotePad::slot_formatJsonToNewTab()
+{
+	startFormat(TextFormatter::JSON_PRETTY, true);
+}
+
+//在后台线程中格式化当前文档的UTF-8拷贝，不建立QJsonDocument或整个文档的QString。
+//只读的文档格式化到新标签页中。缩进使用文档的缩进设置
+void CCNotePad::startFormat(int type, bool isToNewTab)
+{
+	ScintillaEditView* pEdit = getCurEditView();
+	if (pEdit == nullptr)
 	{
 		return;
 	}
 
-	QString text = _pEditView->text();
-	if (text.isEmpty())
+	//大文本模式中编辑框里只是文件的一块
+	if (TXT_TYPE != getDocTypeProperty(pEdit))
 	{
+		ui.statusBar->showMessage(tr("The mode of the current document does not allow this operation."), MSG_EXIST_TIME);
 		return;
 	}
 
-	QString xmlOut;
+	if (m_textFormatter != nullptr && m_textFormatter->isRunning())
+	{
+		ui.statusBar->showMessage(tr("Formatting is in progress, please wait."), MSG_EXIST_TIME);
+		return;
+	}
 
-	QXmlStreamReader reader(text);
-	QXmlStreamWriter writer(&xmlOut);
-	writer.setAutoFormatting(true);
+	qint64 length = pEdit->execute(SCI_GETLENGTH);
+	if (length == 0)
+	{
+		return;
+	}
 
-	while (!reader.atEnd()) {
-		reader.readNext();
-		if (!reader.isWhitespace()) {
-			writer.writeCurrentToken(reader);
+	QByteArray text(length, Qt::Uninitialized);
+	pEdit->getText(text.data(), 0, length);
+
+	bool useTab = (pEdit->execute(SCI_GETUSETABS) != 0);
+	int indent = pEdit->execute(SCI_GETINDENT);
+	if (indent <= 0)
+	{
+		indent = pEdit->execute(SCI_GETTABWIDTH);
+	}
+
+	QByteArray eol("\n");
+	int eolMode = pEdit->execute(SCI_GETEOLMODE);
+	if (eolMode == SC_EOL_CRLF)
+	{
+		eol = "\r\n";
+	}
+	else if (eolMode == SC_EOL_CR)
+	{
+		eol = "\r";
+	}
+
+	//只读的文档只能输出到新标签页
+	m_formatInPlace = !isToNewTab && !pEdit->isReadOnly();
+
+	if (m_formatInPlace)
+	{
+		m_formatOutput = new QTemporaryFile(this);
+		if (!m_formatOutput->open())
+		{
+			ui.statusBar->showMessage(tr("Can not create the temporary file for formatting: %1").arg(m_formatOutput->errorString()), MSG_EXIST_TIME);
+			delete m_formatOutput;
+			m_formatOutput = nullptr;
+			return;
+		}
+
+		//格式化期间不允许编辑，否则完成替换时会丢掉这些修改
+		m_formatTarget = pEdit;
+		pEdit->setReadOnly(true);
+	}
+	else
+	{
+		slot_actionNewFile_toggle(true);
+		m_formatTarget = getCurEditView();
+
+		bool isXml = (type == TextFormatter::XML_PRETTY || type == TextFormatter::XML_MINIFY);
+		QsciLexer* lexer = ScintillaEditView::createLexer(isXml ? L_XML : L_JSON, "");
+		if (m_formatTarget != nullptr && lexer != nullptr)
+		{
+			QsciLexer* curLexer = m_formatTarget->lexer();
+			if (curLexer != nullptr)
+			{
+				m_formatTarget->setLexer(nullptr);
+				delete curLexer;
+			}
+			m_formatTarget->setLexer(lexer);
+			QString tag = lexer->lexerTag();
+			setLangsDescLable(tag);
 		}
 	}
 
-	if (reader.hasError()) 
+	if (m_textFormatter == nullptr)
 	{
-		ui.statusBar->showMessage(tr("XML format error, please check!"), MSG_EXIST_TIME);
-		QApplication::beep();
-		return;
+		m_textFormatter = new TextFormatter(this);
+		connect(m_textFormatter, &TextFormatter::signOutput, this, &CCNotePad::slot_formatOutput);
+		connect(m_textFormatter, &TextFormatter::signProgress, this, &CCNotePad::slot_formatProgress);
+		connect(m_textFormatter, &TextFormatter::signFinished, this, &CCNotePad::slot_formatFinished);
 	}
 
-	_pEditView->setText(xmlOut);
+	//小文档很快就完成了，不弹出进度窗口
+	if (length > 8 * 1024 * 1024)
+	{
+		m_formatProgressWin = new ProgressWin(this);
+		m_formatProgressWin->setWindowModality(Qt::WindowModal);
+		m_formatProgressWin->info(tr("Formatting %1 MB, please wait ...").arg(length / (1024 * 1024)));
+		m_formatProgressWin->setTotalSteps(100);
+		connect(m_formatProgressWin.data(), &ProgressWin::quitClick, this, &CCNotePad::slot_formatCancel);
+		m_formatProgressWin->show();
+	}
 
+	m_textFormatter->start(text, type, indent, useTab, eol);
+	ui.statusBar->showMessage(tr("Formatting ..."), MSG_EXIST_TIME);
 }
 
-void CCNotePad::slot_formatJson()
+void CCNotePad::slot_formatProgress(int percent)
 {
-	ScintillaEditView* _pEditView = getCurEditView();
-	if (_pEditView == nullptr || _pEditView->isReadOnly())
+	if (!m_formatProgressWin.isNull())
+	{
+		m_formatProgressWin->setStep(percent);
+	}
+}
+
+//取消后格式化器不再发出结束信号，这里直接结束
+void CCNotePad::slot_formatCancel()
+{
+	if (m_textFormatter != nullptr && m_textFormatter->isRunning())
 	{
+		m_textFormatter->cancel();
+		slot_formatFinished(TextFormatter::FORMAT_OK, QString(), 0, 0, 0, true);
+	}
+}
+
+void CCNotePad::slot_formatOutput(QByteArray data)
+{
+	//目标标签页已经关闭
+	if (m_formatTarget.isNull())
+	{
+		slot_formatCancel();
 		return;
 	}
 
-	QString text = _pEditView->text();
-	if (text.isEmpty())
+	if (m_formatInPlace)
 	{
+		if (m_formatOutput->write(data) != data.size())
+		{
+			//取消时会删除临时文件，先取出错误
+			QString errMsg = m_formatOutput->errorString();
+			slot_formatCancel();
+			ui.statusBar->showMessage(tr("Can not write the temporary file for formatting: %1").arg(errMsg), MSG_EXIST_TIME);
+		}
 		return;
 	}
+	m_formatTarget->execute(SCI_APPENDTEXT, data.size(), reinterpret_cast<sptr_t>(data.constData()));
+}
+
+//第一块替换全文，后面的追加在末尾，放在一个撤销动作中。读失败时撤销已经做的替换，保持原文
+bool CCNotePad::replaceWithFormatOutput(ScintillaEditView* pEdit, QString& errorString)
+{
+	const qint64 readSize = 4 * 1024 * 1024;
+
+	if (!m_formatOutput->seek(0))
+	{
+		errorString = m_formatOutput->errorString();
+		return false;
+	}
+
+	pEdit->execute(SCI_BEGINUNDOACTION);
+	pEdit->execute(SCI_SETTARGETRANGE, 0, pEdit->execute(SCI_GETLENGTH));
+
+	bool isFirst = true;
+	bool isOk = true;
+	for (;;)
+	{
+		QByteArray data = m_formatOutput->read(readSize);
+		if (data.isEmpty())
+		{
+			//读到末尾时错误为NoError，都没有输出时也要把原文替换为空
+			isOk = (m_formatOutput->error() == QFileDevice::NoError);
+			if (isOk && isFirst)
+			{
+				pEdit->execute(SCI_REPLACETARGET, 0, reinterpret_cast<sptr_t>(""));
+			}
+			break;
+		}
+
+		if (isFirst)
+		{
+			pEdit->execute(SCI_REPLACETARGET, data.size(), reinterpret_cast<sptr_t>(data.constData()));
+			isFirst = false;
+		}
+		else
+		{
+			pEdit->execute(SCI_APPENDTEXT, data.size(), reinterpret_cast<sptr_t>(data.constData()));
+		}
+	}
+
+	pEdit->execute(SCI_ENDUNDOACTION);
+
+	if (!isOk)
+	{
+		errorString = m_formatOutput->errorString();
+		if (!isFirst)
+		{
+			pEdit->execute(SCI_UNDO);
+		}
+		return false;
+	}
+	return true;
+}
 
-	QByteArray bytes = text.toUtf8();
+void CCNotePad::slot_formatFinished(int error, QString errMsg, qint64 errPos, qint64 errLine, qint64 errColumn, bool isCancel)
+{
+	//可能是在进度窗口的取消信号中调用的，不能直接删除
+	if (!m_formatProgressWin.isNull())
+	{
+		m_formatProgressWin->hide();
+		m_formatProgressWin->deleteLater();
+		m_formatProgressWin.clear();
+	}
 
-	QJsonParseError parseError;
-	QJsonDocument doc = QJsonDocument::fromJson(bytes, &parseError);
+	bool isReadFailed = false;
+	QString readError;
 
-	if (QJsonParseError::NoError != parseError.error)
+	if (!m_formatTarget.isNull() && m_formatInPlace)
 	{
-		ui.statusBar->showMessage(tr("JSON format error, please check!"),MSG_EXIST_TIME);
+		//只读的文档不会原地格式化，开始时设置的只读在这里取消
+		m_formatTarget->setReadOnly(false);
+
+		//成功时分块读回临时文件替换原文，整体为一步撤销；出错时原文没有动过，把光标放到出错的地方
+		if (error == TextFormatter::FORMAT_OK && !isCancel && m_formatOutput != nullptr)
+		{
+			isReadFailed = !replaceWithFormatOutput(m_formatTarget, readError);
+		}
+		else if (error != TextFormatter::FORMAT_OK)
+		{
+			m_formatTarget->execute(SCI_GOTOPOS, errPos);
+		}
+	}
+	m_formatTarget.clear();
+	delete m_formatOutput;
+	m_formatOutput = nullptr;
+
+	if (isReadFailed)
+	{
+		ui.statusBar->showMessage(tr("Can not read the temporary file for formatting: %1").arg(readError), MSG_EXIST_TIME);
+		return;
+	}
+
+	if (error == TextFormatter::FORMAT_OK)
+	{
+		ui.statusBar->showMessage(isCancel ? tr("Format canceled.") : tr("Format finished."), MSG_EXIST_TIME);
+		return;
+	}
+
+	if (error == TextFormatter::FORMAT_XML_ERROR)
+	{
+		ui.statusBar->showMessage(tr("XML format error at line %1, column %2 : %3").arg(errLine).arg(errColumn).arg(errMsg), MSG_EXIST_TIME);
 		QApplication::beep();
 		return;
 	}
 
-	QString content(doc.toJson(QJsonDocument::Indented));
-	_pEditView->setText(content);
+	QString reason;
+	switch (error)
+	{
+	case TextFormatter::FORMAT_UNEXPECTED_END:
+		reason = tr("unexpected end of text");
+		break;
+	case TextFormatter::FORMAT_UNTERMINATED_STRING:
+		reason = tr("unterminated string");
+		break;
+	case TextFormatter::FORMAT_CONTROL_CHAR_IN_STRING:
+		reason = tr("control character in string");
+		break;
+	case TextFormatter::FORMAT_INVALID_ESCAPE:
+		reason = tr("invalid escape sequence");
+		break;
+	case TextFormatter::FORMAT_INVALID_NUMBER:
+		reason = tr("invalid number");
+		break;
+	case TextFormatter::FORMAT_INVALID_LITERAL:
+		reason = tr("invalid literal");
+		break;
+	case TextFormatter::FORMAT_EXTRA_CONTENT:
+		reason = tr("extra content after the value");
+		break;
+	default:
+		reason = tr("unexpected character");
+		break;
+	}
+
+	ui.statusBar->showMessage(tr("JSON format error at line %1, column %2 : %3").arg(errLine).arg(errColumn).arg(reason), MSG_EXIST_TIME);
+	QApplication::beep();
 }
 
 //清空历史打开记录
@@ -9816,6 +10813,23 @@ void CCNotePad::slot_showWebAddr(bool check)
 	NddSetting::updataKeyValueFromNumSets(SHOWWEBADDR, s_hightWebAddr);
 }
 
+//关闭时释放所有文档的单词索引，打开时重新在后台统计
+void CCNotePad::slot_wordComplete(bool check)
+{
+	CCNotePad::s_wordComplete = check ? 1 : 0;
+
+	NddSetting::updataKeyValueFromNumSets(WORD_COMPLETE_OFF, check ? 0 : 1);
+
+	for (int i = ui.editTabWidget->count() - 1; i >= 0; --i)
+	{
+		ScintillaEditView* pEdit = dynamic_cast<ScintillaEditView*>(ui.editTabWidget->widget(i));
+		if (pEdit != nullptr)
+		{
+			pEdit->setWordComplete(check);
+		}
+	}
+}
+
 //更新当前主题的样式
 void CCNotePad::updateThemes()
 {
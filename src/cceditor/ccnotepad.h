@@ -22,13 +22,18 @@
 #include "scintillaeditview.h"
 #include "findwin.h"
 #include "pluginGl.h"
+#include "openrequestchannel.h"
 
 
 //class ScintillaEditView;
 class ScintillaHexEditView;
 class FindRecords;
 class FindResultWin;
+class BigFileSearcher;
+class TextFormatter;
+class ProgressWin;
 class QAction;
+class QTemporaryFile;
 class CompareDirs;
 class CompareWin;
 struct HexFileMgr;
@@ -40,6 +45,9 @@ static const char* Tail_Thread = "tailthread";
 //编码类型,int
 static const char* Edit_Text_Code = "code";
 
+//映射打开的文档当前引用的文件,QString。保存为非UTF8编码后引用的是交换文件
+static const char* Edit_Mapped_File = "mappedfile";
+
 enum OpenAttr {
 	Text = 1,
 	HexReadOnly,
@@ -140,6 +148,7 @@ public:
 	int markAtBack(QStringList& keyword);
 	int findAtBack(QStringList& keyword);
 	int replaceAtBack(QStringList& keyword, QStringList& replace);
+	bool findAllInBigText(QWidget* pw, QString whatFind, QString showText, bool isRe, bool isCase, bool isWholeWord, QString& errMsg);
 	void updateThemes();
 
 	void setGlobalFgColor(int style);
@@ -154,6 +163,8 @@ public:
 #ifdef NO_PLUGIN
 	//插件中调用主程序的功能。
 	bool pluginInvoke(int cmdId, void* data);
+	bool getPluginSnapshot(NDD_DOC_SNAPSHOT* pSnapshot);
+	bool applyPluginEdits(NDD_EDIT_BATCH* pBatch);
 #endif
 signals:
 	void signSendRegisterKey(QString key);
@@ -198,6 +209,7 @@ public slots:
 	void slot_clearMark();
 	void slot_zoomValueChange();
 	void on_quitActiveWindow();
+	void slot_openRequests(const QList<OpenRequest>& requests);
 
 protected:
 	void closeEvent(QCloseEvent *event) override;
@@ -220,6 +232,7 @@ private slots:
 	void slot_saveAllFile();
 	void slot_autoSaveFile(bool);
 	void slot_timerAutoSave();
+	void slot_trimBackgroundTabs();
 
 	void slot_tabCurrentChanged(int index);
 	void slot_copyAvailable(bool select);
@@ -252,6 +265,11 @@ private slots:
 	void slot_convertMacLineEnd(bool);
 	void slot_openReceneFile();
 	void slot_gotoline();
+	void slot_superBigLineIndexProgress(QString filePath, int percent);
+	void slot_superBigLineIndexFinished(QString filePath, qint64 totalLines);
+	void slot_bigTextFindRecords(QString filePath, QVector<FindRecord> records);
+	void slot_bigTextFindProgress(QString filePath, int percent);
+	void slot_bigTextFindFinished(QString filePath, int hits, bool isCancel);
 	void slot_show_spaces(bool check);
 	void slot_show_line_end(bool check);
 	void slot_load_with_gbk();
@@ -337,7 +355,14 @@ private slots:
 	void slot_findPrev();
 	void slot_escQuit();
 	void slot_formatXml();
+	void slot_minifyXml();
 	void slot_formatJson();
+	void slot_minifyJson();
+	void slot_formatJsonToNewTab();
+	void slot_formatOutput(QByteArray data);
+	void slot_formatProgress(int percent);
+	void slot_formatCancel();
+	void slot_formatFinished(int error, QString errMsg, qint64 errPos, qint64 errLine, qint64 errColumn, bool isCancel);
 
 	void slot_clearHistoryOpenList();
 
@@ -355,9 +380,11 @@ private slots:
 	void slot_pluginMgr();
 #ifdef NO_PLUGIN
 	void onPlugWork(bool check);
-	void sendParaToPlugin(NDD_PROC_DATA& procData);
+	void slot_loadPluginMenu();
+	bool sendParaToPlugin(NDD_PROC_DATA& procData);
 #endif
 	void slot_showWebAddr(bool check);
+	void slot_wordComplete(bool check);
 	void slot_langFileSuffix();
 	void slot_shortcutManager();
 	void on_lineEndChange(int index);
@@ -366,12 +393,16 @@ private slots:
 	void on_roladFile(ScintillaEditView* pEdit,quint64 lastSize, qint64 curSize);
 #endif
 	void on_md5hash();
+	void slot_memoryOverview();
 
 private:
 	void initFindResultDockWin();
+	void startFormat(int type, bool isToNewTab);
+	bool replaceWithFormatOutput(ScintillaEditView* pEdit, QString& errorString);
 	void enableEditTextChangeSign(ScintillaEditView * pEdit);
 	void disEnableEditTextChangeSign(ScintillaEditView * pEdit);
 	bool saveFile(QString fileName, ScintillaEditView * pEdit, bool isBakWrite=true, bool isStatic=false, bool isClearSwpFile=false);
+	bool saveMappedFile(QString fileName, ScintillaEditView* pEdit, bool isBakWrite, bool isStatic, bool isClearSwpFile);
 	void updateProAfterSaveNewFile(int curTabIndex, QString fileName, ScintillaEditView * pEdit);
 	void setShoctIcon(int iconSize=24);
 	void initToolBar();
@@ -435,6 +466,11 @@ private:
 
 	void initNotePadSqlOptions();
 	void saveNotePadSqlOptions();
+	void initTabTrim();
+	void trimTabMemory(ScintillaEditView* pEdit);
+	bool canReleaseTabText(ScintillaEditView* pEdit);
+	void releaseTabText(ScintillaEditView* pEdit);
+	void restoreTabText(ScintillaEditView* pEdit);
 	//void saveDefFont();
 	void savePadUseTimes();
 	void saveTempFile(ScintillaEditView * pEdit, int index, QSettings& qs);
@@ -474,6 +510,7 @@ private:
 	void loadPluginLib();
 	void loadPluginProcs(QString strLibDir, QMenu* pMenu);
 	void onPlugFound(NDD_PROC_DATA& procData, QMenu* pUserData);
+	NDD_PROC_DATA* findPluginData(const QString& plugPath);
 	void destroyAllPluginModule();
 #endif
 
@@ -486,6 +523,7 @@ private:
 	void doComment(int type);
 	void tailfile(bool isOn, ScintillaEditView* pEdit);
 	void on_findResultlineDoubleClick(QString* pFilePath, int pos, int end);
+	void on_findResultBigTextLineDoubleClick(QString* pFilePath, int lineNum, qint64 lineAddr, int pos, int end);
 private:
 	Ui::CCNotePad ui;
 
@@ -499,6 +537,16 @@ private:
 
 	QDockWidget* m_dockSelectTreeWin;
 	FindResultWin* m_pResultWin;
+	BigFileSearcher* m_bigFileSearcher;
+
+	//后台格式化，输出追加到m_formatTarget中。原地格式化时输出先分块写到临时文件m_formatOutput，
+	//不在内存中攒一份完整的结果；原文保持不变，成功结束后再分块读回替换，中途保存写出的也是完整的原文
+	TextFormatter* m_textFormatter;
+	QPointer<ScintillaEditView> m_formatTarget;
+	bool m_formatInPlace;
+	QTemporaryFile* m_formatOutput;
+	//大文档格式化时显示进度，可以取消
+	QPointer<ProgressWin> m_formatProgressWin;
 
 	QPointer<QDockWidget> m_dockFileListWin;
 	FileListView* m_fileListView;
@@ -581,6 +629,12 @@ private:
 	QTranslator* m_translator;
 	QTimer * m_timerAutoSave;
 
+	//后台标签页的内存释放策略
+	QTimer* m_tabTrimTimer;
+	int m_tabTrimMinutes;
+	qint64 m_tabMemoryBudget;
+	bool m_isTabTrimText;
+
 	QToolButton* m_newFile;
 	QToolButton* m_openFile;
 	QToolButton* m_saveFile;
@@ -640,5 +694,6 @@ public:
 	static int s_curStyleId;
 	static int s_curMarkColorId;
 	static int s_hightWebAddr;//高亮网页地址
+	static int s_wordComplete;//输入时补全所有打开文档中的单词
 };
 
@@ -4,12 +4,26 @@
 #include "CmpareMode.h"
 #include "ccnotepad.h"
 #include "progresswin.h"
+#include "mappedfiletext.h"
+#include "texttranscoder.h"
+#include "nddtrace.h"
 
 #include <QMessageBox>
 #include <QFile>
 #include <QtGlobal>
 #include <qscilexer.h>
 #include <QFileInfo>
+#include <QtConcurrent>
+#include <algorithm>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && (_M_IX86_FP >= 2))
+#include <emmintrin.h>
+#define NDD_LINE_SCAN_SSE2 1
+#endif
+
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
 
 LangType detectLanguage(QString& headContent, QString& filepath);
 
@@ -262,21 +276,33 @@ int FileManager::loadFileDataInTextFromOffset(ScintillaEditView* editView, QStri
 		return 0;
 	}
 
-	QByteArray bytes;
+	if (!file.seek(startReadSize))
+	{
+		file.close();
+		return 0;
+	}
+
+	//后面的内容按块解码追加，不在内存中放整段新内容。不是文件开头，不检查BOM
+	TextDecoder decoder(fileTextCode, false);
+	QByteArray bytes(TextTranscoder::CHUNK_SIZE, Qt::Uninitialized);
+	QString text;
 
-	if (file.seek(startReadSize))
+	qint64 readBytes = 0;
+	while ((readBytes = file.read(bytes.data(), TextTranscoder::CHUNK_SIZE)) > 0)
 	{
-		//读取后面所有的内容
-		bytes = file.readAll();
+		text.clear();
+		decoder.decode(bytes.constData(), readBytes, text);
+		editView->append(text);
 	}
 
 	file.close();
 
-	QString text;
-
-	Encode::tranStrToUNICODE(fileTextCode, bytes.data(), bytes.count(), text);
-	
-	editView->append(text);
+	text.clear();
+	decoder.finish(text);
+	if (!text.isEmpty())
+	{
+		editView->append(text);
+	}
 
 	return 0;
 }
@@ -478,6 +504,8 @@ int FileManager::loadFileDataInText(ScintillaEditView* editView, QString filePat
 //MsgBoxParent::尽量把这个给一下，让MsgBox有图标，不那么难看。
 int FileManager::loadFileDataInText(ScintillaEditView* editView, QString filePath, CODE_ID& fileTextCode, RC_LINE_FORM& lineEnd, CCNotePad* callbackObj, bool hexAsk, QWidget* msgBoxParent)
 {
+	NDD_TRACE_SPAN("FileManager::loadFileDataInText", filePath);
+
 	QFile file(filePath);
 
 	//如果文件不存在，直接返回
@@ -636,6 +664,173 @@ int FileManager::loadFileDataInText(ScintillaEditView* editView, QString filePat
 }
 
 
+//映射打开时读取的文件头大小，用来识别编码和换行符
+const qint64 MAPPED_HEAD_SIZE = 64 * 1024;
+//保存映射的文本时每次写入的大小
+const qint64 MAPPED_WRITE_SIZE = 4 * 1024 * 1024;
+
+//大文件以可编辑方式打开时，不读取解码整个文件，而是把文件映射给编辑器的文档直接引用，修改只记录在文档的片段表中。
+//只支持UTF8/ASCII文本，其它编码需要转码，返回非0，外面再走loadFileDataInText
+int FileManager::loadFileDataMapped(ScintillaEditView* editView, QString filePath, CODE_ID& fileTextCode, RC_LINE_FORM& lineEnd)
+{
+	NDD_TRACE_SPAN("FileManager::loadFileDataMapped", filePath);
+
+	QFile file(filePath);
+
+	if (!file.open(QIODevice::ExistingOnly | QIODevice::ReadOnly))
+	{
+		return 1;
+	}
+
+	//文件头用来识别BOM和换行符
+	QByteArray head = file.read(MAPPED_HEAD_SIZE);
+	file.close();
+
+	if (head.isEmpty())
+	{
+		return 1;
+	}
+
+	CODE_ID code = fileTextCode;
+	if (code == CODE_ID::UNKOWN)
+	{
+		code = CmpareMode::getTextFileEncodeType((uchar*)head.data(), head.size(), filePath);
+	}
+
+	if (code != CODE_ID::UTF8_NOBOM && code != CODE_ID::UTF8_BOM)
+	{
+		return 2;
+	}
+
+	lineEnd = RC_LINE_FORM::UNKNOWN_LINE;
+
+	int pos = head.indexOf('\n');
+	if (pos >= 1)
+	{
+		lineEnd = (head.at(pos - 1) == '\r') ? RC_LINE_FORM::DOS_LINE : RC_LINE_FORM::UNIX_LINE;
+	}
+
+	if (lineEnd == UNKNOWN_LINE)
+	{
+#ifdef _WIN32
+		lineEnd = DOS_LINE;
+#else
+		lineEnd = UNIX_LINE;
+#endif
+	}
+
+	MappedFileText* text = MappedFileText::create(filePath, (code == CODE_ID::UTF8_BOM) ? 3 : 0);
+	if (text == nullptr)
+	{
+		return 3;
+	}
+
+	//大文件不做语法高亮，不要和文本一样大的样式缓冲区。失败时文档已经释放了text
+	if (0 == editView->execute(SCI_SETMAPPEDTEXT, SC_DOCUMENTOPTION_STYLES_NONE, reinterpret_cast<sptr_t>(text)))
+	{
+		return 4;
+	}
+
+	editView->setProperty(Edit_Mapped_File, filePath);
+	fileTextCode = code;
+	return 0;
+}
+
+//把编辑器的文本分块写到file中，不在内存中拼出整个文本。文本是UTF8，只用于不需要转码的保存
+bool FileManager::writeEditText(ScintillaEditView* editView, QFile& file)
+{
+	qint64 length = editView->execute(SCI_GETLENGTH);
+
+	for (qint64 start = 0; start < length; start += MAPPED_WRITE_SIZE)
+	{
+		qint64 size = qMin(MAPPED_WRITE_SIZE, length - start);
+		const char* range = reinterpret_cast<const char*>(editView->execute(SCI_GETRANGEPOINTER, start, size));
+
+		if (range == nullptr || file.write(range, size) != size)
+		{
+			return false;
+		}
+	}
+	return true;
+}
+
+//UTF8直接写编辑器的字节；其它编码每块先解码再编码，块边界截断的字符由解码器留到下一块
+bool FileManager::writeEditText(ScintillaEditView* editView, QFile& file, CODE_ID code)
+{
+	if (editView->isUtf8() && (code == CODE_ID::UTF8_NOBOM || code == CODE_ID::UTF8_BOM))
+	{
+		QByteArray bom = Encode::getEncodeStartFlagByte(code);
+		if (!bom.isEmpty() && file.write(bom) != bom.size())
+		{
+			return false;
+		}
+		return writeEditText(editView, file);
+	}
+
+	TextEncoder encoder(code);
+	QByteArray bytes;
+
+	//十六进制方式查看的二进制文本不是UTF8，数据量也不大，整体转换
+	if (!editView->isUtf8())
+	{
+		QString text = editView->text();
+		encoder.encode(text.constData(), text.size(), bytes);
+		encoder.finish(bytes);
+		return (file.write(bytes) == bytes.size());
+	}
+
+	TextDecoder decoder(CODE_ID::UTF8_NOBOM, false);
+
+	QString text;
+	text.reserve(MAPPED_WRITE_SIZE + 8);
+	bytes.reserve(MAPPED_WRITE_SIZE * 3 + 32);
+
+	qint64 length = editView->execute(SCI_GETLENGTH);
+
+	for (qint64 start = 0; start < length; start += MAPPED_WRITE_SIZE)
+	{
+		qint64 size = qMin(MAPPED_WRITE_SIZE, length - start);
+		const char* range = reinterpret_cast<const char*>(editView->execute(SCI_GETRANGEPOINTER, start, size));
+		if (range == nullptr)
+		{
+			return false;
+		}
+
+		decoder.decode(range, size, text);
+		encoder.encode(text.constData(), text.size(), bytes);
+
+		if (file.write(bytes) != bytes.size())
+		{
+			return false;
+		}
+		text.resize(0);
+		bytes.resize(0);
+	}
+
+	decoder.finish(text);
+	encoder.encode(text.constData(), text.size(), bytes);
+	encoder.finish(bytes);
+
+	return (bytes.isEmpty() || file.write(bytes) == bytes.size());
+}
+
+//文件保存后让文档改为引用保存后的文件，释放之前映射的文件。交换文件在文档不再引用时删除
+bool FileManager::remapEditText(ScintillaEditView* editView, QString filePath, bool withBom, bool isSwapFile)
+{
+	MappedFileText* text = MappedFileText::create(filePath, withBom ? 3 : 0, isSwapFile);
+	if (text == nullptr)
+	{
+		return false;
+	}
+	if (0 == editView->execute(SCI_REBASEMAPPEDTEXT, 0, reinterpret_cast<sptr_t>(text)))
+	{
+		return false;
+	}
+	editView->setProperty(Edit_Mapped_File, filePath);
+	return true;
+}
+
+
 //加载文件，只为查找使用
 int FileManager::loadFileForSearch(ScintillaEditView* editView, QString filePath)
 {
@@ -693,6 +888,34 @@ int FileManager::loadFileForSearch(ScintillaEditView* editView, QString filePath
 	return 0;
 }
 
+int FileManager::reloadFileText(ScintillaEditView* editView, QString filePath, CODE_ID fileTextCode)
+{
+	NDD_TRACE_SPAN("FileManager::reloadFileText", filePath);
+
+	QFile file(filePath);
+
+	if (!file.open(QIODevice::ExistingOnly | QIODevice::ReadOnly))
+	{
+		return 2;
+	}
+
+	if (file.size() + qMin((qint64)(1 << 20), (qint64)(file.size() / 6)) > INT_MAX)
+	{
+		file.close();
+		return 3;
+	}
+
+	bool existGrbledCode = false;
+	QString outText;
+
+	CmpareMode::scanFileOutPut(file, fileTextCode, filePath, outText, existGrbledCode);
+	file.close();
+
+	editView->setText(outText);
+
+	return 0;
+}
+
 const int ONE_PAGE_BYTES = 4096;
 
 //加载下一页或者上一页。(二进制模式）
@@ -1073,6 +1296,8 @@ bool FileManager::loadFileData(QString filePath, HexFileMgr* & hexFileOut)
 //加载大文本文件。从0开始读取ONE_PAGE_TEXT_SIZE 500K的内容
 bool FileManager::loadFileData(QString filePath, TextFileMgr* & textFileOut, RC_LINE_FORM & lineEnd)
 {
+	NDD_TRACE_SPAN("FileManager::loadFileData", filePath);
+
 	QFile *file = new QFile(filePath);
 
 	if (!file->open(QIODevice::ReadOnly | QIODevice::ExistingOnly))
@@ -1215,6 +1440,8 @@ int getLineNumInBuf(char* buf, int size, CODE_ID code = UNKOWN)
 //创建大文件编辑模式的索引文件。0 成功，-1取消
 int FileManager::createBlockIndex(BigTextEditFileMgr* txtFile)
 {
+	NDD_TRACE_SPAN("FileManager::createBlockIndex");
+
 	//每次filePtr 4M的速度进行建块
 	qint64 fileSize = txtFile->file->size();
 
@@ -1385,6 +1612,350 @@ int FileManager::getBigFileBlockId(QString filepath, quint32 lineNum)
 	return -1;
 }
 
+#ifdef NDD_LINE_SCAN_SSE2
+static inline int lowestBitIndex(unsigned int v)
+{
+#ifdef _MSC_VER
+	unsigned long index = 0;
+	_BitScanForward(&index, v);
+	return (int)index;
+#else
+	return __builtin_ctz(v);
+#endif
+}
+
+static inline int bitCount(unsigned int v)
+{
+#ifdef _MSC_VER
+	return (int)__popcnt(v);
+#else
+	return __builtin_popcount(v);
+#endif
+}
+#endif
+
+//统计buf中的行结束符。lineCount是累计的行数，每当lineCount到达step的整数倍时，把下一行行首的偏移记录到checkPoints中。
+//checkPoints为nullptr时只计数。单字节类编码使用SSE2一次比较16个字节；UNICODE_LE/BE必须按两个字节一个单元整体比较。
+//baseOffset是buf[0]在文件中的偏移，UNICODE模式下必须是偶数
+static void scanLineEnds(const char* buf, qint64 size, qint64 baseOffset, int code, char eolChar, qint64& lineCount, QVector<qint64>* checkPoints, qint64 step)
+{
+	if (code == UNICODE_LE || code == UNICODE_BE)
+	{
+		char lo = (code == UNICODE_LE) ? eolChar : '\0';
+		char hi = (code == UNICODE_LE) ? '\0' : eolChar;
+
+		for (qint64 i = 0; i + 1 < size; i += 2)
+		{
+			if (buf[i] == lo && buf[i + 1] == hi)
+			{
+				++lineCount;
+				if (checkPoints != nullptr && (lineCount % step) == 0)
+				{
+					checkPoints->append(baseOffset + i + 2);
+				}
+			}
+		}
+		return;
+	}
+
+	qint64 i = 0;
+
+#ifdef NDD_LINE_SCAN_SSE2
+	const __m128i eol = _mm_set1_epi8(eolChar);
+
+	for (; i + 16 <= size; i += 16)
+	{
+		__m128i chunk = _mm_loadu_si128(reinterpret_cast<const __m128i*>(buf + i));
+		unsigned int mask = (unsigned int)_mm_movemask_epi8(_mm_cmpeq_epi8(chunk, eol));
+
+		if (mask == 0)
+		{
+			continue;
+		}
+
+		int n = bitCount(mask);
+
+		//这16个字节里面不会跨过检查点，直接累加即可
+		if (checkPoints == nullptr || (lineCount % step) + n < step)
+		{
+			lineCount += n;
+			continue;
+		}
+
+		while (mask != 0)
+		{
+			int bit = lowestBitIndex(mask);
+			mask &= (mask - 1);
+
+			++lineCount;
+			if ((lineCount % step) == 0)
+			{
+				checkPoints->append(baseOffset + i + bit + 1);
+			}
+		}
+	}
+#endif
+
+	while (i < size)
+	{
+		const char* p = (const char*)memchr(buf + i, eolChar, size - i);
+		if (p == nullptr)
+		{
+			break;
+		}
+		i = (p - buf) + 1;
+
+		++lineCount;
+		if (checkPoints != nullptr && (lineCount % step) == 0)
+		{
+			checkPoints->append(baseOffset + i);
+		}
+	}
+}
+
+//后台线程中执行：从头到尾扫描一遍文件，建立稀疏行索引。使用单独的QFile，不和界面线程共用文件句柄
+void FileManager::buildSuperBigLineIndex(QSharedPointer<SuperBigLineIndex> index, QString filePath, int code, int lineEndType)
+{
+	NDD_TRACE_SPAN("FileManager::buildSuperBigLineIndex", filePath);
+
+	QFile file(filePath);
+
+	if (!file.open(QIODevice::ReadOnly | QIODevice::ExistingOnly))
+	{
+		return;
+	}
+
+	const qint64 READ_BLOCK_SIZE = 8 * 1024 * 1024;
+
+	qint64 fileSize = file.size();
+	char eolChar = (lineEndType == MAC_LINE) ? '\r' : '\n';
+
+	QVector<qint64> checkPoints;
+	checkPoints.reserve(fileSize / (SuperBigLineIndex::LINE_INDEX_STEP * 64) + 16);
+	checkPoints.append(0);
+
+	qint64 lineCount = 0;
+	qint64 curOffset = 0;
+	int lastPercent = -1;
+
+	char* buf = new char[READ_BLOCK_SIZE];
+
+	while (curOffset < fileSize)
+	{
+		if (index->isCancel)
+		{
+			delete[]buf;
+			return;
+		}
+
+		qint64 ret = file.read(buf, READ_BLOCK_SIZE);
+		if (ret <= 0)
+		{
+			break;
+		}
+
+		scanLineEnds(buf, ret, curOffset, code, eolChar, lineCount, &checkPoints, SuperBigLineIndex::LINE_INDEX_STEP);
+
+		curOffset += ret;
+
+		int percent = (int)(curOffset * 100 / fileSize);
+		if (percent != lastPercent)
+		{
+			lastPercent = percent;
+			index->progress = percent;
+			emit FileManager::getInstance().signLineIndexProgress(filePath, percent);
+		}
+	}
+
+	delete[]buf;
+
+	//最后一个检查点刚好在文件尾部，不是一个真实的行
+	if (checkPoints.size() > 1 && checkPoints.last() >= fileSize)
+	{
+		checkPoints.removeLast();
+	}
+
+	//最后一行没有换行符，也算一行
+	qint64 totalLines = lineCount;
+	if (fileSize > 0)
+	{
+		bool endWithEol = false;
+		int unitSize = (code == UNICODE_LE || code == UNICODE_BE) ? 2 : 1;
+
+		if (file.seek(fileSize - unitSize))
+		{
+			char tail[2] = { 0 };
+			if (file.read(tail, unitSize) == unitSize)
+			{
+				endWithEol = (unitSize == 1) ? (tail[0] == eolChar) : ((code == UNICODE_LE) ? (tail[0] == eolChar && tail[1] == '\0') : (tail[0] == '\0' && tail[1] == eolChar));
+			}
+		}
+		if (!endWithEol)
+		{
+			++totalLines;
+		}
+	}
+
+	file.close();
+
+	if (index->isCancel)
+	{
+		return;
+	}
+
+	index->checkPoints.swap(checkPoints);
+	index->totalLines = totalLines;
+	index->progress = 100;
+	index->isFinished = true;
+
+	emit FileManager::getInstance().signLineIndexFinished(filePath, totalLines);
+}
+
+//超大文本打开后，在后台建立行索引。已经存在的旧索引会被取消，比如编码修改后需要重新建立
+void FileManager::startSuperBigLineIndex(TextFileMgr* txtFile)
+{
+	if (txtFile == nullptr)
+	{
+		return;
+	}
+
+	if (!txtFile->lineIndex.isNull())
+	{
+		txtFile->lineIndex->isCancel = true;
+	}
+
+	txtFile->curStartLineNum = -1;
+	txtFile->lineIndex = QSharedPointer<SuperBigLineIndex>(new SuperBigLineIndex());
+
+	QtConcurrent::run(&FileManager::buildSuperBigLineIndex, txtFile->lineIndex, txtFile->filePath, txtFile->loadWithCode, txtFile->lineEndType);
+}
+
+bool FileManager::isSuperBigLineIndexReady(QString filepath, qint64* totalLines)
+{
+	TextFileMgr* txtFile = getSuperBigFileMgr(filepath);
+
+	if (txtFile == nullptr || txtFile->lineIndex.isNull() || !txtFile->lineIndex->isFinished)
+	{
+		return false;
+	}
+
+	if (totalLines != nullptr)
+	{
+		*totalLines = txtFile->lineIndex->totalLines;
+	}
+	return true;
+}
+
+//统计buf中行结束符的数量，可以在任意线程中调用
+qint64 FileManager::countLineEnds(const char* buf, qint64 size, int code, int lineEndType)
+{
+	qint64 lineCount = 0;
+	scanLineEnds(buf, size, 0, code, (lineEndType == MAC_LINE) ? '\r' : '\n', lineCount, nullptr, 1);
+	return lineCount;
+}
+
+//从startAddr（必须是行首）开始往后扫描到endAddr。stopLines大于0时，返回经过stopLines行后的行首地址，没找到返回-1；
+//stopLines为0时，返回中间经过的行数。只在界面线程调用，使用完后恢复文件的读写位置
+qint64 FileManager::scanSuperBigLines(TextFileMgr* txtFile, qint64 startAddr, qint64 endAddr, int stopLines)
+{
+	const qint64 READ_BLOCK_SIZE = 1024 * 1024;
+
+	qint64 oldPos = txtFile->file->pos();
+	char eolChar = (txtFile->lineEndType == MAC_LINE) ? '\r' : '\n';
+
+	QVector<qint64> found;
+	qint64 lineCount = 0;
+	qint64 curOffset = startAddr;
+
+	char* buf = new char[READ_BLOCK_SIZE];
+
+	txtFile->file->seek(startAddr);
+
+	while (curOffset < endAddr)
+	{
+		qint64 ret = txtFile->file->read(buf, qMin(READ_BLOCK_SIZE, endAddr - curOffset));
+		if (ret <= 0)
+		{
+			break;
+		}
+
+		scanLineEnds(buf, ret, curOffset, txtFile->loadWithCode, eolChar, lineCount, (stopLines > 0) ? &found : nullptr, (stopLines > 0) ? stopLines : 1);
+
+		curOffset += ret;
+
+		if (!found.isEmpty())
+		{
+			break;
+		}
+	}
+
+	delete[]buf;
+
+	txtFile->file->seek(oldPos);
+
+	if (stopLines > 0)
+	{
+		return found.isEmpty() ? -1 : found.first();
+	}
+	return lineCount;
+}
+
+//获取超大文本第lineNum行（从0开始）的行首地址。索引还没建立好时返回false
+bool FileManager::getSuperBigLineAddr(QString filepath, qint64 lineNum, qint64& lineAddr)
+{
+	qint64 totalLines = 0;
+
+	if (!isSuperBigLineIndexReady(filepath, &totalLines) || lineNum < 0 || lineNum >= totalLines)
+	{
+		return false;
+	}
+
+	TextFileMgr* txtFile = getSuperBigFileMgr(filepath);
+	const QVector<qint64>& checkPoints = txtFile->lineIndex->checkPoints;
+
+	qint64 i = lineNum / SuperBigLineIndex::LINE_INDEX_STEP;
+	if (i >= checkPoints.size())
+	{
+		i = checkPoints.size() - 1;
+	}
+
+	int remainLines = (int)(lineNum - i * SuperBigLineIndex::LINE_INDEX_STEP);
+
+	if (remainLines == 0)
+	{
+		lineAddr = checkPoints.at(i);
+		return true;
+	}
+
+	lineAddr = scanSuperBigLines(txtFile, checkPoints.at(i), txtFile->fileSize, remainLines);
+
+	return (lineAddr >= 0);
+}
+
+//获取超大文本中addr地址所在行的行号（从0开始）。索引还没建立好时返回-1
+qint64 FileManager::getSuperBigLineNumAt(QString filepath, qint64 addr)
+{
+	if (!isSuperBigLineIndexReady(filepath))
+	{
+		return -1;
+	}
+
+	TextFileMgr* txtFile = getSuperBigFileMgr(filepath);
+	const QVector<qint64>& checkPoints = txtFile->lineIndex->checkPoints;
+
+	//找到不大于addr的最后一个检查点
+	auto it = std::upper_bound(checkPoints.begin(), checkPoints.end(), addr);
+	if (it == checkPoints.begin())
+	{
+		return 0;
+	}
+	--it;
+
+	qint64 i = it - checkPoints.begin();
+
+	return i * SuperBigLineIndex::LINE_INDEX_STEP + scanSuperBigLines(txtFile, *it, addr, 0);
+}
+
 HexFileMgr * FileManager::getHexFileHand(QString filepath)
 {
 	if (m_hexFileMgr.contains(filepath))
@@ -7,6 +7,8 @@
 #include <QObject>
 #include <QList>
 #include <QFile>
+#include <QSharedPointer>
+#include <atomic>
 
 class ScintillaEditView;
 class ScintillaHexEditView;
@@ -62,6 +64,21 @@ private:
 	HexFileMgr(const HexFileMgr&) = delete;
 };
 
+//超大文本后台建立的稀疏行索引。每隔LINE_INDEX_STEP行记录一个检查点，即该行行首在文件中的偏移
+//只有isFinished为true后，才能读取checkPoints和totalLines
+struct SuperBigLineIndex {
+	static const int LINE_INDEX_STEP = 1024;
+	QVector<qint64> checkPoints;//checkPoints[i]是第i*LINE_INDEX_STEP行(从0开始)的行首偏移
+	qint64 totalLines;
+	std::atomic<bool> isCancel;
+	std::atomic<bool> isFinished;
+	std::atomic<int> progress;//百分比
+
+	SuperBigLineIndex() :totalLines(0), isCancel(false), isFinished(false), progress(0)
+	{
+	}
+};
+
 //管理大文本文件的信息
 struct TextFileMgr {
 	QString filePath;
@@ -73,13 +90,21 @@ struct TextFileMgr {
 	int contentRealSize;
 	int loadWithCode;
 	int lineEndType;//行尾类型，win linux mac
+	qint64 curStartLineNum;//当前显示内容首行的行号，从0开始。-1表示未知
+	QSharedPointer<SuperBigLineIndex> lineIndex;//后台建立的行索引
 	
-	TextFileMgr() :file(nullptr), fileOffset(0), lineSize(64), fileSize(0), contentBuf(nullptr), contentRealSize(0), loadWithCode(CODE_ID::UNKOWN),lineEndType(RC_LINE_FORM::UNKNOWN_LINE)
+	TextFileMgr() :file(nullptr), fileOffset(0), lineSize(64), fileSize(0), contentBuf(nullptr), contentRealSize(0), loadWithCode(CODE_ID::UNKOWN),lineEndType(RC_LINE_FORM::UNKNOWN_LINE), curStartLineNum(-1)
 	{
 
 	}
 	void destory()
 	{
+		//通知后台建立索引的线程退出
+		if (!lineIndex.isNull())
+		{
+			lineIndex->isCancel = true;
+			lineIndex.clear();
+		}
 		if (file != nullptr)
 		{
 			file->close();
@@ -161,8 +186,20 @@ public:
 
 	int loadFileDataInText(ScintillaEditView* editView, QString filePath, CODE_ID& fileTextCode, RC_LINE_FORM& lineEnd, CCNotePad* callbackObj = nullptr, bool hexAsk = true, QWidget* msgBoxParent = nullptr);
 	
+	int loadFileDataMapped(ScintillaEditView* editView, QString filePath, CODE_ID& fileTextCode, RC_LINE_FORM& lineEnd);
+
+	bool writeEditText(ScintillaEditView* editView, QFile& file);
+
+	//按code编码分块写入，带BOM的编码先写BOM
+	bool writeEditText(ScintillaEditView* editView, QFile& file, CODE_ID code);
+
+	bool remapEditText(ScintillaEditView* editView, QString filePath, bool withBom, bool isSwapFile = false);
+
 	int loadFileForSearch(ScintillaEditView * editView, QString filePath);
 
+	//按已知编码重新读取文件内容，不重新识别语法。后台标签页释放文本后，激活时用它加载
+	int reloadFileText(ScintillaEditView* editView, QString filePath, CODE_ID fileTextCode);
+
 	//int loadFileData(ScintillaEditView * editView, QString filePath, CODE_ID & fileTextCode, RC_LINE_FORM & lineEnd);
 
 	int loadFilePreNextPage(int dir, QString & filePath, HexFileMgr *& hexFileOut);
@@ -187,6 +224,16 @@ public:
 
 	int getBigFileBlockId(QString filepath, quint32 lineNum);
 
+	void startSuperBigLineIndex(TextFileMgr* txtFile);
+
+	bool isSuperBigLineIndexReady(QString filepath, qint64* totalLines = nullptr);
+
+	bool getSuperBigLineAddr(QString filepath, qint64 lineNum, qint64& lineAddr);
+
+	qint64 getSuperBigLineNumAt(QString filepath, qint64 addr);
+
+	static qint64 countLineEnds(const char* buf, qint64 size, int code, int lineEndType);
+
 	void closeHexFileHand(QString filepath);
 
 	void closeSuperBigTextFileHand(QString filepath);
@@ -208,10 +255,17 @@ public:
 		m_lastErrorCode = NONE_ERROR;
 	}
 
+signals:
+	//下面两个信号是在后台线程中发出的，连接时使用默认的连接方式即可，会排队到主线程执行
+	void signLineIndexProgress(QString filePath, int percent);
+	void signLineIndexFinished(QString filePath, qint64 totalLines);
+
 private:
 	FileManager();
 	~FileManager();
 	int createBlockIndex(BigTextEditFileMgr* txtFile);
+	static void buildSuperBigLineIndex(QSharedPointer<SuperBigLineIndex> index, QString filePath, int code, int lineEndType);
+	qint64 scanSuperBigLines(TextFileMgr* txtFile, qint64 startAddr, qint64 endAddr, int stopLines);
 
 	FileManager(const FileManager&) = delete;
 	FileManager& operator=(const FileManager&) = delete;
@@ -144,8 +144,7 @@ void ColumnEdit::slot_ok()
 		}
 	}
 
-	pEdit->execute(SCI_BEGINUNDOACTION);
-
+	//列模式和下面的多行插入都是一次修改文档，只有一个撤销步骤
 	if (ui.textGroupBox->isChecked())
 	{
 		if (pEdit->execute(SCI_SELECTIONISRECTANGLE) || pEdit->execute(SCI_GETSELECTIONS) > 1)
@@ -191,42 +190,35 @@ void ColumnEdit::slot_ok()
 	auto endPos = pEdit->execute(SCI_GETLENGTH);
 	auto endLine = pEdit->execute(SCI_LINEFROMPOSITION, endPos);
 	
-	QByteArray lineData;
+	//每一行在光标所在列插入，不再替换整行。所有行的插入最后一次完成
+	std::vector<QByteArray> insertTexts;
+	std::vector<Sci_TextRange> ranges;
+	insertTexts.reserve(endLine - cursorLine + 1);
+	ranges.reserve(endLine - cursorLine + 1);
 
 	int rn = repeNum;
 
 	for (size_t i = cursorLine; i <= static_cast<size_t>(endLine); ++i)
 	{
-		auto lineBegin = pEdit->execute(SCI_POSITIONFROMLINE, i);
 		auto lineEnd = pEdit->execute(SCI_GETLINEENDPOSITION, i);
-
 		auto lineEndCol = pEdit->execute(SCI_GETCOLUMN, lineEnd);
-		auto lineLen = lineEnd - lineBegin;
-		lineData.resize(lineLen);
-			
 
-		Sci_TextRange  lineText;
-		lineText.chrg.cpMin = static_cast<Sci_Position>(lineBegin);
-		lineText.chrg.cpMax = static_cast<Sci_Position>(lineEnd);
-		lineText.lpstrText = lineData.data();
-		//获取原始行的内容
-		pEdit->SendScintilla(SCI_GETTEXTRANGE, 0, &lineText);
+		Sci_TextRange range;
 
 		if (lineEndCol < cursorCol)
 		{
-			QByteArray s_space(cursorCol - lineEndCol, ' ');
-			lineData.append(s_space);
-			lineData.append(text.toUtf8());
+			//行不够长，在行尾补上空格
+			insertTexts.push_back(QByteArray(cursorCol - lineEndCol, ' ') + text.toUtf8());
+			range.chrg.cpMin = static_cast<Sci_PositionCR>(lineEnd);
 		}
 		else
 		{
-			int posAbs2Start = pEdit->execute(SCI_FINDCOLUMN, i, cursorCol);
-			int posRelative2Start = posAbs2Start - lineBegin;
-			lineData.insert(posRelative2Start, text.toUtf8());
+			insertTexts.push_back(text.toUtf8());
+			range.chrg.cpMin = static_cast<Sci_PositionCR>(pEdit->execute(SCI_FINDCOLUMN, i, cursorCol));
 		}
-
-		pEdit->SendScintilla(SCI_SETTARGETRANGE, lineBegin, lineEnd);
-		pEdit->SendScintilla(SCI_REPLACETARGET, lineData.size(), lineData.data());
+		range.chrg.cpMax = range.chrg.cpMin;
+		range.lpstrText = insertTexts.back().data();
+		ranges.push_back(range);
 
 		if (isNum)
 		{
@@ -268,5 +260,5 @@ void ColumnEdit::slot_ok()
 		}
 	}
 
-	pEdit->execute(SCI_ENDUNDOACTION);
+	pEdit->execute(SCI_REPLACERANGES, ranges.size(), reinterpret_cast<sptr_t>(ranges.data()));
 }
@@ -2,25 +2,105 @@
 #include "rcglobal.h"
 #include "CmpareMode.h"
 #include "doctypelistview.h"
+#include "texttranscoder.h"
 
 #include <QFileDialog>
+#include <QTemporaryFile>
 #include <QTreeWidgetItem>
 #include <QDateTime>
 #include <QFutureWatcher>
 #include <QString>
 #include <QtConcurrent>
+#include <QThread>
 #include <QInputDialog>
 #include <QDragEnterEvent>
 
+#ifdef Q_OS_WIN
+#include <qt_windows.h>
+#else
+#include <stdio.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
 
 const int ITEM_CODE = Qt::UserRole + 1;
 
+//转换主要是读写磁盘，线程多了反而互相抢磁盘
+const int MAX_CONVERT_THREADS = 4;
+
 static QString fileSuffix(const QString& filePath)
 {
 	QFileInfo fi(filePath);
 	return fi.suffix();
 }
 
+//把srcPath的内容写回dstPath原来的文件，文件本身不变，所有的硬链接都能看到新内容。不是原子的
+static bool copyContentBack(const QString& srcPath, const QString& dstPath)
+{
+	QFile src(srcPath);
+	QFile dst(dstPath);
+
+	if (!src.open(QIODevice::ReadOnly) || !dst.open(QIODevice::WriteOnly | QIODevice::Truncate))
+	{
+		return false;
+	}
+
+	QByteArray buf(TextTranscoder::CHUNK_SIZE, Qt::Uninitialized);
+	while (true)
+	{
+		qint64 n = src.read(buf.data(), buf.size());
+		if (n < 0)
+		{
+			return false;
+		}
+		if (n == 0)
+		{
+			break;
+		}
+		if (dst.write(buf.constData(), n) != n)
+		{
+			return false;
+		}
+	}
+	return dst.flush();
+}
+
+//同一目录内重命名覆盖目标文件，是原子的，不会出现写了一半的文件。QFile::rename不能覆盖已有文件。
+//dstPath必须是解析过链接的真实文件，否则替换掉的是链接本身
+static bool replaceFile(const QString& srcPath, const QString& dstPath)
+{
+#ifdef Q_OS_WIN
+	//ReplaceFile保留原文件的属性、所有者和ACL
+	return (0 != ReplaceFileW((LPCWSTR)QDir::toNativeSeparators(dstPath).utf16(), (LPCWSTR)QDir::toNativeSeparators(srcPath).utf16(),
+		nullptr, REPLACEFILE_IGNORE_MERGE_ERRORS, nullptr, nullptr));
+#else
+	QByteArray src = QFile::encodeName(srcPath);
+	QByteArray dst = QFile::encodeName(dstPath);
+
+	struct stat st;
+	if (0 != ::stat(dst.constData(), &st))
+	{
+		return false;
+	}
+
+	//有多个硬链接时重命名会把这个名字和其它链接分开，只能把内容写回原文件
+	if (st.st_nlink > 1)
+	{
+		return copyContentBack(srcPath, dstPath);
+	}
+
+	//临时文件属于当前用户，改回原文件的所有者和权限。不是root时只能改组，改不了也不影响替换
+	if (0 != ::chown(src.constData(), st.st_uid, st.st_gid))
+	{
+		(void)::chown(src.constData(), (uid_t)-1, st.st_gid);
+	}
+	::chmod(src.constData(), st.st_mode & 07777);
+
+	return (0 == ::rename(src.constData(), dst.constData()));
+#endif
+}
+
 static QString getFileSizeFormat(qint64 size)
 {
 #if 0
@@ -36,10 +116,13 @@ static QString getFileSizeFormat(qint64 size)
 	return QString::number(size);
 }
 
-EncodeConvert::EncodeConvert(QWidget *parent): QWidget(parent), m_commitCmpFileNums(0), m_finishCmpFileNums(0), m_menu(nullptr)
+EncodeConvert::EncodeConvert(QWidget *parent): QWidget(parent), m_commitCmpFileNums(0), m_finishCmpFileNums(0), m_menu(nullptr),
+	m_nextConvertJob(0), m_runningConvertJobs(0), m_convertDstCode(CODE_ID::UNKOWN), m_isVerifyConvert(true), m_convertedBytes(0), m_failConvertNums(0)
 {
 	ui.setupUi(this);
 
+	m_convertPool.setMaxThreadCount(qBound(1, QThread::idealThreadCount(), MAX_CONVERT_THREADS));
+
 	m_extComBoxNum = 0;
 	connect(ui.treeWidget, &QTreeWidget::itemPressed, this, &EncodeConvert::slot_itemClicked);
 
@@ -307,11 +390,20 @@ QFuture<EncodeThreadParameter_*> EncodeConvert::checkFileCode(QString filePath,
 }
 
 
-CODE_ID EncodeConvert::convertFileToCode(QString& filePath, CODE_ID srcCode, CODE_ID dstCode)
+//读一块转一块写到同目录的临时文件，需要时读回来校验，最后原子替换原文件。中途失败时原文件不变
+CODE_ID EncodeConvert::convertFileToCode(EncodeThreadParameter* parameter, CODE_ID srcCode, CODE_ID dstCode, bool isVerify)
 {
+	if (srcCode == CODE_ID::UNKOWN || dstCode == CODE_ID::UNKOWN)
+	{
+		parameter->error = tr("unknown text code");
+		return CODE_ID::UNKOWN;
+	}
 
-	if (srcCode == CODE_ID::UNKOWN)
+	//符号链接要转换的是它指向的文件，临时文件也放在那个文件的目录下
+	const QString filePath = QFileInfo(parameter->filepath).canonicalFilePath();
+	if (filePath.isEmpty())
 	{
+		parameter->error = tr("open failed");
 		return CODE_ID::UNKOWN;
 	}
 
@@ -319,100 +411,70 @@ CODE_ID EncodeConvert::convertFileToCode(QString& filePath, CODE_ID srcCode, COD
 
 	if (!file.open(QIODevice::ReadOnly | QIODevice::ExistingOnly))
 	{
+		parameter->error = tr("open failed");
 		return CODE_ID::UNKOWN;
 	}
 
-	QByteArray content = file.readAll();
+	parameter->bytes = file.size();
 
-	file.close();
+	//临时文件放在同一目录，才能原子重命名。失败时QTemporaryFile自动删除
+	QFileInfo fi(filePath);
+	QTemporaryFile tempFile(QString("%1/.%2.XXXXXX").arg(fi.absolutePath()).arg(fi.fileName()));
 
-	int skip = 0;
-
-	switch (srcCode)
-	{
-	case UNKOWN:
-		break;
-	case ANSI:
-		break;
-	case UNICODE_LE:
-		skip = 2;
-		break;
-	case UNICODE_BE:
-		skip = 2;
-		break;
-	case UTF8_NOBOM:
-		break;
-	case UTF8_BOM:
-		skip = 3;
-		break;
-	case GBK:
-		break;
-	default:
-		break;
-	}
-
-	if (!file.open(QIODevice::WriteOnly | QIODevice::ExistingOnly | QIODevice::Truncate))
+	if (!tempFile.open())
 	{
+		parameter->error = tr("create temp file failed");
 		return CODE_ID::UNKOWN;
 	}
 
-
-	QByteArray text2Save;
-
-	if (skip == 2 && content.size() >= 2)
+	//源编码的BOM由解码器跳过，目标编码的BOM由编码器写入
+	if (!TextTranscoder::transcode(file, srcCode, tempFile, dstCode, parameter->decodeInvalid, parameter->encodeInvalid) || !tempFile.flush())
 	{
-		text2Save = QByteArray(content.mid(2));
+		parameter->error = tr("write failed");
+		return CODE_ID::UNKOWN;
 	}
-	else if (skip == 3 && content.size() >= 3)
+
+	//windows下打开着的文件不能重命名
+	tempFile.close();
+
+	//源文件中有无法解码的字节时，原来的字节已经丢失，两边解码后比较也发现不了，直接说明原因
+	if (isVerify && parameter->decodeInvalid > 0)
 	{
-		text2Save = QByteArray(content.mid(3));
+		parameter->error = tr("contains %1 invalid byte sequences for the source encoding, the original file is kept").arg(parameter->decodeInvalid);
+		return CODE_ID::UNKOWN;
 	}
-	else
+
+	//有字符被替换为'?'时，文本必然对不上，不用再比较，直接说明原因
+	if (isVerify && parameter->encodeInvalid > 0)
 	{
-		text2Save = QByteArray(content);
+		parameter->error = tr("contains %1 characters not representable in the target encoding, the original file is kept").arg(parameter->encodeInvalid);
+		return CODE_ID::UNKOWN;
 	}
 
-	QString textOut;
-
-	Encode::tranStrToUNICODE(srcCode, text2Save.data(), text2Save.size(), textOut);
-	 
-
-	if (dstCode != UNKOWN)
+	if (isVerify)
 	{
-		//QByteArray codeFlag = Encode::getEncodeStartFlagByte(dstCode);
-
-		//20210822 发现大坑，转换到一定格式后，字符串前面自动带了标识，不需要再来检查一次
-		//if (!codeFlag.isEmpty())
-		//{
-		//	//先写入标识头
-		//	file.write(codeFlag);
-		//}
+		QFile written(tempFile.fileName());
 
-		//如果编码是已知如下类型，则后续保存其它行时，不修改编码格式，继续按照原编码进行保存
-		//前面已经设置过编码了，这里不需要再设置
-		if (dstCode == CODE_ID::UTF8_BOM)
+		if (!file.seek(0) || !written.open(QIODevice::ReadOnly) || !TextTranscoder::compareText(file, srcCode, written, dstCode))
 		{
-			//自动转换不会带UTF-8 BOM，所以自己要在前面写个BOM头。这是一个例外。需要手动写入头
-			//其他必然BL LE则不需要。
-			QByteArray codeFlag = Encode::getEncodeStartFlagByte(dstCode);
-
-			if (!codeFlag.isEmpty())
-			{
-				//先写入标识头
-				file.write(codeFlag);
-			}
-		}
-
-		if (textOut.length() > 0)
-		{
-			//保存时注意编码问题。这个tolocal已经带了字符BOM头了。只要UTF8_BOM不会带
-			QByteArray t = textOut.toLocal8Bit();
-			file.write(textOut.toLocal8Bit());
+			parameter->error = tr("verify failed, the original file is kept");
+			return CODE_ID::UNKOWN;
 		}
 	}
 
 	file.close();
 
+	if (!replaceFile(tempFile.fileName(), filePath))
+	{
+		parameter->error = tr("replace file failed");
+		return CODE_ID::UNKOWN;
+	}
+
+	//重命名以后临时文件已经不在了；内容写回原文件时临时文件还在，由QTemporaryFile删除
+	if (!QFile::exists(tempFile.fileName()))
+	{
+		tempFile.setAutoRemove(false);
+	}
 	return dstCode;
 }
 
@@ -426,33 +488,49 @@ CODE_ID EncodeConvert::getComboBoxCode(int index){
 	return ret;
 };
 
-QFuture<EncodeThreadParameter_*> EncodeConvert::convertFileCode(QString filePath, QTreeWidgetItem* item)
+QFuture<EncodeThreadParameter_*> EncodeConvert::convertFileCode(const ConvertJob& job)
 {
-	EncodeThreadParameter_* p = new EncodeThreadParameter_(filePath);
-	p->item = item;
-
-	CODE_ID srcCode = static_cast<CODE_ID>(item->data(0, ITEM_CODE).toInt());
-
-	CODE_ID dstCode = getComboBoxCode(ui.codeToComboBox->currentIndex());
+	EncodeThreadParameter_* p = new EncodeThreadParameter_(job.filePath);
+	p->item = job.item;
 
+	CODE_ID srcCode = job.srcCode;
+	CODE_ID dstCode = m_convertDstCode;
+	bool isVerify = m_isVerifyConvert;
 
-	//int 0相等 1 不等
-	return commitTask([=](EncodeThreadParameter_* parameter)->EncodeThreadParameter_*
+	//在自己的线程池中执行，同时转换的文件数有上限
+	return QtConcurrent::run(&m_convertPool, [=](EncodeThreadParameter_* parameter)->EncodeThreadParameter_*
 		{
-			if (dstCode != CODE_ID::UNKOWN)
-			{
-				parameter->code = convertFileToCode(parameter->filepath, srcCode, dstCode);
-			}
-			else
-			{
-				parameter->code = UNKOWN;
-			}
+			parameter->code = convertFileToCode(parameter, srcCode, dstCode, isVerify);
 			return parameter;
 		}
 	, p);
 
 }
 
+//补充任务到线程池，保持最多线程数个文件在转换。5万个文件时也不会一次生成5万个任务
+void EncodeConvert::submitConvertJobs()
+{
+	while (m_runningConvertJobs < m_convertPool.maxThreadCount() && m_nextConvertJob < m_convertJobs.size())
+	{
+		const ConvertJob& job = m_convertJobs.at(m_nextConvertJob++);
+
+		QFutureWatcher<EncodeThreadParameter_*>* futureWatcher = new QFutureWatcher<EncodeThreadParameter_*>();
+
+		QObject::connect(futureWatcher, &QFutureWatcher<EncodeThreadParameter_>::finished, this, &EncodeConvert::slot_convertFileFinish);
+
+		futureWatcher->setFuture(this->convertFileCode(job));
+
+		++m_runningConvertJobs;
+	}
+}
+
+//已经转换的字节数每秒
+QString EncodeConvert::convertSpeed() const
+{
+	qint64 ms = qMax<qint64>(1, m_convertTimer.elapsed());
+	return tranFileSize(m_convertedBytes * 1000 / ms);
+}
+
 //20220114 仅仅使用第一行失败编码还是不行，因为utf8和gbk其实有相同的编码范围。
 //如果识别第一行为gbk的，则直接使用gbk。但是如果识别为utf8的，则需要识别更多的文本内容，这样会更慢
 void EncodeConvert::scanFileCode()
@@ -548,6 +626,7 @@ void EncodeConvert::slot_startConvert()
 
 	//如果编码是已知如下类型，则后续保存其它行时，不修改编码格式，继续按照原编码进行保存
 
+	//转换时每个任务自己带编码器，不再修改全局的locale编码
 	QString destCodeName = Encode::getQtCodecNameById(dstCode);
 	if (destCodeName.isEmpty() || destCodeName == "unknown")
 	{
@@ -555,34 +634,35 @@ void EncodeConvert::slot_startConvert()
 		assert(false);
 		return;
 	}
-	else
-	{
-		QTextCodec::setCodecForLocale(QTextCodec::codecForName(destCodeName.toStdString().c_str()));
-	}
 
 	ui.selectFileBt->setEnabled(false);
+	ui.startBt->setEnabled(false);
 	ui.codeToComboBox->setEditable(false);
 	ui.closeBt->setEnabled(false);
 
+	m_convertJobs.clear();
+	m_nextConvertJob = 0;
+	m_runningConvertJobs = 0;
+	m_convertDstCode = dstCode;
+	m_isVerifyConvert = ui.verifyCheckBox->isChecked();
+	m_convertedBytes = 0;
+	m_failConvertNums = 0;
 
 	for (QList<fileAttriNode>::iterator iter = m_fileAttris.begin(); iter != m_fileAttris.end(); ++iter)
 	{
 		if ((iter->type == RC_FILE) && isSupportExt(extComboBoxIndex, fileSuffix(iter->relativePath)))
 		{
-			qDebug() << iter->relativePath;
-
 			CODE_ID srcCode = static_cast<CODE_ID>(iter->selfItem->data(0, ITEM_CODE).toInt());
 
-			CODE_ID dstCode = getComboBoxCode(ui.codeToComboBox->currentIndex());
-
 			if (srcCode != dstCode)
 			{
+				ConvertJob job;
+				job.filePath = iter->relativePath;
+				job.item = iter->selfItem;
+				job.srcCode = srcCode;
+				m_convertJobs.append(job);
 
-				QFutureWatcher<EncodeThreadParameter_*>* futureWatcher = new QFutureWatcher<EncodeThreadParameter_*>();
-
-				QObject::connect(futureWatcher, &QFutureWatcher<EncodeThreadParameter_>::finished, this, &EncodeConvert::slot_convertFileFinish);
-
-				futureWatcher->setFuture(this->convertFileCode(iter->relativePath, iter->selfItem));
+				iter->selfItem->setText(4, tr("wait convert"));
 
 				++m_commitCmpFileNums;
 			}
@@ -597,6 +677,11 @@ void EncodeConvert::slot_startConvert()
 		}
 	}
 
+	ui.logTextBrowser->append(tr("total file %1, convert %2 files at the same time").arg(m_commitCmpFileNums).arg(m_convertPool.maxThreadCount()));
+
+	m_convertTimer.start();
+	submitConvertJobs();
+
 	int finishProcessRatio = 0;
 
 	while (m_finishCmpFileNums < m_commitCmpFileNums)
@@ -607,15 +692,20 @@ void EncodeConvert::slot_startConvert()
 		if (curProcessRatio - finishProcessRatio >= 5)
 		{
 			finishProcessRatio = curProcessRatio;
-			ui.logTextBrowser->append(tr("total file %1,cur deal index %2,finish %3%").arg(m_commitCmpFileNums).arg(m_finishCmpFileNums).arg(curProcessRatio));
+			ui.logTextBrowser->append(tr("total file %1,cur deal index %2,finish %3%, speed %4/s").arg(m_commitCmpFileNums).arg(m_finishCmpFileNums).arg(curProcessRatio).arg(convertSpeed()));
 		}
-		QCoreApplication::processEvents();
+		//任务完成的通知是事件，没有事件时不空转
+		QCoreApplication::processEvents(QEventLoop::WaitForMoreEvents);
 	}
 
 	ui.logTextBrowser->append(tr("total file %1,cur deal index %2,finish 100%").arg(m_commitCmpFileNums).arg(m_finishCmpFileNums));
-	ui.logTextBrowser->append(tr("convert finished !"));
+	ui.logTextBrowser->append(tr("convert finished ! failed %1, read %2 in %3 s, speed %4/s").arg(m_failConvertNums)
+		.arg(tranFileSize(m_convertedBytes)).arg(m_convertTimer.elapsed() / 1000.0, 0, 'f', 1).arg(convertSpeed()));
+
+	m_convertJobs.clear();
 
 	ui.selectFileBt->setEnabled(true);
+	ui.startBt->setEnabled(true);
 	ui.codeToComboBox->setEditable(true);
 	ui.closeBt->setEnabled(true);
 }
@@ -635,14 +725,28 @@ void EncodeConvert::slot_convertFileFinish()
 		{
 			result->item->setText(3, Encode::getCodeNameById(result->code));
 			result->item->setText(4, tr("convert finish"));
+
+			//只有不校验时，有替换字符的文件才会转换成功
+			if (result->decodeInvalid > 0)
+			{
+				ui.logTextBrowser->append(tr("file %1 has %2 invalid byte sequences for the source encoding, they are replaced").arg(result->filepath).arg(result->decodeInvalid));
+			}
+			if (result->encodeInvalid > 0)
+			{
+				ui.logTextBrowser->append(tr("file %1 has %2 characters not representable in the target encoding, they are replaced").arg(result->filepath).arg(result->encodeInvalid));
+			}
+
+			result->item->setData(0, ITEM_CODE, result->code);
 		}
 		else
 		{
+			//失败时原文件没有改变，编码还是原来的
 			result->item->setText(4, tr("convert fail"));
-			ui.logTextBrowser->append(tr("file %1 convert failed,pleas check...").arg(result->item->data(0, Qt::ToolTipRole).toString()));
+			ui.logTextBrowser->append(tr("file %1 convert failed: %2").arg(result->filepath).arg(result->error));
+			++m_failConvertNums;
 		}
 
-		result->item->setData(0, ITEM_CODE, result->code);
+		m_convertedBytes += result->bytes;
 
 		delete result;
 		result = nullptr;
@@ -652,6 +756,9 @@ void EncodeConvert::slot_convertFileFinish()
 	s = nullptr;
 
 	++m_finishCmpFileNums;
+	--m_runningConvertJobs;
+
+	submitConvertJobs();
 }
 
 //对item进行间隔着色
@@ -2,6 +2,8 @@
 
 #include <QWidget>
 #include <QFuture>
+#include <QThreadPool>
+#include <QElapsedTimer>
 #include <functional>
 #include <QMap>
 
@@ -13,15 +15,33 @@ typedef struct EncodeThreadParameter_ {
 	QString filepath;
 	CODE_ID code;
 	QTreeWidgetItem* item;
+	//转换时读取的字节数，统计吞吐
+	qint64 bytes;
+	//源文件中无法按源编码解码的字符个数
+	qint64 decodeInvalid;
+	//目标编码中无法表示、被替换掉的字符个数
+	qint64 encodeInvalid;
+	QString error;
 
 	EncodeThreadParameter_(QString filePath_)
 	{
 		filepath = filePath_;
 		code = CODE_ID::UNKOWN;
+		item = nullptr;
+		bytes = 0;
+		decodeInvalid = 0;
+		encodeInvalid = 0;
 	}
 
 }EncodeThreadParameter;
 
+//等待转换的文件
+struct ConvertJob {
+	QString filePath;
+	QTreeWidgetItem* item;
+	CODE_ID srcCode;
+};
+
 class EncodeConvert : public QWidget
 {
 	Q_OBJECT
@@ -37,9 +57,11 @@ private:
 	
 	QFuture<EncodeThreadParameter*> commitTask(std::function<EncodeThreadParameter* (EncodeThreadParameter*)> fun, EncodeThreadParameter* parameter);
 	QFuture<EncodeThreadParameter_*> checkFileCode(QString filePath, QTreeWidgetItem* item);
-	static CODE_ID convertFileToCode(QString& filePath, CODE_ID srcCode, CODE_ID dstDode);
+	static CODE_ID convertFileToCode(EncodeThreadParameter* parameter, CODE_ID srcCode, CODE_ID dstDode, bool isVerify);
 	static CODE_ID getComboBoxCode(int index);
-	QFuture<EncodeThreadParameter_*> convertFileCode(QString filePath, QTreeWidgetItem* item);
+	QFuture<EncodeThreadParameter_*> convertFileCode(const ConvertJob& job);
+	void submitConvertJobs();
+	QString convertSpeed() const;
 	void scanFileCode();
 
 protected:
@@ -75,4 +97,16 @@ private:
 	QList< QMap<QString, bool>* > m_supportFileExt;
 
 	QMenu* m_menu;
+
+	//转换任务排队，同时执行的不超过m_convertPool的线程数，每个文件读一块写一块
+	QList<ConvertJob> m_convertJobs;
+	int m_nextConvertJob;
+	int m_runningConvertJobs;
+	CODE_ID m_convertDstCode;
+	bool m_isVerifyConvert;
+	QThreadPool m_convertPool;
+
+	QElapsedTimer m_convertTimer;
+	qint64 m_convertedBytes;
+	int m_failConvertNums;
 };
@@ -0,0 +1,639 @@
+﻿#include "fasthash.h"
+
+#include <QVector>
+#include <QtConcurrent>
+#include <string.h>
+
+//按小端序读写，与平台无关
+static inline quint32 readLE32(const uchar* p)
+{
+	return (quint32)p[0] | ((quint32)p[1] << 8) | ((quint32)p[2] << 16) | ((quint32)p[3] << 24);
+}
+
+static inline quint64 readLE64(const uchar* p)
+{
+	return (quint64)readLE32(p) | ((quint64)readLE32(p + 4) << 32);
+}
+
+static inline void writeLE32(uchar* p, quint32 v)
+{
+	p[0] = (uchar)v;
+	p[1] = (uchar)(v >> 8);
+	p[2] = (uchar)(v >> 16);
+	p[3] = (uchar)(v >> 24);
+}
+
+/***************************** XXH3 *****************************/
+
+static const quint32 XXH_PRIME32_1 = 0x9E3779B1U;
+static const quint32 XXH_PRIME32_2 = 0x85EBCA77U;
+static const quint32 XXH_PRIME32_3 = 0xC2B2AE3DU;
+static const quint64 XXH_PRIME64_1 = 0x9E3779B185EBCA87ULL;
+static const quint64 XXH_PRIME64_2 = 0xC2B2AE3D27D4EB4FULL;
+static const quint64 XXH_PRIME64_3 = 0x165667B19E3779F9ULL;
+static const quint64 XXH_PRIME64_4 = 0x85EBCA77C2B2AE63ULL;
+static const quint64 XXH_PRIME64_5 = 0x27D4EB2F165667C5ULL;
+static const quint64 XXH_PRIME_MX1 = 0x165667919E3779F9ULL;
+static const quint64 XXH_PRIME_MX2 = 0x9FB21C651E98DF25ULL;
+
+static const int XXH_SECRET_SIZE = 192;
+static const int XXH_SECRET_CONSUME_RATE = 8;
+static const int XXH_STRIPES_PER_BLOCK = (XXH_SECRET_SIZE - Xxh3Hash::STRIPE_LEN) / XXH_SECRET_CONSUME_RATE;
+
+static const uchar XXH3_kSecret[XXH_SECRET_SIZE] = {
+	0xb8, 0xfe, 0x6c, 0x39, 0x23, 0xa4, 0x4b, 0xbe, 0x7c, 0x01, 0x81, 0x2c, 0xf7, 0x21, 0xad, 0x1c,
+	0xde, 0xd4, 0x6d, 0xe9, 0x83, 0x90, 0x97, 0xdb, 0x72, 0x40, 0xa4, 0xa4, 0xb7, 0xb3, 0x67, 0x1f,
+	0xcb, 0x79, 0xe6, 0x4e, 0xcc, 0xc0, 0xe5, 0x78, 0x82, 0x5a, 0xd0, 0x7d, 0xcc, 0xff, 0x72, 0x21,
+	0xb8, 0x08, 0x46, 0x74, 0xf7, 0x43, 0x24, 0x8e, 0xe0, 0x35, 0x90, 0xe6, 0x81, 0x3a, 0x26, 0x4c,
+	0x3c, 0x28, 0x52, 0xbb, 0x91, 0xc3, 0x00, 0xcb, 0x88, 0xd0, 0x65, 0x8b, 0x1b, 0x53, 0x2e, 0xa3,
+	0x71, 0x64, 0x48, 0x97, 0xa2, 0x0d, 0xf9, 0x4e, 0x38, 0x19, 0xef, 0x46, 0xa9, 0xde, 0xac, 0xd8,
+	0xa8, 0xfa, 0x76, 0x3f, 0xe3, 0x9c, 0x34, 0x3f, 0xf9, 0xdc, 0xbb, 0xc7, 0xc7, 0x0b, 0x4f, 0x1d,
+	0x8a, 0x51, 0xe0, 0x4b, 0xcd, 0xb4, 0x59, 0x31, 0xc8, 0x9f, 0x7e, 0xc9, 0xd9, 0x78, 0x73, 0x64,
+	0xea, 0xc5, 0xac, 0x83, 0x34, 0xd3, 0xeb, 0xc3, 0xc5, 0x81, 0xa0, 0xff, 0xfa, 0x13, 0x63, 0xeb,
+	0x17, 0x0d, 0xdd, 0x51, 0xb7, 0xf0, 0xda, 0x49, 0xd3, 0x16, 0x55, 0x26, 0x29, 0xd4, 0x68, 0x9e,
+	0x2b, 0x16, 0xbe, 0x58, 0x7d, 0x47, 0xa1, 0xfc, 0x8f, 0xf8, 0xb8, 0xd1, 0x7a, 0xd0, 0x31, 0xce,
+	0x45, 0xcb, 0x3a, 0x8f, 0x95, 0x16, 0x04, 0x28, 0xaf, 0xd7, 0xfb, 0xca, 0xbb, 0x4b, 0x40, 0x7e,
+};
+
+static inline quint64 rotl64(quint64 x, int r)
+{
+	return (x << r) | (x >> (64 - r));
+}
+
+static inline quint32 swap32(quint32 x)
+{
+	return ((x << 24) & 0xff000000U) | ((x << 8) & 0x00ff0000U) | ((x >> 8) & 0x0000ff00U) | ((x >> 24) & 0x000000ffU);
+}
+
+static inline quint64 swap64(quint64 x)
+{
+	return ((quint64)swap32((quint32)x) << 32) | swap32((quint32)(x >> 32));
+}
+
+//64x64->128位乘法，高低两半异或
+static inline quint64 mul128Fold64(quint64 lhs, quint64 rhs)
+{
+#if defined(__SIZEOF_INT128__)
+	unsigned __int128 product = (unsigned __int128)lhs * rhs;
+	return (quint64)product ^ (quint64)(product >> 64);
+#else
+	quint64 loLo = (lhs & 0xFFFFFFFF) * (rhs & 0xFFFFFFFF);
+	quint64 hiLo = (lhs >> 32) * (rhs & 0xFFFFFFFF);
+	quint64 loHi = (lhs & 0xFFFFFFFF) * (rhs >> 32);
+	quint64 hiHi = (lhs >> 32) * (rhs >> 32);
+
+	quint64 cross = (loLo >> 32) + (hiLo & 0xFFFFFFFF) + loHi;
+	quint64 upper = (hiLo >> 32) + (cross >> 32) + hiHi;
+	quint64 lower = (cross << 32) | (loLo & 0xFFFFFFFF);
+	return lower ^ upper;
+#endif
+}
+
+static inline quint64 xxh64Avalanche(quint64 h)
+{
+	h ^= h >> 33;
+	h *= XXH_PRIME64_2;
+	h ^= h >> 29;
+	h *= XXH_PRIME64_3;
+	h ^= h >> 32;
+	return h;
+}
+
+static inline quint64 xxh3Avalanche(quint64 h)
+{
+	h ^= h >> 37;
+	h *= XXH_PRIME_MX1;
+	h ^= h >> 32;
+	return h;
+}
+
+static inline quint64 xxh3Rrmxmx(quint64 h, quint64 len)
+{
+	h ^= rotl64(h, 49) ^ rotl64(h, 24);
+	h *= XXH_PRIME_MX2;
+	h ^= (h >> 35) + len;
+	h *= XXH_PRIME_MX2;
+	return h ^ (h >> 28);
+}
+
+static inline quint64 xxh3Mix16B(const uchar* input, const uchar* secret)
+{
+	return mul128Fold64(readLE64(input) ^ readLE64(secret), readLE64(input + 8) ^ readLE64(secret + 8));
+}
+
+//不超过240字节的输入一次算完，不经过累加器
+static quint64 xxh3ShortHash(const uchar* input, quint64 len)
+{
+	const uchar* secret = XXH3_kSecret;
+
+	if (len == 0)
+	{
+		return xxh64Avalanche(readLE64(secret + 56) ^ readLE64(secret + 64));
+	}
+	if (len <= 3)
+	{
+		quint32 combined = ((quint32)input[0] << 16) | ((quint32)input[len >> 1] << 24) | (quint32)input[len - 1] | ((quint32)len << 8);
+		quint64 bitflip = readLE32(secret) ^ readLE32(secret + 4);
+		return xxh64Avalanche((quint64)combined ^ bitflip);
+	}
+	if (len <= 8)
+	{
+		quint64 bitflip = readLE64(secret + 8) ^ readLE64(secret + 16);
+		quint64 input64 = readLE32(input + len - 4) + ((quint64)readLE32(input) << 32);
+		return xxh3Rrmxmx(input64 ^ bitflip, len);
+	}
+	if (len <= 16)
+	{
+		quint64 inputLo = readLE64(input) ^ (readLE64(secret + 24) ^ readLE64(secret + 32));
+		quint64 inputHi = readLE64(input + len - 8) ^ (readLE64(secret + 40) ^ readLE64(secret + 48));
+		quint64 acc = len + swap64(inputLo) + inputHi + mul128Fold64(inputLo, inputHi);
+		return xxh3Avalanche(acc);
+	}
+	if (len <= 128)
+	{
+		quint64 acc = len * XXH_PRIME64_1;
+		if (len > 32)
+		{
+			if (len > 64)
+			{
+				if (len > 96)
+				{
+					acc += xxh3Mix16B(input + 48, secret + 96);
+					acc += xxh3Mix16B(input + len - 64, secret + 112);
+				}
+				acc += xxh3Mix16B(input + 32, secret + 64);
+				acc += xxh3Mix16B(input + len - 48, secret + 80);
+			}
+			acc += xxh3Mix16B(input + 16, secret + 32);
+			acc += xxh3Mix16B(input + len - 32, secret + 48);
+		}
+		acc += xxh3Mix16B(input, secret);
+		acc += xxh3Mix16B(input + len - 16, secret + 16);
+		return xxh3Avalanche(acc);
+	}
+
+	//129到240字节
+	quint64 acc = len * XXH_PRIME64_1;
+	int rounds = (int)len / 16;
+	for (int i = 0; i < 8; ++i)
+	{
+		acc += xxh3Mix16B(input + 16 * i, secret + 16 * i);
+	}
+	acc = xxh3Avalanche(acc);
+
+	quint64 accEnd = xxh3Mix16B(input + len - 16, secret + 136 - 17);
+	for (int i = 8; i < rounds; ++i)
+	{
+		accEnd += xxh3Mix16B(input + 16 * i, secret + 16 * (i - 8) + 3);
+	}
+	return xxh3Avalanche(acc + accEnd);
+}
+
+static inline void xxh3Accumulate512(quint64 acc[8], const uchar* input, const uchar* secret)
+{
+	for (int i = 0; i < 8; ++i)
+	{
+		quint64 dataVal = readLE64(input + 8 * i);
+		quint64 dataKey = dataVal ^ readLE64(secret + 8 * i);
+		acc[i ^ 1] += dataVal;
+		acc[i] += (dataKey & 0xFFFFFFFF) * (dataKey >> 32);
+	}
+}
+
+static inline void xxh3ScrambleAcc(quint64 acc[8], const uchar* secret)
+{
+	for (int i = 0; i < 8; ++i)
+	{
+		quint64 a = acc[i];
+		a ^= a >> 47;
+		a ^= readLE64(secret + 8 * i);
+		a *= XXH_PRIME32_1;
+		acc[i] = a;
+	}
+}
+
+Xxh3Hash::Xxh3Hash()
+{
+	reset();
+}
+
+void Xxh3Hash::reset()
+{
+	m_acc[0] = XXH_PRIME32_3;
+	m_acc[1] = XXH_PRIME64_1;
+	m_acc[2] = XXH_PRIME64_2;
+	m_acc[3] = XXH_PRIME64_3;
+	m_acc[4] = XXH_PRIME64_4;
+	m_acc[5] = XXH_PRIME32_2;
+	m_acc[6] = XXH_PRIME64_5;
+	m_acc[7] = XXH_PRIME32_1;
+
+	m_totalLen = 0;
+	m_bufferLen = 0;
+	memset(m_buffer, 0, sizeof(m_buffer));
+}
+
+void Xxh3Hash::consumeStripes(const uchar* data, int stripes)
+{
+	for (int n = 0; n < stripes; ++n)
+	{
+		xxh3Accumulate512(m_acc, data + n * STRIPE_LEN, XXH3_kSecret + n * XXH_SECRET_CONSUME_RATE);
+	}
+}
+
+void Xxh3Hash::consumeBlock(const uchar* block)
+{
+	consumeStripes(block, XXH_STRIPES_PER_BLOCK);
+	xxh3ScrambleAcc(m_acc, XXH3_kSecret + XXH_SECRET_SIZE - STRIPE_LEN);
+}
+
+void Xxh3Hash::addData(const char* data, qint64 length)
+{
+	const uchar* p = (const uchar*)data;
+	m_totalLen += length;
+
+	uchar* pending = m_buffer + STRIPE_LEN;
+
+	//先把缓存补满；缓存满了并且后面还有数据，才把缓存作为一个完整的块处理
+	if (m_bufferLen > 0 || length <= BLOCK_LEN)
+	{
+		int take = (int)qMin<qint64>(length, BLOCK_LEN - m_bufferLen);
+		memcpy(pending + m_bufferLen, p, take);
+		m_bufferLen += take;
+		p += take;
+		length -= take;
+
+		if (length == 0)
+		{
+			return;
+		}
+
+		consumeBlock(pending);
+		memcpy(m_buffer, pending + BLOCK_LEN - STRIPE_LEN, STRIPE_LEN);
+		m_bufferLen = 0;
+	}
+
+	//大块数据直接在输入上处理，不经过缓存
+	if (length > BLOCK_LEN)
+	{
+		qint64 blocks = (length - 1) / BLOCK_LEN;
+		for (qint64 i = 0; i < blocks; ++i)
+		{
+			consumeBlock(p);
+			p += BLOCK_LEN;
+		}
+		length -= blocks * BLOCK_LEN;
+		memcpy(m_buffer, p - STRIPE_LEN, STRIPE_LEN);
+	}
+
+	memcpy(pending, p, length);
+	m_bufferLen = (int)length;
+}
+
+QByteArray Xxh3Hash::result() const
+{
+	quint64 h = 0;
+
+	if (m_totalLen <= 240)
+	{
+		h = xxh3ShortHash(m_buffer + STRIPE_LEN, m_totalLen);
+	}
+	else
+	{
+		quint64 acc[8];
+		memcpy(acc, m_acc, sizeof(acc));
+
+		const uchar* pending = m_buffer + STRIPE_LEN;
+		int stripes = (m_bufferLen - 1) / STRIPE_LEN;
+		for (int n = 0; n < stripes; ++n)
+		{
+			xxh3Accumulate512(acc, pending + n * STRIPE_LEN, XXH3_kSecret + n * XXH_SECRET_CONSUME_RATE);
+		}
+
+		//最后一条stripe以输入末尾为结束，缓存不够64字节时，前半部分是上一个块的末尾
+		xxh3Accumulate512(acc, pending + m_bufferLen - STRIPE_LEN, XXH3_kSecret + XXH_SECRET_SIZE - STRIPE_LEN - 7);
+
+		h = m_totalLen * XXH_PRIME64_1;
+		for (int i = 0; i < 4; ++i)
+		{
+			const uchar* secret = XXH3_kSecret + 11 + 16 * i;
+			h += mul128Fold64(acc[2 * i] ^ readLE64(secret), acc[2 * i + 1] ^ readLE64(secret + 8));
+		}
+		h = xxh3Avalanche(h);
+	}
+
+	QByteArray out(8, 0);
+	for (int i = 0; i < 8; ++i)
+	{
+		out[i] = (char)(h >> (56 - 8 * i));
+	}
+	return out;
+}
+
+/***************************** BLAKE3 *****************************/
+
+static const quint32 BLAKE3_IV[8] = {
+	0x6A09E667, 0xBB67AE85, 0x3C6EF372, 0xA54FF53A, 0x510E527F, 0x9B05688C, 0x1F83D9AB, 0x5BE0CD19,
+};
+
+static const int BLAKE3_MSG_SCHEDULE[7][16] = {
+	{ 0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15 },
+	{ 2, 6, 3, 10, 7, 0, 4, 13, 1, 11, 12, 5, 9, 14, 15, 8 },
+	{ 3, 4, 10, 12, 13, 2, 7, 14, 6, 5, 9, 0, 11, 15, 8, 1 },
+	{ 10, 7, 12, 9, 14, 3, 13, 15, 4, 0, 11, 2, 5, 8, 1, 6 },
+	{ 12, 13, 9, 11, 15, 10, 14, 8, 7, 2, 5, 3, 0, 1, 6, 4 },
+	{ 9, 14, 11, 5, 8, 12, 15, 1, 13, 3, 0, 10, 2, 6, 4, 7 },
+	{ 11, 15, 5, 0, 1, 9, 8, 6, 14, 10, 2, 12, 3, 4, 7, 13 },
+};
+
+enum BLAKE3_FLAGS {
+	CHUNK_START = 1 << 0,
+	CHUNK_END = 1 << 1,
+	PARENT = 1 << 2,
+	ROOT = 1 << 3,
+};
+
+static inline quint32 rotr32(quint32 x, int r)
+{
+	return (x >> r) | (x << (32 - r));
+}
+
+static inline void blake3G(quint32 s[16], int a, int b, int c, int d, quint32 x, quint32 y)
+{
+	s[a] = s[a] + s[b] + x;
+	s[d] = rotr32(s[d] ^ s[a], 16);
+	s[c] = s[c] + s[d];
+	s[b] = rotr32(s[b] ^ s[c], 12);
+	s[a] = s[a] + s[b] + y;
+	s[d] = rotr32(s[d] ^ s[a], 8);
+	s[c] = s[c] + s[d];
+	s[b] = rotr32(s[b] ^ s[c], 7);
+}
+
+//压缩一个64字节的块，out取前8个字为新的链值，取全部16个字为根节点的输出
+static void blake3Compress(const quint32 cv[8], const uchar block[64], quint64 counter, quint32 blockLen, quint32 flags, quint32 out[16])
+{
+	quint32 m[16];
+	for (int i = 0; i < 16; ++i)
+	{
+		m[i] = readLE32(block + 4 * i);
+	}
+
+	quint32 s[16] = {
+		cv[0], cv[1], cv[2], cv[3], cv[4], cv[5], cv[6], cv[7],
+		BLAKE3_IV[0], BLAKE3_IV[1], BLAKE3_IV[2], BLAKE3_IV[3],
+		(quint32)counter, (quint32)(counter >> 32), blockLen, flags,
+	};
+
+	for (int r = 0; r < 7; ++r)
+	{
+		const int* sc = BLAKE3_MSG_SCHEDULE[r];
+		blake3G(s, 0, 4, 8, 12, m[sc[0]], m[sc[1]]);
+		blake3G(s, 1, 5, 9, 13, m[sc[2]], m[sc[3]]);
+		blake3G(s, 2, 6, 10, 14, m[sc[4]], m[sc[5]]);
+		blake3G(s, 3, 7, 11, 15, m[sc[6]], m[sc[7]]);
+		blake3G(s, 0, 5, 10, 15, m[sc[8]], m[sc[9]]);
+		blake3G(s, 1, 6, 11, 12, m[sc[10]], m[sc[11]]);
+		blake3G(s, 2, 7, 8, 13, m[sc[12]], m[sc[13]]);
+		blake3G(s, 3, 4, 9, 14, m[sc[14]], m[sc[15]]);
+	}
+
+	for (int i = 0; i < 8; ++i)
+	{
+		out[i] = s[i] ^ s[i + 8];
+		out[i + 8] = s[i + 8] ^ cv[i];
+	}
+}
+
+static void blake3ParentCv(const quint32 left[8], const quint32 right[8], quint32 cv[8])
+{
+	uchar block[64];
+	for (int i = 0; i < 8; ++i)
+	{
+		writeLE32(block + 4 * i, left[i]);
+		writeLE32(block + 32 + 4 * i, right[i]);
+	}
+
+	quint32 out[16];
+	blake3Compress(BLAKE3_IV, block, 0, 64, PARENT, out);
+	memcpy(cv, out, 8 * sizeof(quint32));
+}
+
+//完整的1KB分块，且不是整棵树唯一的分块
+static void blake3ChunkCv(const uchar* data, quint64 chunkCounter, quint32 cv[8])
+{
+	quint32 out[16];
+	memcpy(cv, BLAKE3_IV, 8 * sizeof(quint32));
+
+	const int blocks = Blake3Hash::CHUNK_LEN / Blake3Hash::BLOCK_LEN;
+	for (int i = 0; i < blocks; ++i)
+	{
+		quint32 flags = (i == 0 ? CHUNK_START : 0) | (i == blocks - 1 ? CHUNK_END : 0);
+		blake3Compress(cv, data + i * Blake3Hash::BLOCK_LEN, chunkCounter, Blake3Hash::BLOCK_LEN, flags, out);
+		memcpy(cv, out, 8 * sizeof(quint32));
+	}
+}
+
+//GROUP_CHUNKS个分块组成的完整子树，chunkCounter是它第一个分块的序号
+static void blake3GroupCv(const uchar* data, quint64 chunkCounter, quint32 cv[8])
+{
+	quint32 cvs[Blake3Hash::GROUP_CHUNKS][8];
+	for (int i = 0; i < Blake3Hash::GROUP_CHUNKS; ++i)
+	{
+		blake3ChunkCv(data + (qint64)i * Blake3Hash::CHUNK_LEN, chunkCounter + i, cvs[i]);
+	}
+
+	for (int n = Blake3Hash::GROUP_CHUNKS; n > 1; n /= 2)
+	{
+		for (int i = 0; i < n / 2; ++i)
+		{
+			blake3ParentCv(cvs[2 * i], cvs[2 * i + 1], cvs[i]);
+		}
+	}
+	memcpy(cv, cvs[0], 8 * sizeof(quint32));
+}
+
+//一段连续的子树，cvs按子树序号存放结果
+struct Blake3GroupTask {
+	const uchar* data;
+	quint64 chunkCounter;
+	qint64 begin;
+	qint64 end;
+	quint32* cvs;
+};
+
+static void runGroupTask(Blake3GroupTask& task)
+{
+	for (qint64 i = task.begin; i < task.end; ++i)
+	{
+		blake3GroupCv(task.data + i * Blake3Hash::GROUP_LEN, task.chunkCounter + i * Blake3Hash::GROUP_CHUNKS, task.cvs + i * 8);
+	}
+}
+
+Blake3Hash::Blake3Hash()
+{
+	reset();
+}
+
+void Blake3Hash::reset()
+{
+	m_cvStackLen = 0;
+	memcpy(m_chunkCv, BLAKE3_IV, sizeof(m_chunkCv));
+	m_chunkCounter = 0;
+	memset(m_block, 0, sizeof(m_block));
+	m_blockLen = 0;
+	m_blocksCompressed = 0;
+}
+
+void Blake3Hash::updateChunk(const uchar* data, int length)
+{
+	while (length > 0)
+	{
+		//块满了并且后面还有数据，才压缩；分块的最后一块要带CHUNK_END，留到结束时处理
+		if (m_blockLen == BLOCK_LEN)
+		{
+			quint32 out[16];
+			blake3Compress(m_chunkCv, m_block, m_chunkCounter, BLOCK_LEN, (m_blocksCompressed == 0 ? CHUNK_START : 0), out);
+			memcpy(m_chunkCv, out, sizeof(m_chunkCv));
+			++m_blocksCompressed;
+			m_blockLen = 0;
+		}
+
+		int take = qMin(length, BLOCK_LEN - m_blockLen);
+		memcpy(m_block + m_blockLen, data, take);
+		m_blockLen += take;
+		data += take;
+		length -= take;
+	}
+}
+
+//当前分块已满，压缩最后一块后把链值压栈，开始下一个分块
+void Blake3Hash::finishChunk()
+{
+	quint32 out[16];
+	memset(m_block + m_blockLen, 0, BLOCK_LEN - m_blockLen);
+	blake3Compress(m_chunkCv, m_block, m_chunkCounter, m_blockLen, (m_blocksCompressed == 0 ? CHUNK_START : 0) | CHUNK_END, out);
+
+	pushCv(out, m_chunkCounter + 1);
+
+	++m_chunkCounter;
+	memcpy(m_chunkCv, BLAKE3_IV, sizeof(m_chunkCv));
+	m_blockLen = 0;
+	m_blocksCompressed = 0;
+}
+
+//totalChunks是加入cv之后的总数，以cv代表的子树大小为单位。末位为0说明左边有同样大小的兄弟，合并后继续向上
+void Blake3Hash::pushCv(const quint32 cv[8], quint64 totalChunks)
+{
+	quint32 merged[8];
+	memcpy(merged, cv, sizeof(merged));
+
+	while ((totalChunks & 1) == 0)
+	{
+		--m_cvStackLen;
+		blake3ParentCv(m_cvStack[m_cvStackLen], merged, merged);
+		totalChunks >>= 1;
+	}
+
+	memcpy(m_cvStack[m_cvStackLen], merged, sizeof(merged));
+	++m_cvStackLen;
+}
+
+void Blake3Hash::addData(const char* data, qint64 length, int threads)
+{
+	const uchar* p = (const uchar*)data;
+
+	while (length > 0)
+	{
+		if (chunkLen() == CHUNK_LEN)
+		{
+			finishChunk();
+		}
+
+		//分块边界对齐到子树大小，后面还有超过一个子树的数据时，整个子树一起算。
+		//至少留下1字节走正常流程，保证最后一个分块不会被当成子树内部节点
+		if (chunkLen() == 0 && (m_chunkCounter % GROUP_CHUNKS) == 0 && length > GROUP_LEN)
+		{
+			qint64 groups = (length - 1) / GROUP_LEN;
+			QVector<quint32> cvs(groups * 8);
+
+			//按线程数切成连续的几段，每段一个任务
+			int parts = (threads > 1) ? (int)qMin<qint64>(threads, groups) : 1;
+			QVector<Blake3GroupTask> tasks;
+			for (int i = 0; i < parts; ++i)
+			{
+				Blake3GroupTask task;
+				task.begin = groups * i / parts;
+				task.end = groups * (i + 1) / parts;
+				task.data = p;
+				task.chunkCounter = m_chunkCounter;
+				task.cvs = cvs.data();
+				tasks.append(task);
+			}
+
+			if (parts > 1)
+			{
+				QtConcurrent::blockingMap(tasks, runGroupTask);
+			}
+			else
+			{
+				runGroupTask(tasks[0]);
+			}
+
+			for (qint64 i = 0; i < groups; ++i)
+			{
+				m_chunkCounter += GROUP_CHUNKS;
+				pushCv(cvs.constData() + i * 8, m_chunkCounter / GROUP_CHUNKS);
+			}
+
+			p += groups * GROUP_LEN;
+			length -= groups * GROUP_LEN;
+			continue;
+		}
+
+		int take = (int)qMin<qint64>(length, CHUNK_LEN - chunkLen());
+		updateChunk(p, take);
+		p += take;
+		length -= take;
+	}
+}
+
+QByteArray Blake3Hash::result() const
+{
+	//当前分块的输出节点，然后自右向左与栈中的链值合并到根
+	quint32 inputCv[8];
+	uchar block[BLOCK_LEN];
+	quint32 blockLen = m_blockLen;
+	quint64 counter = m_chunkCounter;
+	quint32 flags = (m_blocksCompressed == 0 ? CHUNK_START : 0) | CHUNK_END;
+
+	memcpy(inputCv, m_chunkCv, sizeof(inputCv));
+	memcpy(block, m_block, m_blockLen);
+	memset(block + m_blockLen, 0, BLOCK_LEN - m_blockLen);
+
+	for (int i = m_cvStackLen - 1; i >= 0; --i)
+	{
+		quint32 out[16];
+		blake3Compress(inputCv, block, counter, blockLen, flags, out);
+
+		for (int j = 0; j < 8; ++j)
+		{
+			writeLE32(block + 4 * j, m_cvStack[i][j]);
+			writeLE32(block + 32 + 4 * j, out[j]);
+		}
+		memcpy(inputCv, BLAKE3_IV, sizeof(inputCv));
+		blockLen = BLOCK_LEN;
+		counter = 0;
+		flags = PARENT;
+	}
+
+	quint32 out[16];
+	blake3Compress(inputCv, block, 0, blockLen, flags | ROOT, out);
+
+	QByteArray digest(32, 0);
+	for (int i = 0; i < 8; ++i)
+	{
+		writeLE32((uchar*)digest.data() + 4 * i, out[i]);
+	}
+	return digest;
+}
@@ -0,0 +1,66 @@
+﻿#pragma once
+
+#include <QByteArray>
+
+//XXH3的64位版本，种子为0，使用默认密钥。结果为8字节大端序，与xxhsum的输出一致。
+//非加密哈希，只适合用来快速比较文件是否相同
+class Xxh3Hash
+{
+public:
+	Xxh3Hash();
+
+	void reset();
+	void addData(const char* data, qint64 length);
+	QByteArray result() const;
+
+	static const int STRIPE_LEN = 64;
+	static const int BLOCK_LEN = 1024;
+
+private:
+	void consumeBlock(const uchar* block);
+	void consumeStripes(const uchar* data, int stripes);
+
+	quint64 m_acc[8];
+	quint64 m_totalLen;
+
+	//m_buffer前STRIPE_LEN字节是上一个块的末尾，最后一条stripe不够长时从这里补。
+	//块只在确定后面还有数据时才处理，所以结束时m_bufferLen至少为1
+	uchar m_buffer[STRIPE_LEN + BLOCK_LEN];
+	int m_bufferLen;
+};
+
+//BLAKE3，输出32字节。数据按1KB分块组成二叉树，对齐的子树互不依赖，
+//大块数据可以按子树分给多个线程计算，结果与单线程完全相同
+class Blake3Hash
+{
+public:
+	Blake3Hash();
+
+	void reset();
+
+	//threads大于1时，整块的子树放到全局线程池并行计算
+	void addData(const char* data, qint64 length, int threads = 1);
+	QByteArray result() const;
+
+	static const int BLOCK_LEN = 64;
+	static const int CHUNK_LEN = 1024;
+	//并行计算的最小单位：64个分块组成的子树
+	static const int GROUP_CHUNKS = 64;
+	static const qint64 GROUP_LEN = (qint64)GROUP_CHUNKS * CHUNK_LEN;
+
+private:
+	int chunkLen() const { return m_blocksCompressed * BLOCK_LEN + m_blockLen; }
+	void updateChunk(const uchar* data, int length);
+	void finishChunk();
+	void pushCv(const quint32 cv[8], quint64 totalChunks);
+
+	quint32 m_cvStack[54][8];
+	int m_cvStackLen;
+
+	//当前分块的状态
+	quint32 m_chunkCv[8];
+	quint64 m_chunkCounter;
+	uchar m_block[BLOCK_LEN];
+	int m_blockLen;
+	int m_blocksCompressed;
+};
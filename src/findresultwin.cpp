@@ -21,7 +21,7 @@
 //使用Html的转义解决了该问题
 
 FindResultWin::FindResultWin(QWidget *parent)
-	: QWidget(parent), m_menu(nullptr), m_parent(parent),m_defaultFontSize(14), m_defFontSizeChange(false)
+	: QWidget(parent), m_menu(nullptr), m_parent(parent), m_streamFilePath(nullptr), m_streamInsertLine(-1), m_defaultFontSize(14), m_defFontSizeChange(false)
 {
 	ui.setupUi(this);
 	connect(ui.displayView, &FindResultView::lineDoubleClick, this, &FindResultWin::on_lineDoubleClick);
@@ -46,6 +46,9 @@ void FindResultWin::clear()
 	}
 	m_resultLineFilePath.clear();
 	m_resultLineInfo.clear();
+
+	m_streamFilePath = nullptr;
+	m_streamInsertLine = -1;
 }
 
 void FindResultWin::slot_clearAllContents()
@@ -338,7 +341,13 @@ void FindResultWin::appendResultsToShow(QVector<FindRecords*>* record, int hits,
 		this->setVisible(true);
 	}
 
+	//新的结果插在最前面，正在追加的大文本查找结果的行号全部变化了，不再追加
+	m_streamFilePath = nullptr;
+	m_streamInsertLine = -1;
+
 	ResultLineInfo lineInfo;
+	lineInfo.lineNum = 0;
+	lineInfo.lineAddr = -1;
 
 	QString findTitle = tr("Search \"%1\" (%2 hits in %3 files)\n").arg(whatFind).arg(hits).arg(record->size());
 
@@ -475,6 +484,140 @@ void FindResultWin::appendResultsToShow(QVector<FindRecords*>* record, int hits,
 	pDisplay->SendScintilla(SCI_GOTOLINE, 0);
 }
 
+//大文本全文件查找开始：先插入标题和文件行，后面的结果分批追加到文件行的下面
+void FindResultWin::beginStreamResults(QString filePath, QString whatFind)
+{
+	if (this->isHidden())
+	{
+		this->setVisible(true);
+	}
+
+	FindResultView* pDisplay = ui.displayView;
+	pDisplay->on_foldAll();
+
+	m_streamFilePath = new QString(filePath);
+	m_resultLineFilePath.append(m_streamFilePath);
+	m_streamWhatFind = whatFind;
+
+	QString findTitle = tr("Search \"%1\" in big text file (searching ...)\n").arg(whatFind);
+	QString desc = tr(" %1 (searching ...)\n").arg(filePath);
+
+	pDisplay->insertAt(findTitle + desc, 0, 0);
+
+	ResultLineInfo lineInfo;
+	lineInfo.lineNum = 0;
+	lineInfo.lineAddr = -1;
+
+	lineInfo.level = 0;
+	m_resultLineInfo.insert(0, lineInfo);
+
+	lineInfo.level = 1;
+	m_resultLineInfo.insert(1, lineInfo);
+
+	pDisplay->SendScintilla(SCI_SETFOLDLEVEL, 0, (long)(0 | SC_FOLDLEVELHEADERFLAG));
+	pDisplay->SendScintilla(SCI_SETFOLDLEVEL, 1, (long)(1 | SC_FOLDLEVELHEADERFLAG));
+
+	pDisplay->setLineBackColorStyle(0, STYLE_COLOUR_TITLE);
+	pDisplay->setLineBackColorStyle(1, (StyleSet::isCurrentDeepStyle() ? STYLE_DEEP_COLOUR_DEST_FILE : STYLE_COLOUR_DEST_FILE));
+
+	pDisplay->SendScintilla(SCI_GOTOLINE, 0);
+
+	m_streamInsertLine = 2;
+}
+
+//追加一批大文本查找的结果。records中的pos/end是在文件该行中的列，lineStartPos是显示内容开始的列
+void FindResultWin::appendStreamResults(QString filePath, const QVector<FindRecord>& records)
+{
+	if (m_streamFilePath == nullptr || *m_streamFilePath != filePath || records.isEmpty())
+	{
+		return;
+	}
+
+	FindResultView* pDisplay = ui.displayView;
+
+	QStringList contents;
+	QList<int> keyworkOffsetPos;
+	QString linePrefix;
+
+	ResultLineInfo lineInfo;
+	lineInfo.level = 2;
+	lineInfo.pFilePath = m_streamFilePath;
+
+	for (int i = 0; i < records.size(); ++i)
+	{
+		const FindRecord& v = records.at(i);
+
+		linePrefix = tr("    Line %1: ").arg(v.lineNum + 1);
+		contents.append(tr("%1%2\n").arg(linePrefix).arg(v.lineContents));
+		keyworkOffsetPos.append(linePrefix.toUtf8().size());
+
+		lineInfo.resultPos = v.pos;
+		lineInfo.resultEnd = v.end;
+		lineInfo.lineNum = v.lineNum;
+		lineInfo.lineAddr = v.lineAddr;
+		m_resultLineInfo.insert(m_streamInsertLine + i, lineInfo);
+	}
+
+	pDisplay->insertAt(contents.join(""), m_streamInsertLine, 0);
+
+	QString lineNumStr = tr("    Line ");
+	int skipLineNumOffset = lineNumStr.toUtf8().size();
+
+	for (int i = 0; i < records.size(); ++i)
+	{
+		const FindRecord& v = records.at(i);
+		int lineNum = m_streamInsertLine + i;
+		int lineOffsetPos = keyworkOffsetPos.at(i);
+
+		pDisplay->SendScintilla(SCI_SETFOLDLEVEL, lineNum, (long)2 | SC_FOLDLEVELBASE);
+		pDisplay->setLineColorStyle(lineNum, skipLineNumOffset, lineOffsetPos - skipLineNumOffset - 2, STYLE_COLOUR_KEYWORD_HIGH);
+		pDisplay->setLineColorStyle(lineNum, v.pos - v.lineStartPos + lineOffsetPos, v.end - v.pos, (StyleSet::isCurrentDeepStyle() ? STYLE_DEEP_COLOUR_KEYWORD_HIGH : STYLE_COLOUR_KEYWORD_BACK_HIGH));
+	}
+
+	m_streamInsertLine += records.size();
+}
+
+//大文本查找结束，更新标题和文件行上的命中数量
+void FindResultWin::endStreamResults(QString filePath, int hits, bool isFinished)
+{
+	if (m_streamFilePath == nullptr || *m_streamFilePath != filePath)
+	{
+		return;
+	}
+
+	FindResultView* pDisplay = ui.displayView;
+
+	auto replaceLineText = [pDisplay](int line, const QString& text) {
+		QByteArray bytes = text.toUtf8();
+		int startPos = pDisplay->SendScintilla(SCI_POSITIONFROMLINE, line);
+		int endPos = pDisplay->SendScintilla(SCI_GETLINEENDPOSITION, line);
+		pDisplay->SendScintilla(SCI_SETTARGETRANGE, startPos, endPos);
+		pDisplay->SendScintilla(SCI_REPLACETARGET, bytes.size(), bytes.constData());
+	};
+
+	QString findTitle = tr("Search \"%1\" (%2 hits in %3 files)").arg(m_streamWhatFind).arg(hits).arg(1);
+	QString desc;
+	if (isFinished)
+	{
+		desc = tr(" %1 (%2 hits)").arg(filePath).arg(hits);
+	}
+	else
+	{
+		desc = tr(" %1 (%2 hits, search aborted)").arg(filePath).arg(hits);
+	}
+
+	pDisplay->setReadOnly(false);
+	replaceLineText(0, findTitle);
+	replaceLineText(1, desc);
+	pDisplay->setReadOnly(true);
+
+	pDisplay->setLineBackColorStyle(0, STYLE_COLOUR_TITLE);
+	pDisplay->setLineBackColorStyle(1, (StyleSet::isCurrentDeepStyle() ? STYLE_DEEP_COLOUR_DEST_FILE : STYLE_COLOUR_DEST_FILE));
+
+	m_streamFilePath = nullptr;
+	m_streamInsertLine = -1;
+}
+
 
 int FindResultWin::getDefaultFontSize()
 {
@@ -494,8 +637,16 @@ void FindResultWin::on_lineDoubleClick(int lineNum)
 
 		if (lineInfo.level == 2)
 		{
-			//文件定位到行
-			emit lineDoubleClicked(lineInfo.pFilePath, lineInfo.resultPos, lineInfo.resultEnd);
+			//大文本全文件查找的结果，需要先加载对应的块
+			if (lineInfo.lineAddr >= 0)
+			{
+				emit bigTextLineDoubleClicked(lineInfo.pFilePath, lineInfo.lineNum, lineInfo.lineAddr, lineInfo.resultPos, lineInfo.resultEnd);
+			}
+			else
+			{
+				//文件定位到行
+				emit lineDoubleClicked(lineInfo.pFilePath, lineInfo.resultPos, lineInfo.resultEnd);
+			}
 		}
 		else if ((lineInfo.level == 0) || (lineInfo.level == 1))
 		{
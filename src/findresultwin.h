@@ -13,6 +13,8 @@ struct ResultLineInfo {
 	int resultPos;//ֶεĿʼoffset01ûֶεġ
 	int resultEnd;//
 	QString* pFilePath;
+	int lineNum;//ıȫļҵĽ¼ļекźƫơͨlineAddrΪ-1
+	qint64 lineAddr;
 };
 
 class FindResultWin : public QWidget
@@ -25,6 +27,9 @@ public:
 	~FindResultWin();
 
 	void appendResultsToShow(QVector<FindRecords*>* record, int hits, QString whatFind);
+	void beginStreamResults(QString filePath, QString whatFind);
+	void appendStreamResults(QString filePath, const QVector<FindRecord>& records);
+	void endStreamResults(QString filePath, int hits, bool isFinished);
 	int  getDefaultFontSize();
 	void setDefaultFontSize(int defSize);
 	void clear();
@@ -32,6 +37,7 @@ signals:
 	void itemDoubleClicked(const QModelIndex &index);
 	void showMsg(QString &msg);
 	void lineDoubleClicked(QString* pFilePath, int pos, int end);
+	void bigTextLineDoubleClicked(QString* pFilePath, int lineNum, qint64 lineAddr, int pos, int end);
 
 private slots:
 	void on_lineDoubleClick(int line);
@@ -54,6 +60,11 @@ private:
 	QList<ResultLineInfo> m_resultLineInfo;
 	QList<QString*> m_resultLineFilePath;
 
+	//ıȫļҵĽǷ׷ӵģ¼׷ӵļһβСû׷ʱΪnullptr
+	QString* m_streamFilePath;
+	QString m_streamWhatFind;
+	int m_streamInsertLine;
+
 	int m_defaultFontSize;
 	bool m_defFontSizeChange;
 };
@@ -25,6 +25,8 @@ enum TAB_TYPES {
 
 const int MAX_RECORD_KEY_LENGTH = 120;
 
+int getDocTypeProperty(QWidget* pwidget);
+
 FindWin::FindWin(QWidget *parent):QMainWindow(parent), m_editTabWidget(nullptr), m_isFindFirst(true), m_findHistory(nullptr), \
 	pEditTemp(nullptr), m_curEditWin(nullptr), m_isStatic(false), m_isReverseFind(false), m_pMainPad(parent)
 {
@@ -82,6 +84,27 @@ FindWin::~FindWin()
 	}
 }
 
+qint64 FindWin::searchEditMemory() const
+{
+	if (pEditTemp == nullptr)
+	{
+		return 0;
+	}
+	return pEditTemp->memoryUsage().total();
+}
+
+bool FindWin::releaseSearchEdit()
+{
+	//目录查找替换进行中时，进度窗口还在，此时不能释放
+	if (pEditTemp == nullptr || findChild<ProgressWin*>() != nullptr)
+	{
+		return false;
+	}
+	delete pEditTemp;
+	pEditTemp = nullptr;
+	return true;
+}
+
 void FindWin::slot_tabIndexChange(int index)
 {
 	TAB_TYPES type = (TAB_TYPES)index;
@@ -1710,10 +1733,59 @@ void FindWin::slot_findAllInCurDoc()
 
 	if (index >= 0)
 	{
+		//大文本的编辑框中只有当前块，需要在整个文件上查找
+		int docType = getDocTypeProperty(m_editTabWidget->widget(index));
+		if ((BIG_TEXT_RO_TYPE == docType) || (SUPER_BIG_TEXT_RO_TYPE == docType))
+		{
+			findAllInBigText(m_editTabWidget->widget(index));
+			return;
+		}
+
 		findAllInOpenDoc(index);
 	}
 }
 
+//大文本全文件查找，在后台进行，结果分批显示到查找结果窗口
+void FindWin::findAllInBigText(QWidget* pw)
+{
+	if (ui.findComboBox->currentText().isEmpty())
+	{
+		ui.statusbar->showMessage(tr("what find is null !"), 8000);
+		QApplication::beep();
+		return;
+	}
+
+	CCNotePad* pMainPad = dynamic_cast<CCNotePad*>(m_pMainPad);
+	if (pMainPad == nullptr)
+	{
+		return;
+	}
+
+	updateParameterFromUI();
+
+	QString whatFind = ui.findComboBox->currentText();
+	QString originWhatFine = whatFind;
+
+	if (m_extend)
+	{
+		QString extendFind;
+		convertExtendedToString(whatFind, extendFind);
+		whatFind = extendFind;
+	}
+
+	addFindHistory(originWhatFine);
+
+	QString errMsg;
+	if (!pMainPad->findAllInBigText(pw, whatFind, originWhatFine, m_re, m_cs, m_wo, errMsg))
+	{
+		ui.statusbar->showMessage(errMsg, 8000);
+		QApplication::beep();
+		return;
+	}
+
+	ui.statusbar->showMessage(tr("Searching the whole file in background, results will be shown in find result window."), 8000);
+}
+
 void FindWin::findAllInOpenDoc(int index)
 {
 	if (ui.findComboBox->currentText().isEmpty())
@@ -25,6 +25,11 @@ struct FindRecord {
 	int pos; //查找字段的开始位置
 	int end; //查找字段的结束位置
 	QString lineContents;
+	qint64 lineAddr; //大文本全文件查找时，行首在文件中的偏移。普通文档为-1
+
+	FindRecord() :lineNum(0), lineStartPos(0), pos(0), end(0), lineAddr(-1)
+	{
+	}
 };
 
 class FindRecords {
@@ -81,6 +86,11 @@ public:
 	int findAtBack(QStringList& keyword);
 	int markAtBack(QStringList& keyword);
 	int replaceAtBack(QStringList& keyword, QStringList& replace);
+
+	//目录查找替换用的后台编辑框占用的内存，没有创建时为0
+	qint64 searchEditMemory() const;
+	//释放目录查找替换用的后台编辑框，下次目录查找时重新创建
+	bool releaseSearchEdit();
 protected:
 	
 	virtual void focusInEvent(QFocusEvent *ev);
@@ -133,6 +143,8 @@ private:
 
 	void findAllInOpenDoc(int index = -1);
 
+	void findAllInBigText(QWidget* pw);
+
 private slots:
 
 	void slot_findNext();
@@ -1,6 +1,9 @@
 ﻿#include "ccnotepad.h"
 #include "nddsetting.h"
 #include "styleset.h"
+#include "styletablecache.h"
+#include "openrequestchannel.h"
+#include "nddtrace.h"
 
 
 #include <QtWidgets/QApplication>
@@ -120,6 +123,25 @@ class MyApplication : public QApplication
 
 int main(int argc, char *argv[])
 {
+	//-trace tracefile 记录启动和常用操作的耗时，退出时写入文件
+	NddTrace::init(argc, argv);
+	qint64 traceStartUs = NddTrace::isEnabled() ? NddTrace::nowUs() : -1;
+
+#if defined(Q_OS_UNIX) && !defined(Q_OS_MAC)
+	//已经有实例在运行时，不创建QApplication，直接把整个命令行转发给它
+	{
+		QStringList forwardArgs;
+		for (int i = 1; i < argc; ++i)
+		{
+			forwardArgs.append(QString::fromLocal8Bit(argv[i]));
+		}
+		if (OpenRequestChannel::forward(forwardArgs, QDir::currentPath()))
+		{
+			return 0;
+		}
+	}
+#endif
+
 #if (QT_VERSION >= QT_VERSION_CHECK(5, 14, 0))
 	QApplication::setHighDpiScaleFactorRoundingPolicy(Qt::HighDpiScaleFactorRoundingPolicy::PassThrough);
 #elif (QT_VERSION >= QT_VERSION_CHECK(5, 6, 0))
@@ -154,6 +176,16 @@ int main(int argc, char *argv[])
 
 	QStringList arguments = QCoreApplication::arguments();
 
+#ifdef Q_OS_WIN
+	//windows下arguments()取自系统的命令行，NddTrace::init从argv中去掉的 -trace 还在
+	int traceIndex = arguments.indexOf(QString("-trace"));
+	if ((traceIndex > 0) && (traceIndex + 1 < arguments.size()))
+	{
+		arguments.removeAt(traceIndex + 1);
+		arguments.removeAt(traceIndex);
+	}
+#endif
+
 	//目前就三种
 	//1) ndd filepath
 	//2) ndd filepath -n linenum
@@ -426,6 +458,19 @@ drop_old:
     nppShared.lock();
     memcpy(nppShared.data(), &pid, sizeof(pid_t));
     nppShared.unlock();
+#ifndef Q_OS_MAC
+    //后面再执行ndd时，通过本地socket把要打开的文件转发过来
+    OpenRequestChannel* openChannel = new OpenRequestChannel(pMainNotepad);
+    if (openChannel->listen())
+    {
+        QObject::connect(openChannel, &OpenRequestChannel::signOpenRequests, pMainNotepad, &CCNotePad::slot_openRequests);
+    }
+    else if (!openChannel->errorString().isEmpty())
+    {
+        //再次执行ndd时文件不会转发到这个窗口，告诉用户原因
+        pMainNotepad->statusBar()->showMessage(QObject::tr("Can not receive files opened from the command line: %1").arg(openChannel->errorString()), 10000);
+    }
+#endif
 #endif // Q_OS_WIN
 	//恢复上次关闭时的文件
 #ifdef Q_OS_WIN
@@ -474,9 +519,19 @@ drop_old:
 	pMainNotepad->checkAppFont();
 #endif
 
+	if (traceStartUs >= 0)
+	{
+		NddTrace::addSpan("startup", QString(), traceStartUs, NddTrace::nowUs());
+	}
+
 	a.exec();
 
+	//下次启动时不用再解析主题的ini文件
+	StyleTableCache::getInstance().save();
+
 	NddSetting::close();
 
+	NddTrace::save();
+
 	return 0;
 }
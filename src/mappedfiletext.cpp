@@ -0,0 +1,61 @@
+﻿#include "mappedfiletext.h"
+
+//映射的文件在文档释放前不能被修改，所以只读打开
+MappedFileText* MappedFileText::create(QString filePath, qint64 skipBytes, bool removeOnRelease)
+{
+	MappedFileText* text = new MappedFileText();
+	text->m_file.setFileName(filePath);
+
+	if (!text->m_file.open(QIODevice::ExistingOnly | QIODevice::ReadOnly) || text->m_file.size() <= skipBytes)
+	{
+		delete text;
+		return nullptr;
+	}
+
+	text->m_filePtr = text->m_file.map(0, text->m_file.size());
+	if (text->m_filePtr == nullptr)
+	{
+		delete text;
+		return nullptr;
+	}
+
+	text->m_skipBytes = skipBytes;
+	text->m_length = text->m_file.size() - skipBytes;
+	text->m_removeOnRelease = removeOnRelease;
+	return text;
+}
+
+MappedFileText::MappedFileText() : m_filePtr(nullptr), m_skipBytes(0), m_length(0), m_removeOnRelease(false)
+{
+}
+
+MappedFileText::~MappedFileText()
+{
+	if (m_filePtr != nullptr)
+	{
+		m_file.unmap(m_filePtr);
+		m_filePtr = nullptr;
+	}
+	m_file.close();
+
+	//先解除映射再删除，windows下映射着的文件删不掉
+	if (m_removeOnRelease)
+	{
+		m_file.remove();
+	}
+}
+
+void MappedFileText::Release()
+{
+	delete this;
+}
+
+const char* MappedFileText::Data() const
+{
+	return reinterpret_cast<const char*>(m_filePtr + m_skipBytes);
+}
+
+Sci_Position MappedFileText::Length() const
+{
+	return m_length;
+}
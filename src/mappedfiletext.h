@@ -0,0 +1,33 @@
+﻿#pragma once
+
+#include <QString>
+#include <QFile>
+
+#include "ILoader.h"
+
+//文件映射到内存后交给Scintilla文档直接引用，不再复制一份文本。
+//文档不再使用时调用Release，这时才解除映射、关闭文件
+class MappedFileText : public IMappedText
+{
+public:
+	//映射整个文件，skipBytes是跳过的文件头，比如UTF8的BOM。失败返回nullptr
+	//removeOnRelease用于保存时生成的交换文件，文档不再引用时删除文件
+	static MappedFileText* create(QString filePath, qint64 skipBytes = 0, bool removeOnRelease = false);
+
+	void SCI_METHOD Release() override;
+	const char* SCI_METHOD Data() const override;
+	Sci_Position SCI_METHOD Length() const override;
+
+private:
+	MappedFileText();
+	~MappedFileText();
+
+	MappedFileText(const MappedFileText&) = delete;
+	MappedFileText& operator=(const MappedFileText&) = delete;
+
+	QFile m_file;
+	uchar* m_filePtr;
+	qint64 m_skipBytes;
+	qint64 m_length;
+	bool m_removeOnRelease;
+};
@@ -1,14 +1,96 @@
 #include "md5hash.h"
 #include "ccnotepad.h"
 #include "ctipwin.h"
+#include "fasthash.h"
+#include "rcglobal.h"
 
 #include <QCryptographicHash>
 #include <QFile>
 #include <QFileDialog>
 #include <QClipboard>
+#include <QFutureWatcher>
+#include <QThread>
+#include <QtConcurrent>
+
+//QCryptographicHashе㷨id100ʼöֵͻ
+const int HASH_XXH3 = 100;
+const int HASH_BLAKE3 = 101;
+
+//ͬʱļ
+const int MAX_HASH_THREADS = 4;
+
+//ÿνϣһμһǷȡ
+const qint64 HASH_SLICE_SIZE = 64 * 1024 * 1024;
+
+//ӳʧʱ˳
+const qint64 HASH_READ_SIZE = 4 * 1024 * 1024;
+
+//Ѽ㷨ͬһӿ
+class FileHasher
+{
+public:
+	FileHasher(int method, int threads) :m_method(method), m_threads(threads), m_cryptoHash(nullptr)
+	{
+		if (m_method != HASH_XXH3 && m_method != HASH_BLAKE3)
+		{
+			m_cryptoHash = new QCryptographicHash((QCryptographicHash::Algorithm)m_method);
+		}
+	}
+
+	~FileHasher()
+	{
+		delete m_cryptoHash;
+	}
+
+	void addData(const char* data, qint64 length)
+	{
+		if (m_method == HASH_XXH3)
+		{
+			m_xxh3.addData(data, length);
+		}
+		else if (m_method == HASH_BLAKE3)
+		{
+			m_blake3.addData(data, length, m_threads);
+		}
+		else
+		{
+			//QCryptographicHashĳint
+			while (length > 0)
+			{
+				int len = (int)qMin<qint64>(length, HASH_SLICE_SIZE);
+				m_cryptoHash->addData(data, len);
+				data += len;
+				length -= len;
+			}
+		}
+	}
+
+	QByteArray result()
+	{
+		if (m_method == HASH_XXH3)
+		{
+			return m_xxh3.result();
+		}
+		else if (m_method == HASH_BLAKE3)
+		{
+			return m_blake3.result();
+		}
+		return m_cryptoHash->result();
+	}
+
+private:
+	FileHasher(const FileHasher&) = delete;
+	FileHasher& operator=(const FileHasher&) = delete;
+
+	int m_method;
+	int m_threads;
+	QCryptographicHash* m_cryptoHash;
+	Xxh3Hash m_xxh3;
+	Blake3Hash m_blake3;
+};
 
 Md5hash::Md5hash(QWidget *parent)
-	: QWidget(parent), m_isFile(false)
+	: QWidget(parent), m_isFile(false), m_hashGeneration(0), m_hashFileNums(0), m_runningHashFiles(0), m_hashedBytes(0)
 {
 	ui.setupUi(this);
 
@@ -19,6 +101,10 @@ Md5hash::Md5hash(QWidget *parent)
 	m_btGroup.addButton(ui.sha256RadioBt, 4);
 	m_btGroup.addButton(ui.sha3RadioBt, 12);
 	m_btGroup.addButton(ui.kec256RadioBt, 8);
+	m_btGroup.addButton(ui.xxh3RadioBt, HASH_XXH3);
+	m_btGroup.addButton(ui.blake3RadioBt, HASH_BLAKE3);
+
+	m_hashPool.setMaxThreadCount(qBound(1, QThread::idealThreadCount(), MAX_HASH_THREADS));
 
 #if (QT_VERSION <= QT_VERSION_CHECK(5,15,0))
 	connect(&m_btGroup, QOverload<int>::of(&QButtonGroup::buttonClicked), this, &Md5hash::on_methodIdChange);
@@ -30,12 +116,26 @@ Md5hash::Md5hash(QWidget *parent)
 }
 
 Md5hash::~Md5hash()
-{}
+{
+	//ûڼļ˳ǽ
+	++m_hashGeneration;
+	m_hashPool.waitForDone();
+
+	//ûнslot_fileHashedĽͷţwatcherǴڵӶ洰һɾ
+	for (QFutureWatcher<FileHashResult*>* watcher : m_hashWatchers)
+	{
+		watcher->disconnect(this);
+		if (watcher->future().resultCount() > 0)
+		{
+			delete watcher->result();
+		}
+	}
+}
 
 void Md5hash::slot_select()
 {
 	QFileDialog fd(this, QString(), CCNotePad::s_lastOpenDirPath);
-	fd.setFileMode(QFileDialog::ExistingFile);
+	fd.setFileMode(QFileDialog::ExistingFiles);
 	m_fileList.clear();
 
 	if (fd.exec() == QDialog::Accepted)   //ɹִ
@@ -60,34 +160,18 @@ void Md5hash::on_methodIdChange(int id)
 	on_hash();
 }
 
+int Md5hash::hashMethod()
+{
+	int id = m_btGroup.checkedId();
+	return (id == -1) ? (int)QCryptographicHash::Md5 : id;
+}
+
 void Md5hash::on_hash()
 {
-	QCryptographicHash::Algorithm method = QCryptographicHash::Md5;
+	int method = hashMethod();
 
-	if (ui.md5RadioBt->isChecked())
-	{
-		method = QCryptographicHash::Md5;
-	}
-	else if (ui.md4RadioBt->isChecked())
-	{
-		method = QCryptographicHash::Md4;
-	}
-	else if (ui.sha1RadioBt->isChecked())
-	{
-		method = QCryptographicHash::Sha1;
-	}
-	else if (ui.sha256RadioBt->isChecked())
-	{
-		method = QCryptographicHash::Sha256;
-	}
-	else if (ui.sha3RadioBt->isChecked())
-	{
-		method = QCryptographicHash::Sha3_256;
-	}
-	else if (ui.kec256RadioBt->isChecked())
-	{
-		method = QCryptographicHash::Keccak_256;
-	}
+	//¼㣬ڽеļ
+	++m_hashGeneration;
 
 	//ı
 	if (!m_isFile)
@@ -98,46 +182,150 @@ void Md5hash::on_hash()
 
 		if (!text.isEmpty())
 		{
-			QByteArray result = QCryptographicHash::hash(data, method);
-			ui.hashTextEdit->setPlainText(result.toHex());
+			FileHasher hasher(method, 1);
+			hasher.addData(data.constData(), data.size());
+			ui.hashTextEdit->setPlainText(hasher.result().toHex());
 		}
 	}
 	else
 	{
-		QCryptographicHash fileHash(method);
-		QByteArray rs;
+		ui.hashTextEdit->clear();
+		startFileHash(method);
+		m_isFile = false;
+	}
+}
 
-		QList<QByteArray> result;
+//ļ̳߳м㣬ÿһһ
+void Md5hash::startFileHash(int method)
+{
+	int generation = m_hashGeneration;
 
-		for (int i = 0; i < m_fileList.size(); ++i)
-		{
-			rs.clear();
-			QFile file(m_fileList.at(i));
-			if (file.open(QIODevice::ReadOnly))
+	//BLAKE3ļڲҲԶ̣߳ͬʱļʱÿļһЩ߳
+	int parallelFiles = qMax(1, qMin(m_fileList.size(), m_hashPool.maxThreadCount()));
+	int threads = qMax(1, QThread::idealThreadCount() / parallelFiles);
+
+	m_hashFileNums = m_fileList.size();
+	m_runningHashFiles = 0;
+	m_hashedBytes = 0;
+	m_hashTimer.start();
+
+	for (int i = 0; i < m_fileList.size(); ++i)
+	{
+		FileHashResult* result = new FileHashResult(m_fileList.at(i));
+
+		QFutureWatcher<FileHashResult*>* futureWatcher = new QFutureWatcher<FileHashResult*>(this);
+
+		futureWatcher->setProperty("generation", generation);
+		m_hashWatchers.append(futureWatcher);
+
+		QObject::connect(futureWatcher, &QFutureWatcher<FileHashResult*>::finished, this, &Md5hash::slot_fileHashed);
+
+		futureWatcher->setFuture(QtConcurrent::run(&m_hashPool, [=](FileHashResult* r)->FileHashResult*
 			{
-				if (fileHash.addData(&file))
-				{
-					rs = fileHash.result();
-					result.append(rs.toHex());
-				}
-				else
-				{
-					result.append("Error Null");
-				}
-				file.close();
+				hashFile(r, method, threads, &m_hashGeneration, generation);
+				return r;
 			}
-			else
+		, result));
+
+		++m_runningHashFiles;
+	}
+}
+
+//ļӳ䵽ڴ棬ӳʧʱ˳ÿһμǷѾȡ
+void Md5hash::hashFile(FileHashResult* result, int method, int threads, const std::atomic<int>* generation, int myGeneration)
+{
+	QElapsedTimer timer;
+	timer.start();
+
+	QFile file(result->filePath);
+	if (!file.open(QIODevice::ReadOnly))
+	{
+		result->error = file.errorString();
+		return;
+	}
+
+	FileHasher hasher(method, threads);
+	result->size = file.size();
+
+	uchar* mapData = (result->size > 0) ? file.map(0, result->size) : nullptr;
+
+	if (mapData != nullptr)
+	{
+		for (qint64 pos = 0; pos < result->size; pos += HASH_SLICE_SIZE)
+		{
+			if (*generation != myGeneration)
 			{
-				result.append("Error Null");
+				break;
 			}
-			
+			hasher.addData((const char*)mapData + pos, qMin(HASH_SLICE_SIZE, result->size - pos));
 		}
-		for (int i = 0; i < result.size(); ++i)
+		file.unmap(mapData);
+	}
+	else
+	{
+		QByteArray buf(HASH_READ_SIZE, Qt::Uninitialized);
+		qint64 total = 0;
+
+		while (*generation == myGeneration)
 		{
-			QString info = QString("File %1 cyp hash is \n%2").arg(m_fileList.at(i)).arg(QString(result.at(i)));
-			ui.hashTextEdit->appendPlainText(info);
+			qint64 len = file.read(buf.data(), HASH_READ_SIZE);
+			if (len < 0)
+			{
+				result->error = file.errorString();
+				break;
+			}
+			if (len == 0)
+			{
+				break;
+			}
+			hasher.addData(buf.constData(), len);
+			total += len;
 		}
-		m_isFile = false;
+		result->size = total;
+	}
+	file.close();
+
+	if (result->error.isEmpty())
+	{
+		result->hash = hasher.result().toHex();
+	}
+	result->msecs = timer.elapsed();
+}
+
+void Md5hash::slot_fileHashed()
+{
+	QFutureWatcher<FileHashResult*>* s = dynamic_cast<QFutureWatcher<FileHashResult*> *>(sender());
+
+	FileHashResult* result = s->result();
+	int generation = s->property("generation").toInt();
+	m_hashWatchers.removeOne(s);
+	s->deleteLater();
+
+	//Ѿ¼ˣǾɵĽ
+	if (generation != m_hashGeneration)
+	{
+		delete result;
+		return;
+	}
+
+	QString info;
+	if (result->error.isEmpty())
+	{
+		qint64 speed = result->size * 1000 / qMax<qint64>(1, result->msecs);
+		info = QString("File %1 cyp hash is \n%2\n%3, %4 ms, %5/s").arg(result->filePath).arg(QString(result->hash)).arg(tranFileSize(result->size)).arg(result->msecs).arg(tranFileSize(speed));
+		m_hashedBytes += result->size;
+	}
+	else
+	{
+		info = QString("File %1 cyp hash is \nError %2").arg(result->filePath).arg(result->error);
+	}
+	ui.hashTextEdit->appendPlainText(info);
+	delete result;
+
+	if (--m_runningHashFiles == 0 && m_hashFileNums > 1)
+	{
+		qint64 ms = qMax<qint64>(1, m_hashTimer.elapsed());
+		ui.hashTextEdit->appendPlainText(tr("Total %1 files, %2, %3 ms, %4/s").arg(m_hashFileNums).arg(tranFileSize(m_hashedBytes)).arg(ms).arg(tranFileSize(m_hashedBytes * 1000 / ms)));
 	}
 }
 
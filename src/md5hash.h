@@ -2,8 +2,25 @@
 
 #include <QWidget>
 #include <QButtonGroup>
+#include <QThreadPool>
+#include <QElapsedTimer>
+#include <QFutureWatcher>
+#include <atomic>
 #include "ui_md5hash.h"
 
+struct FileHashResult {
+	QString filePath;
+	QByteArray hash;
+	qint64 size;
+	qint64 msecs;
+	QString error;
+
+	FileHashResult(const QString& path) :filePath(path), size(0), msecs(0)
+	{
+
+	}
+};
+
 class Md5hash : public QWidget
 {
 	Q_OBJECT
@@ -17,10 +34,25 @@ private slots:
 	void on_hash();
 	void on_methodIdChange(int id);
 	void on_copyClipboard();
+	void slot_fileHashed();
 
 private:
+	int hashMethod();
+	void startFileHash(int method);
+	static void hashFile(FileHashResult* result, int method, int threads, const std::atomic<int>* generation, int myGeneration);
+
 	Ui::Md5hashClass ui;
 	QButtonGroup m_btGroup;
 	QStringList m_fileList;
 	bool m_isFile;
+
+	QThreadPool m_hashPool;
+	//ÿ¼1ֲһ¾ǰ˳Ҳ
+	std::atomic<int> m_hashGeneration;
+	int m_hashFileNums;
+	int m_runningHashFiles;
+	qint64 m_hashedBytes;
+	QElapsedTimer m_hashTimer;
+	//ûнslot_fileHashedļ
+	QList<QFutureWatcher<FileHashResult*>*> m_hashWatchers;
 };
@@ -0,0 +1,229 @@
+﻿#include "memoryoverviewwin.h"
+#include "scintillaeditview.h"
+#include "findwin.h"
+#include "rcglobal.h"
+#include "ctipwin.h"
+
+#include <QMessageBox>
+#include <QHeaderView>
+#include <algorithm>
+
+QString getFilePathProperty(QWidget* pwidget);
+
+//表格的列，与ui中的顺序一致
+enum MEMORY_COLUMN {
+	COL_FILE = 0,
+	COL_TOTAL,
+	COL_TEXT,
+	COL_STYLES,
+	COL_LINES,
+	COL_MARKERS,
+	COL_LINEDATA,
+	COL_INDICATORS,
+	COL_UNDO,
+	COL_LAYOUT,
+	COL_FINDRECORDS,
+	COL_HIGHLIGHT,
+	COL_WORDINDEX,
+};
+
+struct TabMemoryRow {
+	ScintillaEditView* pEdit;
+	QString name;
+	QString filePath;
+	EditMemoryUsage usage;
+};
+
+MemoryOverviewWin::MemoryOverviewWin(QTabWidget* editTabWidget, FindWin* findWin, QWidget* parent)
+	: QWidget(parent), m_editTabWidget(editTabWidget), m_findWin(findWin)
+{
+	ui.setupUi(this);
+
+	ui.memoryTable->horizontalHeader()->setSectionResizeMode(COL_FILE, QHeaderView::Stretch);
+	ui.memoryTable->verticalHeader()->setVisible(false);
+
+	slot_refresh();
+}
+
+MemoryOverviewWin::~MemoryOverviewWin()
+{}
+
+void MemoryOverviewWin::slot_refresh()
+{
+	ui.memoryTable->clearContents();
+	ui.memoryTable->setRowCount(0);
+
+	if (m_editTabWidget.isNull())
+	{
+		return;
+	}
+
+	//十六进制等非文本标签页不统计
+	QVector<TabMemoryRow> rows;
+	for (int i = 0; i < m_editTabWidget->count(); ++i)
+	{
+		ScintillaEditView* pEdit = qobject_cast<ScintillaEditView*>(m_editTabWidget->widget(i));
+		if (pEdit == nullptr)
+		{
+			continue;
+		}
+
+		TabMemoryRow row;
+		row.pEdit = pEdit;
+		row.name = m_editTabWidget->tabText(i);
+		row.filePath = getFilePathProperty(pEdit);
+		row.usage = pEdit->memoryUsage();
+		rows.append(row);
+	}
+
+	std::stable_sort(rows.begin(), rows.end(), [](const TabMemoryRow& a, const TabMemoryRow& b) {
+		return a.usage.total() > b.usage.total();
+	});
+
+	qint64 total = 0;
+	ui.memoryTable->setRowCount(rows.size());
+
+	for (int i = 0; i < rows.size(); ++i)
+	{
+		const TabMemoryRow& row = rows.at(i);
+		const EditMemoryUsage& usage = row.usage;
+		total += usage.total();
+
+		QTableWidgetItem* nameItem = new QTableWidgetItem(row.name);
+		nameItem->setToolTip(row.filePath);
+		//只用来和标签页中的编辑框比较，不直接解引用，标签页关闭后就找不到了
+		nameItem->setData(Qt::UserRole, QVariant::fromValue((quintptr)row.pEdit));
+		ui.memoryTable->setItem(i, COL_FILE, nameItem);
+
+		const qint64 values[] = { usage.total(), usage.text, usage.styles, usage.lines, usage.markers, usage.lineData,
+			usage.indicators, usage.undo, usage.layout, usage.findRecords, usage.smartHighlight, usage.wordIndex };
+
+		for (int j = 0; j < (int)(sizeof(values) / sizeof(values[0])); ++j)
+		{
+			QTableWidgetItem* item = new QTableWidgetItem(tranFileSize(values[j]));
+			item->setTextAlignment(Qt::AlignRight | Qt::AlignVCenter);
+			ui.memoryTable->setItem(i, COL_TOTAL + j, item);
+		}
+	}
+
+	qint64 searchEdit = m_findWin.isNull() ? 0 : m_findWin->searchEditMemory();
+
+	ui.summaryLabel->setText(tr("%1 tabs, total %2; background search editor %3").arg(rows.size()).arg(tranFileSize(total)).arg(tranFileSize(searchEdit)));
+}
+
+ScintillaEditView* MemoryOverviewWin::editOfRow(int row)
+{
+	QTableWidgetItem* item = ui.memoryTable->item(row, COL_FILE);
+	if (item == nullptr || m_editTabWidget.isNull())
+	{
+		return nullptr;
+	}
+
+	QWidget* pw = (QWidget*)item->data(Qt::UserRole).value<quintptr>();
+	if (m_editTabWidget->indexOf(pw) == -1)
+	{
+		return nullptr;
+	}
+	return qobject_cast<ScintillaEditView*>(pw);
+}
+
+QList<ScintillaEditView*> MemoryOverviewWin::selectedEdits()
+{
+	QList<ScintillaEditView*> edits;
+
+	QList<QTableWidgetItem*> items = ui.memoryTable->selectedItems();
+	for (QTableWidgetItem* item : items)
+	{
+		if (item->column() != COL_FILE)
+		{
+			continue;
+		}
+
+		ScintillaEditView* pEdit = editOfRow(item->row());
+		if (pEdit != nullptr)
+		{
+			edits.append(pEdit);
+		}
+	}
+	return edits;
+}
+
+void MemoryOverviewWin::slot_trimSelected()
+{
+	QList<ScintillaEditView*> edits = selectedEdits();
+	if (edits.isEmpty())
+	{
+		CTipWin::showTips(this, tr("Please select the tabs first!"), 1200);
+		return;
+	}
+
+	for (ScintillaEditView* pEdit : edits)
+	{
+		pEdit->trimMemory();
+	}
+	slot_refresh();
+}
+
+void MemoryOverviewWin::slot_clearUndoSelected()
+{
+	QList<ScintillaEditView*> edits = selectedEdits();
+	if (edits.isEmpty())
+	{
+		CTipWin::showTips(this, tr("Please select the tabs first!"), 1200);
+		return;
+	}
+
+	if (QMessageBox::Yes != QMessageBox::question(this, tr("Clear Undo"), tr("The undo history of the selected tabs can not be restored, continue?")))
+	{
+		return;
+	}
+
+	//清空撤销后文档回到保存点，修改过没有保存的文档会被当成没有修改，所以跳过
+	int skipNums = 0;
+	for (ScintillaEditView* pEdit : edits)
+	{
+		if (pEdit->isModified())
+		{
+			++skipNums;
+			continue;
+		}
+		pEdit->clearUndo();
+		pEdit->trimMemory();
+	}
+
+	if (skipNums > 0)
+	{
+		CTipWin::showTips(this, tr("%1 modified tabs skipped, please save them first.").arg(skipNums), 2000);
+	}
+	slot_refresh();
+}
+
+void MemoryOverviewWin::slot_trimAll()
+{
+	if (!m_editTabWidget.isNull())
+	{
+		for (int i = 0; i < m_editTabWidget->count(); ++i)
+		{
+			ScintillaEditView* pEdit = qobject_cast<ScintillaEditView*>(m_editTabWidget->widget(i));
+			if (pEdit != nullptr)
+			{
+				pEdit->trimMemory();
+			}
+		}
+	}
+
+	if (!m_findWin.isNull())
+	{
+		m_findWin->releaseSearchEdit();
+	}
+	slot_refresh();
+}
+
+void MemoryOverviewWin::slot_cellDoubleClicked(int row, int /*column*/)
+{
+	ScintillaEditView* pEdit = editOfRow(row);
+	if (pEdit != nullptr)
+	{
+		m_editTabWidget->setCurrentWidget(pEdit);
+	}
+}
@@ -0,0 +1,36 @@
+﻿#pragma once
+
+#include <QWidget>
+#include <QPointer>
+#include <QTabWidget>
+#include "ui_memoryoverviewwin.h"
+
+class FindWin;
+class ScintillaEditView;
+
+//按占用内存从大到小列出所有标签页，每一列是一个组成部分。
+//可以对选中的标签页释放缓存、清空撤销历史，双击切换到该标签页
+class MemoryOverviewWin : public QWidget
+{
+	Q_OBJECT
+
+public:
+	MemoryOverviewWin(QTabWidget* editTabWidget, FindWin* findWin, QWidget* parent = nullptr);
+	virtual ~MemoryOverviewWin();
+
+private slots:
+	void slot_refresh();
+	void slot_trimSelected();
+	void slot_clearUndoSelected();
+	void slot_trimAll();
+	void slot_cellDoubleClicked(int row, int column);
+
+private:
+	QList<ScintillaEditView*> selectedEdits();
+	ScintillaEditView* editOfRow(int row);
+
+	Ui::MemoryOverviewWinClass ui;
+
+	QPointer<QTabWidget> m_editTabWidget;
+	QPointer<FindWin> m_findWin;
+};
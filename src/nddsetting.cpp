@@ -116,6 +116,9 @@ void NddSetting::init()
 		//打开网页，默认不勾选，资源耗费多
 		addKeyValueToNumSets(SHOWWEBADDR, 0);
 
+		//单词自动补全，默认开启
+		addKeyValueToNumSets(WORD_COMPLETE_OFF, 0);
+
 		//查找结果框的默认字体大小
 		addKeyValueToNumSets(FIND_RESULT_FONT_SIZE, 14);
 	};
@@ -223,6 +226,10 @@ void NddSetting::init()
 				QVariant v(0);
 				checkNoExistAdd(SHOWWEBADDR, v);
 			}
+			{
+				QVariant v(0);
+				checkNoExistAdd(WORD_COMPLETE_OFF, v);
+			}
 			{
 				QVariant v(14);
 				checkNoExistAdd(FIND_RESULT_FONT_SIZE, v);
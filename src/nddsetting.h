@@ -29,6 +29,10 @@ static QString LAST_ACTION_TAB_INDEX = "lati";//上次关闭时，当前激活
 static QString RECENT_OPEN_FILE = "recentopenfile";
 static QString LAST_OPEN_DIR = "lastdir";
 static QString CLEAR_OPENFILE_ON_CLOSE = "clearopenfile"; //关闭时清空历史文件
+static QString TAB_TRIM_MINUTES = "tabtrimmin"; //后台标签页多少分钟没有激活后释放可以重建的内存，0不按时间释放
+static QString TAB_MEMORY_BUDGET = "tabmembudget"; //所有标签页的内存预算，MB。超过时从最久没有激活的标签页开始释放，0不限制
+static QString WORD_COMPLETE_OFF = "wordcompoff"; //1 关闭输入时从所有打开文档中补全单词。没有这一项时为0，默认补全
+static QString TAB_TRIM_TEXT = "tabtrimtext"; //1 释放时连同未修改文件的文本一起释放，激活时从磁盘重新加载
 
 
 //下面这个是winpos.ini中的key，避免单个文件太大，拖慢启动速度
@@ -0,0 +1,173 @@
+﻿#include "nddtrace.h"
+
+#include <QCoreApplication>
+#include <QThread>
+#include <QFile>
+#include <QJsonArray>
+#include <QJsonObject>
+#include <QJsonDocument>
+#include <QMutex>
+#include <QMutexLocker>
+#include <QVector>
+#include <QMap>
+#include <string.h>
+
+std::atomic<bool> NddTrace::s_isEnabled(false);
+
+//跟踪点不在循环的最内层，事件数量不多。超过上限后丢弃，避免长时间运行时内存一直增加
+static const int MAX_TRACE_EVENTS = 1000000;
+
+struct NddTraceEvent
+{
+	const char* name;
+	QString detail;
+	qint64 startUs;
+	qint64 durUs;
+	int tid;
+};
+
+static QMutex s_traceMutex;
+static QVector<NddTraceEvent> s_traceEvents;
+//线程序号对应的线程名称
+static QMap<int, QString> s_traceThreadNames;
+static QString s_traceFile;
+static std::chrono::steady_clock::time_point s_traceStart;
+
+static std::atomic<int> s_nextTraceTid(1);
+
+//trace中的线程号用从1开始的小整数，开启跟踪的主线程是1
+static int currentTraceTid()
+{
+	static thread_local int tid = 0;
+	if (tid == 0)
+	{
+		tid = s_nextTraceTid.fetch_add(1);
+
+		QString threadName = (tid == 1) ? QString("main") : QThread::currentThread()->objectName();
+		if (threadName.isEmpty())
+		{
+			threadName = QString("worker %1").arg(tid);
+		}
+
+		QMutexLocker locker(&s_traceMutex);
+		s_traceThreadNames.insert(tid, threadName);
+	}
+	return tid;
+}
+
+void NddTrace::init(int& argc, char** argv)
+{
+	QString traceFile;
+
+	for (int i = 1; i < argc; ++i)
+	{
+		if ((strcmp(argv[i], "-trace") == 0) && (i + 1 < argc))
+		{
+			traceFile = QString::fromLocal8Bit(argv[i + 1]);
+
+			//后面的参数前移，QApplication和打开文件的参数处理都看不到 -trace
+			for (int j = i + 2; j <= argc; ++j)
+			{
+				argv[j - 2] = argv[j];
+			}
+			argc -= 2;
+			break;
+		}
+	}
+
+	if (traceFile.isEmpty())
+	{
+		traceFile = QString::fromLocal8Bit(qgetenv("NDD_TRACE_FILE"));
+	}
+
+	if (traceFile.isEmpty())
+	{
+		return;
+	}
+
+	s_traceFile = traceFile;
+	s_traceStart = std::chrono::steady_clock::now();
+	currentTraceTid();
+	s_isEnabled.store(true, std::memory_order_relaxed);
+}
+
+qint64 NddTrace::nowUs()
+{
+	return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - s_traceStart).count();
+}
+
+void NddTrace::addSpan(const char* name, const QString& detail, qint64 startUs, qint64 endUs)
+{
+	NddTraceEvent event;
+	event.name = name;
+	event.detail = detail;
+	event.startUs = startUs;
+	event.durUs = endUs - startUs;
+	event.tid = currentTraceTid();
+
+	QMutexLocker locker(&s_traceMutex);
+	if (s_traceEvents.size() < MAX_TRACE_EVENTS)
+	{
+		s_traceEvents.append(event);
+	}
+}
+
+void NddTrace::save()
+{
+	if (!s_isEnabled.exchange(false))
+	{
+		return;
+	}
+
+	QMutexLocker locker(&s_traceMutex);
+
+	const qint64 pid = QCoreApplication::applicationPid();
+	QJsonArray events;
+
+	QJsonObject processName;
+	processName.insert("name", "process_name");
+	processName.insert("ph", "M");
+	processName.insert("pid", pid);
+	processName.insert("args", QJsonObject{ { "name", "Notepad--" } });
+	events.append(processName);
+
+	for (auto it = s_traceThreadNames.constBegin(); it != s_traceThreadNames.constEnd(); ++it)
+	{
+		QJsonObject threadName;
+		threadName.insert("name", "thread_name");
+		threadName.insert("ph", "M");
+		threadName.insert("pid", pid);
+		threadName.insert("tid", it.key());
+		threadName.insert("args", QJsonObject{ { "name", it.value() } });
+		events.append(threadName);
+	}
+
+	for (const NddTraceEvent& event : s_traceEvents)
+	{
+		QJsonObject obj;
+		obj.insert("name", QString::fromUtf8(event.name));
+		obj.insert("cat", "ndd");
+		obj.insert("ph", "X");
+		obj.insert("ts", event.startUs);
+		obj.insert("dur", event.durUs);
+		obj.insert("pid", pid);
+		obj.insert("tid", event.tid);
+		if (!event.detail.isEmpty())
+		{
+			obj.insert("args", QJsonObject{ { "detail", event.detail } });
+		}
+		events.append(obj);
+	}
+
+	QJsonObject root;
+	root.insert("traceEvents", events);
+	root.insert("displayTimeUnit", "ms");
+
+	QFile file(s_traceFile);
+	if (file.open(QIODevice::WriteOnly | QIODevice::Truncate))
+	{
+		file.write(QJsonDocument(root).toJson(QJsonDocument::Compact));
+	}
+
+	s_traceEvents.clear();
+}
@@ -0,0 +1,73 @@
+﻿#pragma once
+
+#include <QString>
+#include <atomic>
+#include <chrono>
+
+//启动和常用操作的耗时跟踪，输出Chrome trace格式的json，可以用chrome://tracing或者Perfetto打开。
+//命令行 -trace tracefile，或者环境变量NDD_TRACE_FILE开启。没有开启时，每个跟踪点只判断一次标志
+class NddTrace
+{
+public:
+	//在创建QApplication之前调用：取出命令行中的 -trace tracefile 并开启跟踪
+	static void init(int& argc, char** argv);
+
+	static bool isEnabled()
+	{
+		return s_isEnabled.load(std::memory_order_relaxed);
+	}
+
+	//程序退出时写入跟踪文件
+	static void save();
+
+	static qint64 nowUs();
+	static void addSpan(const char* name, const QString& detail, qint64 startUs, qint64 endUs);
+
+private:
+	static std::atomic<bool> s_isEnabled;
+};
+
+//作用域内的耗时。name必须是字符串常量，不会复制
+class NddTraceSpan
+{
+public:
+	explicit NddTraceSpan(const char* name) : m_name(name), m_startUs(-1)
+	{
+		if (NddTrace::isEnabled())
+		{
+			m_startUs = NddTrace::nowUs();
+		}
+	}
+
+	//detail只在跟踪开启时保存，一般是文件路径
+	NddTraceSpan(const char* name, const QString& detail) : m_name(name), m_startUs(-1)
+	{
+		if (NddTrace::isEnabled())
+		{
+			m_detail = detail;
+			m_startUs = NddTrace::nowUs();
+		}
+	}
+
+	~NddTraceSpan()
+	{
+		if (m_startUs >= 0)
+		{
+			NddTrace::addSpan(m_name, m_detail, m_startUs, NddTrace::nowUs());
+		}
+	}
+
+private:
+	NddTraceSpan(const NddTraceSpan&) = delete;
+	NddTraceSpan& operator=(const NddTraceSpan&) = delete;
+
+	const char* m_name;
+	QString m_detail;
+	qint64 m_startUs;
+};
+
+#define NDD_TRACE_CAT_INNER(a, b) a##b
+#define NDD_TRACE_CAT(a, b) NDD_TRACE_CAT_INNER(a, b)
+
+//NDD_TRACE_SPAN("name") 或 NDD_TRACE_SPAN("name", filePath)
+#define NDD_TRACE_SPAN(...) NddTraceSpan NDD_TRACE_CAT(nddTraceSpan_, __LINE__)(__VA_ARGS__)
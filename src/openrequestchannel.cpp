@@ -0,0 +1,324 @@
+﻿#include "openrequestchannel.h"
+#include "nddtrace.h"
+
+#include <QLocalServer>
+#include <QLocalSocket>
+#include <QDataStream>
+#include <QDateTime>
+#include <QFileInfo>
+#include <QFile>
+#include <QDir>
+
+#if defined(Q_OS_UNIX) && !defined(Q_OS_MAC)
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <poll.h>
+#include <unistd.h>
+#include <errno.h>
+#include <string.h>
+#endif
+
+//消息格式：magic、负载长度，负载是QDataStream写入的 发送时间、工作目录、参数列表
+static const quint32 OPEN_REQUEST_MAGIC = 0x4E44444F;
+static const quint32 MAX_MESSAGE_SIZE = 1024 * 1024;
+static const qint64 MESSAGE_HEADER_SIZE = 2 * sizeof(quint32);
+
+//同时打开多个文件时，文件管理器几乎同时启动多个进程，这个时间内的请求合并到一批
+static const int BATCH_DELAY_MS = 20;
+
+//转发端等待主实例确认的时间。超时也认为已经转发，数据已经在socket中，主实例忙完后会处理
+static const int ACK_TIMEOUT_MS = 1000;
+
+OpenRequestChannel::OpenRequestChannel(QObject* parent) : QObject(parent), m_server(nullptr)
+{
+	m_batchTimer.setSingleShot(true);
+	m_batchTimer.setInterval(BATCH_DELAY_MS);
+	connect(&m_batchTimer, &QTimer::timeout, this, &OpenRequestChannel::slot_flushRequests);
+}
+
+OpenRequestChannel::~OpenRequestChannel()
+{
+	//关闭时删除socket文件
+	if (m_server != nullptr)
+	{
+		m_server->close();
+	}
+}
+
+//优先放在用户自己的运行时目录下，每个用户一个
+QString OpenRequestChannel::serverPath()
+{
+	QString dir = QFile::decodeName(qgetenv("XDG_RUNTIME_DIR"));
+	if (dir.isEmpty() || !QFileInfo(dir).isDir())
+	{
+		dir = QDir::tempPath();
+	}
+#if defined(Q_OS_UNIX)
+	return QString("%1/ndd-%2.sock").arg(dir).arg(getuid());
+#else
+	return QString("ndd-%1").arg(QDir::home().dirName());
+#endif
+}
+
+QList<OpenRequest> OpenRequestChannel::parseArguments(const QStringList& arguments, const QString& workDir)
+{
+	QList<OpenRequest> requests;
+	QDir dir(workDir);
+
+	for (int i = 0; i < arguments.size(); ++i)
+	{
+		const QString& arg = arguments.at(i);
+
+		//-n linenum 作用在它前面的文件上
+		if (arg == QString("-n") && (i + 1 < arguments.size()))
+		{
+			bool ok = false;
+			int lineNum = arguments.at(i + 1).toInt(&ok);
+			if (ok && !requests.isEmpty())
+			{
+				requests.last().lineNum = lineNum;
+			}
+			++i;
+			continue;
+		}
+
+		if (arg.isEmpty())
+		{
+			continue;
+		}
+
+		OpenRequest request;
+		request.filePath = QFileInfo(arg).isRelative() ? QDir::cleanPath(dir.absoluteFilePath(arg)) : arg;
+		requests.append(request);
+	}
+	return requests;
+}
+
+//只用系统调用和QDataStream组消息，不需要事件循环，在QApplication创建前使用
+bool OpenRequestChannel::forward(const QStringList& arguments, const QString& workDir, const QString& path)
+{
+#if defined(Q_OS_UNIX) && !defined(Q_OS_MAC)
+	QByteArray socketPath = QFile::encodeName(path.isEmpty() ? serverPath() : path);
+
+	sockaddr_un addr;
+	memset(&addr, 0, sizeof(addr));
+	if (socketPath.size() >= (int)sizeof(addr.sun_path))
+	{
+		return false;
+	}
+	addr.sun_family = AF_UNIX;
+	memcpy(addr.sun_path, socketPath.constData(), socketPath.size());
+
+	int fd = ::socket(AF_UNIX, SOCK_STREAM, 0);
+	if (fd < 0)
+	{
+		return false;
+	}
+
+	//没有实例在监听时，connect立即失败
+	if (::connect(fd, (sockaddr*)&addr, sizeof(addr)) != 0)
+	{
+		::close(fd);
+		return false;
+	}
+
+	QByteArray payload;
+	{
+		QDataStream out(&payload, QIODevice::WriteOnly);
+		out.setVersion(QDataStream::Qt_5_0);
+		out << QDateTime::currentMSecsSinceEpoch() << workDir << arguments;
+	}
+
+	QByteArray message;
+	{
+		QDataStream out(&message, QIODevice::WriteOnly);
+		out << OPEN_REQUEST_MAGIC << quint32(payload.size());
+	}
+	message.append(payload);
+
+	const char* data = message.constData();
+	qint64 left = message.size();
+	while (left > 0)
+	{
+		ssize_t n = ::send(fd, data, left, MSG_NOSIGNAL);
+		if (n < 0)
+		{
+			if (errno == EINTR)
+			{
+				continue;
+			}
+			::close(fd);
+			return false;
+		}
+		data += n;
+		left -= n;
+	}
+
+	//等主实例确认后再退出，多个转发进程的文件按启动的先后打开
+	pollfd pfd;
+	pfd.fd = fd;
+	pfd.events = POLLIN;
+	pfd.revents = 0;
+	if (::poll(&pfd, 1, ACK_TIMEOUT_MS) > 0)
+	{
+		char ack = 0;
+		::recv(fd, &ack, 1, 0);
+	}
+
+	::close(fd);
+	return true;
+#else
+	Q_UNUSED(arguments);
+	Q_UNUSED(workDir);
+	Q_UNUSED(path);
+	return false;
+#endif
+}
+
+bool OpenRequestChannel::listen(const QString& path)
+{
+	if (m_server != nullptr)
+	{
+		return m_server->isListening();
+	}
+
+	m_server = new QLocalServer(this);
+	m_server->setSocketOptions(QLocalServer::UserAccessOption);
+	connect(m_server, &QLocalServer::newConnection, this, &OpenRequestChannel::slot_newConnection);
+
+	QString socketPath = path.isEmpty() ? serverPath() : path;
+	if (m_server->listen(socketPath))
+	{
+		return true;
+	}
+
+	if (m_server->serverError() == QAbstractSocket::AddressInUseError)
+	{
+		//还能连上说明有其它实例在监听，不去抢它的socket；否则是上次异常退出留下的文件
+		QLocalSocket probe;
+		probe.connectToServer(socketPath);
+		if (probe.waitForConnected(100))
+		{
+			probe.abort();
+			return false;
+		}
+
+		QLocalServer::removeServer(socketPath);
+		if (m_server->listen(socketPath))
+		{
+			return true;
+		}
+	}
+
+	m_errorString = m_server->errorString();
+	return false;
+}
+
+QString OpenRequestChannel::errorString() const
+{
+	return m_errorString;
+}
+
+void OpenRequestChannel::slot_newConnection()
+{
+	while (m_server->hasPendingConnections())
+	{
+		QLocalSocket* socket = m_server->nextPendingConnection();
+		connect(socket, &QLocalSocket::readyRead, this, &OpenRequestChannel::slot_readyRead);
+		connect(socket, &QLocalSocket::disconnected, socket, &QLocalSocket::deleteLater);
+
+		//转发端连上后马上发送，数据可能已经到了
+		readMessage(socket);
+	}
+}
+
+void OpenRequestChannel::slot_readyRead()
+{
+	QLocalSocket* socket = qobject_cast<QLocalSocket*>(sender());
+	if (socket != nullptr)
+	{
+		readMessage(socket);
+	}
+}
+
+//消息不完整时返回false，等下次readyRead
+bool OpenRequestChannel::readMessage(QLocalSocket* socket)
+{
+	if (socket->bytesAvailable() < MESSAGE_HEADER_SIZE)
+	{
+		return false;
+	}
+
+	quint32 magic = 0;
+	quint32 size = 0;
+	{
+		QByteArray header = socket->peek(MESSAGE_HEADER_SIZE);
+		QDataStream in(header);
+		in >> magic >> size;
+	}
+
+	if (magic != OPEN_REQUEST_MAGIC || size > MAX_MESSAGE_SIZE)
+	{
+		socket->abort();
+		return false;
+	}
+
+	if (socket->bytesAvailable() < MESSAGE_HEADER_SIZE + size)
+	{
+		return false;
+	}
+
+	socket->read(MESSAGE_HEADER_SIZE);
+	QByteArray payload = socket->read(size);
+
+	qint64 sendTime = 0;
+	QString workDir;
+	QStringList arguments;
+	{
+		QDataStream in(payload);
+		in.setVersion(QDataStream::Qt_5_0);
+		in >> sendTime >> workDir >> arguments;
+		if (in.status() != QDataStream::Ok)
+		{
+			socket->abort();
+			return false;
+		}
+	}
+
+	QList<OpenRequest> requests = parseArguments(arguments, workDir);
+	for (OpenRequest& request : requests)
+	{
+		request.sendTime = sendTime;
+	}
+	m_pendingRequests.append(requests);
+
+	socket->write("k", 1);
+	socket->flush();
+	socket->disconnectFromServer();
+
+	//不带文件的请求也要激活一次窗口
+	if (!m_batchTimer.isActive())
+	{
+		m_batchTimer.start();
+	}
+	return true;
+}
+
+void OpenRequestChannel::slot_flushRequests()
+{
+	QList<OpenRequest> requests;
+	requests.swap(m_pendingRequests);
+
+	//转发耗时记录到跟踪文件中：从转发端发出到这里交给界面。发送时间是另一个进程的时钟，换算到跟踪的时间轴上
+	if (NddTrace::isEnabled())
+	{
+		qint64 now = QDateTime::currentMSecsSinceEpoch();
+		qint64 nowUs = NddTrace::nowUs();
+		for (const OpenRequest& request : requests)
+		{
+			NddTrace::addSpan("OpenRequestChannel::forward", request.filePath, nowUs - (now - request.sendTime) * 1000, nowUs);
+		}
+	}
+
+	emit signOpenRequests(requests);
+}
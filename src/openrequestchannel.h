@@ -0,0 +1,77 @@
+﻿#pragma once
+
+#include <QObject>
+#include <QString>
+#include <QStringList>
+#include <QList>
+#include <QTimer>
+
+class QLocalServer;
+class QLocalSocket;
+
+//命令行中的一个打开请求
+struct OpenRequest
+{
+	QString filePath;
+	//-n 指定的行号，-1表示不跳转
+	int lineNum;
+	//转发端发出请求的时间，毫秒。用于统计转发的耗时
+	qint64 sendTime;
+
+	OpenRequest() : lineNum(-1), sendTime(0)
+	{
+	}
+};
+
+//linux下单实例的打开请求通道。
+//已经运行的实例在本地socket上监听；再次执行ndd时，在创建QApplication之前就把整个命令行发给它，然后直接退出。
+//一条消息中可以有多个文件和各自的 -n 行号；接收端把短时间内收到的请求合并成一批，一次打开并只激活一次窗口。
+//替代原来共享内存中只有一个1024字节路径槽位+SIGUSR1的方式，同时打开多个文件时不再相互覆盖而丢失
+class OpenRequestChannel : public QObject
+{
+	Q_OBJECT
+
+public:
+	OpenRequestChannel(QObject* parent = nullptr);
+	virtual ~OpenRequestChannel();
+
+	//当前用户的socket路径
+	static QString serverPath();
+
+	//转发端：不依赖QCoreApplication，在main的最前面调用。
+	//返回true表示请求已经交给运行中的实例，当前进程可以退出；false表示没有运行中的实例。
+	//path为空时使用serverPath()，ndd_bench用单独的路径测试转发耗时
+	static bool forward(const QStringList& arguments, const QString& workDir, const QString& path = QString());
+
+	//解析命令行参数（不含程序名）。支持 file1 file2 ... 和 file -n linenum，相对路径按workDir补全
+	static QList<OpenRequest> parseArguments(const QStringList& arguments, const QString& workDir);
+
+	//主实例调用，开始接收打开请求
+	bool listen(const QString& path = QString());
+
+	//listen失败的原因。已经有其它实例在监听时为空
+	QString errorString() const;
+
+signals:
+	//一批打开请求。列表为空时表示只需要激活窗口
+	void signOpenRequests(const QList<OpenRequest>& requests);
+
+private slots:
+	void slot_newConnection();
+	void slot_readyRead();
+	void slot_flushRequests();
+
+private:
+	OpenRequestChannel(const OpenRequestChannel&) = delete;
+	OpenRequestChannel& operator=(const OpenRequestChannel&) = delete;
+
+	bool readMessage(QLocalSocket* socket);
+
+	QLocalServer* m_server;
+
+	//还没有交给界面的请求
+	QList<OpenRequest> m_pendingRequests;
+	QTimer m_batchTimer;
+
+	QString m_errorString;
+};
@@ -3,6 +3,67 @@
 #include <QDir>
 #include <QMenu>
 #include <QAction>
+#include <QSettings>
+#include <QFileInfo>
+#include <QDateTime>
+
+//插件清单缓存中的状态
+enum PluginManifestState {
+	MANIFEST_STALE = 0,//没有记录，或者文件已经变了，需要加载插件重新识别
+	MANIFEST_PLUGIN,//是插件，识别信息已经读出
+	MANIFEST_NOT_PLUGIN,//不是插件，不用再加载
+};
+
+//从清单中读取插件的识别信息。文件大小、修改时间和界面语言与记录一致才有效
+static int readManifest(QSettings& manifest, const QFileInfo& fi, const QString& langTag, NDD_PROC_DATA* pProcData)
+{
+	int state = MANIFEST_STALE;
+
+	manifest.beginGroup(fi.fileName());
+	if (manifest.value("path").toString() == fi.absoluteFilePath()
+		&& manifest.value("size", -1).toLongLong() == fi.size()
+		&& manifest.value("mtime", -1).toLongLong() == fi.lastModified().toMSecsSinceEpoch()
+		&& manifest.value("langTag").toString() == langTag)
+	{
+		if (manifest.value("valid", false).toBool())
+		{
+			pProcData->m_strPlugName = manifest.value("name").toString();
+			pProcData->m_strComment = manifest.value("comment").toString();
+			pProcData->m_version = manifest.value("version").toString();
+			pProcData->m_auther = manifest.value("auther").toString();
+			pProcData->m_menuType = manifest.value("menuType", 0).toInt();
+			state = MANIFEST_PLUGIN;
+		}
+		else
+		{
+			state = MANIFEST_NOT_PLUGIN;
+		}
+	}
+	manifest.endGroup();
+
+	return state;
+}
+
+//pProcData为空表示该文件不是插件
+static void writeManifest(QSettings& manifest, const QFileInfo& fi, const QString& langTag, const NDD_PROC_DATA* pProcData)
+{
+	manifest.beginGroup(fi.fileName());
+	manifest.remove("");
+	manifest.setValue("path", fi.absoluteFilePath());
+	manifest.setValue("size", fi.size());
+	manifest.setValue("mtime", fi.lastModified().toMSecsSinceEpoch());
+	manifest.setValue("langTag", langTag);
+	manifest.setValue("valid", pProcData != nullptr);
+	if (pProcData != nullptr)
+	{
+		manifest.setValue("name", pProcData->m_strPlugName);
+		manifest.setValue("comment", pProcData->m_strComment);
+		manifest.setValue("version", pProcData->m_version);
+		manifest.setValue("auther", pProcData->m_auther);
+		manifest.setValue("menuType", pProcData->m_menuType);
+	}
+	manifest.endGroup();
+}
 
 
 bool loadApplication(const QString& strFileName, NDD_PROC_DATA* pProcData)
@@ -28,7 +89,7 @@ bool loadApplication(const QString& strFileName, NDD_PROC_DATA* pProcData)
 
 
 
-int loadProc(const QString& strDirOut, std::function<void(NDD_PROC_DATA&, QMenu*)> funcallback, QMenu* pUserData)
+int loadProc(const QString& strDirOut, std::function<void(NDD_PROC_DATA&, QMenu*)> funcallback, QMenu* pUserData, const QString& langTag)
 {
 	int nReturn = 0;
 	QStringList list;
@@ -49,16 +110,41 @@ int loadProc(const QString& strDirOut, std::function<void(NDD_PROC_DATA&, QMenu*
 	list = dir.entryList(strFilter, QDir::Files | QDir::Readable, QDir::Name);
 	QStringList::Iterator it = list.begin();
 
+	//识别信息先从清单缓存中读取，只有新增或者更新过的插件才加载识别。
+	//插件库在第一次使用时才真正加载，启动时间不随插件数量增加
+	QSettings manifest(QSettings::IniFormat, QSettings::UserScope, QString("notepad/pluginmanifest"));
+	manifest.setIniCodec("UTF-8");
+
+	//已经删除的插件，从清单中去掉
+	for (const QString& group : manifest.childGroups())
+	{
+		if (!list.contains(group))
+		{
+			manifest.remove(group);
+		}
+	}
+
 	for (; it != list.end(); ++it)
 	{
 		NDD_PROC_DATA procData;
 		strName = *it;
 		strName = strDir + strName;
 
-		if (!loadApplication(strName, &procData))
+		QFileInfo fi(strName);
+		int state = readManifest(manifest, fi, langTag, &procData);
+
+		if (state == MANIFEST_STALE)
+		{
+			bool isPlugin = loadApplication(strName, &procData);
+			writeManifest(manifest, fi, langTag, isPlugin ? &procData : nullptr);
+			state = isPlugin ? MANIFEST_PLUGIN : MANIFEST_NOT_PLUGIN;
+		}
+
+		if (state != MANIFEST_PLUGIN)
 		{
 			continue;
 		}
+		procData.m_strFilePath = strName;
 
 		funcallback(procData, pUserData);
 		
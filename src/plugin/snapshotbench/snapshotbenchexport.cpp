@@ -0,0 +1,208 @@
+﻿#include <qobject.h>
+#include <qstring.h>
+#include <pluginGl.h>
+#include <functional>
+#include <qsciscintilla.h>
+#include <QAction>
+#include <QMessageBox>
+#include <QElapsedTimer>
+#include <QSharedPointer>
+#ifdef WIN32
+#include <Windows.h>
+#endif
+
+#ifdef __cplusplus
+	extern "C" {
+#endif
+
+	NDD_EXPORT bool NDD_PROC_IDENTIFY(NDD_PROC_DATA* pProcData);
+	NDD_EXPORT int NDD_PROC_MAIN(QWidget* pNotepad, const QString& strFileName, std::function<QsciScintilla* (QWidget*)>getCurEdit, std::function<bool(QWidget*, int, void*)> pluginCallBack, NDD_PROC_DATA* procData);
+
+#ifdef __cplusplus
+	}
+#endif
+
+static NDD_PROC_DATA s_procData;
+static QWidget* s_pMainNotepad = nullptr;
+
+std::function<QsciScintilla* (QWidget*)> s_getCurEdit;
+std::function<bool(QWidget*, int, void*)> s_invokeMainFun;
+
+//正在执行的任务序号，再次点击时先取消它
+static int s_runningTaskId = -1;
+
+bool NDD_PROC_IDENTIFY(NDD_PROC_DATA* pProcData)
+{
+	if(pProcData == NULL)
+	{
+		return false;
+	}
+	pProcData->m_strPlugName = QObject::tr("Snapshot Bench Plug");
+	pProcData->m_strComment = QObject::tr(u8"在主程序线程池中处理文档快照的插件例子：删除行尾空白，并统计各步骤的耗时");
+
+	pProcData->m_version = QString("v1.0");
+	pProcData->m_auther = QString("ndd");
+
+	pProcData->m_menuType = 0;
+
+	return true;
+}
+
+//在工作线程中找出所有行尾的空格和制表符，每一处生成一个删除的修改
+static void findTrailingBlanks(const NDD_DOC_SNAPSHOT& snapshot, const std::atomic<bool>& isCancel, QVector<NDD_EDIT>& edits)
+{
+	const char* text = snapshot.data();
+	const qint64 length = snapshot.size();
+
+	qint64 lineStart = 0;
+	qint64 lines = 0;
+	while (lineStart < length)
+	{
+		//每处理一批行检查一次是否取消
+		if ((++lines & 0xfff) == 0 && isCancel)
+		{
+			return;
+		}
+
+		qint64 lineEnd = lineStart;
+		while (lineEnd < length && text[lineEnd] != '\r' && text[lineEnd] != '\n')
+		{
+			++lineEnd;
+		}
+
+		qint64 blankStart = lineEnd;
+		while (blankStart > lineStart && (text[blankStart - 1] == ' ' || text[blankStart - 1] == '\t'))
+		{
+			--blankStart;
+		}
+		if (blankStart < lineEnd)
+		{
+			edits.append(NDD_EDIT(blankStart, lineEnd - blankStart, QByteArray()));
+		}
+
+		lineStart = lineEnd;
+		if (lineStart < length && text[lineStart] == '\r')
+		{
+			++lineStart;
+		}
+		if (lineStart < length && text[lineStart] == '\n')
+		{
+			++lineStart;
+		}
+	}
+}
+
+//对比旧接口text()的复制，和快照+线程池+批量修改的耗时。界面线程中只有取快照和应用修改两步
+static void doMainWork()
+{
+	int apiVersion = 1;
+	if (!s_invokeMainFun(s_pMainNotepad, NDD_CMD_GET_API_VERSION, &apiVersion) || apiVersion < NDD_PLUGIN_API_VERSION)
+	{
+		QMessageBox::warning(s_pMainNotepad, QObject::tr("Snapshot Bench"), QObject::tr("The main program does not support document snapshots."));
+		return;
+	}
+
+	if (s_runningTaskId >= 0)
+	{
+		s_invokeMainFun(s_pMainNotepad, NDD_CMD_CANCEL_TASK, &s_runningTaskId);
+		s_runningTaskId = -1;
+	}
+
+	QsciScintilla* pEdit = s_getCurEdit(s_pMainNotepad);
+	if (pEdit == nullptr)
+	{
+		return;
+	}
+
+	QElapsedTimer timer;
+	timer.start();
+	QString oldCopy = pEdit->text();
+	qint64 textMs = timer.elapsed();
+	oldCopy.clear();
+
+	//快照和修改结果在工作线程、完成回调之间共享
+	QSharedPointer<NDD_EDIT_BATCH> batch(new NDD_EDIT_BATCH());
+	timer.restart();
+	if (!s_invokeMainFun(s_pMainNotepad, NDD_CMD_GET_SNAPSHOT, &batch->m_snapshot))
+	{
+		QMessageBox::warning(s_pMainNotepad, QObject::tr("Snapshot Bench"), QObject::tr("The mode of the current document does not allow this operation."));
+		return;
+	}
+	qint64 snapshotMs = timer.elapsed();
+
+	QSharedPointer<qint64> workMs(new qint64(0));
+
+	NDD_PLUGIN_TASK task;
+	task.m_work = [batch, workMs](const std::atomic<bool>& isCancel) {
+		QElapsedTimer workTimer;
+		workTimer.start();
+		findTrailingBlanks(batch->m_snapshot, isCancel, batch->m_edits);
+		*workMs = workTimer.elapsed();
+	};
+	task.m_finished = [batch, workMs, textMs, snapshotMs](bool isCancel) {
+		s_runningTaskId = -1;
+		if (isCancel)
+		{
+			return;
+		}
+
+		QElapsedTimer applyTimer;
+		applyTimer.start();
+		bool applied = s_invokeMainFun(s_pMainNotepad, NDD_CMD_APPLY_EDITS, batch.data());
+		qint64 applyMs = applyTimer.elapsed();
+
+		QString msg = QObject::tr("Document size: %1 bytes\ntext() copy on the UI thread: %2 ms\nSnapshot on the UI thread: %3 ms\nScan on a worker thread: %4 ms, %5 trailing blanks found\n")
+			.arg(batch->m_snapshot.size()).arg(textMs).arg(snapshotMs).arg(*workMs).arg(batch->m_edits.size());
+		if (applied)
+		{
+			msg += QObject::tr("Edits applied as one undo step on the UI thread: %1 ms").arg(applyMs);
+		}
+		else
+		{
+			msg += QObject::tr("The document changed during the scan, nothing applied.");
+		}
+		QMessageBox::information(s_pMainNotepad, QObject::tr("Snapshot Bench"), msg);
+	};
+
+	if (s_invokeMainFun(s_pMainNotepad, NDD_CMD_RUN_TASK, &task))
+	{
+		s_runningTaskId = task.m_taskId;
+	}
+}
+
+//pNotepad:就是CCNotepad的主界面指针
+//getCurEdit:获取当前编辑框。这个插件只在取快照前用它对比text()的耗时
+//pluginCallBack:回调主程序的功能，这里用到NDD_CMD_GET_SNAPSHOT、NDD_CMD_RUN_TASK、NDD_CMD_APPLY_EDITS
+int NDD_PROC_MAIN(QWidget* pNotepad, const QString &strFileName, std::function<QsciScintilla*(QWidget*)>getCurEdit, std::function<bool(QWidget*, int, void*)> pluginCallBack, NDD_PROC_DATA* pProcData)
+{
+	if (pProcData == nullptr)
+	{
+		return -1;
+	}
+
+	s_getCurEdit = getCurEdit;
+	s_invokeMainFun = pluginCallBack;
+
+	//务必拷贝一份pProcData，在外面会释放。
+	s_procData = *pProcData;
+	s_pMainNotepad = pNotepad;
+
+	QObject::connect(pProcData->m_pAction, &QAction::triggered, pNotepad, &doMainWork);
+
+	return 0;
+}
+
+#ifdef WIN32
+BOOL WINAPI DllMain(HINSTANCE hInst, DWORD fdwReason, LPVOID lpvReserved) {
+	switch (fdwReason) {
+	case DLL_PROCESS_ATTACH:
+	case DLL_THREAD_ATTACH:
+		break;
+	case DLL_THREAD_DETACH:
+		break;
+	case DLL_PROCESS_DETACH:
+		break;
+	}
+	return TRUE;
+}
+#endif
@@ -1,6 +1,10 @@
 ﻿#pragma once
 #include <QString>
 #include <QMenu>
+#include <QByteArray>
+#include <QVector>
+#include <functional>
+#include <atomic>
 
 struct ndd_proc_data
 {
@@ -27,3 +31,105 @@ typedef struct ndd_proc_data NDD_PROC_DATA;
 
 typedef bool (*NDD_PROC_IDENTIFY_CALLBACK)(NDD_PROC_DATA* pProcData);
 typedef void (*NDD_PROC_FOUND_CALLBACK)(NDD_PROC_DATA* pProcData, void* pUserData);
+
+//插件通过pluginCallBack调用主程序功能的cmdId。数值固定后不能修改，否则会引发兼容性问题。
+//旧版本的主程序不认识的cmdId返回false，插件可以先用NDD_CMD_GET_API_VERSION判断主程序是否支持
+enum NddPluginCmd
+{
+	NDD_CMD_NEW_FILE = 1,//新建文件。data：QVariant*，可为空，回传新文件的名称
+	NDD_CMD_SET_LANG = 2,//设置当前文档的语言。data：int*，0 js 1 json 2 html
+	NDD_CMD_GET_SNAPSHOT = 3,//取当前文档的只读快照。data：NDD_DOC_SNAPSHOT*
+	NDD_CMD_RUN_TASK = 4,//在主程序的线程池中执行任务。data：NDD_PLUGIN_TASK*，返回时填写了m_taskId
+	NDD_CMD_CANCEL_TASK = 5,//取消任务。data：int*，任务序号
+	NDD_CMD_APPLY_EDITS = 6,//把基于快照的一批修改一次应用到文档。data：NDD_EDIT_BATCH*
+	NDD_CMD_GET_API_VERSION = 7,//data：int*，回传NDD_PLUGIN_API_VERSION
+};
+
+//支持快照、线程池和批量修改的插件接口版本
+#define NDD_PLUGIN_API_VERSION 2
+
+//文档的只读快照：整个文档的UTF-8文本，一块连续的内存。取快照时复制一次，
+//之后在任意线程中读取，或者交给其他任务，都是共享这一块内存，不再复制
+struct ndd_doc_snapshot
+{
+	QByteArray m_text;//文档内容。主程序填写
+	QWidget* m_editor;//快照所属的编辑框，只用来标识文档，不要在工作线程中访问。主程序填写
+	quint64 m_docId;//文档在进程内唯一的编号，编辑框关闭后地址可能被新的编辑框重用，用它区分。主程序填写
+	quint64 m_version;//取快照时文档的修改次数，应用修改时用来判断文档是否变了。主程序填写
+
+	ndd_doc_snapshot() : m_editor(nullptr), m_docId(0), m_version(0)
+	{
+
+	}
+
+	const char* data() const
+	{
+		return m_text.constData();
+	}
+
+	qint64 size() const
+	{
+		return m_text.size();
+	}
+
+	//[start, end)的字节，不复制，只在快照存在期间有效
+	QByteArray range(qint64 start, qint64 end) const
+	{
+		return QByteArray::fromRawData(m_text.constData() + start, static_cast<int>(end - start));
+	}
+};
+
+typedef struct ndd_doc_snapshot NDD_DOC_SNAPSHOT;
+
+//在主程序线程池中执行的插件任务
+struct ndd_plugin_task
+{
+	//在工作线程中执行。isCancel变为true时应尽快返回；不能访问界面对象。插件里面需填写
+	std::function<void(const std::atomic<bool>& isCancel)> m_work;
+	//m_work返回后在界面线程中执行，isCancel表示任务被取消过。可为空；插件里面需填写
+	std::function<void(bool isCancel)> m_finished;
+	int m_taskId;//任务序号，用于NDD_CMD_CANCEL_TASK。主程序填写
+
+	ndd_plugin_task() : m_taskId(-1)
+	{
+
+	}
+};
+
+typedef struct ndd_plugin_task NDD_PLUGIN_TASK;
+
+//一处修改：把快照中[m_pos, m_pos + m_removeLength)替换为m_text
+struct ndd_edit
+{
+	qint64 m_pos;
+	qint64 m_removeLength;
+	QByteArray m_text;//UTF-8，不能包含'\0'
+
+	ndd_edit() : m_pos(0), m_removeLength(0)
+	{
+
+	}
+
+	ndd_edit(qint64 pos, qint64 removeLength, const QByteArray& text) : m_pos(pos), m_removeLength(removeLength), m_text(text)
+	{
+
+	}
+};
+
+typedef struct ndd_edit NDD_EDIT;
+
+//基于同一个快照的一批修改，作为一次修改、一个撤销步骤应用到文档。
+//取快照以后文档被修改过或者已经关闭、修改的文本中含有'\0'时都不应用，pluginCallBack返回false
+struct ndd_edit_batch
+{
+	NDD_DOC_SNAPSHOT m_snapshot;//修改基于的快照。插件里面需填写
+	QVector<NDD_EDIT> m_edits;//按位置从小到大，互不重叠。插件里面需填写
+	qint64 m_lengthChange;//应用后文档长度的变化。主程序填写
+
+	ndd_edit_batch() : m_lengthChange(0)
+	{
+
+	}
+};
+
+typedef struct ndd_edit_batch NDD_EDIT_BATCH;
@@ -0,0 +1,108 @@
+﻿#include "plugintaskpool.h"
+
+#include <QCoreApplication>
+#include <QThread>
+#include <QtConcurrent>
+#include <algorithm>
+
+struct PluginTask
+{
+	std::atomic<bool> isCancel;
+	int taskId;
+	std::function<void(const std::atomic<bool>&)> work;
+	std::function<void(bool)> finished;
+
+	PluginTask() : isCancel(false), taskId(0)
+	{
+	}
+};
+
+PluginTaskPool* PluginTaskPool::s_instance = nullptr;
+
+PluginTaskPool* PluginTaskPool::getInstance()
+{
+	//跟随qApp释放，退出时还在执行的任务在析构中等待结束
+	if (s_instance == nullptr)
+	{
+		s_instance = new PluginTaskPool(qApp);
+	}
+	return s_instance;
+}
+
+PluginTaskPool::PluginTaskPool(QObject* parent) : QObject(parent), m_nextTaskId(0)
+{
+	//留一个核给界面线程
+	m_pool.setMaxThreadCount(std::max(QThread::idealThreadCount() - 1, 1));
+
+	connect(this, &PluginTaskPool::signInnerFinished, this, &PluginTaskPool::slot_innerFinished, Qt::QueuedConnection);
+}
+
+PluginTaskPool::~PluginTaskPool()
+{
+	cancelAll();
+	m_pool.waitForDone();
+	s_instance = nullptr;
+}
+
+int PluginTaskPool::start(const NDD_PLUGIN_TASK& task)
+{
+	QSharedPointer<PluginTask> pluginTask(new PluginTask());
+	pluginTask->taskId = ++m_nextTaskId;
+	pluginTask->work = task.m_work;
+	pluginTask->finished = task.m_finished;
+
+	m_tasks.insert(pluginTask->taskId, pluginTask);
+	QtConcurrent::run(&m_pool, &PluginTaskPool::runTask, pluginTask, this);
+	return pluginTask->taskId;
+}
+
+bool PluginTaskPool::cancel(int taskId)
+{
+	QSharedPointer<PluginTask> task = m_tasks.value(taskId);
+	if (task.isNull())
+	{
+		return false;
+	}
+	task->isCancel = true;
+	return true;
+}
+
+void PluginTaskPool::cancelAll()
+{
+	for (const QSharedPointer<PluginTask>& task : m_tasks)
+	{
+		task->isCancel = true;
+	}
+}
+
+//插件的代码抛出异常时不能让工作线程退出
+void PluginTaskPool::runTask(QSharedPointer<PluginTask> task, PluginTaskPool* pool)
+{
+	if (!task->isCancel && task->work)
+	{
+		try {
+			task->work(task->isCancel);
+		}
+		catch (...)
+		{
+			task->isCancel = true;
+		}
+	}
+	emit pool->signInnerFinished(task->taskId);
+}
+
+void PluginTaskPool::slot_innerFinished(int taskId)
+{
+	QSharedPointer<PluginTask> task = m_tasks.take(taskId);
+	if (task.isNull() || !task->finished)
+	{
+		return;
+	}
+
+	try {
+		task->finished(task->isCancel);
+	}
+	catch (...)
+	{
+	}
+}
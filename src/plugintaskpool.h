@@ -0,0 +1,46 @@
+﻿#pragma once
+
+#include <QObject>
+#include <QHash>
+#include <QSharedPointer>
+#include <QThreadPool>
+#include "pluginGl.h"
+
+struct PluginTask;
+
+//执行插件任务的线程池。与QThreadPool::globalInstance()分开，插件的耗时任务不会占满主程序自己后台工作用的线程。
+//任务在工作线程中执行，完成后的回调在界面线程中执行。程序退出时取消所有任务并等待结束
+class PluginTaskPool : public QObject
+{
+	Q_OBJECT
+
+public:
+	static PluginTaskPool* getInstance();
+	virtual ~PluginTaskPool();
+
+	//返回任务序号
+	int start(const NDD_PLUGIN_TASK& task);
+	bool cancel(int taskId);
+	void cancelAll();
+
+signals:
+	void signInnerFinished(int taskId);
+
+private slots:
+	void slot_innerFinished(int taskId);
+
+private:
+	PluginTaskPool(QObject* parent);
+
+	static void runTask(QSharedPointer<PluginTask> task, PluginTaskPool* pool);
+
+	PluginTaskPool(const PluginTaskPool&) = delete;
+	PluginTaskPool& operator=(const PluginTaskPool&) = delete;
+
+	static PluginTaskPool* s_instance;
+
+	QThreadPool m_pool;
+	//还没有回调完成的任务
+	QHash<int, QSharedPointer<PluginTask>> m_tasks;
+	int m_nextTaskId;
+};
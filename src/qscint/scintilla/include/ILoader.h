@@ -18,4 +18,13 @@ public:
 	virtual void * SCI_METHOD ConvertToDocument() = 0;
 };
 
+// Read-only text such as a mapped file that a document refers to instead of copying it.
+// Data must stay valid and unchanged until the document calls Release.
+class IMappedText {
+public:
+	virtual void SCI_METHOD Release() = 0;
+	virtual const char * SCI_METHOD Data() const = 0;
+	virtual Sci_Position SCI_METHOD Length() const = 0;
+};
+
 #endif
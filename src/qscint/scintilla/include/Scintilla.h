@@ -432,6 +432,12 @@ typedef sptr_t (*SciFnDirect)(sptr_t ptr, unsigned int iMessage, uptr_t wParam,
 #define SCI_CANPASTE 2173
 #define SCI_CANUNDO 2174
 #define SCI_EMPTYUNDOBUFFER 2175
+#define SCI_SETUNDOMEMORYBUDGET 2719
+#define SCI_GETUNDOMEMORYBUDGET 2720
+#define SCI_SETUNDOCOMPRESSION 2721
+#define SCI_GETUNDOCOMPRESSION 2722
+#define SCI_GETUNDOMEMORY 2723
+#define SCI_GETUNDOSPILLEDMEMORY 2724
 #define SCI_UNDO 2176
 #define SCI_CUT 2177
 #define SCI_COPY 2178
@@ -457,6 +463,7 @@ typedef sptr_t (*SciFnDirect)(sptr_t ptr, unsigned int iMessage, uptr_t wParam,
 #define SCI_TARGETWHOLEDOCUMENT 2690
 #define SCI_REPLACETARGET 2194
 #define SCI_REPLACETARGETRE 2195
+#define SCI_REPLACERANGES 2729
 #define SCI_SEARCHINTARGET 2197
 #define SCI_SETSEARCHFLAGS 2198
 #define SCI_GETSEARCHFLAGS 2199
@@ -501,6 +508,8 @@ typedef sptr_t (*SciFnDirect)(sptr_t ptr, unsigned int iMessage, uptr_t wParam,
 #define SCI_FOLDCHILDREN 2238
 #define SCI_EXPANDCHILDREN 2239
 #define SCI_FOLDALL 2662
+#define SCI_FOLDATLEVEL 2730
+#define SCI_FOLDATDEPTH 2731
 #define SCI_ENSUREVISIBLE 2232
 #define SC_AUTOMATICFOLD_SHOW 0x0001
 #define SC_AUTOMATICFOLD_CLICK 0x0002
@@ -529,6 +538,7 @@ typedef sptr_t (*SciFnDirect)(sptr_t ptr, unsigned int iMessage, uptr_t wParam,
 #define SC_IDLESTYLING_TOVISIBLE 1
 #define SC_IDLESTYLING_AFTERVISIBLE 2
 #define SC_IDLESTYLING_ALL 3
+#define SC_IDLESTYLING_BACKGROUND 4
 #define SCI_SETIDLESTYLING 2692
 #define SCI_GETIDLESTYLING 2693
 #define SC_WRAP_NONE 0
@@ -850,6 +860,22 @@ typedef sptr_t (*SciFnDirect)(sptr_t ptr, unsigned int iMessage, uptr_t wParam,
 #define SCI_COPYALLOWLINE 2519
 #define SCI_GETCHARACTERPOINTER 2520
 #define SCI_GETRANGEPOINTER 2643
+#define SCI_SETMAPPEDTEXT 2725
+#define SCI_REBASEMAPPEDTEXT 2726
+#define SCI_GETTEXTMAPPED 2727
+#define SCI_GETMAPPEDMEMORY 2728
+#define SC_MEMORY_TEXT 0
+#define SC_MEMORY_STYLES 1
+#define SC_MEMORY_LINES 2
+#define SC_MEMORY_MARKERS 3
+#define SC_MEMORY_LINEDATA 4
+#define SC_MEMORY_INDICATORS 5
+#define SC_MEMORY_UNDO 6
+#define SC_MEMORY_LAYOUT 7
+#define SCI_GETMEMORYUSAGE 2732
+#define SC_RELEASE_CACHES 0
+#define SC_RELEASE_STYLES 1
+#define SCI_RELEASEMEMORY 2733
 #define SCI_GETGAPPOSITION 2644
 #define SCI_INDICSETALPHA 2523
 #define SCI_INDICGETALPHA 2524
@@ -0,0 +1,253 @@
+// Scintilla source code edit control
+/** @file BackgroundLexer.cxx
+ ** Lexes and folds a copy of part of a document on a worker thread.
+ **/
+// The License.txt file describes the conditions under which this software may be distributed.
+
+#include <cstddef>
+#include <cstring>
+
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <memory>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+
+#include "Platform.h"
+
+#include "ILexer.h"
+#include "Scintilla.h"
+
+#include "Position.h"
+#include "BackgroundLexer.h"
+
+using namespace Scintilla;
+
+LexSnapshot::LexSnapshot() : textStart(0), lineFirst(0), endStyled(0), codePage(0), tabInChars(8) {
+	std::fill(dbcsLeadBytes, std::end(dbcsLeadBytes), false);
+}
+
+LexSnapshot::~LexSnapshot() {
+}
+
+Sci::Line LexSnapshot::LineLast() const noexcept {
+	return lineFirst + static_cast<Sci::Line>(lineStarts.size()) - 1;
+}
+
+int SCI_METHOD LexSnapshot::Version() const {
+	return dvOriginal;
+}
+
+void SCI_METHOD LexSnapshot::SetErrorStatus(int) {
+}
+
+Sci_Position SCI_METHOD LexSnapshot::Length() const {
+	return textStart + static_cast<Sci::Position>(text.length());
+}
+
+void SCI_METHOD LexSnapshot::GetCharRange(char *buffer, Sci_Position position, Sci_Position lengthRetrieve) const {
+	for (Sci_Position i = 0; i < lengthRetrieve; i++) {
+		const Sci::Position offset = position + i - textStart;
+		buffer[i] = (offset >= 0 && offset < static_cast<Sci::Position>(text.length())) ? text[offset] : '\0';
+	}
+}
+
+char SCI_METHOD LexSnapshot::StyleAt(Sci_Position position) const {
+	const Sci::Position offset = position - textStart;
+	if (offset >= 0 && offset < static_cast<Sci::Position>(styles.size()))
+		return styles[offset];
+	return 0;
+}
+
+Sci_Position SCI_METHOD LexSnapshot::LineFromPosition(Sci_Position position) const {
+	if (position < textStart)
+		return (lineFirst > 0) ? lineFirst - 1 : 0;
+	const std::vector<Sci::Position>::const_iterator it = std::upper_bound(lineStarts.begin(), lineStarts.end(), position);
+	return lineFirst + (it - lineStarts.begin()) - 1;
+}
+
+Sci_Position SCI_METHOD LexSnapshot::LineStart(Sci_Position line) const {
+	// Lines before the copy start where the copy starts, lines after it at its end
+	if (line <= lineFirst)
+		return textStart;
+	const Sci::Line index = line - lineFirst;
+	if (index < static_cast<Sci::Line>(lineStarts.size()))
+		return lineStarts[index];
+	return Length();
+}
+
+int SCI_METHOD LexSnapshot::GetLevel(Sci_Position line) const {
+	const Sci::Line index = line - (lineFirst - 1);
+	if (index >= 0 && index < static_cast<Sci::Line>(levels.size()))
+		return levels[index];
+	return SC_FOLDLEVELBASE;
+}
+
+int SCI_METHOD LexSnapshot::SetLevel(Sci_Position line, int level) {
+	const Sci::Line index = line - (lineFirst - 1);
+	if (index >= 0 && index < static_cast<Sci::Line>(levels.size())) {
+		const int prev = levels[index];
+		// Same as Document::SetLevel
+		levels[index] = level & ~SC_FOLDLEVELWHITEFLAG;
+		return prev;
+	}
+	return SC_FOLDLEVELBASE;
+}
+
+int SCI_METHOD LexSnapshot::GetLineState(Sci_Position line) const {
+	const Sci::Line index = line - (lineFirst - 1);
+	if (index >= 0 && index < static_cast<Sci::Line>(lineStates.size()))
+		return lineStates[index];
+	return 0;
+}
+
+int SCI_METHOD LexSnapshot::SetLineState(Sci_Position line, int state) {
+	const Sci::Line index = line - (lineFirst - 1);
+	if (index >= 0 && index < static_cast<Sci::Line>(lineStates.size())) {
+		const int prev = lineStates[index];
+		lineStates[index] = state;
+		return prev;
+	}
+	return 0;
+}
+
+void SCI_METHOD LexSnapshot::StartStyling(Sci_Position position, char) {
+	endStyled = position;
+}
+
+bool SCI_METHOD LexSnapshot::SetStyleFor(Sci_Position length, char style) {
+	for (Sci_Position i = 0; i < length; i++, endStyled++) {
+		const Sci::Position offset = endStyled - textStart;
+		if (offset >= 0 && offset < static_cast<Sci::Position>(styles.size()))
+			styles[offset] = style;
+	}
+	return true;
+}
+
+bool SCI_METHOD LexSnapshot::SetStyles(Sci_Position length, const char *styles_) {
+	for (Sci_Position i = 0; i < length; i++, endStyled++) {
+		const Sci::Position offset = endStyled - textStart;
+		if (offset >= 0 && offset < static_cast<Sci::Position>(styles.size()))
+			styles[offset] = styles_[i];
+	}
+	return true;
+}
+
+// Indicators and lexer state changes only matter to the document so are dropped.
+void SCI_METHOD LexSnapshot::DecorationSetCurrentIndicator(int) {
+}
+
+void SCI_METHOD LexSnapshot::DecorationFillRange(Sci_Position, int, Sci_Position) {
+}
+
+void SCI_METHOD LexSnapshot::ChangeLexerState(Sci_Position, Sci_Position) {
+}
+
+int SCI_METHOD LexSnapshot::CodePage() const {
+	return codePage;
+}
+
+bool SCI_METHOD LexSnapshot::IsDBCSLeadByte(char ch) const {
+	return dbcsLeadBytes[static_cast<unsigned char>(ch)];
+}
+
+// The snapshot does not start at position 0 so there is no pointer that callers can index
+// with document positions. Lexers that need BufferPointer are never run in the background.
+const char * SCI_METHOD LexSnapshot::BufferPointer() {
+	return nullptr;
+}
+
+int SCI_METHOD LexSnapshot::GetLineIndentation(Sci_Position line) {
+	int indent = 0;
+	for (Sci::Position i = LineStart(line); i < Length(); i++) {
+		const char ch = text[i - textStart];
+		if (ch == ' ')
+			indent++;
+		else if (ch == '\t')
+			indent = (indent / tabInChars + 1) * tabInChars;
+		else
+			break;
+	}
+	return indent;
+}
+
+BackgroundLexer::BackgroundLexer() : instance(nullptr), generation(-1), lexing(false), quit(false) {
+}
+
+BackgroundLexer::~BackgroundLexer() {
+	{
+		std::lock_guard<std::mutex> guard(mutex);
+		quit = true;
+	}
+	cond.notify_all();
+	if (worker.joinable())
+		worker.join();
+	if (instance)
+		instance->Release();
+}
+
+bool BackgroundLexer::Busy() {
+	std::lock_guard<std::mutex> guard(mutex);
+	return queued || lexing;
+}
+
+// Only replace the lexer while the worker is not using it.
+bool BackgroundLexer::SetInstance(ILexer *instance_, int generation_) {
+	std::lock_guard<std::mutex> guard(mutex);
+	if (queued || lexing)
+		return false;
+	if (instance)
+		instance->Release();
+	instance = instance_;
+	generation = generation_;
+	finished.reset();
+	return true;
+}
+
+void BackgroundLexer::Submit(std::unique_ptr<BackgroundLexJob> job) {
+	{
+		std::lock_guard<std::mutex> guard(mutex);
+		queued = std::move(job);
+		if (!worker.joinable())
+			worker = std::thread(&BackgroundLexer::Run, this);
+	}
+	cond.notify_one();
+}
+
+// A job already being lexed can not be stopped but its result is thrown away.
+void BackgroundLexer::Cancel() {
+	std::lock_guard<std::mutex> guard(mutex);
+	queued.reset();
+	finished.reset();
+}
+
+std::unique_ptr<BackgroundLexJob> BackgroundLexer::TakeFinished() {
+	std::lock_guard<std::mutex> guard(mutex);
+	return std::move(finished);
+}
+
+void BackgroundLexer::Run() {
+	std::unique_lock<std::mutex> lock(mutex);
+	for (;;) {
+		cond.wait(lock, [this] { return quit || queued; });
+		if (quit)
+			return;
+		std::unique_ptr<BackgroundLexJob> job = std::move(queued);
+		ILexer *lexer = instance;
+		lexing = true;
+		lock.unlock();
+
+		const Sci_Position len = job->end - job->start;
+		if (lexer && len > 0) {
+			lexer->Lex(job->start, len, job->initStyle, &job->snapshot);
+			lexer->Fold(job->start, len, job->initStyle, &job->snapshot);
+		}
+
+		lock.lock();
+		lexing = false;
+		if (!queued)
+			finished = std::move(job);
+	}
+}
@@ -0,0 +1,116 @@
+// Scintilla source code edit control
+/** @file BackgroundLexer.h
+ ** Lexes and folds a copy of part of a document on a worker thread.
+ **/
+// The License.txt file describes the conditions under which this software may be distributed.
+
+#ifndef BACKGROUNDLEXER_H
+#define BACKGROUNDLEXER_H
+
+namespace Scintilla {
+
+/**
+ * A copy of a range of a document that a lexer can work on without touching the document.
+ * Some lines before the range being lexed are included for lexers that look back and the
+ * copy continues a little after the range for lexers that look ahead.
+ * To the lexer the document appears to end at the end of the copied text.
+ */
+class LexSnapshot : public IDocument {
+public:
+	Sci::Position textStart;
+	std::string text;
+	std::vector<char> styles;
+	Sci::Line lineFirst;
+	std::vector<Sci::Position> lineStarts;	///< Starts of the lines from lineFirst that start in the text
+	std::vector<int> lineStates;	///< From lineFirst - 1 to one line after the last line
+	std::vector<int> levels;	///< Same lines as lineStates
+	Sci::Position endStyled;
+	int codePage;
+	int tabInChars;
+	bool dbcsLeadBytes[256];
+
+	LexSnapshot();
+	// Deleted so LexSnapshot objects can not be copied.
+	LexSnapshot(const LexSnapshot &) = delete;
+	LexSnapshot(LexSnapshot &&) = delete;
+	LexSnapshot &operator=(const LexSnapshot &) = delete;
+	LexSnapshot &operator=(LexSnapshot &&) = delete;
+	virtual ~LexSnapshot();
+
+	Sci::Line LineLast() const noexcept;
+	int SCI_METHOD Version() const override;
+	void SCI_METHOD SetErrorStatus(int status) override;
+	Sci_Position SCI_METHOD Length() const override;
+	void SCI_METHOD GetCharRange(char *buffer, Sci_Position position, Sci_Position lengthRetrieve) const override;
+	char SCI_METHOD StyleAt(Sci_Position position) const override;
+	Sci_Position SCI_METHOD LineFromPosition(Sci_Position position) const override;
+	Sci_Position SCI_METHOD LineStart(Sci_Position line) const override;
+	int SCI_METHOD GetLevel(Sci_Position line) const override;
+	int SCI_METHOD SetLevel(Sci_Position line, int level) override;
+	int SCI_METHOD GetLineState(Sci_Position line) const override;
+	int SCI_METHOD SetLineState(Sci_Position line, int state) override;
+	void SCI_METHOD StartStyling(Sci_Position position, char mask) override;
+	bool SCI_METHOD SetStyleFor(Sci_Position length, char style) override;
+	bool SCI_METHOD SetStyles(Sci_Position length, const char *styles_) override;
+	void SCI_METHOD DecorationSetCurrentIndicator(int indicator) override;
+	void SCI_METHOD DecorationFillRange(Sci_Position position, int value, Sci_Position fillLength) override;
+	void SCI_METHOD ChangeLexerState(Sci_Position start, Sci_Position end) override;
+	int SCI_METHOD CodePage() const override;
+	bool SCI_METHOD IsDBCSLeadByte(char ch) const override;
+	const char * SCI_METHOD BufferPointer() override;
+	int SCI_METHOD GetLineIndentation(Sci_Position line) override;
+};
+
+/**
+ * One piece of work for the background lexer: lex and fold [start, end) of the snapshot.
+ * version and endStyled record the document state when the snapshot was taken so stale
+ * results can be dropped.
+ */
+struct BackgroundLexJob {
+	LexSnapshot snapshot;
+	Sci::Position start;
+	Sci::Position end;
+	int initStyle;
+	int version;
+	Sci::Position endStyled;
+	BackgroundLexJob() noexcept : start(0), end(0), initStyle(0), version(0), endStyled(0) {
+	}
+};
+
+/**
+ * Owns a worker thread and a separate lexer instance configured like the document's lexer.
+ * At most one job is queued or running at a time; the finished job waits until the
+ * document takes it on the UI thread.
+ */
+class BackgroundLexer {
+	std::mutex mutex;
+	std::condition_variable cond;
+	std::thread worker;
+	ILexer *instance;
+	int generation;
+	std::unique_ptr<BackgroundLexJob> queued;
+	std::unique_ptr<BackgroundLexJob> finished;
+	bool lexing;
+	bool quit;
+	void Run();
+public:
+	BackgroundLexer();
+	// Deleted so BackgroundLexer objects can not be copied.
+	BackgroundLexer(const BackgroundLexer &) = delete;
+	BackgroundLexer(BackgroundLexer &&) = delete;
+	BackgroundLexer &operator=(const BackgroundLexer &) = delete;
+	BackgroundLexer &operator=(BackgroundLexer &&) = delete;
+	~BackgroundLexer();
+
+	bool Busy();
+	bool HasInstance() const noexcept { return instance != nullptr; }
+	int Generation() const noexcept { return generation; }
+	bool SetInstance(ILexer *instance_, int generation_);
+	void Submit(std::unique_ptr<BackgroundLexJob> job);
+	void Cancel();
+	std::unique_ptr<BackgroundLexJob> TakeFinished();
+};
+
+}
+
+#endif
@@ -0,0 +1,332 @@
+// Scintilla source code edit control
+/** @file BackgroundWrap.cxx
+ ** Wraps copies of lines on a pool of worker threads.
+ **/
+// The License.txt file describes the conditions under which this software may be distributed.
+
+#include <cstddef>
+#include <cstdlib>
+#include <cassert>
+#include <cstring>
+#include <cmath>
+
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include <map>
+#include <deque>
+#include <forward_list>
+#include <algorithm>
+#include <iterator>
+#include <limits>
+#include <memory>
+#include <chrono>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+
+#include "Platform.h"
+
+#include "ILoader.h"
+#include "ILexer.h"
+#include "Scintilla.h"
+
+#include "CharacterSet.h"
+#include "Position.h"
+#include "UniqueString.h"
+#include "SplitVector.h"
+#include "Partitioning.h"
+#include "RunStyles.h"
+#include "ContractionState.h"
+#include "CellBuffer.h"
+#include "PerLine.h"
+#include "KeyMap.h"
+#include "Indicator.h"
+#include "LineMarker.h"
+#include "Style.h"
+#include "ViewStyle.h"
+#include "CharClassify.h"
+#include "Decoration.h"
+#include "CaseFolder.h"
+#include "Document.h"
+#include "UniConversion.h"
+#include "Selection.h"
+#include "PositionCache.h"
+#include "EditModel.h"
+#include "MarginView.h"
+#include "EditView.h"
+#include "BackgroundWrap.h"
+
+using namespace Scintilla;
+
+WrapSettings::WrapSettings(const ViewStyle &vs, const SpecialRepresentations &reprs_, const Document *pdoc,
+	int wrapWidth_, int tabWidthMinimumPixels_, int technology_, size_t copies) :
+	reprs(reprs_), wrapWidth(wrapWidth_), tabWidthMinimumPixels(tabWidthMinimumPixels_), technology(technology_),
+	codePage(pdoc->dbcsCodePage), tabInChars(pdoc->tabInChars), indentInChars(pdoc->IndentSize()),
+	aveCharWidth(vs.aveCharWidth), spaceWidth(vs.spaceWidth), measuredAlike(true) {
+	for (size_t copy = 0; copy < copies; copy++) {
+		viewStyles.push_back(std::unique_ptr<ViewStyle>(new ViewStyle(vs)));
+	}
+}
+
+WrapSettings::~WrapSettings() {
+}
+
+namespace {
+
+/**
+ * A worker's own document, view and fonts. Each line is copied into the document by itself
+ * so the worker does not have to treat the same characters as line ends as the editor does.
+ * The worker's position cache is only used on its thread.
+ */
+class WrapLayout : public EditModel {
+	EditView view;
+	std::unique_ptr<Surface> surface;
+	std::unique_ptr<ViewStyle> vs;
+	std::unique_ptr<LineLayout> ll;
+	std::shared_ptr<WrapSettings> settings;
+	bool measuredAlike;
+public:
+	WrapLayout() : measuredAlike(false) {
+		pdoc->SetUndoCollection(false);
+	}
+	Sci::Line TopLineOfMain() const override {
+		return 0;
+	}
+	Point GetVisibleOriginInMain() const override {
+		return Point();
+	}
+	Sci::Line LinesOnScreen() const override {
+		return 1;
+	}
+	Range GetHotSpotRange() const override {
+		return Range(Sci::invalidPosition);
+	}
+	bool NeedsSettings(const std::shared_ptr<WrapSettings> &settings_) const noexcept {
+		return settings != settings_;
+	}
+	// Give the view style copy back so a worker started later for the same settings can take it.
+	// Called with the wrapper's lock held as the copies are shared by the workers.
+	void ReturnViewStyle() {
+		if (settings && vs)
+			settings->viewStyles.push_back(std::move(vs));
+		settings.reset();
+	}
+	void Wrap(BackgroundWrapJob &job, std::unique_ptr<ViewStyle> vsNew);
+};
+
+void WrapLayout::Wrap(BackgroundWrapJob &job, std::unique_ptr<ViewStyle> vsNew) {
+	if (settings != job.settings) {
+		settings = job.settings;
+		vs = std::move(vsNew);
+		measuredAlike = false;
+		if (vs) {
+			reprs = settings->reprs;
+			view.tabWidthMinimumPixels = settings->tabWidthMinimumPixels;
+			view.posCache.Clear();
+			pdoc->SetDBCSCodePage(settings->codePage);
+			pdoc->tabInChars = settings->tabInChars;
+			pdoc->actualIndentInChars = settings->indentInChars;
+			surface.reset(Surface::Allocate(settings->technology));
+			surface->Init(static_cast<WindowID>(nullptr));
+			surface->SetUnicodeMode(SC_CP_UTF8 == settings->codePage);
+			surface->SetDBCSMode(settings->codePage);
+			vs->Refresh(*surface, settings->tabInChars);
+			measuredAlike = (vs->aveCharWidth == settings->aveCharWidth) &&
+				(vs->spaceWidth == settings->spaceWidth);
+		}
+	}
+	if (!measuredAlike) {
+		job.measuredAlike = false;
+		return;
+	}
+
+	for (size_t line = 0; line < job.lines.size(); line++) {
+		const Sci::Position start = job.lineStarts[line];
+		const Sci::Position length = job.lineStarts[line + 1] - start;
+		pdoc->DeleteChars(0, pdoc->Length());
+		pdoc->InsertString(0, job.text.c_str() + start, length);
+		pdoc->StartStyling(0, '\377');
+		pdoc->SetStyles(length, reinterpret_cast<const char *>(job.styles.data() + start));
+		if (!ll || (ll->maxLineLength < length)) {
+			ll.reset(new LineLayout(static_cast<int>(length)));
+		}
+		ll->Invalidate(LineLayout::llInvalid);
+		view.LayoutLine(*this, 0, surface.get(), *vs, ll.get(), settings->wrapWidth);
+		job.lines[line] = ll->lines;
+	}
+}
+
+// A worker with no jobs for this long exits, another is started when jobs are submitted again.
+constexpr std::chrono::seconds workerIdleTimeout(5);
+
+}
+
+BackgroundWrapper::BackgroundWrapper() : quit(false) {
+}
+
+BackgroundWrapper::~BackgroundWrapper() {
+	{
+		std::lock_guard<std::mutex> guard(mutex);
+		quit = true;
+	}
+	cond.notify_all();
+	for (std::thread &worker : workers) {
+		worker.join();
+	}
+}
+
+// Leave a core for the UI thread.
+size_t BackgroundWrapper::WorkerCount() {
+	const size_t cores = std::thread::hardware_concurrency();
+	return std::min<size_t>(std::max<size_t>(cores, 2), 9) - 1;
+}
+
+// Number of jobs waiting for or being wrapped by a worker.
+size_t BackgroundWrapper::Working() {
+	std::lock_guard<std::mutex> guard(mutex);
+	return queued.size() + running.size();
+}
+
+bool BackgroundWrapper::HasJobs() {
+	std::lock_guard<std::mutex> guard(mutex);
+	return !queued.empty() || !running.empty() || !finished.empty();
+}
+
+// The end of the run of jobs that starts at line.
+Sci::Line BackgroundWrapper::JobsEnd(Sci::Line line) {
+	std::lock_guard<std::mutex> guard(mutex);
+	bool found = true;
+	while (found) {
+		found = false;
+		for (const std::unique_ptr<BackgroundWrapJob> &job : queued) {
+			if (job->lineFirst == line) {
+				line = job->LineEnd();
+				found = true;
+			}
+		}
+		for (const BackgroundWrapJob *job : running) {
+			if (!job->cancelled && (job->lineFirst == line)) {
+				line = job->LineEnd();
+				found = true;
+			}
+		}
+		for (const std::unique_ptr<BackgroundWrapJob> &job : finished) {
+			if (job->lineFirst == line) {
+				line = job->LineEnd();
+				found = true;
+			}
+		}
+	}
+	return line;
+}
+
+// The first line of the first job starting at or after line.
+Sci::Line BackgroundWrapper::JobAfter(Sci::Line line) {
+	std::lock_guard<std::mutex> guard(mutex);
+	Sci::Line lineJob = std::numeric_limits<Sci::Line>::max();
+	for (const std::unique_ptr<BackgroundWrapJob> &job : queued) {
+		if (job->lineFirst >= line)
+			lineJob = std::min(lineJob, job->lineFirst);
+	}
+	for (const BackgroundWrapJob *job : running) {
+		if (!job->cancelled && (job->lineFirst >= line))
+			lineJob = std::min(lineJob, job->lineFirst);
+	}
+	for (const std::unique_ptr<BackgroundWrapJob> &job : finished) {
+		if (job->lineFirst >= line)
+			lineJob = std::min(lineJob, job->lineFirst);
+	}
+	return lineJob;
+}
+
+void BackgroundWrapper::Submit(std::unique_ptr<BackgroundWrapJob> job) {
+	std::vector<std::thread> finishedWorkers;
+	{
+		std::lock_guard<std::mutex> guard(mutex);
+		for (const std::thread::id &id : exited) {
+			std::vector<std::thread>::iterator it = std::find_if(workers.begin(), workers.end(),
+				[id](const std::thread &worker) { return worker.get_id() == id; });
+			if (it != workers.end()) {
+				finishedWorkers.push_back(std::move(*it));
+				workers.erase(it);
+			}
+		}
+		exited.clear();
+		queued.push_back(std::move(job));
+		if (workers.size() < WorkerCount())
+			workers.push_back(std::thread(&BackgroundWrapper::Run, this));
+	}
+	cond.notify_one();
+	// These have already left Run so only have their layout to free
+	for (std::thread &worker : finishedWorkers) {
+		worker.join();
+	}
+}
+
+// The lines in [lineStart, lineEnd) have changed or moved so their jobs are out of date.
+// A job already being wrapped can not be stopped but its result is thrown away.
+void BackgroundWrapper::Invalidate(Sci::Line lineStart, Sci::Line lineEnd) {
+	std::lock_guard<std::mutex> guard(mutex);
+	auto overlaps = [lineStart, lineEnd](const std::unique_ptr<BackgroundWrapJob> &job) {
+		return (job->lineFirst < lineEnd) && (job->LineEnd() > lineStart);
+	};
+	queued.erase(std::remove_if(queued.begin(), queued.end(), overlaps), queued.end());
+	finished.erase(std::remove_if(finished.begin(), finished.end(), overlaps), finished.end());
+	for (BackgroundWrapJob *job : running) {
+		if ((job->lineFirst < lineEnd) && (job->LineEnd() > lineStart))
+			job->cancelled = true;
+	}
+}
+
+std::unique_ptr<BackgroundWrapJob> BackgroundWrapper::TakeFinished(Sci::Line lineFirst) {
+	std::lock_guard<std::mutex> guard(mutex);
+	for (std::vector<std::unique_ptr<BackgroundWrapJob>>::iterator it = finished.begin(); it != finished.end(); ++it) {
+		if ((*it)->lineFirst == lineFirst) {
+			std::unique_ptr<BackgroundWrapJob> job = std::move(*it);
+			finished.erase(it);
+			return job;
+		}
+	}
+	return std::unique_ptr<BackgroundWrapJob>();
+}
+
+// Wait until a worker finishes a job, returning at once when none are working.
+void BackgroundWrapper::WaitForFinished() {
+	std::unique_lock<std::mutex> lock(mutex);
+	if (queued.empty() && running.empty())
+		return;
+	condFinished.wait(lock);
+}
+
+void BackgroundWrapper::Run() {
+	WrapLayout layout;
+	std::unique_lock<std::mutex> lock(mutex);
+	for (;;) {
+		if (!cond.wait_for(lock, workerIdleTimeout, [this] { return quit || !queued.empty(); })) {
+			layout.ReturnViewStyle();
+			exited.push_back(std::this_thread::get_id());
+			return;
+		}
+		if (quit)
+			return;
+		std::unique_ptr<BackgroundWrapJob> job = std::move(queued.front());
+		queued.pop_front();
+		running.push_back(job.get());
+		// Take one of the view style copies the first time these settings are seen
+		std::unique_ptr<ViewStyle> vs;
+		if (layout.NeedsSettings(job->settings) && !job->settings->viewStyles.empty()) {
+			vs = std::move(job->settings->viewStyles.back());
+			job->settings->viewStyles.pop_back();
+		}
+		lock.unlock();
+
+		layout.Wrap(*job, std::move(vs));
+
+		lock.lock();
+		running.erase(std::find(running.begin(), running.end(), job.get()));
+		if (!job->cancelled)
+			finished.push_back(std::move(job));
+		condFinished.notify_all();
+	}
+}
@@ -0,0 +1,99 @@
+// Scintilla source code edit control
+/** @file BackgroundWrap.h
+ ** Wraps copies of lines on a pool of worker threads.
+ **/
+// The License.txt file describes the conditions under which this software may be distributed.
+
+#ifndef BACKGROUNDWRAP_H
+#define BACKGROUNDWRAP_H
+
+namespace Scintilla {
+
+/**
+ * The editor settings that decide where lines wrap. Copying a view style reads the application
+ * font so there is an unrealised copy made on the UI thread for each worker which then realises
+ * its fonts and measures with them on its own thread.
+ */
+struct WrapSettings {
+	std::vector<std::unique_ptr<ViewStyle>> viewStyles;
+	SpecialRepresentations reprs;
+	int wrapWidth;
+	int tabWidthMinimumPixels;
+	int technology;
+	int codePage;
+	int tabInChars;
+	int indentInChars;
+	XYPOSITION aveCharWidth;	///< Workers measuring differently to the UI give up
+	XYPOSITION spaceWidth;
+	bool measuredAlike;	///< Only used on the UI thread
+	WrapSettings(const ViewStyle &vs, const SpecialRepresentations &reprs_, const Document *pdoc,
+		int wrapWidth_, int tabWidthMinimumPixels_, int technology_, size_t copies);
+	// Deleted so WrapSettings objects can not be copied.
+	WrapSettings(const WrapSettings &) = delete;
+	WrapSettings(WrapSettings &&) = delete;
+	WrapSettings &operator=(const WrapSettings &) = delete;
+	WrapSettings &operator=(WrapSettings &&) = delete;
+	~WrapSettings();
+};
+
+/**
+ * One piece of work for the wrap workers: the text and styles of some whole lines and,
+ * once wrapped, the number of sublines of each. measuredAlike is false when the worker's
+ * fonts measure differently to the UI's, as happens when they are for a different screen.
+ */
+struct BackgroundWrapJob {
+	std::shared_ptr<WrapSettings> settings;
+	Sci::Line lineFirst;
+	std::string text;
+	std::vector<unsigned char> styles;
+	std::vector<Sci::Position> lineStarts;	///< Offset in text of each line then the end of the text
+	std::vector<int> lines;
+	bool measuredAlike;
+	bool cancelled;
+	BackgroundWrapJob() noexcept : lineFirst(0), measuredAlike(true), cancelled(false) {
+	}
+	Sci::Line LineEnd() const noexcept {
+		return lineFirst + static_cast<Sci::Line>(lines.size());
+	}
+};
+
+/**
+ * Owns the wrap worker threads and the jobs given to them. Jobs cover separate ranges of lines.
+ * A finished job waits until the editor takes it on the UI thread, in line order, and jobs for
+ * lines that change are dropped or, when already being wrapped, have their results dropped.
+ * Workers that have had nothing to do for a while exit so idle editors do not keep threads.
+ */
+class BackgroundWrapper {
+	std::mutex mutex;
+	std::condition_variable cond;
+	std::condition_variable condFinished;
+	std::vector<std::thread> workers;
+	std::vector<std::thread::id> exited;	///< Workers that have returned and can be joined
+	std::deque<std::unique_ptr<BackgroundWrapJob>> queued;
+	std::vector<BackgroundWrapJob *> running;
+	std::vector<std::unique_ptr<BackgroundWrapJob>> finished;
+	bool quit;
+	void Run();
+public:
+	BackgroundWrapper();
+	// Deleted so BackgroundWrapper objects can not be copied.
+	BackgroundWrapper(const BackgroundWrapper &) = delete;
+	BackgroundWrapper(BackgroundWrapper &&) = delete;
+	BackgroundWrapper &operator=(const BackgroundWrapper &) = delete;
+	BackgroundWrapper &operator=(BackgroundWrapper &&) = delete;
+	~BackgroundWrapper();
+
+	static size_t WorkerCount();
+	size_t Working();
+	bool HasJobs();
+	Sci::Line JobsEnd(Sci::Line line);
+	Sci::Line JobAfter(Sci::Line line);
+	void Submit(std::unique_ptr<BackgroundWrapJob> job);
+	void Invalidate(Sci::Line lineStart, Sci::Line lineEnd);
+	std::unique_ptr<BackgroundWrapJob> TakeFinished(Sci::Line lineFirst);
+	void WaitForFinished();
+};
+
+}
+
+#endif
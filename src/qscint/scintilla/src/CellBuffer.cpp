@@ -7,6 +7,7 @@
 
 #include <cstddef>
 #include <cstdlib>
+#include <climits>
 #include <cassert>
 #include <cstring>
 #include <cstdio>
@@ -20,10 +21,12 @@
 
 #include "Platform.h"
 
+#include "ILoader.h"
 #include "Scintilla.h"
 #include "Position.h"
 #include "SplitVector.h"
 #include "Partitioning.h"
+#include "PieceTable.h"
 #include "CellBuffer.h"
 #include "UniConversion.h"
 
@@ -76,6 +79,7 @@ public:
 	virtual bool ReleaseLineCharacterIndex(int lineCharacterIndex) = 0;
 	virtual Sci::Position IndexLineStart(Sci::Line line, int lineCharacterIndex) const noexcept = 0;
 	virtual Sci::Line LineFromPositionIndex(Sci::Position pos, int lineCharacterIndex) const noexcept = 0;
+	virtual size_t MemoryUsed() const noexcept = 0;
 	virtual ~ILineVector() {}
 };
 
@@ -221,6 +225,10 @@ public:
 		}
 	}
 
+	size_t MemoryUsed() const noexcept override {
+		return starts.MemoryUsed() + startsUTF16.starts.MemoryUsed() + startsUTF32.starts.MemoryUsed();
+	}
+
 	int LineCharacterIndex() const noexcept override {
 		int retVal = 0;
 		if (startsUTF32.Active()) {
@@ -271,31 +279,462 @@ public:
 
 Action::Action() {
 	at = startAction;
+	chunk = -1;
 	position = 0;
+	data = nullptr;
 	lenData = 0;
+	offset = 0;
 	mayCoalesce = false;
 }
 
 Action::~Action() {
 }
 
-void Action::Create(actionType at_, Sci::Position position_, const char *data_, Sci::Position lenData_, bool mayCoalesce_) {
+// The text is added to the UndoStore by UndoHistory.
+void Action::Create(actionType at_, Sci::Position position_, Sci::Position lenData_, bool mayCoalesce_) {
+	chunk = -1;
 	data = nullptr;
+	offset = 0;
 	position = position_;
 	at = at_;
-	if (lenData_) {
-		data = std::unique_ptr<char []>(new char[lenData_]);
-		memcpy(&data[0], data_, lenData_);
-	}
 	lenData = lenData_;
 	mayCoalesce = mayCoalesce_;
 }
 
 void Action::Clear() {
+	chunk = -1;
 	data = nullptr;
+	offset = 0;
 	lenData = 0;
 }
 
+namespace {
+
+// A small LZ77 compressor for undo text which is mostly source code and repeats a lot.
+// A control byte below 0x80 is followed by control + 1 literal bytes. Otherwise it is a copy of
+// (control & 0x7f) + packMinMatch bytes from the 16 bit distance back in the following 2 bytes.
+constexpr size_t packMinMatch = 4;
+constexpr size_t packMaxMatch = 0x7f + packMinMatch;
+constexpr size_t packMaxLiterals = 0x80;
+constexpr size_t packMaxDistance = 0xffff;
+constexpr int packHashBits = 14;
+constexpr size_t packNoPosition = static_cast<size_t>(-1);
+
+unsigned int PackHash(const char *s) noexcept {
+	unsigned int v;
+	memcpy(&v, s, sizeof(v));
+	return (v * 2654435761U) >> (32 - packHashBits);
+}
+
+void PackLiterals(std::vector<char> &packed, const char *s, size_t length) {
+	while (length > 0) {
+		const size_t run = std::min(length, packMaxLiterals);
+		packed.push_back(static_cast<char>(run - 1));
+		packed.insert(packed.end(), s, s + run);
+		s += run;
+		length -= run;
+	}
+}
+
+// Returns false when the text does not compress to less than 3/4 of its size.
+bool Pack(const char *text, size_t length, std::vector<char> &packed) {
+	const size_t limit = length / 4 * 3;
+	std::vector<size_t> table(static_cast<size_t>(1) << packHashBits, packNoPosition);
+	packed.clear();
+	packed.reserve(limit + packMaxLiterals + 1);
+	size_t literalStart = 0;
+	size_t pos = 0;
+	while (pos + packMinMatch <= length) {
+		if (packed.size() > limit)
+			return false;
+		const unsigned int hash = PackHash(text + pos);
+		const size_t candidate = table[hash];
+		table[hash] = pos;
+		if ((candidate != packNoPosition) && (pos - candidate <= packMaxDistance) &&
+			(memcmp(text + candidate, text + pos, packMinMatch) == 0)) {
+			size_t matchLength = packMinMatch;
+			while ((matchLength < packMaxMatch) && (pos + matchLength < length) &&
+				(text[candidate + matchLength] == text[pos + matchLength]))
+				matchLength++;
+			PackLiterals(packed, text + literalStart, pos - literalStart);
+			const size_t distance = pos - candidate;
+			packed.push_back(static_cast<char>(0x80 | (matchLength - packMinMatch)));
+			packed.push_back(static_cast<char>(distance & 0xff));
+			packed.push_back(static_cast<char>(distance >> 8));
+			pos += matchLength;
+			literalStart = pos;
+		} else {
+			pos++;
+		}
+	}
+	PackLiterals(packed, text + literalStart, length - literalStart);
+	return packed.size() <= limit;
+}
+
+bool Unpack(const std::vector<char> &packed, char *text, size_t length) {
+	size_t pos = 0;
+	size_t i = 0;
+	while (i < packed.size()) {
+		const unsigned char control = static_cast<unsigned char>(packed[i++]);
+		if (control < 0x80) {
+			const size_t run = control + 1;
+			if ((i + run > packed.size()) || (pos + run > length))
+				return false;
+			memcpy(text + pos, &packed[i], run);
+			i += run;
+			pos += run;
+		} else {
+			if (i + 2 > packed.size())
+				return false;
+			const size_t matchLength = (control & 0x7f) + packMinMatch;
+			const size_t distance = static_cast<unsigned char>(packed[i]) |
+				(static_cast<size_t>(static_cast<unsigned char>(packed[i + 1])) << 8);
+			i += 2;
+			if ((distance == 0) || (distance > pos) || (pos + matchLength > length))
+				return false;
+			// The copy may overlap the text it produces so is done a byte at a time
+			for (size_t k = 0; k < matchLength; k++)
+				text[pos + k] = text[pos + k - distance];
+			pos += matchLength;
+		}
+	}
+	return pos == length;
+}
+
+// Text is packed into chunks of this size, longer text gets a chunk of its own.
+constexpr size_t undoChunkSize = 0x40000;
+
+}
+
+namespace Scintilla {
+
+/**
+ * Temporary file that holds undo text moved out of memory. Space is not reused,
+ * the file goes away when the undo history is deleted.
+ */
+class UndoSpillFile {
+	FILE *fp;
+	long long length;
+	bool Seek(long long position) {
+#if defined(_WIN32)
+		return _fseeki64(fp, position, SEEK_SET) == 0;
+#else
+		return fseeko(fp, position, SEEK_SET) == 0;
+#endif
+	}
+public:
+	UndoSpillFile() : fp(tmpfile()), length(0) {
+	}
+	// Deleted so UndoSpillFile objects can not be copied.
+	UndoSpillFile(const UndoSpillFile &) = delete;
+	UndoSpillFile(UndoSpillFile &&) = delete;
+	void operator=(const UndoSpillFile &) = delete;
+	void operator=(UndoSpillFile &&) = delete;
+	~UndoSpillFile() {
+		if (fp)
+			fclose(fp);
+	}
+	bool Write(const char *data, size_t lengthData, long long &position) {
+		if (!fp || !Seek(length) || (fwrite(data, 1, lengthData, fp) != lengthData))
+			return false;
+		position = length;
+		length += lengthData;
+		return true;
+	}
+	bool Read(long long position, char *data, size_t lengthData) {
+		return fp && Seek(position) && (fread(data, 1, lengthData, fp) == lengthData);
+	}
+};
+
+}
+
+UndoStore::Chunk::Chunk(size_t capacity_) :
+	text(new char[capacity_]), capacity(capacity_), used(0), liveActions(0),
+	spillPosition(-1), spillLength(0), spillPacked(false), triedPacking(false) {
+}
+
+size_t UndoStore::Chunk::Resident() const noexcept {
+	return (text ? capacity : 0) + packed.capacity();
+}
+
+UndoStore::UndoStore() :
+	openChunk(-1), budget(0), compression(true), residentBytes(0), spilledBytes(0),
+	spillFailed(false) {
+	for (int order = 0; order < orderCount; order++) {
+		oldest[order] = -1;
+		newest[order] = -1;
+	}
+}
+
+UndoStore::~UndoStore() {
+}
+
+const char *UndoStore::Add(const char *data, size_t lenData, int &chunk, unsigned int &offset) {
+	chunk = -1;
+	offset = 0;
+	if (lenData == 0)
+		return nullptr;
+	bool added = false;
+	if (lenData > undoChunkSize / 2) {
+		chunk = NewChunk(lenData);
+		added = true;
+	} else {
+		if ((openChunk < 0) || (chunks[openChunk].used + lenData > chunks[openChunk].capacity)) {
+			openChunk = NewChunk(undoChunkSize);
+			added = true;
+		}
+		chunk = openChunk;
+	}
+	Chunk &c = chunks[chunk];
+	if (added) {
+		residentBytes += c.Resident();
+		UpdateOrder(chunk);
+	} else {
+		Touch(chunk);
+	}
+	offset = static_cast<unsigned int>(c.used);
+	memcpy(c.text.get() + c.used, data, lenData);
+	c.used += lenData;
+	c.liveActions++;
+	// Memory only grows when a chunk is added so only then may other chunks have to move out
+	if (added)
+		Trim(chunk);
+	return chunks[chunk].text.get() + offset;
+}
+
+void UndoStore::Release(int chunk) {
+	if (chunk < 0)
+		return;
+	Chunk &c = chunks[chunk];
+	c.liveActions--;
+	if (c.liveActions <= 0) {
+		if (chunk == openChunk)
+			c.used = 0;
+		else
+			FreeChunk(chunk);
+	}
+}
+
+const char *UndoStore::Fetch(int chunk, unsigned int offset) {
+	if (chunk < 0)
+		return nullptr;
+	if (!chunks[chunk].text) {
+		if (!RestoreChunk(chunk))
+			return nullptr;
+		UpdateOrder(chunk);
+		Trim(chunk);
+	}
+	Touch(chunk);
+	return chunks[chunk].text.get() + offset;
+}
+
+void UndoStore::Clear() {
+	chunks.clear();
+	freeChunks.clear();
+	for (int order = 0; order < orderCount; order++) {
+		oldest[order] = -1;
+		newest[order] = -1;
+	}
+	openChunk = -1;
+	residentBytes = 0;
+	spilledBytes = 0;
+	spill.reset();
+	spillFailed = false;
+}
+
+void UndoStore::SetBudget(size_t budget_) {
+	budget = budget_;
+	Trim(-1);
+}
+
+void UndoStore::SetCompression(bool compression_) {
+	compression = compression_;
+}
+
+// Reuse the slot of a freed chunk so the vector does not grow with every chunk ever created.
+int UndoStore::NewChunk(size_t capacity) {
+	while (!freeChunks.empty()) {
+		const int chunk = freeChunks.back();
+		freeChunks.pop_back();
+		if ((chunk < static_cast<int>(chunks.size())) && (chunks[chunk].capacity == 0)) {
+			chunks[chunk] = Chunk(capacity);
+			return chunk;
+		}
+	}
+	chunks.emplace_back(capacity);
+	return static_cast<int>(chunks.size()) - 1;
+}
+
+void UndoStore::FreeChunk(int chunk) {
+	Chunk &c = chunks[chunk];
+	Unlink(chunk, orderPack);
+	Unlink(chunk, orderSpill);
+	residentBytes -= c.Resident();
+	if (c.spillPosition >= 0)
+		spilledBytes -= c.spillLength;
+	c.text.reset();
+	std::vector<char>().swap(c.packed);
+	c.capacity = 0;
+	c.used = 0;
+	c.spillPosition = -1;
+	c.spillLength = 0;
+	freeChunks.push_back(chunk);
+	// Free slots at the end are removed, those they leave in freeChunks are skipped when taken
+	while (!chunks.empty() && (chunks.back().capacity == 0) &&
+		(static_cast<int>(chunks.size()) - 1 != openChunk)) {
+		chunks.pop_back();
+	}
+}
+
+bool UndoStore::RestoreChunk(int chunk) {
+	Chunk &c = chunks[chunk];
+	std::unique_ptr<char[]> text(new char[c.used]);
+	if (!c.packed.empty()) {
+		if (!Unpack(c.packed, text.get(), c.used))
+			return false;
+		// Compress again when it becomes the least recently used
+		c.triedPacking = false;
+	} else if (c.spillPosition >= 0) {
+		if (c.spillPacked) {
+			std::vector<char> packed(c.spillLength);
+			if (!spill->Read(c.spillPosition, packed.data(), packed.size()) ||
+				!Unpack(packed, text.get(), c.used))
+				return false;
+		} else if (!spill->Read(c.spillPosition, text.get(), c.used)) {
+			return false;
+		}
+	} else {
+		return false;
+	}
+	residentBytes -= c.Resident();
+	c.text = std::move(text);
+	c.capacity = c.used;
+	std::vector<char>().swap(c.packed);
+	residentBytes += c.Resident();
+	return true;
+}
+
+void UndoStore::PackChunk(int chunk) {
+	Chunk &c = chunks[chunk];
+	c.triedPacking = true;
+	std::vector<char> packed;
+	if (Pack(c.text.get(), c.used, packed)) {
+		packed.shrink_to_fit();
+		residentBytes -= c.Resident();
+		c.packed = std::move(packed);
+		c.text.reset();
+		residentBytes += c.Resident();
+	}
+	UpdateOrder(chunk);
+}
+
+bool UndoStore::SpillChunk(int chunk) {
+	Chunk &c = chunks[chunk];
+	// A chunk read back from the file is unchanged so only needs to be dropped again
+	if (c.spillPosition < 0) {
+		if (spillFailed)
+			return false;
+		if (!spill)
+			spill = std::unique_ptr<UndoSpillFile>(new UndoSpillFile());
+		const bool packed = !c.packed.empty();
+		const char *data = packed ? c.packed.data() : c.text.get();
+		const size_t length = packed ? c.packed.size() : c.used;
+		long long position = 0;
+		if (!spill->Write(data, length, position)) {
+			spillFailed = true;
+			return false;
+		}
+		c.spillPosition = position;
+		c.spillLength = length;
+		c.spillPacked = packed;
+		spilledBytes += length;
+	}
+	residentBytes -= c.Resident();
+	c.text.reset();
+	std::vector<char>().swap(c.packed);
+	UpdateOrder(chunk);
+	return true;
+}
+
+void UndoStore::Unlink(int chunk, Order order) noexcept {
+	Link &link = chunks[chunk].links[order];
+	if (!link.linked)
+		return;
+	if (link.older >= 0)
+		chunks[link.older].links[order].newer = link.newer;
+	else
+		oldest[order] = link.newer;
+	if (link.newer >= 0)
+		chunks[link.newer].links[order].older = link.older;
+	else
+		newest[order] = link.older;
+	link = Link();
+}
+
+void UndoStore::LinkNewest(int chunk, Order order) noexcept {
+	Link &link = chunks[chunk].links[order];
+	link.older = newest[order];
+	link.newer = -1;
+	link.linked = true;
+	if (newest[order] >= 0)
+		chunks[newest[order]].links[order].newer = chunk;
+	else
+		oldest[order] = chunk;
+	newest[order] = chunk;
+}
+
+// Mark a chunk as the most recently used in the orders it is part of.
+void UndoStore::Touch(int chunk) noexcept {
+	for (int order = 0; order < orderCount; order++) {
+		if (chunks[chunk].links[order].linked && (newest[order] != chunk)) {
+			Unlink(chunk, static_cast<Order>(order));
+			LinkNewest(chunk, static_cast<Order>(order));
+		}
+	}
+}
+
+// Add a chunk to or remove it from the orders after its text was moved in or out of memory.
+void UndoStore::UpdateOrder(int chunk) noexcept {
+	const Chunk &c = chunks[chunk];
+	const bool wanted[orderCount] = { c.text && !c.triedPacking, c.Resident() > 0 };
+	for (int order = 0; order < orderCount; order++) {
+		if (wanted[order] && !c.links[order].linked)
+			LinkNewest(chunk, static_cast<Order>(order));
+		else if (!wanted[order] && c.links[order].linked)
+			Unlink(chunk, static_cast<Order>(order));
+	}
+}
+
+// Find the least recently used chunk that can be compressed or moved to the file.
+// Only the pinned and the open chunk are skipped so this rarely looks past the oldest.
+int UndoStore::LeastRecent(int pinned, Order order) const noexcept {
+	for (int i = oldest[order]; i >= 0; i = chunks[i].links[order].newer) {
+		if ((i != pinned) && (i != openChunk) && (chunks[i].liveActions > 0))
+			return i;
+	}
+	return -1;
+}
+
+// Compress chunks first as that keeps them in memory, then spill to the file.
+// The pinned chunk has just been handed out so must stay.
+void UndoStore::Trim(int pinned) {
+	if (budget == 0)
+		return;
+	if (compression) {
+		while (residentBytes > budget) {
+			const int victim = LeastRecent(pinned, orderPack);
+			if (victim < 0)
+				break;
+			PackChunk(victim);
+		}
+	}
+	while (residentBytes > budget) {
+		const int victim = LeastRecent(pinned, orderSpill);
+		if ((victim < 0) || !SpillChunk(victim))
+			break;
+	}
+}
+
 // The undo history stores a sequence of user operations that represent the user's view of the
 // commands executed on the text.
 // Each user operation contains a sequence of text insertion and text deletion actions.
@@ -329,6 +768,25 @@ UndoHistory::UndoHistory() {
 UndoHistory::~UndoHistory() {
 }
 
+void UndoHistory::CreateAction(int index, actionType at, Sci::Position position, const char *data, Sci::Position lengthData, bool mayCoalesce) {
+	Action &action = actions[index];
+	store.Release(action.chunk);
+	action.Create(at, position, lengthData, mayCoalesce);
+	action.data = store.Add(data, lengthData, action.chunk, action.offset);
+}
+
+void UndoHistory::ReleaseAction(Action &action) {
+	store.Release(action.chunk);
+	action.Clear();
+}
+
+// Actions after newMax can no longer be redone so their text is released.
+void UndoHistory::TruncateRedo(int newMax) {
+	for (int i = newMax + 1; i <= maxAction; i++)
+		ReleaseAction(actions[i]);
+	maxAction = newMax;
+}
+
 void UndoHistory::EnsureUndoRoom() {
 	// Have to test that there is room for 2 more actions in the array
 	// as two actions may be created by the calling function
@@ -403,11 +861,11 @@ const char *UndoHistory::AppendAction(actionType at, Sci::Position position, con
 	}
 	startSequence = oldCurrentAction != currentAction;
 	const int actionWithData = currentAction;
-	actions[currentAction].Create(at, position, data, lengthData, mayCoalesce);
+	CreateAction(currentAction, at, position, data, lengthData, mayCoalesce);
 	currentAction++;
-	actions[currentAction].Create(startAction);
-	maxAction = currentAction;
-	return actions[actionWithData].data.get();
+	CreateAction(currentAction, startAction);
+	TruncateRedo(currentAction);
+	return actions[actionWithData].data;
 }
 
 void UndoHistory::BeginUndoAction() {
@@ -415,8 +873,8 @@ void UndoHistory::BeginUndoAction() {
 	if (undoSequenceDepth == 0) {
 		if (actions[currentAction].at != startAction) {
 			currentAction++;
-			actions[currentAction].Create(startAction);
-			maxAction = currentAction;
+			CreateAction(currentAction, startAction);
+			TruncateRedo(currentAction);
 		}
 		actions[currentAction].mayCoalesce = false;
 	}
@@ -430,8 +888,8 @@ void UndoHistory::EndUndoAction() {
 	if (0 == undoSequenceDepth) {
 		if (actions[currentAction].at != startAction) {
 			currentAction++;
-			actions[currentAction].Create(startAction);
-			maxAction = currentAction;
+			CreateAction(currentAction, startAction);
+			TruncateRedo(currentAction);
 		}
 		actions[currentAction].mayCoalesce = false;
 	}
@@ -442,8 +900,9 @@ void UndoHistory::DropUndoSequence() {
 }
 
 void UndoHistory::DeleteUndoHistory() {
-	for (int i = 1; i < maxAction; i++)
-		actions[i].Clear();
+	for (Action &action : actions)
+		action.Clear();
+	store.Clear();
 	maxAction = 0;
 	currentAction = 0;
 	actions[currentAction].Create(startAction);
@@ -451,6 +910,11 @@ void UndoHistory::DeleteUndoHistory() {
 	tentativePoint = -1;
 }
 
+void UndoHistory::AbandonUndoHistory() {
+	DeleteUndoHistory();
+	savePoint = -1;
+}
+
 void UndoHistory::SetSavePoint() {
 	savePoint = currentAction;
 }
@@ -466,7 +930,7 @@ void UndoHistory::TentativeStart() {
 void UndoHistory::TentativeCommit() {
 	tentativePoint = -1;
 	// Truncate undo history
-	maxAction = currentAction;
+	TruncateRedo(currentAction);
 }
 
 int UndoHistory::TentativeSteps() {
@@ -496,8 +960,10 @@ int UndoHistory::StartUndo() {
 	return currentAction - act;
 }
 
-const Action &UndoHistory::GetUndoStep() const {
-	return actions[currentAction];
+const Action &UndoHistory::GetUndoStep() {
+	Action &action = actions[currentAction];
+	action.data = store.Fetch(action.chunk, action.offset);
+	return action;
 }
 
 void UndoHistory::CompletedUndoStep() {
@@ -521,16 +987,30 @@ int UndoHistory::StartRedo() {
 	return act - currentAction;
 }
 
-const Action &UndoHistory::GetRedoStep() const {
-	return actions[currentAction];
+const Action &UndoHistory::GetRedoStep() {
+	Action &action = actions[currentAction];
+	action.data = store.Fetch(action.chunk, action.offset);
+	return action;
 }
 
 void UndoHistory::CompletedRedoStep() {
 	currentAction++;
 }
 
+void UndoHistory::SetMemoryBudget(size_t budget) {
+	store.SetBudget(budget);
+}
+
+void UndoHistory::SetCompression(bool compression) {
+	store.SetCompression(compression);
+}
+
+size_t UndoHistory::MemoryUsed() const noexcept {
+	return actions.capacity() * sizeof(Action) + store.ResidentBytes();
+}
+
 CellBuffer::CellBuffer(bool hasStyles_, bool largeDocument_) :
-	hasStyles(hasStyles_), largeDocument(largeDocument_) {
+	hasStyles(hasStyles_), stylesReleased(false), largeDocument(largeDocument_) {
 	readOnly = false;
 	utf8Substance = false;
 	utf8LineEnds = 0;
@@ -544,12 +1024,108 @@ CellBuffer::CellBuffer(bool hasStyles_, bool largeDocument_) :
 CellBuffer::~CellBuffer() {
 }
 
+char CellBuffer::SubstanceAt(Sci::Position position) const noexcept {
+	return pieces ? pieces->ValueAt(position) : substance.ValueAt(position);
+}
+
+// Copy the text into the gap buffer and stop referring to the mapped text.
+void CellBuffer::LeaveMapping() {
+	const Sci::Position length = pieces->Length();
+	substance.DeleteAll();
+	substance.ReAllocate(length + 1);
+	substance.InsertValue(0, length, 0);
+	pieces->GetRange(substance.RangePointer(0, length), 0, length);
+	pieces.reset();
+}
+
+// Positions in a document that is not large must fit in an int. The buffer is still empty
+// so a longer text switches it to 64-bit line starts; the owner then reattaches its per-line data.
+bool CellBuffer::SetMappedText(IMappedText *text, int options) {
+	if ((Length() != 0) || readOnly) {
+		text->Release();
+		return false;
+	}
+	if (!largeDocument && (text->Length() >= INT_MAX)) {
+		const int lineCharacterIndex = plv->LineCharacterIndex();
+		plv = std::unique_ptr<LineVector<Sci::Position>>(new LineVector<Sci::Position>());
+		largeDocument = true;
+		AllocateLineCharacterIndex(lineCharacterIndex);
+	}
+	if (options & SC_DOCUMENTOPTION_STYLES_NONE) {
+		// The style buffer would be as large as the text
+		hasStyles = false;
+		stylesReleased = false;
+		style.DeleteAll();
+	}
+	substance.DeleteAll();
+	pieces = std::unique_ptr<PieceTable>(new PieceTable(text));
+	return true;
+}
+
+bool CellBuffer::RebaseMappedText(IMappedText *text) {
+	if (text->Length() != Length()) {
+		text->Release();
+		return false;
+	}
+	std::unique_ptr<PieceTable> rebased(new PieceTable(text));
+	rebased->InsertFromArray(0, text->Data(), text->Length());
+	pieces = std::move(rebased);
+	substance.DeleteAll();
+	return true;
+}
+
+bool CellBuffer::IsMapped() const noexcept {
+	return pieces != nullptr;
+}
+
+size_t CellBuffer::MappedMemoryUsed() const noexcept {
+	return pieces ? pieces->MemoryUsed() : 0;
+}
+
+size_t CellBuffer::TextMemoryUsed() const noexcept {
+	return substance.MemoryUsed() + MappedMemoryUsed();
+}
+
+size_t CellBuffer::StyleMemoryUsed() const noexcept {
+	return style.MemoryUsed();
+}
+
+size_t CellBuffer::LineMemoryUsed() const noexcept {
+	return plv->MemoryUsed();
+}
+
+void CellBuffer::Compact() {
+	substance.Compact();
+	style.Compact();
+}
+
+void CellBuffer::ReleaseStyles() {
+	if (!hasStyles)
+		return;
+	hasStyles = false;
+	stylesReleased = true;
+	style.DeleteAll();
+}
+
+bool CellBuffer::RestoreStyles() {
+	if (!stylesReleased)
+		return false;
+	style.InsertValue(0, Length(), 0);
+	hasStyles = true;
+	stylesReleased = false;
+	return true;
+}
+
+bool CellBuffer::StylesReleased() const noexcept {
+	return stylesReleased;
+}
+
 char CellBuffer::CharAt(Sci::Position position) const noexcept {
-	return substance.ValueAt(position);
+	return SubstanceAt(position);
 }
 
 unsigned char CellBuffer::UCharAt(Sci::Position position) const noexcept {
-	return substance.ValueAt(position);
+	return SubstanceAt(position);
 }
 
 void CellBuffer::GetCharRange(char *buffer, Sci::Position position, Sci::Position lengthRetrieve) const {
@@ -557,12 +1133,15 @@ void CellBuffer::GetCharRange(char *buffer, Sci::Position position, Sci::Positio
 		return;
 	if (position < 0)
 		return;
-	if ((position + lengthRetrieve) > substance.Length()) {
+	if ((position + lengthRetrieve) > Length()) {
 		Platform::DebugPrintf("Bad GetCharRange %d for %d of %d\n", position,
-		                      lengthRetrieve, substance.Length());
+		                      lengthRetrieve, Length());
 		return;
 	}
-	substance.GetRange(buffer, position, lengthRetrieve);
+	if (pieces)
+		pieces->GetRange(buffer, position, lengthRetrieve);
+	else
+		substance.GetRange(buffer, position, lengthRetrieve);
 }
 
 char CellBuffer::StyleAt(Sci::Position position) const noexcept {
@@ -586,15 +1165,22 @@ void CellBuffer::GetStyleRange(unsigned char *buffer, Sci::Position position, Sc
 	style.GetRange(reinterpret_cast<char *>(buffer), position, lengthRetrieve);
 }
 
+// The whole text is wanted in one piece of memory so mapped text has to be copied.
 const char *CellBuffer::BufferPointer() {
+	if (pieces)
+		LeaveMapping();
 	return substance.BufferPointer();
 }
 
 const char *CellBuffer::RangePointer(Sci::Position position, Sci::Position rangeLength) {
+	if (pieces)
+		return pieces->RangePointer(position, rangeLength);
 	return substance.RangePointer(position, rangeLength);
 }
 
 Sci::Position CellBuffer::GapPosition() const {
+	if (pieces)
+		return pieces->Length();
 	return substance.GapPosition();
 }
 
@@ -654,7 +1240,7 @@ const char *CellBuffer::DeleteChars(Sci::Position position, Sci::Position delete
 		if (collectingUndo) {
 			// Save into the undo/redo stack, but only the characters - not the formatting
 			// The gap would be moved to position anyway for the deletion so this doesn't cost extra
-			data = substance.RangePointer(position, deleteLength);
+			data = RangePointer(position, deleteLength);
 			data = uh.AppendAction(removeAction, position, data, deleteLength, startSequence);
 		}
 
@@ -664,11 +1250,12 @@ const char *CellBuffer::DeleteChars(Sci::Position position, Sci::Position delete
 }
 
 Sci::Position CellBuffer::Length() const noexcept {
-	return substance.Length();
+	return pieces ? pieces->Length() : substance.Length();
 }
 
 void CellBuffer::Allocate(Sci::Position newSize) {
-	substance.ReAllocate(newSize);
+	if (!pieces)
+		substance.ReAllocate(newSize);
 	if (hasStyles) {
 		style.ReAllocate(newSize);
 	}
@@ -807,10 +1394,10 @@ void CellBuffer::RemoveLine(Sci::Line line) {
 
 bool CellBuffer::UTF8LineEndOverlaps(Sci::Position position) const {
 	const unsigned char bytes[] = {
-		static_cast<unsigned char>(substance.ValueAt(position-2)),
-		static_cast<unsigned char>(substance.ValueAt(position-1)),
-		static_cast<unsigned char>(substance.ValueAt(position)),
-		static_cast<unsigned char>(substance.ValueAt(position+1)),
+		static_cast<unsigned char>(SubstanceAt(position-2)),
+		static_cast<unsigned char>(SubstanceAt(position-1)),
+		static_cast<unsigned char>(SubstanceAt(position)),
+		static_cast<unsigned char>(SubstanceAt(position+1)),
 	};
 	return UTF8IsSeparator(bytes) || UTF8IsSeparator(bytes+1) || UTF8IsNEL(bytes+1);
 }
@@ -824,7 +1411,7 @@ bool CellBuffer::UTF8IsCharacterBoundary(Sci::Position position) const {
 			if (posBack < 0) {
 				return false;
 			}
-			back.insert(0, 1, substance.ValueAt(posBack));
+			back.insert(0, 1, SubstanceAt(posBack));
 			if (!UTF8IsTrailByte(back.front())) {
 				if (i > 0) {
 					// Have reached a non-trail
@@ -838,7 +1425,7 @@ bool CellBuffer::UTF8IsCharacterBoundary(Sci::Position position) const {
 		}
 	}
 	if (position < Length()) {
-		const unsigned char fore = substance.ValueAt(position);
+		const unsigned char fore = SubstanceAt(position);
 		if (UTF8IsTrailByte(fore)) {
 			return false;
 		}
@@ -858,7 +1445,7 @@ void CellBuffer::ResetLineEnds() {
 	unsigned char chBeforePrev = 0;
 	unsigned char chPrev = 0;
 	for (Sci::Position i = 0; i < length; i++) {
-		const unsigned char ch = substance.ValueAt(position + i);
+		const unsigned char ch = SubstanceAt(position + i);
 		if (ch == '\r') {
 			InsertLine(lineInsert, (position + i) + 1, atLineStart);
 			lineInsert++;
@@ -923,7 +1510,7 @@ void CellBuffer::BasicInsertString(Sci::Position position, const char *s, Sci::P
 		return;
 	PLATFORM_ASSERT(insertLength > 0);
 
-	const unsigned char chAfter = substance.ValueAt(position);
+	const unsigned char chAfter = SubstanceAt(position);
 	bool breakingUTF8LineEnd = false;
 	if (utf8LineEnds && UTF8IsTrailByte(chAfter)) {
 		breakingUTF8LineEnd = UTF8LineEndOverlaps(position);
@@ -945,7 +1532,10 @@ void CellBuffer::BasicInsertString(Sci::Position position, const char *s, Sci::P
 			UTF8IsValid(s, insertLength);
 	}
 
-	substance.InsertFromArray(position, s, 0, insertLength);
+	if (pieces)
+		pieces->InsertFromArray(position, s, insertLength);
+	else
+		substance.InsertFromArray(position, s, 0, insertLength);
 	if (hasStyles) {
 		style.InsertValue(position, insertLength, 0);
 	}
@@ -953,8 +1543,8 @@ void CellBuffer::BasicInsertString(Sci::Position position, const char *s, Sci::P
 	const bool atLineStart = plv->LineStart(lineInsert-1) == position;
 	// Point all the lines after the insertion point further along in the buffer
 	plv->InsertText(lineInsert-1, insertLength);
-	unsigned char chBeforePrev = substance.ValueAt(position - 2);
-	unsigned char chPrev = substance.ValueAt(position - 1);
+	unsigned char chBeforePrev = SubstanceAt(position - 2);
+	unsigned char chPrev = SubstanceAt(position - 1);
 	if (chPrev == '\r' && chAfter == '\n') {
 		// Splitting up a crlf pair at position
 		InsertLine(lineInsert, position, false);
@@ -1000,7 +1590,7 @@ void CellBuffer::BasicInsertString(Sci::Position position, const char *s, Sci::P
 	} else if (utf8LineEnds && !UTF8IsAscii(chAfter)) {
 		// May have end of UTF-8 line end in buffer and start in insertion
 		for (int j = 0; j < UTF8SeparatorLength-1; j++) {
-			const unsigned char chAt = substance.ValueAt(position + insertLength + j);
+			const unsigned char chAt = SubstanceAt(position + insertLength + j);
 			const unsigned char back3[3] = {chBeforePrev, chPrev, chAt};
 			if (UTF8IsSeparator(back3)) {
 				InsertLine(lineInsert, (position + insertLength + j) + 1, atLineStart);
@@ -1032,7 +1622,7 @@ void CellBuffer::BasicDeleteChars(Sci::Position position, Sci::Position deleteLe
 
 	Sci::Line lineRecalculateStart = INVALID_POSITION;
 
-	if ((position == 0) && (deleteLength == substance.Length())) {
+	if ((position == 0) && (deleteLength == Length())) {
 		// If whole buffer is being deleted, faster to reinitialise lines data
 		// than to delete each line.
 		plv->Init();
@@ -1044,9 +1634,9 @@ void CellBuffer::BasicDeleteChars(Sci::Position position, Sci::Position deleteLe
 		Sci::Line lineRemove = linePosition + 1;
 
 		plv->InsertText(lineRemove-1, - (deleteLength));
-		const unsigned char chPrev = substance.ValueAt(position - 1);
+		const unsigned char chPrev = SubstanceAt(position - 1);
 		const unsigned char chBefore = chPrev;
-		unsigned char chNext = substance.ValueAt(position);
+		unsigned char chNext = SubstanceAt(position);
 
 		// Check for breaking apart a UTF-8 sequence
 		// Needs further checks that text is UTF-8 or that some other break apart is occurring
@@ -1086,7 +1676,7 @@ void CellBuffer::BasicDeleteChars(Sci::Position position, Sci::Position deleteLe
 
 		unsigned char ch = chNext;
 		for (Sci::Position i = 0; i < deleteLength; i++) {
-			chNext = substance.ValueAt(position + i + 1);
+			chNext = SubstanceAt(position + i + 1);
 			if (ch == '\r') {
 				if (chNext != '\n') {
 					RemoveLine(lineRemove);
@@ -1100,7 +1690,7 @@ void CellBuffer::BasicDeleteChars(Sci::Position position, Sci::Position deleteLe
 			} else if (utf8LineEnds) {
 				if (!UTF8IsAscii(ch)) {
 					const unsigned char next3[3] = {ch, chNext,
-						static_cast<unsigned char>(substance.ValueAt(position + i + 2))};
+						static_cast<unsigned char>(SubstanceAt(position + i + 2))};
 					if (UTF8IsSeparator(next3) || UTF8IsNEL(next3)) {
 						RemoveLine(lineRemove);
 					}
@@ -1111,14 +1701,17 @@ void CellBuffer::BasicDeleteChars(Sci::Position position, Sci::Position deleteLe
 		}
 		// May have to fix up end if last deletion causes cr to be next to lf
 		// or removes one of a crlf pair
-		const char chAfter = substance.ValueAt(position + deleteLength);
+		const char chAfter = SubstanceAt(position + deleteLength);
 		if (chBefore == '\r' && chAfter == '\n') {
 			// Using lineRemove-1 as cr ended line before start of deletion
 			RemoveLine(lineRemove - 1);
 			plv->SetLineStart(lineRemove - 1, position + 1);
 		}
 	}
-	substance.DeleteRange(position, deleteLength);
+	if (pieces)
+		pieces->DeleteRange(position, deleteLength);
+	else
+		substance.DeleteRange(position, deleteLength);
 	if (lineRecalculateStart >= 0) {
 		RecalculateIndexLineStarts(lineRecalculateStart, lineRecalculateStart);
 	}
@@ -1150,10 +1743,38 @@ void CellBuffer::AddUndoAction(Sci::Position token, bool mayCoalesce) {
 	uh.AppendAction(containerAction, token, nullptr, 0, startSequence, mayCoalesce);
 }
 
+void CellBuffer::AbandonUndoHistory() {
+	uh.AbandonUndoHistory();
+}
+
 void CellBuffer::DeleteUndoHistory() {
 	uh.DeleteUndoHistory();
 }
 
+void CellBuffer::SetUndoMemoryBudget(size_t budget) {
+	uh.SetMemoryBudget(budget);
+}
+
+size_t CellBuffer::UndoMemoryBudget() const noexcept {
+	return uh.MemoryBudget();
+}
+
+void CellBuffer::SetUndoCompression(bool compression) {
+	uh.SetCompression(compression);
+}
+
+bool CellBuffer::UndoCompression() const noexcept {
+	return uh.Compression();
+}
+
+size_t CellBuffer::UndoMemoryUsed() const noexcept {
+	return uh.MemoryUsed();
+}
+
+size_t CellBuffer::UndoMemorySpilled() const noexcept {
+	return uh.MemorySpilled();
+}
+
 bool CellBuffer::CanUndo() const {
 	return uh.CanUndo();
 }
@@ -1162,20 +1783,20 @@ int CellBuffer::StartUndo() {
 	return uh.StartUndo();
 }
 
-const Action &CellBuffer::GetUndoStep() const {
+const Action &CellBuffer::GetUndoStep() {
 	return uh.GetUndoStep();
 }
 
 void CellBuffer::PerformUndoStep() {
 	const Action &actionStep = uh.GetUndoStep();
 	if (actionStep.at == insertAction) {
-		if (substance.Length() < actionStep.lenData) {
+		if (Length() < actionStep.lenData) {
 			throw std::runtime_error(
 				"CellBuffer::PerformUndoStep: deletion must be less than document length.");
 		}
 		BasicDeleteChars(actionStep.position, actionStep.lenData);
 	} else if (actionStep.at == removeAction) {
-		BasicInsertString(actionStep.position, actionStep.data.get(), actionStep.lenData);
+		BasicInsertString(actionStep.position, actionStep.data, actionStep.lenData);
 	}
 	uh.CompletedUndoStep();
 }
@@ -1188,14 +1809,14 @@ int CellBuffer::StartRedo() {
 	return uh.StartRedo();
 }
 
-const Action &CellBuffer::GetRedoStep() const {
+const Action &CellBuffer::GetRedoStep() {
 	return uh.GetRedoStep();
 }
 
 void CellBuffer::PerformRedoStep() {
 	const Action &actionStep = uh.GetRedoStep();
 	if (actionStep.at == insertAction) {
-		BasicInsertString(actionStep.position, actionStep.data.get(), actionStep.lenData);
+		BasicInsertString(actionStep.position, actionStep.data, actionStep.lenData);
 	} else if (actionStep.at == removeAction) {
 		BasicDeleteChars(actionStep.position, actionStep.lenData);
 	}
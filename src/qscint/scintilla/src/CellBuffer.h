@@ -17,6 +17,7 @@ public:
 	virtual void Init()=0;
 	virtual void InsertLine(Sci::Line line)=0;
 	virtual void RemoveLine(Sci::Line line)=0;
+	virtual size_t MemoryUsed() const noexcept=0;
 };
 
 /**
@@ -32,9 +33,13 @@ enum actionType { insertAction, removeAction, startAction, containerAction };
 class Action {
 public:
 	actionType at;
+	int chunk;	///< Chunk of the UndoStore holding the text or -1 when there is no text
 	Sci::Position position;
-	std::unique_ptr<char[]> data;
+	/// Only valid until the undo history changes again: set when the action is appended and
+	/// by GetUndoStep and GetRedoStep as the text may have been moved out of memory.
+	const char *data;
 	Sci::Position lenData;
+	unsigned int offset;	///< Offset of the text in the chunk
 	bool mayCoalesce;
 
 	Action();
@@ -45,8 +50,90 @@ public:
 	// Move constructor allows vector to be resized without reallocating.
 	Action(Action &&other) noexcept = default;
 	~Action();
-	void Create(actionType at_, Sci::Position position_=0, const char *data_=nullptr, Sci::Position lenData_=0, bool mayCoalesce_=true);
+	void Create(actionType at_, Sci::Position position_=0, Sci::Position lenData_=0, bool mayCoalesce_=true);
 	void Clear();
+	/// Set on a step from GetUndoStep or GetRedoStep whose text could not be read back
+	bool TextLost() const noexcept { return (chunk >= 0) && !data; }
+};
+
+class UndoSpillFile;
+
+/**
+ * Holds the text of undo actions packed into large chunks instead of one allocation per action.
+ * When a memory budget is set, the least recently used chunks are compressed and then written
+ * to a temporary file. They are read back when undo or redo reaches them.
+ * Only the chunk being appended to changes, the others are never modified until freed.
+ * Freed chunks leave a slot that is reused by the next new chunk so actions keep their chunk index.
+ */
+class UndoStore {
+	/// Chunks that may still be compressed and chunks still holding memory, each kept
+	/// in least recently used order so finding what to move out does not scan all chunks
+	enum Order { orderPack, orderSpill, orderCount };
+	struct Link {
+		int older;
+		int newer;
+		bool linked;
+		Link() noexcept : older(-1), newer(-1), linked(false) {}
+	};
+	struct Chunk {
+		std::unique_ptr<char[]> text;	///< Null when the chunk is compressed or spilled
+		std::vector<char> packed;	///< Compressed text kept in memory
+		size_t capacity;	///< 0 when the chunk has been freed and its slot can be reused
+		size_t used;
+		int liveActions;
+		long long spillPosition;	///< Position in the spill file or -1
+		size_t spillLength;
+		bool spillPacked;
+		bool triedPacking;
+		Link links[orderCount];
+		Chunk(size_t capacity_);
+		size_t Resident() const noexcept;
+	};
+	std::vector<Chunk> chunks;
+	std::vector<int> freeChunks;	///< May hold slots already reused or removed, checked when taken
+	int openChunk;
+	size_t budget;
+	bool compression;
+	size_t residentBytes;
+	size_t spilledBytes;
+	int oldest[orderCount];
+	int newest[orderCount];
+	std::unique_ptr<UndoSpillFile> spill;
+	bool spillFailed;
+
+	int NewChunk(size_t capacity);
+	void FreeChunk(int chunk);
+	bool RestoreChunk(int chunk);
+	void PackChunk(int chunk);
+	bool SpillChunk(int chunk);
+	void Unlink(int chunk, Order order) noexcept;
+	void LinkNewest(int chunk, Order order) noexcept;
+	void Touch(int chunk) noexcept;
+	void UpdateOrder(int chunk) noexcept;
+	int LeastRecent(int pinned, Order order) const noexcept;
+	void Trim(int pinned);
+public:
+	UndoStore();
+	// Deleted so UndoStore objects can not be copied.
+	UndoStore(const UndoStore &) = delete;
+	UndoStore(UndoStore &&) = delete;
+	void operator=(const UndoStore &) = delete;
+	void operator=(UndoStore &&) = delete;
+	~UndoStore();
+
+	const char *Add(const char *data, size_t lenData, int &chunk, unsigned int &offset);
+	void Release(int chunk);
+	/// Returns null when the chunk was moved out of memory and can not be read back
+	const char *Fetch(int chunk, unsigned int offset);
+	void Clear();
+
+	/// A budget of 0 means no limit so nothing is compressed or spilled
+	void SetBudget(size_t budget_);
+	size_t Budget() const noexcept { return budget; }
+	void SetCompression(bool compression_);
+	bool Compression() const noexcept { return compression; }
+	size_t ResidentBytes() const noexcept { return residentBytes; }
+	size_t SpilledBytes() const noexcept { return spilledBytes; }
 };
 
 /**
@@ -59,8 +146,12 @@ class UndoHistory {
 	int undoSequenceDepth;
 	int savePoint;
 	int tentativePoint;
+	UndoStore store;
 
 	void EnsureUndoRoom();
+	void CreateAction(int index, actionType at, Sci::Position position=0, const char *data=nullptr, Sci::Position lengthData=0, bool mayCoalesce=true);
+	void ReleaseAction(Action &action);
+	void TruncateRedo(int newMax);
 
 public:
 	UndoHistory();
@@ -77,6 +168,9 @@ public:
 	void EndUndoAction();
 	void DropUndoSequence();
 	void DeleteUndoHistory();
+	/// Used when the text of an undo step is lost. The document no longer matches
+	/// any state in the history so it is also no longer at the save point.
+	void AbandonUndoHistory();
 
 	/// The save point is a marker in the undo stack where the container has stated that
 	/// the buffer was saved. Undo and redo can move over the save point.
@@ -93,14 +187,24 @@ public:
 	/// called that many times. Similarly for redo.
 	bool CanUndo() const;
 	int StartUndo();
-	const Action &GetUndoStep() const;
+	const Action &GetUndoStep();
 	void CompletedUndoStep();
 	bool CanRedo() const;
 	int StartRedo();
-	const Action &GetRedoStep() const;
+	const Action &GetRedoStep();
 	void CompletedRedoStep();
+
+	void SetMemoryBudget(size_t budget);
+	size_t MemoryBudget() const noexcept { return store.Budget(); }
+	void SetCompression(bool compression);
+	bool Compression() const noexcept { return store.Compression(); }
+	/// Memory used by the actions and their text, not counting text spilled to disk
+	size_t MemoryUsed() const noexcept;
+	size_t MemorySpilled() const noexcept { return store.SpilledBytes(); }
 };
 
+class PieceTable;
+
 /**
  * Holder for an expandable array of characters that supports undo and line markers.
  * Based on article "Data Structures in a Bit-Mapped Text Editor"
@@ -109,8 +213,11 @@ public:
 class CellBuffer {
 private:
 	bool hasStyles;
+	/// Styles were dropped by ReleaseStyles and are reallocated on the next styling.
+	bool stylesReleased;
 	bool largeDocument;
 	SplitVector<char> substance;
+	std::unique_ptr<PieceTable> pieces;	///< Used instead of substance for mapped text
 	SplitVector<char> style;
 	bool readOnly;
 	bool utf8Substance;
@@ -126,6 +233,8 @@ private:
 	void ResetLineEnds();
 	void RecalculateIndexLineStarts(Sci::Line lineFirst, Sci::Line lineLast);
 	bool MaintainingLineCharacterIndex() const noexcept;
+	char SubstanceAt(Sci::Position position) const noexcept;
+	void LeaveMapping();
 	/// Actions without undo
 	void BasicInsertString(Sci::Position position, const char *s, Sci::Position insertLength);
 	void BasicDeleteChars(Sci::Position position, Sci::Position deleteLength);
@@ -150,6 +259,27 @@ public:
 	const char *RangePointer(Sci::Position position, Sci::Position rangeLength);
 	Sci::Position GapPosition() const;
 
+	/// Store the text in a piece table over read-only text instead of copying it into the
+	/// gap buffer. Only for an empty buffer, the text is then inserted from text->Data().
+	bool SetMappedText(IMappedText *text, int options);
+	/// Refer to new mapped text that has the same contents, such as the file just saved.
+	bool RebaseMappedText(IMappedText *text);
+	bool IsMapped() const noexcept;
+	size_t MappedMemoryUsed() const noexcept;
+
+	/// Memory held by the text (including the piece table of mapped text), the styles
+	/// and the line start index. Mapped file pages are not counted.
+	size_t TextMemoryUsed() const noexcept;
+	size_t StyleMemoryUsed() const noexcept;
+	size_t LineMemoryUsed() const noexcept;
+	/// Give back the gap of the text and style buffers.
+	void Compact();
+	/// Free the style buffer of a document that has styles. RestoreStyles brings it
+	/// back filled with style 0, so the document has to be restyled from the start.
+	void ReleaseStyles();
+	bool RestoreStyles();
+	bool StylesReleased() const noexcept;
+
 	Sci::Position Length() const noexcept;
 	void Allocate(Sci::Position newSize);
 	void SetUTF8Substance(bool utf8Substance_);
@@ -197,16 +327,23 @@ public:
 	void EndUndoAction();
 	void AddUndoAction(Sci::Position token, bool mayCoalesce);
 	void DeleteUndoHistory();
+	void AbandonUndoHistory();
+	void SetUndoMemoryBudget(size_t budget);
+	size_t UndoMemoryBudget() const noexcept;
+	void SetUndoCompression(bool compression);
+	bool UndoCompression() const noexcept;
+	size_t UndoMemoryUsed() const noexcept;
+	size_t UndoMemorySpilled() const noexcept;
 
 	/// To perform an undo, StartUndo is called to retrieve the number of steps, then UndoStep is
 	/// called that many times. Similarly for redo.
 	bool CanUndo() const;
 	int StartUndo();
-	const Action &GetUndoStep() const;
+	const Action &GetUndoStep();
 	void PerformUndoStep();
 	bool CanRedo() const;
 	int StartRedo();
-	const Action &GetRedoStep() const;
+	const Action &GetRedoStep();
 	void PerformRedoStep();
 };
 
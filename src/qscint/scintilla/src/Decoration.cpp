@@ -66,6 +66,9 @@ public:
 	Sci::Position Runs() const override {
 		return rs.Runs();
 	}
+	size_t MemoryUsed() const noexcept override {
+		return sizeof(*this) + rs.MemoryUsed();
+	}
 };
 
 template <typename POS>
@@ -118,6 +121,8 @@ public:
 	void SetClickNotified(bool notified) override {
 		clickNotified = notified;
 	}
+
+	size_t MemoryUsed() const noexcept override;
 };
 
 template <typename POS>
@@ -130,6 +135,16 @@ DecorationList<POS>::~DecorationList() {
 	current = nullptr;
 }
 
+template <typename POS>
+size_t DecorationList<POS>::MemoryUsed() const noexcept {
+	size_t memory = decorationList.capacity() * sizeof(decorationList[0]) +
+		decorationView.capacity() * sizeof(decorationView[0]);
+	for (const std::unique_ptr<Decoration<POS>> &deco : decorationList) {
+		memory += deco->MemoryUsed();
+	}
+	return memory;
+}
+
 template <typename POS>
 Decoration<POS> *DecorationList<POS>::DecorationFromIndicator(int indicator) {
 	for (const std::unique_ptr<Decoration<POS>> &deco : decorationList) {
@@ -21,6 +21,7 @@ public:
 	virtual void SetValueAt(Sci::Position position, int value) = 0;
 	virtual void InsertSpace(Sci::Position position, Sci::Position insertLength) = 0;
 	virtual Sci::Position Runs() const = 0;
+	virtual size_t MemoryUsed() const noexcept = 0;
 };
 
 class IDecorationList {
@@ -48,6 +49,8 @@ public:
 
 	virtual bool ClickNotified() const = 0;
 	virtual void SetClickNotified(bool notified) = 0;
+
+	virtual size_t MemoryUsed() const noexcept = 0;
 };
 
 std::unique_ptr<IDecoration> DecorationCreate(bool largeDocument, int indicator);
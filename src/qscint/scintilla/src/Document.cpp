@@ -19,6 +19,9 @@
 #include <algorithm>
 #include <memory>
 #include <chrono>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
 
 #ifndef NO_CXX11_REGEX
 #include <regex>
@@ -46,6 +49,8 @@
 #include "UniConversion.h"
 #include "ElapsedPeriod.h"
 #include "BoostRegexSearch.h"
+#include "BackgroundLexer.h"
+#include "FoldIndex.h"
 
 
 
@@ -138,12 +143,20 @@ Document::Document(int options) :
 
 	matchesValid = false;
 
+	modificationVersion = 0;
+	provisionalVersion = -1;
+	provisionalStart = 0;
+	provisionalEnd = 0;
+
 	perLineData[ldMarkers].reset(new LineMarkers());
 	perLineData[ldLevels].reset(new LineLevels());
 	perLineData[ldState].reset(new LineState());
 	perLineData[ldMargin].reset(new LineAnnotation());
 	perLineData[ldAnnotation].reset(new LineAnnotation());
 
+	foldIndex.reset(new FoldIndex());
+	foldScanned = 0;
+
 	decorations = DecorationListCreate(IsLarge());
 
 	cb.SetPerLine(this);
@@ -175,6 +188,7 @@ void Document::Init() {
 		if (pl)
 			pl->Init();
 	}
+	InvalidateFoldIndex();
 }
 
 void Document::InsertLine(Sci::Line line) {
@@ -182,6 +196,7 @@ void Document::InsertLine(Sci::Line line) {
 		if (pl)
 			pl->InsertLine(line);
 	}
+	InvalidateFoldIndex();
 }
 
 void Document::RemoveLine(Sci::Line line) {
@@ -189,6 +204,7 @@ void Document::RemoveLine(Sci::Line line) {
 		if (pl)
 			pl->RemoveLine(line);
 	}
+	InvalidateFoldIndex();
 }
 
 LineMarkers *Document::Markers() const {
@@ -266,6 +282,11 @@ void Document::TentativeUndo() {
 			for (int step = 0; step < steps; step++) {
 				const Sci::Line prevLinesTotal = LinesTotal();
 				const Action &action = cb.GetUndoStep();
+				if (action.TextLost()) {
+					// The text was moved out of memory and could not be read back so the history is unusable
+					cb.AbandonUndoHistory();
+					break;
+				}
 				if (action.at == removeAction) {
 					NotifyModified(DocModification(
 									SC_MOD_BEFOREINSERT | SC_PERFORMED_UNDO, action));
@@ -300,7 +321,7 @@ void Document::TentativeUndo() {
 						modFlags |= SC_MULTILINEUNDOREDO;
 				}
 				NotifyModified(DocModification(modFlags, action.position, action.lenData,
-											   linesAdded, action.data.get()));
+											   linesAdded, action.data));
 			}
 
 			const bool endSavePoint = cb.IsSavePoint();
@@ -513,6 +534,7 @@ int SCI_METHOD Document::SetLevel(Sci_Position line, int level) {
 	level &= ~SC_FOLDLEVELWHITEFLAG;
 	const int prev = Levels()->SetLevel(static_cast<Sci::Line>(line), level, LinesTotal());
 	if (prev != level) {
+		InvalidateFoldIndex();
 		DocModification mh(SC_MOD_CHANGEFOLD | SC_MOD_CHANGEMARKER,
 		                   LineStart(line), 0, 0, nullptr, static_cast<Sci::Line>(line));
 		mh.foldLevelNow = level;
@@ -528,6 +550,28 @@ int SCI_METHOD Document::GetLevel(Sci_Position line) const {
 
 void Document::ClearLevels() {
 	Levels()->ClearLevels();
+	InvalidateFoldIndex();
+}
+
+void Document::InvalidateFoldIndex() noexcept {
+	if (foldIndex)
+		foldIndex->Invalidate();
+	foldScanned = 0;
+}
+
+// Scanning is cheap while fold levels keep changing, as they do while lexing, but repeated
+// scans of a document that is not changing, such as when folding many headers, cost more
+// than indexing. Index once the scans since the last change have covered the document.
+void Document::FoldScanned(Sci::Line lines) const {
+	foldScanned += lines;
+	if (!foldIndex->Valid() && (foldScanned > LinesTotal()))
+		foldIndex->Build(*Levels(), LinesTotal());
+}
+
+const FoldIndex &Document::FoldStructure() {
+	if (!foldIndex->Valid())
+		foldIndex->Build(*Levels(), LinesTotal());
+	return *foldIndex;
 }
 
 static bool IsSubordinate(int levelStart, int levelTry) {
@@ -540,6 +584,15 @@ static bool IsSubordinate(int levelStart, int levelTry) {
 Sci::Line Document::GetLastChild(Sci::Line lineParent, int level, Sci::Line lastLine) {
 	if (level == -1)
 		level = LevelNumber(GetLevel(lineParent));
+	if (foldIndex->Valid() && (lastLine == -1) && (level == LevelNumber(GetLevel(lineParent)))) {
+		const Sci::Line lineLastChild = foldIndex->LastChild(lineParent);
+		if (lineLastChild >= 0) {
+			EnsureStyledTo(LineStart(lineLastChild + 2));
+			// Styling the lines may have changed their levels
+			if (foldIndex->Valid())
+				return lineLastChild;
+		}
+	}
 	const Sci::Line maxLine = LinesTotal();
 	const Sci::Line lookLastLine = (lastLine != -1) ? std::min(LinesTotal() - 1, lastLine) : -1;
 	Sci::Line lineMaxSubord = lineParent;
@@ -559,11 +612,14 @@ Sci::Line Document::GetLastChild(Sci::Line lineParent, int level, Sci::Line last
 			}
 		}
 	}
+	FoldScanned(lineMaxSubord - lineParent + 1);
 	return lineMaxSubord;
 }
 
 Sci::Line Document::GetFoldParent(Sci::Line line) const {
 	const int level = LevelNumber(GetLevel(line));
+	if (foldIndex->Valid())
+		return foldIndex->Parent(line, level);
 	Sci::Line lineLook = line - 1;
 	while ((lineLook > 0) && (
 	            (!(GetLevel(lineLook) & SC_FOLDLEVELHEADERFLAG)) ||
@@ -571,6 +627,7 @@ Sci::Line Document::GetFoldParent(Sci::Line line) const {
 	      ) {
 		lineLook--;
 	}
+	FoldScanned(line - lineLook);
 	if ((GetLevel(lineLook) & SC_FOLDLEVELHEADERFLAG) &&
 	        (LevelNumber(GetLevel(lineLook)) < level)) {
 		return lineLook;
@@ -1207,6 +1264,8 @@ EncodingFamily Document::CodePageFamily() const noexcept {
 void Document::ModifiedAt(Sci::Position pos) noexcept {
 	if (endStyled > pos)
 		endStyled = pos;
+	// Background and provisional styling results from before this are stale
+	modificationVersion++;
 }
 
 void Document::CheckReadOnly() {
@@ -1309,6 +1368,94 @@ Sci::Position Document::InsertString(Sci::Position position, const char *s, Sci:
 	return insertLength;
 }
 
+/**
+ * Replace ranges that are in document order and do not overlap as one modification with one undo step.
+ * The ranges are changed from last to first, then watchers are told once that the text from the start
+ * of the first range to the end of the last range was replaced. They see the final text during both
+ * the deletion and the insertion notifications.
+ * Returns the change in document length.
+ */
+Sci::Position Document::ReplaceRanges(const std::vector<RangeReplacement> &ranges) {
+	if (ranges.empty()) {
+		return 0;
+	}
+	Sci::Position endPrevious = 0;
+	for (const RangeReplacement &range : ranges) {
+		if ((range.position < endPrevious) || (range.lengthRemove < 0) || (range.lengthInsert < 0))
+			return 0;
+		endPrevious = range.position + range.lengthRemove;
+	}
+	const Sci::Position blockStart = ranges.front().position;
+	const Sci::Position blockEnd = endPrevious;
+	if (blockEnd > Length()) {
+		return 0;
+	}
+	CheckReadOnly();
+	if (cb.IsReadOnly() || (enteredModification != 0)) {
+		return 0;
+	}
+	enteredModification++;
+
+	// Old and new text of the whole block for the notifications
+	std::string removed(blockEnd - blockStart, '\0');
+	cb.GetCharRange(&removed[0], blockStart, removed.length());
+	std::string inserted;
+	Sci::Position copied = blockStart;
+	for (const RangeReplacement &range : ranges) {
+		inserted.append(removed, copied - blockStart, range.position - copied);
+		inserted.append(range.text, range.lengthInsert);
+		copied = range.position + range.lengthRemove;
+	}
+
+	NotifyModified(
+		DocModification(
+			SC_MOD_BEFOREDELETE | SC_PERFORMED_USER,
+			blockStart, removed.length(),
+			0, 0));
+	const Sci::Line prevLinesTotal = LinesTotal();
+	const bool startSavePoint = cb.IsSavePoint();
+	bool startSequence = false;
+	cb.BeginUndoAction();
+	for (std::vector<RangeReplacement>::const_reverse_iterator it = ranges.rbegin(); it != ranges.rend(); ++it) {
+		bool startAction = false;
+		if (it->lengthRemove > 0) {
+			cb.DeleteChars(it->position, it->lengthRemove, startAction);
+			decorations->DeleteRange(it->position, it->lengthRemove);
+			startSequence = startSequence || startAction;
+		}
+		if (it->lengthInsert > 0) {
+			cb.InsertString(it->position, it->text, it->lengthInsert, startAction);
+			decorations->InsertSpace(it->position, it->lengthInsert);
+			startSequence = startSequence || startAction;
+		}
+	}
+	cb.EndUndoAction();
+	if (startSavePoint && cb.IsCollectingUndo())
+		NotifySavePoint(!startSavePoint);
+	ModifiedAt(blockStart);
+	if (!removed.empty()) {
+		NotifyWatchers(
+			DocModification(
+				SC_MOD_DELETETEXT | SC_PERFORMED_USER | (startSequence ? SC_STARTACTION : 0),
+				blockStart, removed.length(),
+				0, removed.c_str()));
+	}
+	if (!inserted.empty()) {
+		NotifyWatchers(
+			DocModification(
+				SC_MOD_BEFOREINSERT | SC_PERFORMED_USER,
+				blockStart, inserted.length(),
+				0, inserted.c_str()));
+		NotifyWatchers(
+			DocModification(
+				SC_MOD_INSERTTEXT | SC_PERFORMED_USER | ((startSequence && removed.empty()) ? SC_STARTACTION : 0),
+				blockStart, inserted.length(),
+				LinesTotal() - prevLinesTotal, inserted.c_str()));
+	}
+	enteredModification--;
+	return inserted.length() - removed.length();
+}
+
 void Document::ChangeInsertion(const char *s, Sci::Position length) {
 	insertionSet = true;
 	insertion.assign(s, length);
@@ -1330,6 +1477,26 @@ void * SCI_METHOD Document::ConvertToDocument() {
 	return this;
 }
 
+// The text of an empty document becomes the mapped text without copying it. Loading is not undoable.
+bool Document::SetMappedText(IMappedText *text, int options) {
+	if (enteredModification != 0) {
+		text->Release();
+		return false;
+	}
+	const bool wasLarge = IsLarge();
+	if (!cb.SetMappedText(text, options))
+		return false;
+	if (IsLarge() != wasLarge) {
+		cb.SetPerLine(this);
+		decorations = DecorationListCreate(true);
+	}
+	const bool collectingUndo = cb.IsCollectingUndo();
+	cb.SetUndoCollection(false);
+	InsertString(0, text->Data(), text->Length());
+	cb.SetUndoCollection(collectingUndo);
+	return true;
+}
+
 Sci::Position Document::Undo() {
 	Sci::Position newPos = -1;
 	CheckReadOnly();
@@ -1347,6 +1514,11 @@ Sci::Position Document::Undo() {
 			for (int step = 0; step < steps; step++) {
 				const Sci::Line prevLinesTotal = LinesTotal();
 				const Action &action = cb.GetUndoStep();
+				if (action.TextLost()) {
+					// The text was moved out of memory and could not be read back so the history is unusable
+					cb.AbandonUndoHistory();
+					break;
+				}
 				if (action.at == removeAction) {
 					NotifyModified(DocModification(
 									SC_MOD_BEFOREINSERT | SC_PERFORMED_UNDO, action));
@@ -1403,7 +1575,7 @@ Sci::Position Document::Undo() {
 						modFlags |= SC_MULTILINEUNDOREDO;
 				}
 				NotifyModified(DocModification(modFlags, action.position, action.lenData,
-											   linesAdded, action.data.get()));
+											   linesAdded, action.data));
 			}
 
 			const bool endSavePoint = cb.IsSavePoint();
@@ -1427,6 +1599,11 @@ Sci::Position Document::Redo() {
 			for (int step = 0; step < steps; step++) {
 				const Sci::Line prevLinesTotal = LinesTotal();
 				const Action &action = cb.GetRedoStep();
+				if (action.TextLost()) {
+					// The text was moved out of memory and could not be read back so the history is unusable
+					cb.AbandonUndoHistory();
+					break;
+				}
 				if (action.at == insertAction) {
 					NotifyModified(DocModification(
 									SC_MOD_BEFOREINSERT | SC_PERFORMED_REDO, action));
@@ -1463,7 +1640,7 @@ Sci::Position Document::Redo() {
 				}
 				NotifyModified(
 					DocModification(modFlags, action.position, action.lenData,
-									linesAdded, action.data.get()));
+									linesAdded, action.data));
 			}
 
 			const bool endSavePoint = cb.IsSavePoint();
@@ -2000,6 +2177,40 @@ bool Document::HasCaseFolder() const noexcept {
 	return pcf != nullptr;
 }
 
+size_t Document::MemoryUsed() const noexcept {
+	size_t memory = 0;
+	for (int component = SC_MEMORY_TEXT; component <= SC_MEMORY_UNDO; component++) {
+		memory += MemoryUsed(component);
+	}
+	return memory;
+}
+
+size_t Document::MemoryUsed(int component) const noexcept {
+	switch (component) {
+	case SC_MEMORY_TEXT:
+		return cb.TextMemoryUsed();
+	case SC_MEMORY_STYLES:
+		return cb.StyleMemoryUsed();
+	case SC_MEMORY_LINES:
+		return cb.LineMemoryUsed();
+	case SC_MEMORY_MARKERS:
+		return perLineData[ldMarkers]->MemoryUsed();
+	case SC_MEMORY_LINEDATA: {
+			size_t memory = 0;
+			for (int ld = ldLevels; ld < ldSize; ld++) {
+				memory += perLineData[ld]->MemoryUsed();
+			}
+			return memory;
+		}
+	case SC_MEMORY_INDICATORS:
+		return decorations->MemoryUsed();
+	case SC_MEMORY_UNDO:
+		return cb.UndoMemoryUsed();
+	default:
+		return 0;
+	}
+}
+
 void Document::SetCaseFolder(CaseFolder *pcf_) {
 	pcf.reset(pcf_);
 }
@@ -2224,6 +2435,8 @@ int Document::GetCharsOfClass(CharClassify::cc characterClass, unsigned char *bu
 }
 
 void SCI_METHOD Document::StartStyling(Sci_Position position, char) {
+	// Released styles come back as style 0; endStyled was reset when they were released
+	cb.RestoreStyles();
 	endStyled = position;
 }
 
@@ -2272,6 +2485,14 @@ bool SCI_METHOD Document::SetStyles(Sci_Position length, const char *styles) {
 	}
 }
 
+void Document::ReleaseStyles() {
+	if ((enteredStyling != 0) || !cb.HasStyles())
+		return;
+	cb.ReleaseStyles();
+	// Restyle from the start when the styles are wanted again
+	ModifiedAt(0);
+}
+
 void Document::EnsureStyledTo(Sci::Position pos) {
 	if ((enteredStyling == 0) && (pos > GetEndStyled())) {
 		IncrementStyleClock();
@@ -2298,12 +2519,128 @@ void Document::StyleToAdjustingLineDuration(Sci::Position pos) {
 }
 
 void Document::LexerChanged() {
+	modificationVersion++;
 	// Tell the watchers the lexer has changed.
 	for (const WatcherWithUserData &watcher : watchers) {
 		watcher.watcher->NotifyLexerChanged(this, watcher.userData);
 	}
 }
 
+namespace {
+
+// Bytes lexed by each background job, lines copied before it for lexers that look back
+// and bytes copied after it for lexers that look ahead.
+const Sci::Position backgroundStyleChunk = 0x40000;
+const Sci::Line backgroundStyleLookBack = 200;
+const Sci::Position backgroundStyleLookAhead = 0x1000;
+
+}
+
+bool Document::BackgroundStylingAvailable() {
+	if (!pli || pli->UseContainerLexing() || !cb.HasStyles())
+		return false;
+	if (!backgroundLexer)
+		backgroundLexer.reset(new BackgroundLexer());
+	if (backgroundLexer->Generation() != pli->Generation()) {
+		// Lexer or its settings changed: use a new copy once the worker is idle
+		if (backgroundLexer->Busy()) {
+			backgroundLexer->Cancel();
+		} else {
+			backgroundLexer->SetInstance(pli->CreateBackgroundInstance(), pli->Generation());
+		}
+	}
+	return backgroundLexer->HasInstance();
+}
+
+// Style [start, end) with the document's lexer but leave endStyled alone so the background
+// lexer still styles this text properly later. Repeated calls for the same text do nothing
+// until the document changes.
+void Document::StyleProvisionally(Sci::Position start, Sci::Position end) {
+	if (!pli || pli->UseContainerLexing() || (enteredStyling != 0))
+		return;
+	start = LineStart(SciLineFromPosition(std::max(start, endStyled)));
+	end = std::min(end, Length());
+	if (start >= end)
+		return;
+	const bool cached = provisionalVersion == modificationVersion;
+	if (cached && (start >= provisionalStart) && (end <= provisionalEnd))
+		return;
+	const Sci::Position endStyledKept = endStyled;
+	IncrementStyleClock();
+	pli->Colourise(start, end);
+	endStyled = endStyledKept;
+	if (cached && (start <= provisionalEnd) && (end >= provisionalStart)) {
+		provisionalStart = std::min(start, provisionalStart);
+		provisionalEnd = std::max(end, provisionalEnd);
+	} else {
+		provisionalStart = start;
+		provisionalEnd = end;
+	}
+	provisionalVersion = modificationVersion;
+}
+
+// Apply the result of the last background job if the document has not changed since it was
+// copied then start on the next chunk. Returns false when there is nothing left to style.
+bool Document::BackgroundStyleStep() {
+	if (!BackgroundStylingAvailable())
+		return false;
+
+	std::unique_ptr<BackgroundLexJob> job = backgroundLexer->TakeFinished();
+	if (job && (job->version == modificationVersion) && (job->endStyled == endStyled) && (enteredStyling == 0)) {
+		const LexSnapshot &snapshot = job->snapshot;
+		IncrementStyleClock();
+		StartStyling(job->start, '\377');
+		SetStyles(job->end - job->start, &snapshot.styles[job->start - snapshot.textStart]);
+		const Sci::Line lineEnd = SciLineFromPosition(job->end);
+		for (Sci::Line line = SciLineFromPosition(job->start); line <= lineEnd; line++) {
+			SetLineState(line, snapshot.GetLineState(line));
+			SetLevel(line, snapshot.GetLevel(line));
+		}
+	}
+
+	const Sci::Position lengthDoc = Length();
+	if (endStyled >= lengthDoc)
+		return false;
+	if (backgroundLexer->Busy())
+		return true;
+
+	const Sci::Line lineStart = SciLineFromPosition(endStyled);
+	const Sci::Position start = LineStart(lineStart);
+	const Sci::Position end = std::min(LineStart(SciLineFromPosition(std::min(start + backgroundStyleChunk, lengthDoc)) + 1), lengthDoc);
+	const Sci::Line lineFirst = std::max<Sci::Line>(lineStart - backgroundStyleLookBack, 0);
+	const Sci::Position textStart = LineStart(lineFirst);
+	const Sci::Position textEnd = std::min(end + backgroundStyleLookAhead, lengthDoc);
+	const Sci::Line lineLast = SciLineFromPosition(textEnd);
+
+	std::unique_ptr<BackgroundLexJob> next(new BackgroundLexJob());
+	LexSnapshot &snapshot = next->snapshot;
+	snapshot.textStart = textStart;
+	snapshot.text.resize(textEnd - textStart);
+	cb.GetCharRange(&snapshot.text[0], textStart, textEnd - textStart);
+	snapshot.styles.resize(textEnd - textStart);
+	cb.GetStyleRange(reinterpret_cast<unsigned char *>(snapshot.styles.data()), textStart, start - textStart);
+	snapshot.lineFirst = lineFirst;
+	for (Sci::Line line = lineFirst; line <= lineLast; line++) {
+		snapshot.lineStarts.push_back(LineStart(line));
+	}
+	for (Sci::Line line = lineFirst - 1; line <= lineLast + 1; line++) {
+		snapshot.lineStates.push_back(GetLineState(line));
+		snapshot.levels.push_back(GetLevel(line));
+	}
+	snapshot.codePage = dbcsCodePage;
+	snapshot.tabInChars = tabInChars;
+	for (int ch = 0; ch < 256; ch++) {
+		snapshot.dbcsLeadBytes[ch] = IsDBCSLeadByteNoExcept(static_cast<char>(ch));
+	}
+	next->start = start;
+	next->end = end;
+	next->initStyle = (start > 0) ? StyleAt(start - 1) : 0;
+	next->version = modificationVersion;
+	next->endStyled = endStyled;
+	backgroundLexer->Submit(std::move(next));
+	return true;
+}
+
 LexInterface *Document::GetLexInterface() const {
 	return pli.get();
 }
@@ -2468,6 +2805,11 @@ void Document::NotifyModified(DocModification mh) {
 	} else if (mh.modificationType & SC_MOD_DELETETEXT) {
 		decorations->DeleteRange(mh.position, mh.length);
 	}
+	NotifyWatchers(mh);
+}
+
+// Decorations have already been moved.
+void Document::NotifyWatchers(DocModification mh) {
 	for (const WatcherWithUserData &watcher : watchers) {
 		watcher.watcher->NotifyModified(this, mh, watcher.userData);
 	}
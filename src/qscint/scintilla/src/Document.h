@@ -17,6 +17,8 @@ class LineMarkers;
 class LineLevels;
 class LineState;
 class LineAnnotation;
+class BackgroundLexer;
+class FoldIndex;
 
 enum EncodingFamily { efEightBit, efUnicode, efDBCS };
 
@@ -124,6 +126,17 @@ struct StyledText {
 	}
 };
 
+/// One range of Document::ReplaceRanges: lengthRemove bytes at position are replaced by text.
+struct RangeReplacement {
+	Sci::Position position;
+	Sci::Position lengthRemove;
+	const char *text;
+	Sci::Position lengthInsert;
+	RangeReplacement(Sci::Position position_, Sci::Position lengthRemove_, const char *text_, Sci::Position lengthInsert_) noexcept :
+		position(position_), lengthRemove(lengthRemove_), text(text_), lengthInsert(lengthInsert_) {
+	}
+};
+
 class HighlightDelimiter {
 public:
 	HighlightDelimiter() : isEnabled(false) {
@@ -173,13 +186,22 @@ protected:
 	Document *pdoc;
 	ILexer *instance;
 	bool performingStyle;	///< Prevent reentrance
+	int generation;	///< Changes when the lexer, its properties or its word lists change
 public:
-	explicit LexInterface(Document *pdoc_) : pdoc(pdoc_), instance(nullptr), performingStyle(false) {
+	explicit LexInterface(Document *pdoc_) : pdoc(pdoc_), instance(nullptr), performingStyle(false), generation(0) {
 	}
 	virtual ~LexInterface() {
 	}
 	void Colourise(Sci::Position start, Sci::Position end);
 	virtual int LineEndTypesSupported();
+	// A new lexer instance configured like this one for lexing on another thread.
+	// nullptr when that is not possible.
+	virtual ILexer *CreateBackgroundInstance() {
+		return nullptr;
+	}
+	int Generation() const noexcept {
+		return generation;
+	}
 	bool UseContainerLexing() const {
 		return instance == nullptr;
 	}
@@ -251,10 +273,26 @@ private:
 	LineAnnotation *Margins() const;
 	LineAnnotation *Annotations() const;
 
+	// Fold headers indexed once enough lines have been scanned for parents and last children
+	// since the fold levels last changed.
+	std::unique_ptr<FoldIndex> foldIndex;
+	mutable Sci::Line foldScanned;
+	void InvalidateFoldIndex() noexcept;
+	void FoldScanned(Sci::Line lines) const;
+
 	bool matchesValid;
 	std::unique_ptr<RegexSearchBase> regex;
 	std::unique_ptr<LexInterface> pli;
 
+	// Background styling: the worker lexes a copy of text after endStyled and the results are
+	// applied when they still match the document. The visible text ahead of endStyled is styled
+	// provisionally in the meantime.
+	std::unique_ptr<BackgroundLexer> backgroundLexer;
+	int modificationVersion;
+	int provisionalVersion;
+	Sci::Position provisionalStart;
+	Sci::Position provisionalEnd;
+
 public:
 
 	struct CharacterExtracted {
@@ -298,6 +336,8 @@ public:
 	void Init() override;
 	void InsertLine(Sci::Line line) override;
 	void RemoveLine(Sci::Line line) override;
+	/// Total of the document components
+	size_t MemoryUsed() const noexcept override;
 
 	int LineEndTypesSupported() const;
 	bool SetDBCSCodePage(int dbcsCodePage_);
@@ -340,6 +380,7 @@ public:
 	void CheckReadOnly();
 	bool DeleteChars(Sci::Position pos, Sci::Position len);
 	Sci::Position InsertString(Sci::Position position, const char *s, Sci::Position insertLength);
+	Sci::Position ReplaceRanges(const std::vector<RangeReplacement> &ranges);
 	void ChangeInsertion(const char *s, Sci::Position length);
 	int SCI_METHOD AddData(const char *data, Sci_Position length) override;
 	void * SCI_METHOD ConvertToDocument() override;
@@ -348,6 +389,20 @@ public:
 	bool CanUndo() const { return cb.CanUndo(); }
 	bool CanRedo() const { return cb.CanRedo(); }
 	void DeleteUndoHistory() { cb.DeleteUndoHistory(); }
+	bool SetMappedText(IMappedText *text, int options);
+	bool RebaseMappedText(IMappedText *text) { return cb.RebaseMappedText(text); }
+	bool IsMapped() const noexcept { return cb.IsMapped(); }
+	size_t MappedMemoryUsed() const noexcept { return cb.MappedMemoryUsed(); }
+	void SetUndoMemoryBudget(size_t budget) { cb.SetUndoMemoryBudget(budget); }
+	size_t UndoMemoryBudget() const noexcept { return cb.UndoMemoryBudget(); }
+	void SetUndoCompression(bool compression) { cb.SetUndoCompression(compression); }
+	bool UndoCompression() const noexcept { return cb.UndoCompression(); }
+	size_t UndoMemoryUsed() const noexcept { return cb.UndoMemoryUsed(); }
+	size_t UndoMemorySpilled() const noexcept { return cb.UndoMemorySpilled(); }
+	/// Memory used by one component of the document, SC_MEMORY_*. View components return 0.
+	size_t MemoryUsed(int component) const noexcept;
+	void Compact() { cb.Compact(); }
+	void ReleaseStyles();
 	bool SetUndoCollection(bool collectUndo) {
 		return cb.SetUndoCollection(collectUndo);
 	}
@@ -421,6 +476,7 @@ public:
 	void ClearLevels();
 	Sci::Line GetLastChild(Sci::Line lineParent, int level=-1, Sci::Line lastLine=-1);
 	Sci::Line GetFoldParent(Sci::Line line) const;
+	const FoldIndex &FoldStructure();
 	void GetHighlightDelimiters(HighlightDelimiter &highlightDelimiter, Sci::Line line, Sci::Line lastLine);
 
 	Sci::Position ExtendWordSelect(Sci::Position pos, int delta, bool onlyWordCharacters=false) const;
@@ -455,6 +511,9 @@ public:
 	void EnsureStyledTo(Sci::Position pos);
 	void StyleToAdjustingLineDuration(Sci::Position pos);
 	void LexerChanged();
+	bool BackgroundStylingAvailable();
+	void StyleProvisionally(Sci::Position start, Sci::Position end);
+	bool BackgroundStyleStep();
 	int GetStyleClock() const noexcept { return styleClock; }
 	void IncrementStyleClock() noexcept;
 	void SCI_METHOD DecorationSetCurrentIndicator(int indicator) override;
@@ -499,6 +558,7 @@ private:
 	void NotifyModifyAttempt();
 	void NotifySavePoint(bool atSavePoint);
 	void NotifyModified(DocModification mh);
+	void NotifyWatchers(DocModification mh);
 };
 
 class UndoGroup {
@@ -558,7 +618,7 @@ public:
 		position(act.position),
 		length(act.lenData),
 		linesAdded(linesAdded_),
-		text(act.data.get()),
+		text(act.data),
 		line(0),
 		foldLevelNow(0),
 		foldLevelPrev(0),
@@ -345,6 +345,308 @@ LineLayout *EditView::RetrieveLineLayout(Sci::Line lineNumber, const EditModel &
 		model.LinesOnScreen() + 1, model.pdoc->LinesTotal());
 }
 
+/**
+* Copy [start, end) of the line and its styles from the document into the layout, changing the
+* case of characters in styles that force case.
+*/
+static void FillLayoutChars(const EditModel &model, const ViewStyle &vstyle, LineLayout *ll,
+	Sci::Position posLineStart, int start, int end) {
+	model.pdoc->GetCharRange(&ll->chars[start], posLineStart + start, end - start);
+	model.pdoc->GetStyleRange(&ll->styles[start], posLineStart + start, end - start);
+	if (vstyle.someStylesForceCase) {
+		for (int charInLine = start; charInLine<end; charInLine++) {
+			const char chDoc = ll->chars[charInLine];
+			if (vstyle.styles[ll->styles[charInLine]].caseForce == Style::caseUpper)
+				ll->chars[charInLine] = MakeUpperCase(chDoc);
+			else if (vstyle.styles[ll->styles[charInLine]].caseForce == Style::caseLower)
+				ll->chars[charInLine] = MakeLowerCase(chDoc);
+			else if (vstyle.styles[ll->styles[charInLine]].caseForce == Style::caseCamel) {
+				if ((model.pdoc->IsASCIIWordByte(ll->chars[charInLine])) &&
+				  ((charInLine == 0) || (!model.pdoc->IsASCIIWordByte(ll->chars[charInLine - 1])))) {
+					ll->chars[charInLine] = MakeUpperCase(chDoc);
+				} else {
+					ll->chars[charInLine] = MakeLowerCase(chDoc);
+				}
+			}
+		}
+	}
+}
+
+/**
+* Determine the position of each character in @a range of the line. The relative position of
+* the start of the range must already be set and the other positions are relative to the same origin.
+* Returns true when the last segment measured was italic.
+*/
+bool EditView::MeasureRange(const EditModel &model, Sci::Line line, Surface *surface, const ViewStyle &vstyle,
+	LineLayout *ll, Range range, Sci::Position posLineStart) {
+	XYPOSITION *positions = ll->positions.Relative();
+	bool lastSegItalics = false;
+
+	BreakFinder bfLayout(ll, nullptr, range, posLineStart, 0, false, model.pdoc, &model.reprs, nullptr);
+	while (bfLayout.More()) {
+
+		const TextSegment ts = bfLayout.Next();
+
+		std::fill(&positions[ts.start + 1], &positions[ts.end() + 1], 0.0f);
+		if (vstyle.styles[ll->styles[ts.start]].visible) {
+			if (ts.representation) {
+				XYPOSITION representationWidth = vstyle.controlCharWidth;
+				if (ll->chars[ts.start] == '\t') {
+					// Tab is a special case of representation, taking a variable amount of space
+					const XYPOSITION x = positions[ts.start];
+					representationWidth = NextTabstopPos(line, x, vstyle.tabWidth) - positions[ts.start];
+				} else {
+					if (representationWidth <= 0.0) {
+						XYPOSITION positionsRepr[256];	// Should expand when needed
+						posCache.MeasureWidths(surface, vstyle, STYLE_CONTROLCHAR, ts.representation->stringRep.c_str(),
+							static_cast<unsigned int>(ts.representation->stringRep.length()), positionsRepr, model.pdoc);
+						representationWidth = positionsRepr[ts.representation->stringRep.length() - 1] + vstyle.ctrlCharPadding;
+					}
+				}
+				for (int ii = 0; ii < ts.length; ii++)
+					positions[ts.start + 1 + ii] = representationWidth;
+			} else {
+				if ((ts.length == 1) && (' ' == ll->chars[ts.start])) {
+					// Over half the segments are single characters and of these about half are space characters.
+					positions[ts.start + 1] = vstyle.styles[ll->styles[ts.start]].spaceWidth;
+				} else {
+					posCache.MeasureWidths(surface, vstyle, ll->styles[ts.start], &ll->chars[ts.start],
+						ts.length, &positions[ts.start + 1], model.pdoc);
+				}
+			}
+			lastSegItalics = (!ts.representation) && ((ll->chars[ts.end() - 1] != ' ') && vstyle.styles[ll->styles[ts.start]].italic);
+		}
+
+		for (Sci::Position posToIncrease = ts.start + 1; posToIncrease <= ts.end(); posToIncrease++) {
+			positions[posToIncrease] += positions[ts.start];
+		}
+	}
+	return lastSegItalics;
+}
+
+namespace {
+
+// Segments can not be seen beyond this many pixels from the left of the text area
+constexpr int widthVisibleMax = 8192;
+
+// The layout of a segmented line for a changed document is found from the old layout
+struct MovedSegment {
+	int start;
+	size_t segmentOld;
+	XYPOSITION relativeOld;
+	bool measured;
+};
+
+}
+
+/**
+* Lay out a line of LineLayout::segmentedLength bytes or more such as a minified file on one line.
+* Measuring all of such a line for each change and comparing all of it for each paint is too slow,
+* so the line is split into segments of LinePositions::segmentLength bytes. A segment is measured
+* when it can be seen or holds the caret, until then its characters are given the average width.
+* The changes noted by LineLayoutCache::NoteChange are copied from the document and only the
+* segments they touch lose their measurements; the positions after a change are moved with their text.
+* Each segment starts at the first character boundary at or after a multiple of the segment length
+* and tab stops are counted from the start of the segment.
+*/
+void EditView::LayoutSegmentedLine(const EditModel &model, Sci::Line line, Surface *surface, const ViewStyle &vstyle,
+	LineLayout *ll, bool measureAll) {
+	const Sci::Position posLineStart = model.pdoc->LineStart(line);
+	const int lineLength = static_cast<int>(model.pdoc->LineStart(line + 1) - posLineStart);
+	const int numCharsBeforeEOL = static_cast<int>(model.pdoc->LineEnd(line) - posLineStart);
+	const int numCharsInLine = (vstyle.viewEOL) ? lineLength : numCharsBeforeEOL;
+	const size_t segmentCount = (numCharsInLine >> LinePositions::segmentShift) + 1;
+	const XYPOSITION widthEstimate = vstyle.aveCharWidth;
+	ll->Grow(lineLength);
+
+	auto segmentStart = [&](size_t segment) -> int {
+		const Sci::Position start = static_cast<Sci::Position>(segment) << LinePositions::segmentShift;
+		if (start >= numCharsInLine)
+			return numCharsInLine;
+		return static_cast<int>(model.pdoc->MovePositionOutsideChar(posLineStart + start, 1) - posLineStart);
+	};
+	auto estimateSegment = [&](size_t segment) {
+		const int start = segmentStart(segment);
+		const int end = segmentStart(segment + 1);
+		const int first = static_cast<int>(segment << LinePositions::segmentShift);
+		const int last = std::min(static_cast<int>((segment + 1) << LinePositions::segmentShift), numCharsInLine + 1);
+		XYPOSITION *positions = ll->positions.Relative();
+		for (int i = first; i < last; i++) {
+			positions[i] = (i > start) ? (i - start) * widthEstimate : 0.0f;
+		}
+		ll->segments[segment] = LayoutSegment((end - start) * widthEstimate, false);
+	};
+	auto measureSegment = [&](size_t segment) {
+		const int start = segmentStart(segment);
+		const int end = segmentStart(segment + 1);
+		const int first = static_cast<int>(segment << LinePositions::segmentShift);
+		XYPOSITION *positions = ll->positions.Relative();
+		std::fill(positions + first, positions + start + 1, 0.0f);
+		MeasureRange(model, line, surface, vstyle, ll, Range(start, end), posLineStart);
+		ll->segments[segment] = LayoutSegment(positions[end], true);
+		// The end of a character that crosses into the next segment belongs to that segment
+		const int next = static_cast<int>((segment + 1) << LinePositions::segmentShift);
+		if (next <= end) {
+			std::fill(positions + next, positions + end + 1, 0.0f);
+		}
+	};
+
+	const bool changed = (ll->sameBefore < lineLength) || (ll->sameAfter < lineLength) || (ll->lengthLaidOut != lineLength);
+	const int eolLength = lineLength - numCharsInLine;
+	bool rebuild = !ll->segmented || (ll->validity == LineLayout::llInvalid) ||
+		(changed && (ll->lengthLaidOut - ll->numCharsInLine != eolLength));
+
+	if (!rebuild && changed) {
+		// Leave some bytes either side of the change as it can change the case of the next
+		// character and where the characters of the segments near it start.
+		const int lengthSame = std::min(ll->lengthLaidOut, lineLength);
+		const int before = std::max(std::min(ll->sameBefore, lengthSame) - UTF8MaxBytes, 0);
+		const int after = std::min(ll->sameAfter, lengthSame - before);
+		const int tail = std::max(after - eolLength - UTF8MaxBytes, 0);
+		const int delta = numCharsInLine - ll->numCharsInLine;
+		const int changeEnd = numCharsInLine - tail;
+		const size_t firstChanged = before >> LinePositions::segmentShift;
+		const size_t firstMoved = std::min((changeEnd + LinePositions::segmentLength - 1) >> LinePositions::segmentShift,
+			static_cast<int>(segmentCount));
+
+		// Where the moved segments were in the old layout
+		std::vector<XYPOSITION> xOld(ll->segments.size());
+		for (size_t segment = 0; segment < xOld.size(); segment++) {
+			xOld[segment] = ll->positions.SegmentX(segment);
+		}
+		std::vector<MovedSegment> moved;
+		for (size_t segment = firstMoved; segment <= segmentCount; segment++) {
+			const int start = segmentStart(segment);
+			MovedSegment ms = { start, static_cast<size_t>(start - delta) >> LinePositions::segmentShift,
+				ll->positions.Relative()[start - delta], true };
+			moved.push_back(ms);
+		}
+		for (size_t m = 0; m + 1 < moved.size(); m++) {
+			// Characters are measured by the old segment they start in
+			const size_t segmentOldLast = std::max(moved[m + 1].start - delta - 1, moved[m].start - delta) >> LinePositions::segmentShift;
+			for (size_t segmentOld = moved[m].segmentOld; segmentOld <= segmentOldLast; segmentOld++) {
+				if (!ll->segments[segmentOld].measured) {
+					moved[m].measured = false;
+				}
+			}
+		}
+
+		std::memmove(&ll->chars[changeEnd], &ll->chars[changeEnd - delta], tail);
+		std::memmove(&ll->styles[changeEnd], &ll->styles[changeEnd - delta], tail);
+		XYPOSITION *positions = ll->positions.Relative();
+		const int firstIndex = static_cast<int>(firstMoved << LinePositions::segmentShift);
+		auto moveIndex = [&](int i) {
+			const int iOld = i - delta;
+			const MovedSegment &ms = moved[(i >> LinePositions::segmentShift) - firstMoved];
+			if (i <= ms.start) {
+				positions[i] = 0.0f;
+			} else {
+				const XYACCUMULATOR xSegments = static_cast<XYACCUMULATOR>(xOld[iOld >> LinePositions::segmentShift]) - xOld[ms.segmentOld];
+				positions[i] = static_cast<XYPOSITION>(positions[iOld] - ms.relativeOld + xSegments);
+			}
+		};
+		if (delta > 0) {
+			for (int i = numCharsInLine; i >= firstIndex; i--)
+				moveIndex(i);
+		} else if (delta < 0) {
+			for (int i = firstIndex; i <= numCharsInLine; i++)
+				moveIndex(i);
+		}
+
+		std::vector<LayoutSegment> segmentsNew(segmentCount);
+		std::copy(ll->segments.begin(), ll->segments.begin() + std::min(firstChanged, ll->segments.size()), segmentsNew.begin());
+		for (size_t segment = firstMoved; segment < segmentCount; segment++) {
+			const MovedSegment &ms = moved[segment - firstMoved];
+			const MovedSegment &msNext = moved[segment + 1 - firstMoved];
+			const XYACCUMULATOR width = static_cast<XYACCUMULATOR>(xOld[msNext.segmentOld]) - xOld[ms.segmentOld] +
+				msNext.relativeOld - ms.relativeOld;
+			// Tabs moved to another place in their segment have other widths
+			const bool measured = ms.measured && !std::memchr(&ll->chars[ms.start], '\t', msNext.start - ms.start);
+			segmentsNew[segment] = LayoutSegment(static_cast<XYPOSITION>(width), measured);
+		}
+		ll->segments.swap(segmentsNew);
+
+		FillLayoutChars(model, vstyle, ll, posLineStart, before, changeEnd);
+		for (size_t segment = firstChanged; segment < firstMoved; segment++) {
+			estimateSegment(segment);
+		}
+	}
+
+	if (rebuild) {
+		FillLayoutChars(model, vstyle, ll, posLineStart, 0, lineLength);
+		ll->segments.assign(segmentCount, LayoutSegment());
+		for (size_t segment = 0; segment < segmentCount; segment++) {
+			estimateSegment(segment);
+		}
+	}
+
+	if (rebuild || changed) {
+		ll->widthLine = LineLayout::wrapWidthInfinite;
+		ll->lines = 1;
+		ll->edgeColumn = -1;
+		if (vstyle.edgeState == EDGE_BACKGROUND) {
+			const Sci::Position edgePosition = model.pdoc->FindColumn(line, vstyle.theEdge.column);
+			if (edgePosition >= posLineStart) {
+				ll->edgeColumn = static_cast<int>(edgePosition - posLineStart);
+			}
+		}
+		ll->xHighlightGuide = 0;
+		ll->chars[numCharsInLine] = 0;
+		ll->styles[numCharsInLine] = (lineLength > 0) ? model.pdoc->StyleIndexAt(posLineStart + lineLength - 1) : 0;
+		ll->numCharsInLine = numCharsInLine;
+		ll->numCharsBeforeEOL = numCharsBeforeEOL;
+		ll->segmented = true;
+		ll->lengthLaidOut = lineLength;
+		ll->sameBefore = lineLength;
+		ll->sameAfter = lineLength;
+		ll->SetSegmentPositions();
+		ll->validity = LineLayout::llPositions;
+	} else if (ll->validity == LineLayout::llCheckTextAndStyle) {
+		ll->validity = LineLayout::llPositions;
+	}
+
+	if (measureAll) {
+		// Wrapping needs all the positions
+		bool measured = false;
+		for (size_t segment = 0; segment < segmentCount; segment++) {
+			if (!ll->segments[segment].measured) {
+				measureSegment(segment);
+				measured = true;
+			}
+		}
+		if (measured) {
+			ll->SetSegmentPositions();
+			ll->validity = std::min(ll->validity, LineLayout::llPositions);
+		}
+		return;
+	}
+
+	const Sci::Position caretInLine = model.sel.MainCaret() - posLineStart;
+	if ((caretInLine >= 0) && (caretInLine <= numCharsInLine)) {
+		const size_t segment = static_cast<size_t>(caretInLine) >> LinePositions::segmentShift;
+		if (!ll->segments[segment].measured) {
+			measureSegment(segment);
+			ll->SetSegmentPositions();
+		}
+	}
+	// Measuring changes where the later segments are so look again
+	for (int pass = 0; pass < 3; pass++) {
+		const Range rangeLine(0, numCharsInLine);
+		const size_t first = ll->FindBefore(static_cast<XYPOSITION>(model.xOffset), rangeLine) >> LinePositions::segmentShift;
+		const size_t last = ll->FindBefore(static_cast<XYPOSITION>(model.xOffset + widthVisibleMax), rangeLine) >> LinePositions::segmentShift;
+		bool measured = false;
+		for (size_t segment = first; segment <= last; segment++) {
+			if (!ll->segments[segment].measured) {
+				measureSegment(segment);
+				measured = true;
+			}
+		}
+		if (!measured)
+			break;
+		ll->SetSegmentPositions();
+	}
+}
+
 /**
 * Fill in the LineLayout data for the given line.
 * Copy the given @a line and its styles from the document into local arrays.
@@ -362,6 +664,15 @@ void EditView::LayoutLine(const EditModel &model, Sci::Line line, Surface *surfa
 	if (posLineEnd >(posLineStart + ll->maxLineLength)) {
 		posLineEnd = posLineStart + ll->maxLineLength;
 	}
+	if ((posLineEnd - posLineStart) >= LineLayout::segmentedLength) {
+		LayoutSegmentedLine(model, line, surface, vstyle, ll, width != LineLayout::wrapWidthInfinite);
+	} else if (ll->segmented) {
+		// The line was long but is now short
+		ll->segmented = false;
+		ll->segments.clear();
+		ll->positions.ClearSegments();
+		ll->validity = LineLayout::llInvalid;
+	}
 	if (ll->validity == LineLayout::llCheckTextAndStyle) {
 		Sci::Position lineLength = posLineEnd - posLineStart;
 		if (!vstyle.viewEOL) {
@@ -423,32 +734,10 @@ void EditView::LayoutLine(const EditModel &model, Sci::Line line, Surface *surfa
 
 		// Fill base line layout
 		const int lineLength = static_cast<int>(posLineEnd - posLineStart);
-		model.pdoc->GetCharRange(ll->chars.get(), posLineStart, lineLength);
-		model.pdoc->GetStyleRange(ll->styles.get(), posLineStart, lineLength);
+		FillLayoutChars(model, vstyle, ll, posLineStart, 0, lineLength);
 		const int numCharsBeforeEOL = static_cast<int>(model.pdoc->LineEnd(line) - posLineStart);
 		const int numCharsInLine = (vstyle.viewEOL) ? lineLength : numCharsBeforeEOL;
-		for (Sci::Position styleInLine = 0; styleInLine < numCharsInLine; styleInLine++) {
-			const unsigned char styleByte = ll->styles[styleInLine];
-			ll->styles[styleInLine] = styleByte;
-		}
 		const unsigned char styleByteLast = (lineLength > 0) ? ll->styles[lineLength - 1] : 0;
-		if (vstyle.someStylesForceCase) {
-			for (int charInLine = 0; charInLine<lineLength; charInLine++) {
-				const char chDoc = ll->chars[charInLine];
-				if (vstyle.styles[ll->styles[charInLine]].caseForce == Style::caseUpper)
-					ll->chars[charInLine] = MakeUpperCase(chDoc);
-				else if (vstyle.styles[ll->styles[charInLine]].caseForce == Style::caseLower)
-					ll->chars[charInLine] = MakeLowerCase(chDoc);
-				else if (vstyle.styles[ll->styles[charInLine]].caseForce == Style::caseCamel) {
-					if ((model.pdoc->IsASCIIWordByte(ll->chars[charInLine])) &&
-					  ((charInLine == 0) || (!model.pdoc->IsASCIIWordByte(ll->chars[charInLine - 1])))) {
-						ll->chars[charInLine] = MakeUpperCase(chDoc);
-					} else {
-						ll->chars[charInLine] = MakeLowerCase(chDoc);
-					}
-				}
-			}
-		}
 		ll->xHighlightGuide = 0;
 		// Extra element at the end of the line to hold end x position and act as
 		ll->chars[numCharsInLine] = 0;   // Also triggers processing in the loops as this is a control character
@@ -456,52 +745,13 @@ void EditView::LayoutLine(const EditModel &model, Sci::Line line, Surface *surfa
 
 		// Layout the line, determining the position of each character,
 		// with an extra element at the end for the end of the line.
-		ll->positions[0] = 0;
-		bool lastSegItalics = false;
-
-		BreakFinder bfLayout(ll, nullptr, Range(0, numCharsInLine), posLineStart, 0, false, model.pdoc, &model.reprs, nullptr);
-		while (bfLayout.More()) {
-
-			const TextSegment ts = bfLayout.Next();
-
-			std::fill(&ll->positions[ts.start + 1], &ll->positions[ts.end() + 1], 0.0f);
-			if (vstyle.styles[ll->styles[ts.start]].visible) {
-				if (ts.representation) {
-					XYPOSITION representationWidth = vstyle.controlCharWidth;
-					if (ll->chars[ts.start] == '\t') {
-						// Tab is a special case of representation, taking a variable amount of space
-						const XYPOSITION x = ll->positions[ts.start];
-						representationWidth = NextTabstopPos(line, x, vstyle.tabWidth) - ll->positions[ts.start];
-					} else {
-						if (representationWidth <= 0.0) {
-							XYPOSITION positionsRepr[256];	// Should expand when needed
-							posCache.MeasureWidths(surface, vstyle, STYLE_CONTROLCHAR, ts.representation->stringRep.c_str(),
-								static_cast<unsigned int>(ts.representation->stringRep.length()), positionsRepr, model.pdoc);
-							representationWidth = positionsRepr[ts.representation->stringRep.length() - 1] + vstyle.ctrlCharPadding;
-						}
-					}
-					for (int ii = 0; ii < ts.length; ii++)
-						ll->positions[ts.start + 1 + ii] = representationWidth;
-				} else {
-					if ((ts.length == 1) && (' ' == ll->chars[ts.start])) {
-						// Over half the segments are single characters and of these about half are space characters.
-						ll->positions[ts.start + 1] = vstyle.styles[ll->styles[ts.start]].spaceWidth;
-					} else {
-						posCache.MeasureWidths(surface, vstyle, ll->styles[ts.start], &ll->chars[ts.start],
-							ts.length, &ll->positions[ts.start + 1], model.pdoc);
-					}
-				}
-				lastSegItalics = (!ts.representation) && ((ll->chars[ts.end() - 1] != ' ') && vstyle.styles[ll->styles[ts.start]].italic);
-			}
-
-			for (Sci::Position posToIncrease = ts.start + 1; posToIncrease <= ts.end(); posToIncrease++) {
-				ll->positions[posToIncrease] += ll->positions[ts.start];
-			}
-		}
+		XYPOSITION *positions = ll->positions.Relative();
+		positions[0] = 0;
+		const bool lastSegItalics = MeasureRange(model, line, surface, vstyle, ll, Range(0, numCharsInLine), posLineStart);
 
 		// Small hack to make lines that end with italics not cut off the edge of the last character
 		if (lastSegItalics) {
-			ll->positions[numCharsInLine] += vstyle.lastSegItalicsOffset;
+			positions[numCharsInLine] += vstyle.lastSegItalicsOffset;
 		}
 		ll->numCharsInLine = numCharsInLine;
 		ll->numCharsBeforeEOL = numCharsBeforeEOL;
@@ -22,6 +22,10 @@
 #include <iterator>
 #include <memory>
 #include <chrono>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
 
 #include "Platform.h"
 
@@ -54,6 +58,8 @@
 #include "EditModel.h"
 #include "MarginView.h"
 #include "EditView.h"
+#include "BackgroundWrap.h"
+#include "FoldIndex.h"
 #include "Editor.h"
 #include "ElapsedPeriod.h"
 
@@ -1470,6 +1476,12 @@ void Editor::NeedWrapping(Sci::Line docLineStart, Sci::Line docLineEnd) {
 	if (wrapPending.AddRange(docLineStart, docLineEnd)) {
 		view.llc.Invalidate(LineLayout::llPositions);
 	}
+	if (backgroundWrap) {
+		backgroundWrap->Invalidate(docLineStart, docLineEnd);
+		// Rewrapping everything follows changes to the view so settings are copied again
+		if ((docLineStart == 0) && (docLineEnd == WrapPending::lineLarge))
+			wrapSettings.reset();
+	}
 	// Wrap lines during idle.
 	if (Wrapping() && wrapPending.NeedsWrap()) {
 		SetIdle(true);
@@ -1505,6 +1517,10 @@ bool Editor::WrapLines(WrapScope ws) {
 			wrapOccurred = true;
 		}
 		wrapPending.Reset();
+		if (backgroundWrap) {
+			backgroundWrap->Invalidate(0, WrapPending::lineLarge);
+			wrapSettings.reset();
+		}
 
 	} else if (wrapPending.NeedsWrap()) {
 		wrapPending.start = std::min(wrapPending.start, pdoc->LinesTotal());
@@ -1544,11 +1560,18 @@ bool Editor::WrapLines(WrapScope ws) {
 		}
 		const Sci::Line lineEndNeedWrap = std::min(wrapPending.end, pdoc->LinesTotal());
 		lineToWrapEnd = std::min(lineToWrapEnd, lineEndNeedWrap);
+		const bool inBackground = (ws != WrapScope::wsVisible) && BackgroundWrapAvailable(lineEndNeedWrap);
 
 		// Ensure all lines being wrapped are styled.
-		pdoc->EnsureStyledTo(pdoc->LineStart(lineToWrapEnd));
+		// With background styling they are wrapped again when their styles arrive.
+		if (!inBackground && ((idleStyling != SC_IDLESTYLING_BACKGROUND) || !pdoc->BackgroundStylingAvailable()))
+			pdoc->EnsureStyledTo(pdoc->LineStart(lineToWrapEnd));
 
-		if (lineToWrap < lineToWrapEnd) {
+		if (inBackground) {
+			wrapOccurred = WrapLinesInBackground(ws == WrapScope::wsAll);
+			goodTopLine = pcs->DisplayFromDoc(lineDocTop) + std::min(
+				subLineTop, static_cast<Sci::Line>(pcs->GetHeight(lineDocTop)-1));
+		} else if (lineToWrap < lineToWrapEnd) {
 
 			PRectangle rcTextArea = GetClientRectangle();
 			rcTextArea.left = static_cast<XYPOSITION>(vs.textStart);
@@ -1590,6 +1613,115 @@ bool Editor::WrapLines(WrapScope ws) {
 	return wrapOccurred;
 }
 
+namespace {
+
+// Lines and bytes copied into each background wrap job
+const Sci::Line backgroundWrapLines = 0x400;
+const Sci::Position backgroundWrapChunk = 0x40000;
+// Fewer lines than this are wrapped on the UI thread
+const Sci::Line backgroundWrapMinimum = 0x4000;
+
+}
+
+// Many lines are wrapped by worker threads, except when tab stops have been set for particular
+// lines as the workers can not see them or when the workers' fonts measure differently.
+bool Editor::BackgroundWrapAvailable(Sci::Line lineEndNeedWrap) {
+	if (view.ldTabstops || !wMain.GetID() || (wrapSettings && !wrapSettings->measuredAlike))
+		return false;
+	// Jobs already given to the workers are finished even when few lines are left
+	if ((lineEndNeedWrap - wrapPending.start < backgroundWrapMinimum) && !(backgroundWrap && backgroundWrap->HasJobs()))
+		return false;
+	if (!backgroundWrap)
+		backgroundWrap.reset(new BackgroundWrapper());
+	return true;
+}
+
+// Copy the lines after the jobs the workers already have into new jobs, keeping a job
+// waiting for each worker.
+void Editor::SubmitWrapJobs(Sci::Line lineEndNeedWrap) {
+	const size_t jobsWanted = 2 * BackgroundWrapper::WorkerCount();
+	Sci::Line line = backgroundWrap->JobsEnd(wrapPending.start);
+	while ((line < lineEndNeedWrap) && (backgroundWrap->Working() < jobsWanted)) {
+		const Sci::Line lineLimit = std::min({line + backgroundWrapLines, lineEndNeedWrap, backgroundWrap->JobAfter(line)});
+		const Sci::Position start = pdoc->LineStart(line);
+		Sci::Line lineEnd = line + 1;
+		while ((lineEnd < lineLimit) && (pdoc->LineStart(lineEnd + 1) - start <= backgroundWrapChunk))
+			lineEnd++;
+		const Sci::Position end = pdoc->LineStart(lineEnd);
+		if ((idleStyling != SC_IDLESTYLING_BACKGROUND) || !pdoc->BackgroundStylingAvailable())
+			pdoc->EnsureStyledTo(end);
+
+		std::unique_ptr<BackgroundWrapJob> job(new BackgroundWrapJob());
+		job->settings = wrapSettings;
+		job->lineFirst = line;
+		job->text.resize(end - start);
+		job->styles.resize(end - start);
+		if (end > start) {
+			pdoc->GetCharRange(&job->text[0], start, end - start);
+			pdoc->GetStyleRange(job->styles.data(), start, end - start);
+		}
+		for (Sci::Line lineInJob = line; lineInJob <= lineEnd; lineInJob++) {
+			job->lineStarts.push_back(pdoc->LineStart(lineInJob) - start);
+		}
+		job->lines.resize(lineEnd - line);
+		backgroundWrap->Submit(std::move(job));
+		line = backgroundWrap->JobsEnd(lineEnd);
+	}
+}
+
+// Apply the finished jobs that continue on from wrapPending.start then give the workers more lines.
+// The heights are set in batches as jobs finish so the scroll bar soon has about the right range.
+// With wait, returns once all the lines needing wrap are wrapped.
+bool Editor::WrapLinesInBackground(bool wait) {
+	PRectangle rcTextArea = GetClientRectangle();
+	rcTextArea.left = static_cast<XYPOSITION>(vs.textStart);
+	rcTextArea.right -= vs.rightMarginWidth;
+	const int width = static_cast<int>(rcTextArea.Width());
+	if (!wrapSettings || (wrapSettings->wrapWidth != width)) {
+		backgroundWrap->Invalidate(0, WrapPending::lineLarge);
+		wrapWidth = width;
+		RefreshStyleData();
+		wrapSettings = std::make_shared<WrapSettings>(vs, reprs, pdoc, wrapWidth,
+			view.tabWidthMinimumPixels, technology, BackgroundWrapper::WorkerCount());
+	}
+
+	bool wrapOccurred = false;
+	const Sci::Line lineEndNeedWrap = std::min(wrapPending.end, pdoc->LinesTotal());
+	for (;;) {
+		// Jobs are applied in line order so wrapPending.start stays the first line not wrapped
+		std::unique_ptr<BackgroundWrapJob> job;
+		while ((job = backgroundWrap->TakeFinished(wrapPending.start)) != nullptr) {
+			if (!job->measuredAlike) {
+				// Wrap on the UI thread until the settings change
+				wrapSettings->measuredAlike = false;
+				backgroundWrap->Invalidate(0, WrapPending::lineLarge);
+				return wrapOccurred;
+			}
+			for (size_t lineInJob = 0; lineInJob < job->lines.size(); lineInJob++) {
+				const Sci::Line line = job->lineFirst + static_cast<Sci::Line>(lineInJob);
+				if (pcs->SetHeight(line, job->lines[lineInJob] +
+					(vs.annotationVisible ? pdoc->AnnotationLines(line) : 0))) {
+					wrapOccurred = true;
+				}
+			}
+			wrapPending.start = job->LineEnd();
+		}
+		if (wrapPending.start >= lineEndNeedWrap)
+			break;
+		SubmitWrapJobs(lineEndNeedWrap);
+		if (!wait)
+			break;
+		backgroundWrap->WaitForFinished();
+	}
+
+	if (wrapPending.start >= lineEndNeedWrap) {
+		backgroundWrap->Invalidate(0, WrapPending::lineLarge);
+	} else if (!FineTickerRunning(tickBackgroundWrap)) {
+		FineTickerStart(tickBackgroundWrap, 10, 1);
+	}
+	return wrapOccurred;
+}
+
 void Editor::LinesJoin() {
 	if (!RangeContainsProtected(targetStart, targetEnd)) {
 		UndoGroup ug(pdoc);
@@ -1909,6 +2041,10 @@ void Editor::AddCharUTF(const char *s, unsigned int len, bool treatAsDBCS) {
 		std::sort(selPtrs.begin(), selPtrs.end(),
 			[](const SelectionRange *a, const SelectionRange *b) {return *a < *b;});
 
+		if (ReplaceSelectionsTogether(selPtrs, s, len)) {
+			selPtrs.clear();
+		}
+
 		// Loop in reverse to avoid disturbing positions of selections yet to be processed.
 		for (std::vector<SelectionRange *>::reverse_iterator rit = selPtrs.rbegin();
 			rit != selPtrs.rend(); ++rit) {
@@ -1999,6 +2135,35 @@ void Editor::AddCharUTF(const char *s, unsigned int len, bool treatAsDBCS) {
 	}
 }
 
+// Typing into or deleting many selections changes the document once instead of once for each selection.
+// selPtrs are in document order. Returns false when the selections have to be changed one at a time.
+bool Editor::ReplaceSelectionsTogether(const std::vector<SelectionRange *> &selPtrs, const char *s, Sci::Position len) {
+	if ((selPtrs.size() < 2) || inOverstrike || pdoc->IsReadOnly())
+		return false;
+	std::vector<RangeReplacement> ranges;
+	ranges.reserve(selPtrs.size());
+	Sci::Position endPrevious = 0;
+	for (const SelectionRange *currentSel : selPtrs) {
+		if (currentSel->anchor.VirtualSpace() || currentSel->caret.VirtualSpace())
+			return false;
+		const Sci::Position start = currentSel->Start().Position();
+		if ((start < endPrevious) || RangeContainsProtected(start, currentSel->End().Position()))
+			return false;
+		endPrevious = currentSel->End().Position();
+		ranges.push_back(RangeReplacement(start, currentSel->Length(), s, len));
+	}
+	pdoc->ReplaceRanges(ranges);
+	// The notifications have moved the selections so place them from the ranges
+	Sci::Position delta = 0;
+	for (size_t r = 0; r < selPtrs.size(); r++) {
+		const Sci::Position position = ranges[r].position + delta + len;
+		selPtrs[r]->caret.SetPosition(position);
+		selPtrs[r]->anchor.SetPosition(position);
+		delta += len - ranges[r].lengthRemove;
+	}
+	return true;
+}
+
 void Editor::ClearBeforeTentativeStart() {
 	// Make positions for the first composition string.
 	FilterSelections();
@@ -2091,6 +2256,14 @@ void Editor::ClearSelection(bool retainMultipleSelections) {
 	if (!sel.IsRectangular() && !retainMultipleSelections)
 		FilterSelections();
 	UndoGroup ug(pdoc);
+	// Empty selections are included so they are placed again after the change
+	std::vector<SelectionRange *> selPtrs;
+	for (size_t r = 0; r < sel.Count(); r++) {
+		selPtrs.push_back(&sel.Range(r));
+	}
+	std::sort(selPtrs.begin(), selPtrs.end(),
+		[](const SelectionRange *a, const SelectionRange *b) {return *a < *b;});
+	ReplaceSelectionsTogether(selPtrs, "", 0);
 	for (size_t r=0; r<sel.Count(); r++) {
 		if (!sel.Range(r).Empty()) {
 			if (!RangeContainsProtected(sel.Range(r).Start().Position(),
@@ -2515,9 +2688,14 @@ void Editor::NotifySavePoint(Document *, void *, bool atSavePoint) {
 
 void Editor::CheckModificationForWrap(DocModification mh) {
 	if (mh.modificationType & (SC_MOD_INSERTTEXT | SC_MOD_DELETETEXT)) {
+		view.llc.NoteChange(pdoc, mh.position, (mh.modificationType & SC_MOD_INSERTTEXT) ? mh.length : 0, mh.linesAdded != 0);
 		view.llc.Invalidate(LineLayout::llCheckTextAndStyle);
 		const Sci::Line lineDoc = pdoc->SciLineFromPosition(mh.position);
 		const Sci::Line lines = std::max(static_cast<Sci::Line>(0), mh.linesAdded);
+		if (backgroundWrap && (mh.linesAdded != 0)) {
+			// Wrap jobs for the lines after this have the wrong line numbers
+			backgroundWrap->Invalidate(lineDoc, WrapPending::lineLarge);
+		}
 		if (Wrapping()) {
 			NeedWrapping(lineDoc, lineDoc + lines + 1);
 		}
@@ -2590,7 +2768,12 @@ void Editor::NotifyModified(Document *, DocModification mh, void *) {
 			}
 		}
 		if (mh.modificationType & SC_MOD_CHANGESTYLE) {
+			view.llc.NoteChange(pdoc, mh.position, mh.length, false);
 			view.llc.Invalidate(LineLayout::llCheckTextAndStyle);
+			if ((idleStyling == SC_IDLESTYLING_BACKGROUND) && Wrapping() && (paintState == notPainting)) {
+				NeedWrapping(pdoc->SciLineFromPosition(mh.position),
+					pdoc->SciLineFromPosition(mh.position + mh.length) + 1);
+			}
 		}
 	} else {
 		// Move selection and brace highlights
@@ -4961,8 +5144,8 @@ bool Editor::Idle() {
 	if (needWrap) {
 		// Wrap lines during idle.
 		WrapLines(WrapScope::wsIdle);
-		// No more wrapping
-		needWrap = wrapPending.NeedsWrap();
+		// No more wrapping or the wrap workers have the rest
+		needWrap = wrapPending.NeedsWrap() && !FineTickerRunning(tickBackgroundWrap);
 	} else if (needIdleStyling) {
 		IdleStyling();
 	}
@@ -5001,6 +5184,20 @@ void Editor::TickFor(TickReason reason) {
 			}
 			FineTickerCancel(tickDwell);
 			break;
+		case tickBackgroundStyle:
+			if ((idleStyling != SC_IDLESTYLING_BACKGROUND) || !pdoc->BackgroundStyleStep()) {
+				FineTickerCancel(tickBackgroundStyle);
+			}
+			break;
+		case tickBackgroundWrap:
+			WrapLines(WrapScope::wsIdle);
+			if (!backgroundWrap || !backgroundWrap->HasJobs()) {
+				FineTickerCancel(tickBackgroundWrap);
+				// Any lines left are wrapped on the UI thread
+				if (Wrapping() && wrapPending.NeedsWrap())
+					SetIdle(true);
+			}
+			break;
 		default:
 			// tickPlatform handled by subclass
 			break;
@@ -5100,6 +5297,10 @@ void Editor::StartIdleStyling(bool truncatedLastStyling) {
 // Style for an area but bound the amount of styling to remain responsive
 void Editor::StyleAreaBounded(PRectangle rcArea, bool scrolling) {
 	const Sci::Position posAfterArea = PositionAfterArea(rcArea);
+	if (idleStyling == SC_IDLESTYLING_BACKGROUND) {
+		StyleAreaInBackground(rcArea, posAfterArea);
+		return;
+	}
 	const Sci::Position posAfterMax = PositionAfterMaxStyling(posAfterArea, scrolling);
 	if (posAfterMax < posAfterArea) {
 		// Idle styling may be performed before current visible area
@@ -5112,6 +5313,29 @@ void Editor::StyleAreaBounded(PRectangle rcArea, bool scrolling) {
 	StartIdleStyling(posAfterMax < posAfterArea);
 }
 
+// Text a little after the styled part is styled now as usual. When the area is further on,
+// only the area is styled, provisionally, and the text up to it is left to the background lexer.
+void Editor::StyleAreaInBackground(PRectangle rcArea, Sci::Position posAfterArea) {
+	const Sci::Position backgroundStylingGap = 0x40000;
+	if (pdoc->BackgroundStylingAvailable() && (posAfterArea - pdoc->GetEndStyled() > backgroundStylingGap)) {
+		const Sci::Line lineBefore = TopLineOfMain() + std::max(static_cast<Sci::Line>(rcArea.top), static_cast<Sci::Line>(0)) / vs.lineHeight;
+		const Sci::Position posBeforeArea = (lineBefore < pcs->LinesDisplayed()) ?
+			pdoc->LineStart(pcs->DocFromDisplay(lineBefore)) : pdoc->Length();
+		pdoc->StyleProvisionally(posBeforeArea, posAfterArea);
+	} else {
+		StyleToPositionInView(posAfterArea);
+	}
+	StartBackgroundStyling();
+}
+
+void Editor::StartBackgroundStyling() {
+	if ((pdoc->GetEndStyled() < pdoc->Length()) && !FineTickerRunning(tickBackgroundStyle)) {
+		if (pdoc->BackgroundStyleStep()) {
+			FineTickerStart(tickBackgroundStyle, 10, 1);
+		}
+	}
+}
+
 void Editor::IdleStyling() {
 	const Sci::Position posAfterArea = PositionAfterArea(GetClientRectangle());
 	const Sci::Position endGoal = (idleStyling >= SC_IDLESTYLING_AFTERVISIBLE) ?
@@ -5480,6 +5704,69 @@ void Editor::FoldAll(int action) {
 	Redraw();
 }
 
+/**
+ * Contract or expand every fold header with a level number of level above SC_FOLDLEVELBASE or,
+ * when byDepth, every header inside level other headers. The visibility of all the folds is
+ * changed before the scroll bars and window are updated once.
+ */
+void Editor::FoldAtLevel(int level, int action, bool byDepth) {
+	pdoc->EnsureStyledTo(pdoc->Length());
+	const FoldIndex &folds = pdoc->FoldStructure();
+	auto matches = [&folds, level, byDepth](Sci::Line header) {
+		return byDepth ? (folds.Depth(header) == level) : (folds.Level(header) - SC_FOLDLEVELBASE == level);
+	};
+	bool expanding = action == SC_FOLDACTION_EXPAND;
+	if (action == SC_FOLDACTION_TOGGLE) {
+		// Discover current state
+		for (Sci::Line header = 0; header < folds.Headers(); header++) {
+			if (matches(header)) {
+				expanding = !pcs->GetExpanded(folds.Header(header));
+				break;
+			}
+		}
+	}
+	for (Sci::Line header = 0; header < folds.Headers(); header++) {
+		if (!matches(header))
+			continue;
+		const Sci::Line line = folds.Header(header);
+		if (expanding) {
+			if (pcs->GetExpanded(line))
+				continue;
+			pcs->SetExpanded(line, true);
+			if (pcs->GetVisible(line)) {
+				ExpandLine(line);
+			} else {
+				// Expand the contracted folds around the header from the outside in as
+				// toggling it would, and expanding them shows the header's lines too
+				Sci::Line headerOuter = -1;
+				for (Sci::Line parent = folds.ParentHeader(header); parent >= 0; parent = folds.ParentHeader(parent)) {
+					if (!pcs->GetExpanded(folds.Header(parent)))
+						headerOuter = parent;
+				}
+				for (Sci::Line parent = folds.ParentHeader(header); parent >= 0; parent = folds.ParentHeader(parent)) {
+					pcs->SetExpanded(folds.Header(parent), true);
+					if (parent == headerOuter)
+						break;
+				}
+				if (headerOuter >= 0)
+					ExpandLine(folds.Header(headerOuter));
+			}
+		} else {
+			const Sci::Line lineMaxSubord = pdoc->GetLastChild(line);
+			if (lineMaxSubord > line) {
+				pcs->SetExpanded(line, false);
+				pcs->SetVisible(line + 1, lineMaxSubord, false);
+			}
+		}
+	}
+	if (!expanding && !pcs->GetVisible(pdoc->SciLineFromPosition(sel.MainCaret()))) {
+		// This does not re-expand the folds
+		EnsureCaretVisible();
+	}
+	SetScrollBars();
+	Redraw();
+}
+
 void Editor::FoldChanged(Sci::Line line, int levelNow, int levelPrev) {
 	if (levelNow & SC_FOLDLEVELHEADERFLAG) {
 		if (!(levelPrev & SC_FOLDLEVELHEADERFLAG)) {
@@ -5891,6 +6178,26 @@ sptr_t Editor::WndProc(unsigned int iMessage, uptr_t wParam, sptr_t lParam) {
 		pdoc->DeleteUndoHistory();
 		return 0;
 
+	case SCI_SETUNDOMEMORYBUDGET:
+		pdoc->SetUndoMemoryBudget(static_cast<size_t>(wParam));
+		return 0;
+
+	case SCI_GETUNDOMEMORYBUDGET:
+		return static_cast<sptr_t>(pdoc->UndoMemoryBudget());
+
+	case SCI_SETUNDOCOMPRESSION:
+		pdoc->SetUndoCompression(wParam != 0);
+		return 0;
+
+	case SCI_GETUNDOCOMPRESSION:
+		return pdoc->UndoCompression();
+
+	case SCI_GETUNDOMEMORY:
+		return static_cast<sptr_t>(pdoc->UndoMemoryUsed());
+
+	case SCI_GETUNDOSPILLEDMEMORY:
+		return static_cast<sptr_t>(pdoc->UndoMemorySpilled());
+
 	case SCI_GETFIRSTVISIBLELINE:
 		return topLine;
 
@@ -6040,6 +6347,20 @@ sptr_t Editor::WndProc(unsigned int iMessage, uptr_t wParam, sptr_t lParam) {
 		PLATFORM_ASSERT(lParam);
 		return ReplaceTarget(true, CharPtrFromSPtr(lParam), static_cast<Sci::Position>(wParam));
 
+	case SCI_REPLACERANGES: {
+			if (lParam == 0)
+				return 0;
+			const Sci_TextRange *textRanges = static_cast<const Sci_TextRange *>(PtrFromSPtr(lParam));
+			std::vector<RangeReplacement> ranges;
+			ranges.reserve(wParam);
+			for (uptr_t i = 0; i < wParam; i++) {
+				const Sci_TextRange &tr = textRanges[i];
+				const char *text = tr.lpstrText ? tr.lpstrText : "";
+				ranges.push_back(RangeReplacement(tr.chrg.cpMin, tr.chrg.cpMax - tr.chrg.cpMin, text, strlen(text)));
+			}
+			return pdoc->ReplaceRanges(ranges);
+		}
+
 	case SCI_SEARCHINTARGET:
 		PLATFORM_ASSERT(lParam);
 		return SearchInTarget(CharPtrFromSPtr(lParam), static_cast<Sci::Position>(wParam));
@@ -7233,6 +7554,14 @@ sptr_t Editor::WndProc(unsigned int iMessage, uptr_t wParam, sptr_t lParam) {
 		FoldAll(static_cast<int>(wParam));
 		break;
 
+	case SCI_FOLDATLEVEL:
+		FoldAtLevel(static_cast<int>(wParam), static_cast<int>(lParam), false);
+		break;
+
+	case SCI_FOLDATDEPTH:
+		FoldAtLevel(static_cast<int>(wParam), static_cast<int>(lParam), true);
+		break;
+
 	case SCI_EXPANDCHILDREN:
 		FoldExpand(static_cast<Sci::Line>(wParam), SC_FOLDACTION_EXPAND, static_cast<int>(lParam));
 		break;
@@ -7915,6 +8244,46 @@ sptr_t Editor::WndProc(unsigned int iMessage, uptr_t wParam, sptr_t lParam) {
 	case SCI_GETCHARACTERPOINTER:
 		return reinterpret_cast<sptr_t>(pdoc->BufferPointer());
 
+	case SCI_SETMAPPEDTEXT: {
+			if (lParam == 0)
+				return 0;
+			const bool wasLarge = pdoc->IsLarge();
+			if (!pdoc->SetMappedText(reinterpret_cast<IMappedText *>(lParam), static_cast<int>(wParam)))
+				return 0;
+			if (pdoc->IsLarge() != wasLarge) {
+				// Text over 2G made the document large so the line states need 64-bit lines too
+				pcs = ContractionStateCreate(true);
+				pcs->InsertLines(0, pdoc->LinesTotal() - 1);
+			}
+			SetEmptySelection(0);
+			return 1;
+		}
+
+	case SCI_REBASEMAPPEDTEXT:
+		if (lParam == 0)
+			return 0;
+		return pdoc->RebaseMappedText(reinterpret_cast<IMappedText *>(lParam));
+
+	case SCI_GETTEXTMAPPED:
+		return pdoc->IsMapped();
+
+	case SCI_GETMAPPEDMEMORY:
+		return static_cast<sptr_t>(pdoc->MappedMemoryUsed());
+
+	case SCI_GETMEMORYUSAGE:
+		if (wParam == SC_MEMORY_LAYOUT)
+			return static_cast<sptr_t>(view.llc.MemoryUsed() + view.posCache.MemoryUsed());
+		return static_cast<sptr_t>(pdoc->MemoryUsed(static_cast<int>(wParam)));
+
+	case SCI_RELEASEMEMORY:
+		view.llc.Deallocate();
+		view.posCache.Clear();
+		if (wParam & SC_RELEASE_STYLES)
+			pdoc->ReleaseStyles();
+		pdoc->Compact();
+		Redraw();
+		return 0;
+
 	case SCI_GETRANGEPOINTER:
 		return reinterpret_cast<sptr_t>(pdoc->RangePointer(
 			static_cast<Sci::Position>(wParam), lParam));
@@ -10,6 +10,9 @@
 
 namespace Scintilla {
 
+class BackgroundWrapper;
+struct WrapSettings;
+
 /**
  */
 class Timer {
@@ -251,6 +254,8 @@ protected:	// ScintillaBase subclass needs access to much of Editor
 	// Wrapping support
 	WrapPending wrapPending;
 	ActionDuration durationWrapOneLine;
+	std::unique_ptr<BackgroundWrapper> backgroundWrap;
+	std::shared_ptr<WrapSettings> wrapSettings;
 
 	bool convertPastes;
 
@@ -373,6 +378,9 @@ protected:	// ScintillaBase subclass needs access to much of Editor
 	bool WrapOneLine(Surface *surface, Sci::Line lineToWrap);
 	enum class WrapScope {wsAll, wsVisible, wsIdle};
 	bool WrapLines(WrapScope ws);
+	bool BackgroundWrapAvailable(Sci::Line lineEndNeedWrap);
+	void SubmitWrapJobs(Sci::Line lineEndNeedWrap);
+	bool WrapLinesInBackground(bool wait);
 	void LinesJoin();
 	void LinesSplit(int pixelWidth);
 
@@ -394,6 +402,7 @@ protected:	// ScintillaBase subclass needs access to much of Editor
 	SelectionPosition RealizeVirtualSpace(const SelectionPosition &position);
 	void AddChar(char ch);
 	virtual void AddCharUTF(const char *s, unsigned int len, bool treatAsDBCS=false);
+	bool ReplaceSelectionsTogether(const std::vector<SelectionRange *> &selPtrs, const char *s, Sci::Position len);
 	void ClearBeforeTentativeStart();
 	void InsertPaste(const char *text, Sci::Position len);
 	enum PasteShape { pasteStream=0, pasteRectangular = 1, pasteLine = 2 };
@@ -507,7 +516,7 @@ protected:	// ScintillaBase subclass needs access to much of Editor
 	void ButtonUpWithModifiers(Point pt, unsigned int curTime, int modifiers);
 
 	bool Idle();
-	enum TickReason { tickCaret, tickScroll, tickWiden, tickDwell, tickPlatform };
+	enum TickReason { tickCaret, tickScroll, tickWiden, tickDwell, tickBackgroundStyle, tickBackgroundWrap, tickPlatform };
 	virtual void TickFor(TickReason reason);
 	virtual bool FineTickerRunning(TickReason reason);
 	virtual void FineTickerStart(TickReason reason, int millis, int tolerance);
@@ -522,6 +531,8 @@ protected:	// ScintillaBase subclass needs access to much of Editor
 	Sci::Position PositionAfterMaxStyling(Sci::Position posMax, bool scrolling) const;
 	void StartIdleStyling(bool truncatedLastStyling);
 	void StyleAreaBounded(PRectangle rcArea, bool scrolling);
+	void StyleAreaInBackground(PRectangle rcArea, Sci::Position posAfterArea);
+	void StartBackgroundStyling();
 	void IdleStyling();
 	virtual void IdleWork();
 	virtual void QueueIdleWork(WorkNeeded::workItems items, Sci::Position upTo=0);
@@ -545,6 +556,7 @@ protected:	// ScintillaBase subclass needs access to much of Editor
 	void FoldChanged(Sci::Line line, int levelNow, int levelPrev);
 	void NeedShown(Sci::Position pos, Sci::Position len);
 	void FoldAll(int action);
+	void FoldAtLevel(int level, int action, bool byDepth);
 
 	Sci::Position GetTag(char *tagValue, int tagNumber);
 	Sci::Position ReplaceTarget(bool replacePatterns, const char *text, Sci::Position length=-1);
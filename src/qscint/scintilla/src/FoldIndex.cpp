@@ -0,0 +1,143 @@
+// Scintilla source code edit control
+/** @file FoldIndex.cxx
+ ** Index of the fold headers of a document.
+ **/
+// The License.txt file describes the conditions under which this software may be distributed.
+
+#include <cstddef>
+
+#include <stdexcept>
+#include <vector>
+#include <forward_list>
+#include <algorithm>
+#include <memory>
+
+#include "Platform.h"
+
+#include "ILoader.h"
+#include "Scintilla.h"
+
+#include "Position.h"
+#include "SplitVector.h"
+#include "Partitioning.h"
+#include "CellBuffer.h"
+#include "PerLine.h"
+#include "FoldIndex.h"
+
+using namespace Scintilla;
+
+namespace {
+
+int LevelNumberOf(int level) noexcept {
+	return level & SC_FOLDLEVELNUMBERMASK;
+}
+
+}
+
+FoldIndex::FoldIndex() noexcept : valid(false) {
+}
+
+FoldIndex::~FoldIndex() {
+}
+
+void FoldIndex::Invalidate() noexcept {
+	valid = false;
+}
+
+// Finds the same lines as the scans in Document::GetLastChild and Document::GetFoldParent.
+// A header's last child is the line before the next non-whitespace line with the same or
+// a lower level and its parent is the nearest header before it with a lower level, so both
+// come from stacks of the headers still open.
+void FoldIndex::Build(const LineLevels &lineLevels, Sci::Line lines) {
+	headers.clear();
+	levels.clear();
+	parents.clear();
+	lastChildren.clear();
+	depths.clear();
+
+	std::vector<Sci::Line> open;	// Headers that may be parents of the next header
+	std::vector<Sci::Line> unfinished;	// Non-whitespace headers whose last child is not found
+	for (Sci::Line line = 0; line < lines; line++) {
+		const int level = lineLevels.GetLevel(line);
+		const int levelNumber = LevelNumberOf(level);
+		if (!(level & SC_FOLDLEVELWHITEFLAG)) {
+			while (!unfinished.empty() && (levels[unfinished.back()] >= levelNumber)) {
+				lastChildren[unfinished.back()] = line - 1;
+				unfinished.pop_back();
+			}
+		}
+		if (level & SC_FOLDLEVELHEADERFLAG) {
+			while (!open.empty() && (levels[open.back()] >= levelNumber)) {
+				open.pop_back();
+			}
+			const Sci::Line header = static_cast<Sci::Line>(headers.size());
+			headers.push_back(line);
+			levels.push_back(levelNumber);
+			parents.push_back(open.empty() ? -1 : open.back());
+			depths.push_back(static_cast<int>(open.size()));
+			lastChildren.push_back(-1);
+			open.push_back(header);
+			if (!(level & SC_FOLDLEVELWHITEFLAG))
+				unfinished.push_back(header);
+		}
+	}
+	for (const Sci::Line header : unfinished) {
+		lastChildren[header] = lines - 1;
+	}
+
+	// Whitespace belonging to a parent is given back to it
+	for (size_t header = 0; header < headers.size(); header++) {
+		const Sci::Line lastChild = lastChildren[header];
+		if ((lastChild > headers[header]) &&
+			(levels[header] > LevelNumberOf(lineLevels.GetLevel(lastChild + 1))) &&
+			(lineLevels.GetLevel(lastChild) & SC_FOLDLEVELWHITEFLAG)) {
+			lastChildren[header] = lastChild - 1;
+		}
+	}
+	valid = true;
+}
+
+Sci::Line FoldIndex::Headers() const noexcept {
+	return static_cast<Sci::Line>(headers.size());
+}
+
+Sci::Line FoldIndex::Header(Sci::Line header) const noexcept {
+	return headers[header];
+}
+
+int FoldIndex::Level(Sci::Line header) const noexcept {
+	return levels[header];
+}
+
+int FoldIndex::Depth(Sci::Line header) const noexcept {
+	return depths[header];
+}
+
+Sci::Line FoldIndex::ParentHeader(Sci::Line header) const noexcept {
+	return parents[header];
+}
+
+// Index of the last header before line or -1.
+Sci::Line FoldIndex::HeaderBefore(Sci::Line line) const noexcept {
+	const std::vector<Sci::Line>::const_iterator it = std::lower_bound(headers.begin(), headers.end(), line);
+	return static_cast<Sci::Line>(it - headers.begin()) - 1;
+}
+
+// The last child of a header line or -1 when line is not a header or is whitespace,
+// in which case the caller scans.
+Sci::Line FoldIndex::LastChild(Sci::Line line) const noexcept {
+	const Sci::Line header = HeaderBefore(line + 1);
+	if ((header >= 0) && (headers[header] == line))
+		return lastChildren[header];
+	return -1;
+}
+
+// The nearest header before line with a lower level number than level.
+// Headers between a header and its parent have levels at least as high so are skipped.
+Sci::Line FoldIndex::Parent(Sci::Line line, int level) const noexcept {
+	Sci::Line header = HeaderBefore(line);
+	while ((header >= 0) && (levels[header] >= level)) {
+		header = parents[header];
+	}
+	return (header >= 0) ? headers[header] : -1;
+}
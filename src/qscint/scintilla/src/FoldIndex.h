@@ -0,0 +1,53 @@
+// Scintilla source code edit control
+/** @file FoldIndex.h
+ ** Index of the fold headers of a document.
+ **/
+// The License.txt file describes the conditions under which this software may be distributed.
+
+#ifndef FOLDINDEX_H
+#define FOLDINDEX_H
+
+namespace Scintilla {
+
+/**
+ * The fold headers of a document with the parent and last child of each, built in one pass
+ * over the fold levels. Parent and last child queries are then a binary search instead of a
+ * scan over the lines in between. The index is thrown away when any fold level changes or
+ * lines are inserted or removed and is only rebuilt once it would save more than it costs.
+ */
+class FoldIndex {
+	std::vector<Sci::Line> headers;	///< Every line with SC_FOLDLEVELHEADERFLAG in order
+	std::vector<int> levels;	///< Level number of each header
+	std::vector<Sci::Line> parents;	///< Index in headers of each header's parent or -1
+	std::vector<Sci::Line> lastChildren;	///< Last child line of each header or -1 for whitespace headers
+	std::vector<int> depths;	///< Number of headers enclosing each header
+	bool valid;
+	Sci::Line HeaderBefore(Sci::Line line) const noexcept;
+public:
+	FoldIndex() noexcept;
+	// Deleted so FoldIndex objects can not be copied.
+	FoldIndex(const FoldIndex &) = delete;
+	FoldIndex(FoldIndex &&) = delete;
+	FoldIndex &operator=(const FoldIndex &) = delete;
+	FoldIndex &operator=(FoldIndex &&) = delete;
+	~FoldIndex();
+
+	bool Valid() const noexcept {
+		return valid;
+	}
+	void Invalidate() noexcept;
+	void Build(const LineLevels &lineLevels, Sci::Line lines);
+
+	Sci::Line Headers() const noexcept;
+	Sci::Line Header(Sci::Line header) const noexcept;
+	int Level(Sci::Line header) const noexcept;
+	int Depth(Sci::Line header) const noexcept;
+	Sci::Line ParentHeader(Sci::Line header) const noexcept;
+
+	Sci::Line LastChild(Sci::Line line) const noexcept;
+	Sci::Line Parent(Sci::Line line, int level) const noexcept;
+};
+
+}
+
+#endif
@@ -110,6 +110,10 @@ public:
 		return static_cast<T>(body->Length())-1;
 	}
 
+	size_t MemoryUsed() const noexcept {
+		return body->MemoryUsed();
+	}
+
 	void InsertPartition(T partition, T pos) {
 		if (stepPartition < partition) {
 			ApplyStep(partition);
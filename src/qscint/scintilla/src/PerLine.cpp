@@ -12,11 +12,13 @@
 #include <stdexcept>
 #include <vector>
 #include <forward_list>
+#include <iterator>
 #include <algorithm>
 #include <memory>
 
 #include "Platform.h"
 
+#include "ILoader.h"
 #include "Scintilla.h"
 #include "Position.h"
 #include "SplitVector.h"
@@ -79,6 +81,12 @@ void MarkerHandleSet::CombineWith(MarkerHandleSet *other) {
 	mhList.splice_after(mhList.before_begin(), other->mhList);
 }
 
+size_t MarkerHandleSet::MemoryUsed() const noexcept {
+	// Each list node holds the handle, the number and the link
+	const size_t nodes = std::distance(mhList.begin(), mhList.end());
+	return sizeof(*this) + nodes * (sizeof(MarkerHandleNumber) + sizeof(void *));
+}
+
 LineMarkers::~LineMarkers() {
 	markers.DeleteAll();
 }
@@ -87,6 +95,16 @@ void LineMarkers::Init() {
 	markers.DeleteAll();
 }
 
+size_t LineMarkers::MemoryUsed() const noexcept {
+	size_t memory = markers.MemoryUsed();
+	for (Sci::Line line = 0; line < markers.Length(); line++) {
+		if (markers.ValueAt(line)) {
+			memory += markers.ValueAt(line)->MemoryUsed();
+		}
+	}
+	return memory;
+}
+
 void LineMarkers::InsertLine(Sci::Line line) {
 	if (markers.Length()) {
 		markers.Insert(line, 0);
@@ -195,6 +213,10 @@ void LineLevels::Init() {
 	levels.DeleteAll();
 }
 
+size_t LineLevels::MemoryUsed() const noexcept {
+	return levels.MemoryUsed();
+}
+
 void LineLevels::InsertLine(Sci::Line line) {
 	if (levels.Length()) {
 		const int level = (line < levels.Length()) ? levels[line] : SC_FOLDLEVELBASE;
@@ -252,6 +274,10 @@ void LineState::Init() {
 	lineStates.DeleteAll();
 }
 
+size_t LineState::MemoryUsed() const noexcept {
+	return lineStates.MemoryUsed();
+}
+
 void LineState::InsertLine(Sci::Line line) {
 	if (lineStates.Length()) {
 		lineStates.EnsureLength(line);
@@ -388,6 +414,17 @@ void LineAnnotation::ClearAll() {
 	annotations.DeleteAll();
 }
 
+size_t LineAnnotation::MemoryUsed() const noexcept {
+	size_t memory = annotations.MemoryUsed();
+	for (Sci::Line line = 0; line < annotations.Length(); line++) {
+		if (annotations.ValueAt(line)) {
+			const int length = Length(line);
+			memory += sizeof(AnnotationHeader) + length + (MultipleStyles(line) ? length : 0);
+		}
+	}
+	return memory;
+}
+
 void LineAnnotation::SetStyle(Sci::Line line, int style) {
 	annotations.EnsureLength(line+1);
 	if (!annotations[line]) {
@@ -440,6 +477,16 @@ void LineTabstops::Init() {
 	tabstops.DeleteAll();
 }
 
+size_t LineTabstops::MemoryUsed() const noexcept {
+	size_t memory = tabstops.MemoryUsed();
+	for (Sci::Line line = 0; line < tabstops.Length(); line++) {
+		if (tabstops.ValueAt(line)) {
+			memory += sizeof(TabstopList) + tabstops.ValueAt(line)->capacity() * sizeof(int);
+		}
+	}
+	return memory;
+}
+
 void LineTabstops::InsertLine(Sci::Line line) {
 	if (tabstops.Length()) {
 		tabstops.EnsureLength(line);
@@ -41,6 +41,7 @@ public:
 	void RemoveHandle(int handle);
 	bool RemoveNumber(int markerNum, bool all);
 	void CombineWith(MarkerHandleSet *other);
+	size_t MemoryUsed() const noexcept;
 };
 
 class LineMarkers : public PerLine {
@@ -59,6 +60,7 @@ public:
 	void Init() override;
 	void InsertLine(Sci::Line line) override;
 	void RemoveLine(Sci::Line line) override;
+	size_t MemoryUsed() const noexcept override;
 
 	int MarkValue(Sci::Line line) noexcept;
 	Sci::Line MarkerNext(Sci::Line lineStart, int mask) const;
@@ -83,6 +85,7 @@ public:
 	void Init() override;
 	void InsertLine(Sci::Line line) override;
 	void RemoveLine(Sci::Line line) override;
+	size_t MemoryUsed() const noexcept override;
 
 	void ExpandLevels(Sci::Line sizeNew=-1);
 	void ClearLevels();
@@ -104,6 +107,7 @@ public:
 	void Init() override;
 	void InsertLine(Sci::Line line) override;
 	void RemoveLine(Sci::Line line) override;
+	size_t MemoryUsed() const noexcept override;
 
 	int SetLineState(Sci::Line line, int state);
 	int GetLineState(Sci::Line line);
@@ -124,6 +128,7 @@ public:
 	void Init() override;
 	void InsertLine(Sci::Line line) override;
 	void RemoveLine(Sci::Line line) override;
+	size_t MemoryUsed() const noexcept override;
 
 	bool MultipleStyles(Sci::Line line) const;
 	int Style(Sci::Line line) const;
@@ -153,6 +158,7 @@ public:
 	void Init() override;
 	void InsertLine(Sci::Line line) override;
 	void RemoveLine(Sci::Line line) override;
+	size_t MemoryUsed() const noexcept override;
 
 	bool ClearTabstops(Sci::Line line);
 	bool AddTabstop(Sci::Line line, int x);
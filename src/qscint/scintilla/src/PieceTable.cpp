@@ -0,0 +1,207 @@
+// Scintilla source code edit control
+/** @file PieceTable.cxx
+ ** Text storage that refers to read-only text such as a mapped file plus a buffer of added text.
+ **/
+// The License.txt file describes the conditions under which this software may be distributed.
+
+#include <cstddef>
+#include <cstring>
+
+#include <stdexcept>
+#include <vector>
+#include <algorithm>
+#include <functional>
+#include <memory>
+
+#include "Platform.h"
+
+#include "ILoader.h"
+#include "Scintilla.h"
+
+#include "Position.h"
+#include "SplitVector.h"
+#include "Partitioning.h"
+#include "PieceTable.h"
+
+using namespace Scintilla;
+
+namespace {
+
+bool Inside(const char *s, Sci::Position length, const char *text, Sci::Position textLength) noexcept {
+	const std::less_equal<const char *> lessEqual;
+	return text && lessEqual(text, s) && lessEqual(s + length, text + textLength);
+}
+
+}
+
+PieceTable::PieceTable(IMappedText *original_) :
+	original(original_), originalText(nullptr), originalLength(0), starts(256), cacheStart(0), cacheEnd(0), cacheText(nullptr) {
+	if (original) {
+		originalText = original->Data();
+		originalLength = original->Length();
+	}
+	pieces.SetGrowSize(256);
+}
+
+PieceTable::~PieceTable() {
+	if (original)
+		original->Release();
+}
+
+Sci::Position PieceTable::Length() const noexcept {
+	return starts.PositionFromPartition(starts.Partitions());
+}
+
+Sci::Position PieceTable::Pieces() const noexcept {
+	return pieces.Length();
+}
+
+size_t PieceTable::MemoryUsed() const noexcept {
+	return added.capacity() + pieces.Length() * (sizeof(Piece) + sizeof(Sci::Position));
+}
+
+const char *PieceTable::PieceText(Sci::Position piece) const noexcept {
+	const Piece &p = pieces.ValueAt(piece);
+	return (p.added ? added.data() : originalText) + p.start;
+}
+
+void PieceTable::Invalidate() noexcept {
+	cacheStart = 0;
+	cacheEnd = 0;
+	cacheText = nullptr;
+}
+
+char PieceTable::ValueAt(Sci::Position position) const noexcept {
+	if ((position < cacheStart) || (position >= cacheEnd)) {
+		if ((position < 0) || (position >= Length()))
+			return 0;
+		const Sci::Position piece = starts.PartitionFromPosition(position);
+		cacheStart = starts.PositionFromPartition(piece);
+		cacheEnd = starts.PositionFromPartition(piece + 1);
+		cacheText = PieceText(piece);
+	}
+	return cacheText[position - cacheStart];
+}
+
+void PieceTable::GetRange(char *buffer, Sci::Position position, Sci::Position retrieveLength) const noexcept {
+	if (retrieveLength <= 0)
+		return;
+	Sci::Position piece = starts.PartitionFromPosition(position);
+	while (retrieveLength > 0) {
+		const Sci::Position pieceStart = starts.PositionFromPartition(piece);
+		const Sci::Position pieceEnd = starts.PositionFromPartition(piece + 1);
+		const Sci::Position lengthCopy = std::min(retrieveLength, pieceEnd - position);
+		memcpy(buffer, PieceText(piece) + position - pieceStart, lengthCopy);
+		buffer += lengthCopy;
+		position += lengthCopy;
+		retrieveLength -= lengthCopy;
+		piece++;
+	}
+}
+
+const char *PieceTable::RangePointer(Sci::Position position, Sci::Position rangeLength) {
+	if ((Length() == 0) || (position >= Length()))
+		return nullptr;
+	const Sci::Position piece = starts.PartitionFromPosition(position);
+	const Sci::Position pieceStart = starts.PositionFromPartition(piece);
+	if (position + rangeLength <= starts.PositionFromPartition(piece + 1))
+		return PieceText(piece) + position - pieceStart;
+	rangeCopy.resize(rangeLength);
+	GetRange(rangeCopy.data(), position, rangeLength);
+	return rangeCopy.data();
+}
+
+// Make a piece start at position and return its index, the number of pieces at the end.
+Sci::Position PieceTable::SplitAt(Sci::Position position) {
+	if (position >= Length())
+		return pieces.Length();
+	const Sci::Position piece = starts.PartitionFromPosition(position);
+	const Sci::Position pieceStart = starts.PositionFromPartition(piece);
+	if (pieceStart == position)
+		return piece;
+	Piece after = pieces.ValueAt(piece);
+	after.start += position - pieceStart;
+	pieces.Insert(piece + 1, after);
+	starts.InsertPartition(piece + 1, position);
+	return piece + 1;
+}
+
+void PieceTable::InsertFromArray(Sci::Position position, const char *s, Sci::Position insertLength) {
+	if (insertLength <= 0)
+		return;
+	Invalidate();
+	// Text that is already in the original or the added buffer is referred to, not copied.
+	// This is how the whole original becomes the first piece.
+	Piece piece;
+	if (Inside(s, insertLength, originalText, originalLength)) {
+		piece = Piece(false, s - originalText);
+	} else if (Inside(s, insertLength, added.data(), added.size())) {
+		piece = Piece(true, s - added.data());
+	} else {
+		piece = Piece(true, added.size());
+		added.insert(added.end(), s, s + insertLength);
+	}
+
+	if (pieces.Length() == 0) {
+		pieces.Insert(0, piece);
+		starts.InsertText(0, insertLength);
+		return;
+	}
+
+	// Typing extends the piece before it
+	if (position > 0) {
+		const Sci::Position before = starts.PartitionFromPosition(position - 1);
+		const Sci::Position beforeStart = starts.PositionFromPartition(before);
+		const Sci::Position beforeEnd = starts.PositionFromPartition(before + 1);
+		const Piece &previous = pieces.ValueAt(before);
+		if ((beforeEnd == position) && (previous.added == piece.added) &&
+			(previous.start + beforeEnd - beforeStart == piece.start)) {
+			starts.InsertText(before, insertLength);
+			return;
+		}
+	}
+
+	const Sci::Position index = SplitAt(position);
+	pieces.Insert(index, piece);
+	starts.InsertPartition(index, position);
+	starts.InsertText(index, insertLength);
+}
+
+void PieceTable::DeleteRange(Sci::Position position, Sci::Position deleteLength) {
+	if (deleteLength <= 0)
+		return;
+	Invalidate();
+	if ((position == 0) && (deleteLength == Length())) {
+		pieces.DeleteAll();
+		starts.DeleteAll();
+		return;
+	}
+
+	// Deleting from the start or the end of one piece only shortens it
+	const Sci::Position piece = starts.PartitionFromPosition(position);
+	const Sci::Position pieceStart = starts.PositionFromPartition(piece);
+	const Sci::Position pieceEnd = starts.PositionFromPartition(piece + 1);
+	const Sci::Position deleteEnd = position + deleteLength;
+	if ((deleteEnd - position < pieceEnd - pieceStart) && (deleteEnd <= pieceEnd)) {
+		if (position == pieceStart) {
+			Piece shortened = pieces.ValueAt(piece);
+			shortened.start += deleteLength;
+			pieces.SetValueAt(piece, shortened);
+			starts.InsertText(piece, -deleteLength);
+			return;
+		} else if (deleteEnd == pieceEnd) {
+			starts.InsertText(piece, -deleteLength);
+			return;
+		}
+	}
+
+	const Sci::Position first = SplitAt(position);
+	const Sci::Position last = SplitAt(position + deleteLength);
+	for (Sci::Position i = last - 1; i >= first; i--) {
+		// Empty the piece then remove a boundary that is now at the same position as its start
+		const Sci::Position lengthPiece = starts.PositionFromPartition(i + 1) - starts.PositionFromPartition(i);
+		starts.InsertText(i, -lengthPiece);
+		starts.RemovePartition((i + 1 < starts.Partitions()) ? i + 1 : i);
+		pieces.Delete(i);
+	}
+}
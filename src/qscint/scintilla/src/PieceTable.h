@@ -0,0 +1,67 @@
+// Scintilla source code edit control
+/** @file PieceTable.h
+ ** Text storage that refers to read-only text such as a mapped file plus a buffer of added text.
+ **/
+// The License.txt file describes the conditions under which this software may be distributed.
+
+#ifndef PIECETABLE_H
+#define PIECETABLE_H
+
+namespace Scintilla {
+
+/**
+ * The text as a sequence of pieces, each a range of either the read-only original text or of
+ * the added buffer which only ever grows at its end. Editing changes the pieces and never the
+ * text they refer to so memory is proportional to the edits instead of the length of the text.
+ * Has the parts of the SplitVector<char> interface that CellBuffer uses.
+ */
+class PieceTable {
+	struct Piece {
+		bool added;
+		Sci::Position start;
+		Piece() noexcept : added(false), start(0) {
+		}
+		Piece(bool added_, Sci::Position start_) noexcept : added(added_), start(start_) {
+		}
+	};
+	IMappedText *original;
+	const char *originalText;
+	Sci::Position originalLength;
+	std::vector<char> added;
+	SplitVector<Piece> pieces;
+	Partitioning<Sci::Position> starts;	///< Piece i covers [starts(i), starts(i+1))
+	std::vector<char> rangeCopy;
+	// The piece last used by ValueAt as most access is sequential
+	mutable Sci::Position cacheStart;
+	mutable Sci::Position cacheEnd;
+	mutable const char *cacheText;
+
+	const char *PieceText(Sci::Position piece) const noexcept;
+	Sci::Position SplitAt(Sci::Position position);
+	void Invalidate() noexcept;
+public:
+	explicit PieceTable(IMappedText *original_);
+	// Deleted so PieceTable objects can not be copied.
+	PieceTable(const PieceTable &) = delete;
+	PieceTable(PieceTable &&) = delete;
+	void operator=(const PieceTable &) = delete;
+	void operator=(PieceTable &&) = delete;
+	~PieceTable();
+
+	Sci::Position Length() const noexcept;
+	Sci::Position Pieces() const noexcept;
+	/// Memory used by the pieces and the added text, not counting the original text
+	size_t MemoryUsed() const noexcept;
+
+	char ValueAt(Sci::Position position) const noexcept;
+	void GetRange(char *buffer, Sci::Position position, Sci::Position retrieveLength) const noexcept;
+	/// Points into the text when the range is within one piece, otherwise to a copy that
+	/// is valid until the next call.
+	const char *RangePointer(Sci::Position position, Sci::Position rangeLength);
+	void InsertFromArray(Sci::Position position, const char *s, Sci::Position insertLength);
+	void DeleteRange(Sci::Position position, Sci::Position deleteLength);
+};
+
+}
+
+#endif
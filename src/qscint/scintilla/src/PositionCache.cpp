@@ -46,6 +46,32 @@
 
 using namespace Scintilla;
 
+void LinePositions::Allocate(int length) {
+	relative.reset(new XYPOSITION[length]);
+	segmentX.assign((length >> segmentShift) + 1, 0.0f);
+}
+
+// Keep the first lengthUsed positions.
+void LinePositions::Grow(int length, int lengthUsed) {
+	std::unique_ptr<XYPOSITION[]> relativeNew(new XYPOSITION[length]);
+	std::copy(relative.get(), relative.get() + lengthUsed, relativeNew.get());
+	relative = std::move(relativeNew);
+	segmentX.resize((length >> segmentShift) + 1, 0.0f);
+}
+
+void LinePositions::Free() noexcept {
+	relative.reset();
+	segmentX.clear();
+}
+
+void LinePositions::ClearSegments() noexcept {
+	std::fill(segmentX.begin(), segmentX.end(), 0.0f);
+}
+
+size_t LinePositions::MemoryUsed(int length) const noexcept {
+	return (relative ? length * sizeof(XYPOSITION) : 0) + segmentX.capacity() * sizeof(XYPOSITION);
+}
+
 LineLayout::LineLayout(int maxLineLength_) :
 	lenLineStarts(0),
 	lineNumber(-1),
@@ -59,6 +85,10 @@ LineLayout::LineLayout(int maxLineLength_) :
 	containsCaret(false),
 	edgeColumn(0),
 	bracePreviousStyles{},
+	segmented(false),
+	lengthLaidOut(0),
+	sameBefore(0),
+	sameAfter(0),
 	hotspot(0,0),
 	widthLine(wrapWidthInfinite),
 	lines(1),
@@ -77,7 +107,23 @@ void LineLayout::Resize(int maxLineLength_) {
 		styles.reset(new unsigned char[maxLineLength_ + 1]);
 		// Extra position allocated as sometimes the Windows
 		// GetTextExtentExPoint API writes an extra element.
-		positions.reset(new XYPOSITION[maxLineLength_ + 1 + 1]);
+		positions.Allocate(maxLineLength_ + 1 + 1);
+		maxLineLength = maxLineLength_;
+	}
+}
+
+// Like Resize but keeps the text, styles and positions already laid out so a long line
+// that grows does not have to be measured again.
+void LineLayout::Grow(int maxLineLength_) {
+	if (maxLineLength_ > maxLineLength) {
+		const int lengthUsed = std::min(numCharsInLine + 1, maxLineLength + 1);
+		std::unique_ptr<char[]> charsNew(new char[maxLineLength_ + 1]);
+		std::copy(chars.get(), chars.get() + lengthUsed, charsNew.get());
+		chars = std::move(charsNew);
+		std::unique_ptr<unsigned char[]> stylesNew(new unsigned char[maxLineLength_ + 1]);
+		std::copy(styles.get(), styles.get() + lengthUsed, stylesNew.get());
+		styles = std::move(stylesNew);
+		positions.Grow(maxLineLength_ + 1 + 1, lengthUsed);
 		maxLineLength = maxLineLength_;
 	}
 }
@@ -85,7 +131,7 @@ void LineLayout::Resize(int maxLineLength_) {
 void LineLayout::Free() {
 	chars.reset();
 	styles.reset();
-	positions.reset();
+	positions.Free();
 	lineStarts.reset();
 }
 
@@ -94,6 +140,20 @@ void LineLayout::Invalidate(validLevel validity_) {
 		validity = validity_;
 }
 
+// [start, start + lengthChanged) of the line, which is now lengthLine bytes long, is new text or has new styles.
+void LineLayout::NoteChange(int start, int lengthChanged, int lengthLine) noexcept {
+	sameBefore = std::min(sameBefore, start);
+	sameAfter = std::min(sameAfter, std::max(lengthLine - start - lengthChanged, 0));
+}
+
+void LineLayout::SetSegmentPositions() noexcept {
+	XYACCUMULATOR x = 0;
+	for (size_t segment = 0; segment < segments.size(); segment++) {
+		positions.SetSegmentX(segment, static_cast<XYPOSITION>(x));
+		x += segments[segment].width;
+	}
+}
+
 int LineLayout::LineStart(int line) const {
 	if (line <= 0) {
 		return 0;
@@ -243,6 +303,18 @@ int LineLayout::EndLineStyle() const {
 	return styles[numCharsBeforeEOL > 0 ? numCharsBeforeEOL-1 : 0];
 }
 
+size_t LineLayout::MemoryUsed() const noexcept {
+	size_t memory = sizeof(*this) + segments.capacity() * sizeof(LayoutSegment);
+	if (chars) {
+		// chars and styles hold maxLineLength + 1 bytes, positions one more element, see Resize
+		memory += 2 * (maxLineLength + 1) + positions.MemoryUsed(maxLineLength + 1 + 1);
+	}
+	if (lineStarts) {
+		memory += lenLineStarts * sizeof(int);
+	}
+	return memory;
+}
+
 LineLayoutCache::LineLayoutCache() :
 	level(0),
 	allInvalidated(false), styleClock(-1), useCount(0) {
@@ -286,6 +358,18 @@ void LineLayoutCache::AllocateForLevel(Sci::Line linesOnScreen, Sci::Line linesI
 void LineLayoutCache::Deallocate() {
 	PLATFORM_ASSERT(useCount == 0);
 	cache.clear();
+	// A document level cache may have had an entry for every line
+	cache.shrink_to_fit();
+}
+
+size_t LineLayoutCache::MemoryUsed() const noexcept {
+	size_t memory = cache.capacity() * sizeof(cache[0]);
+	for (const std::unique_ptr<LineLayout> &ll : cache) {
+		if (ll) {
+			memory += ll->MemoryUsed();
+		}
+	}
+	return memory;
 }
 
 void LineLayoutCache::Invalidate(LineLayout::validLevel validity_) {
@@ -301,6 +385,29 @@ void LineLayoutCache::Invalidate(LineLayout::validLevel validity_) {
 	}
 }
 
+// Segmented layouts of long lines are not compared with the document when checked so
+// the part of the line that changed is noted here.
+void LineLayoutCache::NoteChange(const Document *pdoc, Sci::Position position, Sci::Position length, bool linesChanged) {
+	if (cache.empty() || allInvalidated)
+		return;
+	const Sci::Line lineFirst = pdoc->SciLineFromPosition(position);
+	const Sci::Line lineLast = pdoc->SciLineFromPosition(position + length);
+	for (const std::unique_ptr<LineLayout> &ll : cache) {
+		if (ll && ll->segmented && (ll->lineNumber >= lineFirst)) {
+			if (linesChanged) {
+				// Lines have moved so the layout may now be for other text
+				ll->Invalidate(LineLayout::llInvalid);
+			} else if (ll->lineNumber <= lineLast) {
+				const Sci::Position lineStart = pdoc->LineStart(ll->lineNumber);
+				const Sci::Position lineEnd = pdoc->LineStart(ll->lineNumber + 1);
+				const Sci::Position start = std::max(position, lineStart) - lineStart;
+				const Sci::Position end = std::min(position + length, lineEnd) - lineStart;
+				ll->NoteChange(static_cast<int>(start), static_cast<int>(end - start), static_cast<int>(lineEnd - lineStart));
+			}
+		}
+	}
+}
+
 void LineLayoutCache::SetLevel(int level_) {
 	allInvalidated = false;
 	if ((level_ != -1) && (level != level_)) {
@@ -334,9 +441,15 @@ LineLayout *LineLayoutCache::Retrieve(Sci::Line lineNumber, Sci::Line lineCaret,
 		PLATFORM_ASSERT(useCount == 0);
 		if (!cache.empty() && (pos < static_cast<int>(cache.size()))) {
 			if (cache[pos]) {
-				if ((cache[pos]->lineNumber != lineNumber) ||
-				        (cache[pos]->maxLineLength < maxChars)) {
+				if (cache[pos]->lineNumber != lineNumber) {
 					cache[pos].reset();
+				} else if (cache[pos]->maxLineLength < maxChars) {
+					if (cache[pos]->segmented) {
+						// Leave room so typing in a long line does not grow it each time
+						cache[pos]->Grow(maxChars + maxChars / 16);
+					} else {
+						cache[pos].reset();
+					}
 				}
 			}
 			if (!cache[pos]) {
@@ -461,10 +574,15 @@ BreakFinder::BreakFinder(const LineLayout *ll_, const Selection *psel, Range lin
 	// First find the first visible character
 	if (xStart > 0.0f)
 		nextBreak = ll->FindBefore(static_cast<XYPOSITION>(xStart), lineRange);
-	// Now back to a style break
-	while ((nextBreak > lineRange.start) && (ll->styles[nextBreak] == ll->styles[nextBreak - 1])) {
+	// Now back to a style break, but not far in a segmented line which may be all one style
+	const int backLimit = ll->segmented ?
+		std::max(static_cast<int>(lineRange.start), nextBreak - lengthStartSubdivision) : static_cast<int>(lineRange.start);
+	while ((nextBreak > backLimit) && (ll->styles[nextBreak] == ll->styles[nextBreak - 1])) {
 		nextBreak--;
 	}
+	if ((nextBreak == backLimit) && (nextBreak > lineRange.start)) {
+		nextBreak = static_cast<int>(pdoc->MovePositionOutsideChar(posLineStart + nextBreak, -1) - posLineStart);
+	}
 
 	if (breakForSelection) {
 		const SelectionPosition posStart(posLineStart);
@@ -483,7 +601,7 @@ BreakFinder::BreakFinder(const LineLayout *ll_, const Selection *psel, Range lin
 	if (pvsDraw && pvsDraw->indicatorsSetFore) {
 		for (const IDecoration *deco : pdoc->decorations->View()) {
 			if (pvsDraw->indicators[deco->Indicator()].OverridesTextFore()) {
-				Sci::Position startPos = deco->EndRun(posLineStart);
+				Sci::Position startPos = deco->EndRun(posLineStart + nextBreak);
 				while (startPos < (posLineStart + lineRange.end)) {
 					Insert(startPos - posLineStart);
 					startPos = deco->EndRun(startPos);
@@ -600,6 +718,11 @@ void PositionCacheEntry::Clear() {
 	clock = 0;
 }
 
+size_t PositionCacheEntry::MemoryUsed() const noexcept {
+	// Positions followed by the text, see Set
+	return positions ? (len + (len / sizeof(XYPOSITION)) + 1) * sizeof(XYPOSITION) : 0;
+}
+
 bool PositionCacheEntry::Retrieve(unsigned int styleNumber_, const char *s_,
 	unsigned int len_, XYPOSITION *positions_) const {
 	if ((styleNumber == styleNumber_) && (len == len_) &&
@@ -661,6 +784,16 @@ void PositionCache::SetSize(size_t size_) {
 	pces.resize(size_);
 }
 
+size_t PositionCache::MemoryUsed() const noexcept {
+	size_t memory = pces.capacity() * sizeof(PositionCacheEntry);
+	if (!allClear) {
+		for (const PositionCacheEntry &pce : pces) {
+			memory += pce.MemoryUsed();
+		}
+	}
+	return memory;
+}
+
 void PositionCache::MeasureWidths(Surface *surface, const ViewStyle &vstyle, unsigned int styleNumber,
 	const char *s, unsigned int len, XYPOSITION *positions, const Document *pdoc) {
 
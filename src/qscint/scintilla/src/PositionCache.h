@@ -44,6 +44,48 @@ enum PointEnd {
 	peSubLineEnd = 0x2
 };
 
+/**
+ * The x position of each character of a line with an extra element for the end of the line.
+ * Positions are held relative to the start of segments of segmentLength bytes along with the
+ * x of each segment so a change in the width of one segment only moves the later segment starts.
+ * For lines that are not segmented every segment starts at 0 so the relative positions are the x.
+ */
+class LinePositions {
+	std::unique_ptr<XYPOSITION[]> relative;
+	std::vector<XYPOSITION> segmentX;
+public:
+	enum { segmentShift = 12, segmentLength = 1 << segmentShift };
+	void Allocate(int length);
+	void Grow(int length, int lengthUsed);
+	void Free() noexcept;
+	XYPOSITION operator[](Sci::Position i) const noexcept {
+		return relative[i] + segmentX[i >> segmentShift];
+	}
+	XYPOSITION *Relative() noexcept {
+		return relative.get();
+	}
+	XYPOSITION SegmentX(size_t segment) const noexcept {
+		return segmentX[segment];
+	}
+	void SetSegmentX(size_t segment, XYPOSITION x) noexcept {
+		segmentX[segment] = x;
+	}
+	void ClearSegments() noexcept;
+	/// length is the number of positions allocated
+	size_t MemoryUsed(int length) const noexcept;
+};
+
+/**
+ * Layout state of one segment of a very long line.
+ * Segments that have not been shown are not measured and use the average character width.
+ */
+struct LayoutSegment {
+	XYPOSITION width;
+	bool measured;
+	explicit LayoutSegment(XYPOSITION width_=0, bool measured_=false) noexcept : width(width_), measured(measured_) {
+	}
+};
+
 /**
  */
 class LineLayout {
@@ -67,9 +109,17 @@ public:
 	int edgeColumn;
 	std::unique_ptr<char[]> chars;
 	std::unique_ptr<unsigned char[]> styles;
-	std::unique_ptr<XYPOSITION[]> positions;
+	LinePositions positions;
 	char bracePreviousStyles[2];
 
+	// Lines of segmentedLength bytes or more are laid out a segment at a time, see EditView::LayoutLine
+	enum { segmentedLength = 0x10000 };
+	bool segmented;
+	std::vector<LayoutSegment> segments;
+	int lengthLaidOut;	///< Bytes in the line including its end of line when it was laid out
+	int sameBefore;	///< Bytes at the start of the line unchanged since it was laid out
+	int sameAfter;	///< Bytes at the end of the line unchanged since it was laid out
+
 	// Hotspot support
 	Range hotspot;
 
@@ -86,8 +136,11 @@ public:
 	void operator=(LineLayout &&) = delete;
 	virtual ~LineLayout();
 	void Resize(int maxLineLength_);
+	void Grow(int maxLineLength_);
 	void Free();
 	void Invalidate(validLevel validity_);
+	void NoteChange(int start, int lengthChanged, int lengthLine) noexcept;
+	void SetSegmentPositions() noexcept;
 	int LineStart(int line) const;
 	enum class Scope { visibleOnly, includeEnd };
 	int LineLastVisible(int line, Scope scope) const;
@@ -101,6 +154,7 @@ public:
 	int FindPositionFromX(XYPOSITION x, Range range, bool charPosition) const;
 	Point PointFromPosition(int posInLine, int lineHeight, PointEnd pe) const;
 	int EndLineStyle() const;
+	size_t MemoryUsed() const noexcept;
 };
 
 /**
@@ -129,11 +183,13 @@ public:
 		llcDocument=SC_CACHE_DOCUMENT
 	};
 	void Invalidate(LineLayout::validLevel validity_);
+	void NoteChange(const Document *pdoc, Sci::Position position, Sci::Position length, bool linesChanged);
 	void SetLevel(int level_);
 	int GetLevel() const { return level; }
 	LineLayout *Retrieve(Sci::Line lineNumber, Sci::Line lineCaret, int maxChars, int styleClock_,
 		Sci::Line linesOnScreen, Sci::Line linesInDoc);
 	void Dispose(LineLayout *ll);
+	size_t MemoryUsed() const noexcept;
 };
 
 class PositionCacheEntry {
@@ -156,6 +212,7 @@ public:
 	static unsigned int Hash(unsigned int styleNumber_, const char *s, unsigned int len_);
 	bool NewerThan(const PositionCacheEntry &other) const;
 	void ResetClock();
+	size_t MemoryUsed() const noexcept;
 };
 
 class Representation {
@@ -238,6 +295,7 @@ public:
 	void Clear();
 	void SetSize(size_t size_);
 	size_t GetSize() const { return pces.size(); }
+	size_t MemoryUsed() const noexcept;
 	void MeasureWidths(Surface *surface, const ViewStyle &vstyle, unsigned int styleNumber,
 		const char *s, unsigned int len, XYPOSITION *positions, const Document *pdoc);
 };
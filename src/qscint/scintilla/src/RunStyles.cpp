@@ -277,6 +277,11 @@ DISTANCE RunStyles<DISTANCE, STYLE>::Find(STYLE value, DISTANCE start) const noe
 	return -1;
 }
 
+template <typename DISTANCE, typename STYLE>
+size_t RunStyles<DISTANCE, STYLE>::MemoryUsed() const noexcept {
+	return starts->MemoryUsed() + styles->MemoryUsed();
+}
+
 template <typename DISTANCE, typename STYLE>
 void RunStyles<DISTANCE, STYLE>::Check() const {
 	if (Length() < 0) {
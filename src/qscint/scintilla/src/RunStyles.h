@@ -55,6 +55,7 @@ public:
 	bool AllSame() const noexcept;
 	bool AllSameAs(STYLE value) const noexcept;
 	DISTANCE Find(STYLE value, DISTANCE start) const noexcept;
+	size_t MemoryUsed() const noexcept;
 
 	void Check() const;
 };
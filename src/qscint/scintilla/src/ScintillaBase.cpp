@@ -549,6 +549,10 @@ class LexState : public LexInterface {
 	void SetLexerModule(const LexerModule *lex);
 	PropSetSimple props;
 	int interfaceVersion;
+	// What was sent to the instance so a copy can be made for background lexing
+	std::map<std::string, std::string> instanceProps;
+	std::map<int, std::string> instanceWordLists;
+	bool instanceCustomised;	///< Sub styles or private calls which can not be copied
 public:
 	int lexLanguage;
 
@@ -574,6 +578,7 @@ public:
 	int PropGetExpanded(const char *key, char *result) const;
 
 	int LineEndTypesSupported() override;
+	ILexer *CreateBackgroundInstance() override;
 	int AllocateSubStyles(int styleBase, int numberStyles);
 	int SubStylesStart(int styleBase);
 	int SubStylesLength(int styleBase);
@@ -596,6 +601,7 @@ LexState::LexState(Document *pdoc_) : LexInterface(pdoc_) {
 	performingStyle = false;
 	interfaceVersion = lvOriginal;
 	lexLanguage = SCLEX_CONTAINER;
+	instanceCustomised = false;
 }
 
 LexState::~LexState() {
@@ -619,6 +625,10 @@ void LexState::SetLexerModule(const LexerModule *lex) {
 			instance = nullptr;
 		}
 		interfaceVersion = lvOriginal;
+		instanceProps.clear();
+		instanceWordLists.clear();
+		instanceCustomised = false;
+		generation++;
 		lexCurrent = lex;
 		if (lexCurrent) {
 			instance = lexCurrent->Create();
@@ -659,6 +669,8 @@ const char *LexState::DescribeWordListSets() {
 
 void LexState::SetWordList(int n, const char *wl) {
 	if (instance) {
+		instanceWordLists[n] = wl;
+		generation++;
 		const Sci_Position firstModification = instance->WordListSet(n, wl);
 		if (firstModification >= 0) {
 			pdoc->ModifiedAt(firstModification);
@@ -672,6 +684,8 @@ const char *LexState::GetName() const {
 
 void *LexState::PrivateCall(int operation, void *pointer) {
 	if (pdoc && instance) {
+		instanceCustomised = true;
+		generation++;
 		return instance->PrivateCall(operation, pointer);
 	} else {
 		return nullptr;
@@ -705,6 +719,8 @@ const char *LexState::DescribeProperty(const char *name) {
 void LexState::PropSet(const char *key, const char *val) {
 	props.Set(key, val, strlen(key), strlen(val));
 	if (instance) {
+		instanceProps[key] = val;
+		generation++;
 		const Sci_Position firstModification = instance->PropertySet(key, val);
 		if (firstModification >= 0) {
 			pdoc->ModifiedAt(firstModification);
@@ -731,8 +747,26 @@ int LexState::LineEndTypesSupported() {
 	return 0;
 }
 
+ILexer *LexState::CreateBackgroundInstance() {
+	if (!lexCurrent || !instance || instanceCustomised)
+		return nullptr;
+	// LPeg reads the text through BufferPointer which a LexSnapshot can not provide
+	if (lexCurrent->GetLanguage() == SCLEX_LPEG)
+		return nullptr;
+	ILexer *copy = lexCurrent->Create();
+	for (const std::pair<const std::string, std::string> &prop : instanceProps) {
+		copy->PropertySet(prop.first.c_str(), prop.second.c_str());
+	}
+	for (const std::pair<const int, std::string> &wordList : instanceWordLists) {
+		copy->WordListSet(wordList.first, wordList.second.c_str());
+	}
+	return copy;
+}
+
 int LexState::AllocateSubStyles(int styleBase, int numberStyles) {
 	if (instance && (interfaceVersion >= lvSubStyles)) {
+		instanceCustomised = true;
+		generation++;
 		return static_cast<ILexerWithSubStyles *>(instance)->AllocateSubStyles(styleBase, numberStyles);
 	}
 	return -1;
@@ -774,6 +808,8 @@ void LexState::FreeSubStyles() {
 
 void LexState::SetIdentifiers(int style, const char *identifiers) {
 	if (instance && (interfaceVersion >= lvSubStyles)) {
+		instanceCustomised = true;
+		generation++;
 		static_cast<ILexerWithSubStyles *>(instance)->SetIdentifiers(style, identifiers);
 		pdoc->ModifiedAt(0);
 	}
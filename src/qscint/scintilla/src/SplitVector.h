@@ -325,6 +325,23 @@ public:
 	ptrdiff_t GapPosition() const noexcept {
 		return part1Length;
 	}
+
+	/// Bytes allocated for the elements including the gap.
+	/// Memory owned by the elements themselves is not included.
+	size_t MemoryUsed() const noexcept {
+		return body.capacity() * sizeof(T);
+	}
+
+	/// Release the gap so the allocation only holds the elements.
+	/// Pointers into the buffer are invalidated.
+	void Compact() {
+		if (body.capacity() > static_cast<size_t>(lengthBody)) {
+			GapTo(lengthBody);
+			body.resize(lengthBody);
+			body.shrink_to_fit();
+			gapLength = 0;
+		}
+	}
 };
 
 }
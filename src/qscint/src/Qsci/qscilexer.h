@@ -26,6 +26,7 @@
 #include <QMap>
 #include <QObject>
 #include <QString>
+#include <QVector>
 
 #include <Qsci/qsciglobal.h>
 
@@ -91,6 +92,40 @@ public:
 		QColor paper;
 		bool eol_fill;
 	};
+
+	//! The style settings of a lexer as read from a QSettings by
+	//! readStyleSettings().  Lexers of the same language and theme can all
+	//! apply one copy with applyStyleSettings() instead of each looking up
+	//! every key again.
+	struct StyleSettings {
+		enum {
+			HasColor = 0x01,
+			HasEolFill = 0x02,
+			HasFont = 0x04,
+			HasPaper = 0x08
+		};
+
+		struct Style {
+			int style;
+			int flags;
+			QColor color;
+			bool eolFill;
+			QFont font;
+			QColor paper;
+		};
+
+		int defaultFlags;
+		QColor defaultColor;
+		QColor defaultPaper;
+		QFont defaultFont;
+		bool hasAutoIndentStyle;
+		int autoIndentStyle;
+		QVector<Style> styles;
+		bool complete;
+
+		StyleSettings() : defaultFlags(0), hasAutoIndentStyle(false),
+			autoIndentStyle(0), complete(true) {}
+	};
     //! Construct a QsciLexer with parent \a parent.  \a parent is typically
     //! the QsciScintilla instance.
     QsciLexer(QObject *parent = 0);
@@ -278,6 +313,24 @@ public:
     //! \sa writeSettings(), QsciScintilla::setLexer()
     bool readSettings(QSettings &qs,const char *prefix = "/Scintilla");
 
+    //! The colour, paper, font and end-of-line for each style number are
+    //! read from the settings \a qs into \a settings without changing the
+    //! lexer.  Lexer specific properties are not read.
+    //!
+    //! \sa applyStyleSettings(), readPropertySettings()
+    void readStyleSettings(QSettings &qs, StyleSettings &settings,
+            const char *prefix = "/Scintilla") const;
+
+    //! The style settings \a settings, read by readStyleSettings() from a
+    //! lexer of the same language, are applied.  true is returned if no
+    //! setting was missing.
+    bool applyStyleSettings(const StyleSettings &settings);
+
+    //! All lexer specific properties are read from the settings \a qs.
+    //! true is returned if there was no error.
+    bool readPropertySettings(QSettings &qs,
+            const char *prefix = "/Scintilla");
+
     //! Causes all properties to be refreshed by emitting the
     //! propertyChanged() signal as required.
     virtual void refreshProperties();
@@ -406,6 +459,7 @@ private:
 
 
     void setStyleDefaults() const;
+    void applyDefaultSettings(const StyleSettings &settings);
 
     QsciLexer(const QsciLexer &);
     QsciLexer &operator=(const QsciLexer &);
@@ -743,6 +743,27 @@ public:
         //! This message empties the undo buffer.
         SCI_EMPTYUNDOBUFFER = 2175,
 
+        //! This message limits the memory used by the text of the undo
+        //! history.  wParam is the budget in bytes, 0 means no limit.
+        SCI_SETUNDOMEMORYBUDGET = 2719,
+
+        //! This message returns the memory budget of the undo history.
+        SCI_GETUNDOMEMORYBUDGET = 2720,
+
+        //! This message sets whether undo text is compressed before it is
+        //! moved to a temporary file.
+        SCI_SETUNDOCOMPRESSION = 2721,
+
+        //! This message returns whether undo text is compressed.
+        SCI_GETUNDOCOMPRESSION = 2722,
+
+        //! This message returns the memory in bytes used by the undo history.
+        SCI_GETUNDOMEMORY = 2723,
+
+        //! This message returns the size in bytes of the undo text moved to
+        //! a temporary file.
+        SCI_GETUNDOSPILLEDMEMORY = 2724,
+
         //!
         SCI_UNDO = 2176,
 
@@ -2065,6 +2086,52 @@ public:
         //!
         SCI_GETGAPPOSITION = 2644,
 
+        //! This message makes an empty document refer to read-only text
+        //! such as a mapped file instead of copying it.  lParam is an
+        //! IMappedText that the document releases when no longer used.
+        //! wParam may be SC_DOCUMENTOPTION_STYLES_NONE to drop the style
+        //! buffer.
+        SCI_SETMAPPEDTEXT = 2725,
+
+        //! This message makes the document refer to mapped text with the
+        //! same contents, such as the file it was saved to.
+        SCI_REBASEMAPPEDTEXT = 2726,
+
+        //! This message returns whether the document text is stored in a
+        //! piece table over mapped text.
+        SCI_GETTEXTMAPPED = 2727,
+
+        //! This message returns the memory used by the edits of a mapped
+        //! document.
+        SCI_GETMAPPEDMEMORY = 2728,
+
+        //! This message returns the bytes allocated for one component of
+        //! the document.  wParam is one of the SC_MEMORY values.
+        //! SC_MEMORY_LAYOUT is the layout and position caches of this view.
+        SCI_GETMEMORYUSAGE = 2732,
+
+        //! This message frees the layout and position caches and the gap of
+        //! the text and style buffers.  If wParam is SC_RELEASE_STYLES the
+        //! styles are freed as well and the document is restyled when they
+        //! are next needed.
+        SCI_RELEASEMEMORY = 2733,
+
+        //! This message replaces several ranges as one modification with one
+        //! undo step.  wParam is the number of Sci_TextRange that lParam
+        //! points to.  They are in document order and do not overlap.
+        //! Returns the change in document length.
+        SCI_REPLACERANGES = 2729,
+
+        //! This message contracts, expands or toggles every fold header whose
+        //! level number is wParam above SC_FOLDLEVELBASE.  lParam is one of
+        //! the SC_FOLDACTION values.
+        SCI_FOLDATLEVEL = 2730,
+
+        //! This message contracts, expands or toggles every fold header that
+        //! is inside wParam other headers.  lParam is one of the SC_FOLDACTION
+        //! values.
+        SCI_FOLDATDEPTH = 2731,
+
         //!
         SCI_DELETERANGE = 2645,
 
@@ -2435,6 +2502,7 @@ public:
         SC_IDLESTYLING_TOVISIBLE = 1,
         SC_IDLESTYLING_AFTERVISIBLE = 2,
         SC_IDLESTYLING_ALL = 3,
+        SC_IDLESTYLING_BACKGROUND = 4,
     };
 
     enum
@@ -3462,6 +3530,24 @@ public:
         SC_FOLDACTION_TOGGLE = 2,
     };
 
+    enum
+    {
+        SC_MEMORY_TEXT = 0,
+        SC_MEMORY_STYLES = 1,
+        SC_MEMORY_LINES = 2,
+        SC_MEMORY_MARKERS = 3,
+        SC_MEMORY_LINEDATA = 4,
+        SC_MEMORY_INDICATORS = 5,
+        SC_MEMORY_UNDO = 6,
+        SC_MEMORY_LAYOUT = 7,
+    };
+
+    enum
+    {
+        SC_RELEASE_CACHES = 0,
+        SC_RELEASE_STYLES = 1,
+    };
+
     enum
     {
         SC_AUTOMATICFOLD_SHOW = 0x0001,
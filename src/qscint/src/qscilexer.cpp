@@ -457,64 +457,90 @@ bool QsciLexer::writeProperties(QSettings &,const QString &) const
 // Restore the user settings.
 bool QsciLexer::readSettings(QSettings &qs,const char *prefix)
 {
-    bool ok, flag, rc = true;
+    StyleSettings settings;
+
+    readStyleSettings(qs, settings, prefix);
+
+    bool rc = applyStyleSettings(settings);
+
+    if (!readPropertySettings(qs, prefix))
+        rc = false;
+
+    return rc;
+}
+
+
+// Read the style settings without changing the lexer.
+void QsciLexer::readStyleSettings(QSettings &qs, StyleSettings &settings,
+        const char *prefix) const
+{
+    bool ok;
     int num;
     QString key, full_key;
     QStringList fdesc;
 
-    //原来是先读取默认值，在读取配置值。加入主题后，得先读取配置的默认值。
-    //因为非默认主题的初始样式值，就该是默认样式值。只有读取配置的默认值，后面初始化样式时，
-    //才能获取到真正的样式默认值。
-    if (m_themesId != 0)
-    {
-        key = QString("%1/%2/").arg(prefix).arg(language());
-
-        // Read the default foreground colour.
-        full_key = key + "defaultcolor";
+    settings = StyleSettings();
 
-        ok = qs.contains(full_key);
-        num = qs.value(full_key).toString().toInt(&ok, 16);
+    key = QString("%1/%2/").arg(prefix).arg(language());
 
-        if (ok)
-            setDefaultColor(QColor((num >> 16) & 0xff, (num >> 8) & 0xff, num & 0xff));
-        else
-            rc = false;
+    // Read the default foreground colour.
+    full_key = key + "defaultcolor";
 
-        // Read the default background colour.
-        full_key = key + "defaultpaper";
+    num = qs.value(full_key).toString().toInt(&ok, 16);
 
-        ok = qs.contains(full_key);
-        num = qs.value(full_key).toString().toInt(&ok, 16);
+    if (ok)
+    {
+        settings.defaultColor = QColor((num >> 16) & 0xff, (num >> 8) & 0xff, num & 0xff);
+        settings.defaultFlags |= StyleSettings::HasColor;
+    }
+    else
+        settings.complete = false;
 
-        if (ok)
-            setDefaultPaper(QColor((num >> 16) & 0xff, (num >> 8) & 0xff, num & 0xff));
-        else
-            rc = false;
+    // Read the default background colour.
+    full_key = key + "defaultpaper";
 
-        // Read the default font.  First try the deprecated format that uses an
-        // integer point size.
-        full_key = key + "defaultfont";
+    num = qs.value(full_key).toString().toInt(&ok, 16);
 
-        ok = qs.contains(full_key);
-        fdesc = qs.value(full_key).toStringList();
+    if (ok)
+    {
+        settings.defaultPaper = QColor((num >> 16) & 0xff, (num >> 8) & 0xff, num & 0xff);
+        settings.defaultFlags |= StyleSettings::HasPaper;
+    }
+    else
+        settings.complete = false;
 
-        if (ok && fdesc.count() == 5)
-        {
-            QFont f;
+    // Read the default font.  Only the deprecated format that uses an integer
+    // point size is written.
+    full_key = key + "defaultfont";
 
-            f.setFamily(fdesc[0]);
-            f.setPointSize(fdesc[1].toInt());
-            f.setBold(fdesc[2].toInt());
-            f.setItalic(fdesc[3].toInt());
-            f.setUnderline(fdesc[4].toInt());
+    ok = qs.contains(full_key);
+    fdesc = qs.value(full_key).toStringList();
 
-            setDefaultFont(f);
-        }
-        else
-            rc = false;
+    if (ok && fdesc.count() == 5)
+    {
+        settings.defaultFont.setFamily(fdesc[0]);
+        settings.defaultFont.setPointSize(fdesc[1].toInt());
+        settings.defaultFont.setBold(fdesc[2].toInt());
+        settings.defaultFont.setItalic(fdesc[3].toInt());
+        settings.defaultFont.setUnderline(fdesc[4].toInt());
+        settings.defaultFlags |= StyleSettings::HasFont;
     }
+    else
+        settings.complete = false;
 
-    setStyleDefaults();
+    // Read the auto-indentation style.
+    full_key = key + "autoindentstyle";
+
+    ok = qs.contains(full_key);
+    num = qs.value(full_key).toInt();
+
+    if (ok)
+    {
+        settings.autoIndentStyle = num;
+        settings.hasAutoIndentStyle = true;
+    }
+    else
+        settings.complete = false;
 
     // Read the styles.
     for (int i = 0; i <= QsciScintillaBase::STYLE_MAX; ++i)
@@ -523,32 +549,40 @@ bool QsciLexer::readSettings(QSettings &qs,const char *prefix)
         if (description(i).isEmpty())
             continue;
 
+        StyleSettings::Style style;
+        style.style = i;
+        style.flags = 0;
+        style.eolFill = false;
+
         key = QString("%1/%2/style%3/").arg(prefix).arg(language()).arg(i);
 
         // Read the foreground colour.
         full_key = key + "color";
 
-        ok = qs.contains(full_key);
         num = qs.value(full_key).toString().toInt(&ok, 16);
 
         if (ok)
-            setColor(QColor((num >> 16) & 0xff, (num >> 8) & 0xff, num & 0xff), i);
+        {
+            style.color = QColor((num >> 16) & 0xff, (num >> 8) & 0xff, num & 0xff);
+            style.flags |= StyleSettings::HasColor;
+        }
         else
-            rc = false;
+            settings.complete = false;
 
         // Read the end-of-line fill.
         full_key = key + "eolfill";
 
         ok = qs.contains(full_key);
-        flag = qs.value(full_key, false).toBool();
 
         if (ok)
-            setEolFill(flag, i);
+        {
+            style.eolFill = qs.value(full_key, false).toBool();
+            style.flags |= StyleSettings::HasEolFill;
+        }
         else
-            rc = false;
+            settings.complete = false;
 
-        // Read the font.  First try the deprecated format that uses an integer
-        // point size.
+        // Read the font.
         full_key = key + "font";
 
         ok = qs.contains(full_key);
@@ -556,157 +590,94 @@ bool QsciLexer::readSettings(QSettings &qs,const char *prefix)
 
         if (ok && fdesc.count() == 5)
         {
-            QFont f;
-
-            f.setFamily(fdesc[0]);
-            f.setPointSize(fdesc[1].toInt());
-            f.setBold(fdesc[2].toInt());
-            f.setItalic(fdesc[3].toInt());
-            f.setUnderline(fdesc[4].toInt());
-
-            setFont(f, i);
+            style.font.setFamily(fdesc[0]);
+            style.font.setPointSize(fdesc[1].toInt());
+            style.font.setBold(fdesc[2].toInt());
+            style.font.setItalic(fdesc[3].toInt());
+            style.font.setUnderline(fdesc[4].toInt());
+            style.flags |= StyleSettings::HasFont;
         }
         else
-            rc = false;
-
-        // Now try the newer font format that uses a floating point point size.
-        // It is not an error if it doesn't exist.
-        //full_key = key + "font2";
-
-       // ok = qs.contains(full_key);
-       // fdesc = qs.value(full_key).toStringList();
-
-        /*if (ok)
-        {
-             Allow for future versions with more fields.
-            if (fdesc.count() >= 5)
-            {
-                QFont f;
+            settings.complete = false;
 
-                f.setFamily(fdesc[0]);
-                f.setPointSizeF(fdesc[1].toDouble());
-                f.setBold(fdesc[2].toInt());
-                f.setItalic(fdesc[3].toInt());
-                f.setUnderline(fdesc[4].toInt());
-
-                setFont(f, i);
-            }
-            else
-            {
-                rc = false;
-            }
-        }*/
-
-#if 1 //不读取背景颜色，和主题保存一致
         // Read the background colour.
         full_key = key + "paper";
 
-        ok = qs.contains(full_key);
         num = qs.value(full_key).toString().toInt(&ok,16);
 
         if (ok)
-            setPaper(QColor((num >> 16) & 0xff, (num >> 8) & 0xff, num & 0xff), i);
+        {
+            style.paper = QColor((num >> 16) & 0xff, (num >> 8) & 0xff, num & 0xff);
+            style.flags |= StyleSettings::HasPaper;
+        }
         else
-            rc = false;
-#endif
+            settings.complete = false;
+
+        if (style.flags != 0)
+            settings.styles.append(style);
     }
+}
 
-    // Read the properties.
-    key = QString("%1/%2/properties/").arg(prefix).arg(language());
 
-    if (!readProperties(qs,key))
-        rc = false;
+// Apply style settings read by readStyleSettings().
+bool QsciLexer::applyStyleSettings(const StyleSettings &settings)
+{
+    //原来是先读取默认值，在读取配置值。加入主题后，得先读取配置的默认值。
+    //因为非默认主题的初始样式值，就该是默认样式值。只有读取配置的默认值，后面初始化样式时，
+    //才能获取到真正的样式默认值。
+    if (m_themesId != 0)
+        applyDefaultSettings(settings);
 
-    refreshProperties();
+    setStyleDefaults();
 
-    //只有默认主题才需要读取默认值。非默认主题，最前面已经读取过了。
-    if (m_themesId == 0)
+    for (const StyleSettings::Style &style : settings.styles)
     {
-        // Read the rest.
-        key = QString("%1/%2/").arg(prefix).arg(language());
+        if (style.flags & StyleSettings::HasColor)
+            setColor(style.color, style.style);
 
-        // Read the default foreground colour.
-        full_key = key + "defaultcolor";
+        if (style.flags & StyleSettings::HasEolFill)
+            setEolFill(style.eolFill, style.style);
 
-        ok = qs.contains(full_key);
-        num = qs.value(full_key).toString().toInt(&ok, 16);
-
-        if (ok)
-            setDefaultColor(QColor((num >> 16) & 0xff, (num >> 8) & 0xff, num & 0xff));
-        else
-            rc = false;
+        if (style.flags & StyleSettings::HasFont)
+            setFont(style.font, style.style);
 
-        // Read the default background colour.
-        full_key = key + "defaultpaper";
+        if (style.flags & StyleSettings::HasPaper)
+            setPaper(style.paper, style.style);
+    }
 
-        ok = qs.contains(full_key);
-        num = qs.value(full_key).toString().toInt(&ok, 16);
+    //只有默认主题才需要读取默认值。非默认主题，最前面已经读取过了。
+    if (m_themesId == 0)
+        applyDefaultSettings(settings);
 
-        if (ok)
-            setDefaultPaper(QColor((num >> 16) & 0xff, (num >> 8) & 0xff, num & 0xff));
-        else
-            rc = false;
+    if (settings.hasAutoIndentStyle)
+        setAutoIndentStyle(settings.autoIndentStyle);
 
-        // Read the default font.  First try the deprecated format that uses an
-        // integer point size.
-        full_key = key + "defaultfont";
+    return settings.complete;
+}
 
-        ok = qs.contains(full_key);
-        fdesc = qs.value(full_key).toStringList();
 
-        if (ok && fdesc.count() == 5)
-        {
-            QFont f;
+// Apply the default colours and font of style settings.
+void QsciLexer::applyDefaultSettings(const StyleSettings &settings)
+{
+    if (settings.defaultFlags & StyleSettings::HasColor)
+        setDefaultColor(settings.defaultColor);
 
-            f.setFamily(fdesc[0]);
-            f.setPointSize(fdesc[1].toInt());
-            f.setBold(fdesc[2].toInt());
-            f.setItalic(fdesc[3].toInt());
-            f.setUnderline(fdesc[4].toInt());
+    if (settings.defaultFlags & StyleSettings::HasPaper)
+        setDefaultPaper(settings.defaultPaper);
 
-            setDefaultFont(f);
-        }
-        else
-            rc = false;
-    }
+    if (settings.defaultFlags & StyleSettings::HasFont)
+        setDefaultFont(settings.defaultFont);
+}
 
-    // Now try the newer font format that uses a floating point point size.  It
-    // is not an error if it doesn't exist.
-    //full_key = key + "defaultfont2";
-
-    //ok = qs.contains(full_key);
-    //fdesc = qs.value(full_key).toStringList();
-
-    //if (ok)
-    //{
-    //    // Allow for future versions with more fields.
-    //    if (fdesc.count() >= 5)
-    //    {
-    //        QFont f;
-
-    //        f.setFamily(fdesc[0]);
-    //        f.setPointSizeF(fdesc[1].toDouble());
-    //        f.setBold(fdesc[2].toInt());
-    //        f.setItalic(fdesc[3].toInt());
-    //        f.setUnderline(fdesc[4].toInt());
-
-    //        setDefaultFont(f);
-    //    }
-    //    else
-    //    {
-    //        rc = false;
-    //    }
-    //}
 
-    full_key = key + "autoindentstyle";
+// Read the lexer specific properties and refresh them.
+bool QsciLexer::readPropertySettings(QSettings &qs, const char *prefix)
+{
+    QString key = QString("%1/%2/properties/").arg(prefix).arg(language());
 
-    ok = qs.contains(full_key);
-    num = qs.value(full_key).toInt();
+    bool rc = readProperties(qs, key);
 
-    if (ok)
-        setAutoIndentStyle(num);
-    else
-        rc = false;
+    refreshProperties();
 
     return rc;
 }
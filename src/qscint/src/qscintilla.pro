@@ -189,6 +189,8 @@ HEADERS = \
     ../scintilla/lexlib/SubStyles.h \
     ../scintilla/lexlib/WordList.h \
     ../scintilla/src/AutoComplete.h \
+    ../scintilla/src/BackgroundLexer.h \
+    ../scintilla/src/BackgroundWrap.h \
     ../scintilla/src/CallTip.h \
     ../scintilla/src/CaseConvert.h \
     ../scintilla/src/CaseFolder.h \
@@ -204,6 +206,7 @@ HEADERS = \
     ../scintilla/src/EditView.h \
     ../scintilla/src/ElapsedPeriod.h \
     ../scintilla/src/ExternalLexer.h \
+    ../scintilla/src/FoldIndex.h \
     ../scintilla/src/FontQuality.h \
     ../scintilla/src/Indicator.h \
     ../scintilla/src/IntegerRectangle.h \
@@ -212,6 +215,7 @@ HEADERS = \
     ../scintilla/src/MarginView.h \
     ../scintilla/src/Partitioning.h \
     ../scintilla/src/PerLine.h \
+    ../scintilla/src/PieceTable.h \
     ../scintilla/src/Position.h \
     ../scintilla/src/PositionCache.h \
     ../scintilla/src/RESearch.h \
@@ -426,6 +430,8 @@ SOURCES = \
     ../scintilla/lexlib/StyleContext.cpp \
     ../scintilla/lexlib/WordList.cpp \
     ../scintilla/src/AutoComplete.cpp \
+    ../scintilla/src/BackgroundLexer.cpp \
+    ../scintilla/src/BackgroundWrap.cpp \
     ../scintilla/src/CallTip.cpp \
     ../scintilla/src/CaseConvert.cpp \
     ../scintilla/src/CaseFolder.cpp \
@@ -440,11 +446,13 @@ SOURCES = \
     ../scintilla/src/Editor.cpp \
     ../scintilla/src/EditView.cpp \
     ../scintilla/src/ExternalLexer.cpp \
+    ../scintilla/src/FoldIndex.cpp \
     ../scintilla/src/Indicator.cpp \
     ../scintilla/src/KeyMap.cpp \
     ../scintilla/src/LineMarker.cpp \
     ../scintilla/src/MarginView.cpp \
     ../scintilla/src/PerLine.cpp \
+    ../scintilla/src/PieceTable.cpp \
     ../scintilla/src/PositionCache.cpp \
     ../scintilla/src/RESearch.cpp \
     ../scintilla/src/RunStyles.cpp \
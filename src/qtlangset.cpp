@@ -5,6 +5,7 @@
 #include "ccnotepad.h"
 #include "styleset.h"
 #include "extlexermanager.h"
+#include "styletablecache.h"
 
 #include <SciLexer.h>
 #include <qscilexer.h>
@@ -1309,21 +1310,11 @@ void QtLangSet::setStyleShow(QFont& font, QColor& fcColor, QColor &bkColor)
 }
 
 //读取特定语言的设置；StyleId-1则读取当前主题，否则指定的StyleId主题
+//先读取用户修改过的配置，没有则从标准目录读原始配置。
+//每个tab都会创建lexer，样式表按ini文件缓存，不再每次解析ini、逐个样式查找
 bool QtLangSet::readLangSettings(QsciLexer *lexer, QString tag, int StyleId)
 {
-	QString cfgPath = QString("notepad/userstyle/%1/%2").arg((StyleId == -1) ? StyleSet::getCurrentStyle() : StyleSet::getStyleName(StyleId)).arg(tag);
-
-	QSettings qs(QSettings::IniFormat, QSettings::UserScope, cfgPath);
-	if (QFile::exists(qs.fileName()))
-	{
-		return lexer->readSettings(qs);
-	}
-	else//这里应该加个逻辑完备的保护。如果没有读取到用户配置，则应该从标准目标去读原始配置
-	{
-		return readLangOriginSettings(lexer, tag, StyleId, true);
-	}
-	
-	return false;
+	return StyleTableCache::getInstance().readLexerSettings(lexer, tag, StyleId, true);
 }
 
 //读取特定语言的原始样式设置；StyleId-1则读取当前主题，否则指定的StyleId主题
@@ -1336,14 +1327,7 @@ bool QtLangSet::readLangOriginSettings(QsciLexer* lexer, QString tag, int StyleI
 		return true;
 	}
 
-	//默认皮肤路径放在软件的同级目录下面的themes目录
-	QString cfgPath = QString("%1/themes/%2/%3.ini").arg(QCoreApplication::applicationDirPath()).arg((StyleId == -1)?StyleSet::getCurrentStyle(): StyleSet::getStyleName(StyleId)).arg(tag);
-	QSettings qs(cfgPath, QSettings::IniFormat);
-	if (QFile::exists(qs.fileName()))
-	{
-		return lexer->readSettings(qs);
-	}
-	return false;
+	return StyleTableCache::getInstance().readLexerSettings(lexer, tag, StyleId, false);
 }
 
 
@@ -1359,6 +1343,8 @@ void QtLangSet::saveLangeSet(QsciLexer *lexer, int StyleId)
 		QSettings qs(QSettings::IniFormat, QSettings::UserScope, cfgPath);
 		lexer->writeSettings(qs);
 		qs.sync();
+
+		StyleTableCache::getInstance().remove(qs.fileName());
 	}
 }
 
@@ -9,6 +9,9 @@
 #include "filemanager.h"
 #include "shortcutkeymgr.h"
 #include "markdownview.h"
+#include "smarthighlightcache.h"
+#include "wordindex.h"
+#include "nddtrace.h"
 
 #include <Scintilla.h>
 #include <SciLexer.h>
@@ -71,6 +74,7 @@
 
 #include <stdexcept>
 #include <mutex>
+#include <cstring>
 
 
 
@@ -96,6 +100,9 @@ const int MAX_PRE_NEXT_TIMES = 30;
 
 const int INIT_BIG_RO_TEXT_LINE_WIDTH = 8;
 
+//每个文档撤销历史的内存上限，超过后把最久没用到的撤销数据压缩，再写到临时文件中
+const qint64 UNDO_MEMORY_BUDGET = 64 * 1024 * 1024;
+
 #ifdef Q_OS_WIN
 LanguageName ScintillaEditView::langNames[L_EXTERNAL + 1] = {
 {QString("normal"),		QString("Normal QString"),		QString("Normal text file"),								L_TXT,			SCLEX_NULL},
@@ -197,8 +204,11 @@ LanguageName ScintillaEditView::langNames[L_EXTERNAL + 1] = {
 };
 #endif
 
+//文档编号只在界面线程中分配
+static quint64 s_lastDocId = 0;
+
 ScintillaEditView::ScintillaEditView(QWidget *parent,bool isBigText)
-	: QsciScintilla(parent), m_NoteWin(nullptr), m_preFirstLineNum(0), m_curPos(0), m_hasHighlight(false), m_bookmarkPng(nullptr), m_styleColorMenu(nullptr), m_isBigText(isBigText), m_curBlockLineStartNum(0)
+	: QsciScintilla(parent), m_NoteWin(nullptr), m_preFirstLineNum(0), m_curPos(0), m_hasHighlight(false), m_bookmarkPng(nullptr), m_styleColorMenu(nullptr), m_isBigText(isBigText), m_curBlockLineStartNum(0), m_smartHighlight(nullptr), m_wordIndex(nullptr), m_docVersion(0), m_docId(++s_lastDocId), m_urlIndicFore(-1)
 #ifdef Q_OS_WIN
     ,m_isInTailStatus(false)
 #endif
@@ -219,7 +229,7 @@ ScintillaEditView::~ScintillaEditView()
 #endif
 }
 
-ScintillaEditView::ScintillaEditView():QsciScintilla(nullptr),m_NoteWin(nullptr), m_preFirstLineNum(0), m_curPos(0), m_hasHighlight(false), m_bookmarkPng(nullptr), m_styleColorMenu(nullptr), m_isBigText(false), m_curBlockLineStartNum(0)
+ScintillaEditView::ScintillaEditView():QsciScintilla(nullptr),m_NoteWin(nullptr), m_preFirstLineNum(0), m_curPos(0), m_hasHighlight(false), m_bookmarkPng(nullptr), m_styleColorMenu(nullptr), m_isBigText(false), m_curBlockLineStartNum(0), m_smartHighlight(nullptr), m_wordIndex(nullptr), m_docVersion(0), m_docId(++s_lastDocId), m_urlIndicFore(-1)
 #ifdef Q_OS_WIN
 , m_isInTailStatus(false)
 #endif
@@ -244,6 +254,71 @@ ScintillaEditView* ScintillaEditView::createEditForSearch()
 	return new ScintillaEditView();
 }
 
+EditMemoryUsage ScintillaEditView::memoryUsage() const
+{
+	EditMemoryUsage usage;
+	usage.text = execute(SCI_GETMEMORYUSAGE, SC_MEMORY_TEXT);
+	usage.styles = execute(SCI_GETMEMORYUSAGE, SC_MEMORY_STYLES);
+	usage.lines = execute(SCI_GETMEMORYUSAGE, SC_MEMORY_LINES);
+	usage.markers = execute(SCI_GETMEMORYUSAGE, SC_MEMORY_MARKERS);
+	usage.lineData = execute(SCI_GETMEMORYUSAGE, SC_MEMORY_LINEDATA);
+	usage.indicators = execute(SCI_GETMEMORYUSAGE, SC_MEMORY_INDICATORS);
+	usage.undo = execute(SCI_GETMEMORYUSAGE, SC_MEMORY_UNDO);
+	usage.layout = execute(SCI_GETMEMORYUSAGE, SC_MEMORY_LAYOUT);
+
+	//QString按容量估算，不算共享和分配器的额外开销
+	for (const FindRecords* r : m_curMarkList)
+	{
+		usage.findRecords += sizeof(FindRecords) + (r->findFilePath.capacity() + r->findText.capacity()) * (qint64)sizeof(QChar);
+		usage.findRecords += r->records.capacity() * (qint64)sizeof(FindRecord);
+		for (const FindRecord& record : r->records)
+		{
+			usage.findRecords += record.lineContents.capacity() * (qint64)sizeof(QChar);
+		}
+	}
+
+	if (m_smartHighlight != nullptr)
+	{
+		usage.smartHighlight = m_smartHighlight->memoryUsage();
+	}
+
+	if (m_wordIndex != nullptr)
+	{
+		usage.wordIndex = m_wordIndex->memoryUsage();
+	}
+	return usage;
+}
+
+void ScintillaEditView::trimMemory(bool isReleaseStyles)
+{
+	execute(SCI_RELEASEMEMORY, isReleaseStyles ? SC_RELEASE_STYLES : SC_RELEASE_CACHES);
+}
+
+void ScintillaEditView::clearUndo()
+{
+	execute(SCI_EMPTYUNDOBUFFER);
+}
+
+bool ScintillaEditView::canReleaseText() const
+{
+	if (m_isBigText || isModified() || execute(SCI_CANUNDO) || execute(SCI_CANREDO) || execute(SCI_GETMAPPEDMEMORY) > 0)
+	{
+		return false;
+	}
+
+	if (!m_curMarkList.isEmpty())
+	{
+		return false;
+	}
+
+	//书签和折叠状态在重新加载后会丢失
+	if (execute(SCI_MARKERNEXT, 0, 1 << _SC_MARGE_SYBOLE) != -1 || execute(SCI_CONTRACTEDFOLDNEXT, 0) != -1)
+	{
+		return false;
+	}
+	return true;
+}
+
 
 //截获ESC键盘，让界面去退出当前的子界面
 void ScintillaEditView::keyPressEvent(QKeyEvent* event)
@@ -280,6 +355,30 @@ void ScintillaEditView::mouseReleaseEvent(QMouseEvent* ev)
 void ScintillaEditView::setBigTextMode(bool isBigText)
 {
 	m_isBigText = isBigText;
+
+	//大文本模式只加载了一部分内容，不参与自动补全
+	if (m_isBigText && m_wordIndex != nullptr)
+	{
+		delete m_wordIndex;
+		m_wordIndex = nullptr;
+	}
+}
+
+void ScintillaEditView::setWordComplete(bool enable)
+{
+	if (enable && m_wordIndex == nullptr && !m_isBigText)
+	{
+		m_wordIndex = new DocWordIndex(this);
+	}
+	else if (!enable && m_wordIndex != nullptr)
+	{
+		if (execute(SCI_AUTOCACTIVE))
+		{
+			execute(SCI_AUTOCCANCEL);
+		}
+		delete m_wordIndex;
+		m_wordIndex = nullptr;
+	}
 }
 
 void ScintillaEditView::setLexer(QsciLexer * lexer)
@@ -664,6 +763,8 @@ QString ScintillaEditView::getTagByLexerId(int lexerId)
 //isOrigin:是否原生lexer，即不读取用户修改过的配置风格
 QsciLexer* ScintillaEditView::createLexer(int lexerId, QString tag, bool isOrigin, int styleId)
 {
+	NDD_TRACE_SPAN("ScintillaEditView::createLexer", tag);
+
 	QsciLexer* ret = nullptr;
 
 	switch (lexerId)
@@ -1042,10 +1143,8 @@ void ScintillaEditView::init()
 	//开始括号匹配，比如html的<>，开启前后这类字段的匹配
 	setBraceMatching(SloppyBraceMatch);
 
-	//自动补全效果不好，不开启20211017
-	//setAutoCompletionSource(QsciScintilla::AcsAPIs);   //设置源，自动补全所有地方出现的
-	//setAutoCompletionCaseSensitivity(true);   //设置自动补全大小写敏感
-	//setAutoCompletionThreshold(1);    //设置每输入一个字符就会出现自动补全的提示
+	//自动补全不使用QsciScintilla的AcsAPIs/AcsDocument，每次都要扫描整个文档。
+	//改为从所有打开文档的单词索引中取前缀匹配，见slot_charAddedForCompletion
 
 	//设置字体
 	QFont font(DEFAULT_FONT_NAME, 11, QFont::Normal);
@@ -1054,6 +1153,13 @@ void ScintillaEditView::init()
 	
 	execute(SCI_SETTABWIDTH, ScintillaEditView::s_tabLens);
 
+	//大文件跳到中后部时，只同步着色可见区域，前面未着色的部分交给后台线程词法分析，避免界面卡住
+	execute(SCI_SETIDLESTYLING, SC_IDLESTYLING_BACKGROUND);
+
+	//全部替换、排序等大修改的撤销数据不再一直占着内存
+	execute(SCI_SETUNDOMEMORYBUDGET, UNDO_MEMORY_BUDGET);
+	execute(SCI_SETUNDOCOMPRESSION, true);
+
 	//使用空格替换tab
 	setIndentationsUseTabs(!ScintillaEditView::s_noUseTab);
 
@@ -1136,6 +1242,25 @@ void ScintillaEditView::init()
 	connect(this->verticalScrollBar(), &QScrollBar::valueChanged, this, &ScintillaEditView::slot_scrollYValueChange);
 	connect(this, &ScintillaEditView::delayWork, this,&ScintillaEditView::slot_delayWork, Qt::QueuedConnection);
 
+	//缓存查找完成或修改后更新了匹配，重新高亮可见范围
+	m_smartHighlight = new SmartHighlightCache(this);
+	connect(m_smartHighlight, &SmartHighlightCache::matchesChanged, this, &ScintillaEditView::slot_delayWork, Qt::QueuedConnection);
+
+	connect(this, &QsciScintillaBase::SCN_MODIFIED, this, &ScintillaEditView::slot_modifiedForUrl);
+
+	if (!m_isBigText && CCNotePad::s_wordComplete == 1)
+	{
+		m_wordIndex = new DocWordIndex(this);
+	}
+	connect(this, &QsciScintillaBase::SCN_CHARADDED, this, &ScintillaEditView::slot_charAddedForCompletion);
+
+	connect(this, &QsciScintillaBase::SCN_MODIFIED, this, [this](int, int modificationType) {
+		if (modificationType & (SC_MOD_INSERTTEXT | SC_MOD_DELETETEXT))
+		{
+			++m_docVersion;
+		}
+	});
+
 	//设置换行符号的格式
 #if defined(Q_OS_WIN)
 	execute(SCI_SETEOLMODE, SC_EOL_CRLF);
@@ -1206,6 +1331,12 @@ void ScintillaEditView::clearSuperBitLineCache()
 {
 	m_addrLineNumMap.clear();
 }
+
+//后台行索引计算出fileOffset地址处的行号（从1开始）后，加入缓存，showBigTextLineAddr就可以显示行号了
+void ScintillaEditView::addSuperBigLineCache(qint64 fileOffset, quint32 lineNum)
+{
+	m_addrLineNumMap.insert(fileOffset, lineNum);
+}
 //20230116新增，尽可能的还是显示行号。如果发生了跳转，则没有办法计算前面的行号，
 //则只能显示地址。如果没跳转，而是动态顺序翻页，则可以显示行号
 //20230201发现一个问题。底层qscint是按照utf8字节流来计算字符大小的。如果原始文件的编码
@@ -1711,6 +1842,11 @@ void ScintillaEditView::slot_clearHightWord()
 		m_hasHighlight = false;
 		clearIndicator(SCE_UNIVERSAL_FOUND_STYLE_SMART);
 	}
+
+	if (m_smartHighlight != nullptr)
+	{
+		m_smartHighlight->clear();
+	}
 }
 
 
@@ -1744,6 +1880,32 @@ intptr_t ScintillaEditView::replaceTarget(QByteArray& str2replace, intptr_t from
 
 void ScintillaEditView::highlightViewWithWord(QString & word2Hilite)
 {
+	//全文的匹配位置已经缓存了，只给可见范围设置指示器，不用再查找
+	if (m_smartHighlight != nullptr)
+	{
+		QByteArray word = word2Hilite.toUtf8();
+		m_smartHighlight->setWord(word);
+
+		if (m_smartHighlight->isReady())
+		{
+			int startPos = 0;
+			int endPos = 0;
+			getVisibleStartAndEndPosition(&startPos, &endPos);
+
+			QVector<qint64> matches;
+			m_smartHighlight->matchesInRange(startPos, endPos, matches);
+
+			this->execute(SCI_SETINDICATORCURRENT, SCE_UNIVERSAL_FOUND_STYLE_SMART);
+			for (qint64 pos : matches)
+			{
+				this->execute(SCI_INDICATORFILLRANGE, pos, word.size());
+			}
+			m_hasHighlight = true;
+			return;
+		}
+	}
+
+	//缓存还没准备好（或者匹配太多不缓存），先只查找可见的行
 	int originalStartPos = execute(SCI_GETTARGETSTART);
 	int originalEndPos = execute(SCI_GETTARGETEND);
 
@@ -2315,8 +2477,18 @@ void ScintillaEditView::showWordNums()
 		QRegExp bkRe("\\s");
 		int blank = text.count(bkRe);
 
-		QMessageBox::about(this, tr("Word Nums"), tr("Current Doc Word Nums is %1 . \nLine nums is %2 . \nSpace nums is %3, Non-space is %4 .").\
-			arg(text.size() - wrapNums).arg(lineNum).arg(blank - wrapNums).arg(text.size() - blank));
+		QString msg = tr("Current Doc Word Nums is %1 . \nLine nums is %2 . \nSpace nums is %3, Non-space is %4 .").\
+			arg(text.size() - wrapNums).arg(lineNum).arg(blank - wrapNums).arg(text.size() - blank);
+
+		//自动补全单词索引的大小
+		if (m_wordIndex != nullptr && m_wordIndex->isReady())
+		{
+			const WordIndex& index = WordIndex::getInstance();
+			msg += tr("\nCompletion index: %1 words, %2 KB. All tabs: %3 words, %4 KB .").arg(m_wordIndex->wordCount()).arg(m_wordIndex->memoryUsage() / 1024)\
+				.arg(index.wordCount()).arg(index.memoryUsage() / 1024);
+		}
+
+		QMessageBox::about(this, tr("Word Nums"), msg);
 	}
 	
 }
@@ -3129,46 +3301,54 @@ ColumnModeInfos ScintillaEditView::getColumnModeSelectInfo()
 
 void ScintillaEditView::columnReplace(ColumnModeInfos& cmi, QByteArray& str)
 {
+	std::vector<QByteArray> strs(cmi.size(), str);
+	columnReplace(cmi, strs);
+}
+
+//按列编辑的批量替换：先生成所有行的新内容，再用SCI_REPLACERANGES一次修改文档，只有一个撤销步骤和一次修改通知。
+//cmi按位置从小到大排列，strs[i]替换cmi[i]的选择。完成后cmi是替换后文本的位置
+void ScintillaEditView::columnReplace(ColumnModeInfos& cmi, const std::vector<QByteArray>& strs)
+{
+	std::vector<QByteArray> texts;
+	std::vector<Sci_TextRange> ranges;
+	texts.reserve(cmi.size());
+	ranges.reserve(cmi.size());
+
 	intptr_t totalDiff = 0;
 	for (size_t i = 0, len = cmi.size(); i < len; ++i)
 	{
-		if (cmi[i].isValid())
+		if (!cmi[i].isValid())
 		{
-			intptr_t len2beReplace = cmi[i]._selRpos - cmi[i]._selLpos;
-			intptr_t diff = str.size() - len2beReplace;
-
-			cmi[i]._selLpos += totalDiff;
-			cmi[i]._selRpos += totalDiff;
-			bool hasVirtualSpc = cmi[i]._nbVirtualAnchorSpc > 0;
+			continue;
+		}
 
-			if (hasVirtualSpc) // if virtual space is present, then insert space
-			{
-				for (intptr_t j = 0, k = cmi[i]._selLpos; j < cmi[i]._nbVirtualCaretSpc; ++j, ++k)
-				{
-					execute(SCI_INSERTTEXT, k, reinterpret_cast<sptr_t>(" "));
-				}
-				cmi[i]._selLpos += cmi[i]._nbVirtualAnchorSpc;
-				cmi[i]._selRpos += cmi[i]._nbVirtualCaretSpc;
-			}
+		//选择在行尾之后的虚拟空间时，前面先补上空格
+		intptr_t nbSpc = 0;
+		if (cmi[i]._nbVirtualAnchorSpc > 0)
+		{
+			nbSpc = std::min(cmi[i]._nbVirtualAnchorSpc, cmi[i]._nbVirtualCaretSpc);
+		}
+		texts.push_back(QByteArray(nbSpc, ' ') + strs[i]);
 
-			execute(SCI_SETTARGETRANGE, cmi[i]._selLpos, cmi[i]._selRpos);
+		Sci_TextRange range;
+		range.chrg.cpMin = static_cast<Sci_PositionCR>(cmi[i]._selLpos);
+		range.chrg.cpMax = static_cast<Sci_PositionCR>(cmi[i]._selRpos);
+		range.lpstrText = texts.back().data();
+		ranges.push_back(range);
 
-			execute(SCI_REPLACETARGET, static_cast<int>(-1), reinterpret_cast<sptr_t>(str.data()));
+		intptr_t len2beReplace = cmi[i]._selRpos - cmi[i]._selLpos;
+		cmi[i]._selLpos += totalDiff + nbSpc;
+		cmi[i]._selRpos = cmi[i]._selLpos + strs[i].size();
+		totalDiff += texts.back().size() - len2beReplace;
 
-			if (hasVirtualSpc)
-			{
-				totalDiff += cmi[i]._nbVirtualAnchorSpc + str.size();
+		// Now there's no more virtual space
+		cmi[i]._nbVirtualAnchorSpc = 0;
+		cmi[i]._nbVirtualCaretSpc = 0;
+	}
 
-				// Now there's no more virtual space
-				cmi[i]._nbVirtualAnchorSpc = 0;
-				cmi[i]._nbVirtualCaretSpc = 0;
-			}
-			else
-			{
-				totalDiff += diff;
-			}
-			cmi[i]._selRpos += diff;
-		}
+	if (!ranges.empty())
+	{
+		execute(SCI_REPLACERANGES, ranges.size(), reinterpret_cast<sptr_t>(ranges.data()));
 	}
 }
 
@@ -3265,66 +3445,30 @@ void ScintillaEditView::columnReplace(ColumnModeInfos& cmi, int initial, int inc
 	const int kibInit = getNbDigits(initial, base);
 	const int kib = std::max<int>(kibInit, kibEnd);*/
 
-	intptr_t totalDiff = 0;
-	const size_t len = cmi.size();
-	for (size_t i = 0; i < len; i++)
+	std::vector<QByteArray> strs;
+	strs.reserve(cmi.size());
+	for (size_t i = 0; i < cmi.size(); i++)
 	{
-		if (cmi[i].isValid())
+		if (base != 16)
 		{
-			const intptr_t len2beReplaced = cmi[i]._selRpos - cmi[i]._selLpos;
-
-			if (base != 16)
-			{
-				str = prefix + QString::number(numbers.at(i), base).toUtf8();
-			}
-			else
-			{
-				//16进制，判断大小写
-				if (isCapital)
-				{
-					str = prefix + QString::number(numbers.at(i), base).toUpper().toUtf8();
-				}
-				else
-				{
-					str = prefix + QString::number(numbers.at(i), base).toUtf8();
-				}
-			}
-
-			const intptr_t diff = str.size() - len2beReplaced;
-
-			cmi[i]._selLpos += totalDiff;
-			cmi[i]._selRpos += totalDiff;
-
-			
-
-			const bool hasVirtualSpc = cmi[i]._nbVirtualAnchorSpc > 0;
-			if (hasVirtualSpc) // if virtual space is present, then insert space
-			{
-				for (intptr_t j = 0, k = cmi[i]._selLpos; j < cmi[i]._nbVirtualCaretSpc; ++j, ++k)
-				{
-					execute(SCI_INSERTTEXT, k, reinterpret_cast<sptr_t>(" "));
-				}
-				cmi[i]._selLpos += cmi[i]._nbVirtualAnchorSpc;
-				cmi[i]._selRpos += cmi[i]._nbVirtualCaretSpc;
-			}
-			execute(SCI_SETTARGETRANGE, cmi[i]._selLpos, cmi[i]._selRpos);
-
-			execute(SCI_REPLACETARGET, static_cast<int>(-1), reinterpret_cast<sptr_t>(str.data()));
-
-			if (hasVirtualSpc)
+			str = prefix + QString::number(numbers.at(i), base).toUtf8();
+		}
+		else
+		{
+			//16进制，判断大小写
+			if (isCapital)
 			{
-				totalDiff += cmi[i]._nbVirtualAnchorSpc + str.size();
-				// Now there's no more virtual space
-				cmi[i]._nbVirtualAnchorSpc = 0;
-				cmi[i]._nbVirtualCaretSpc = 0;
+				str = prefix + QString::number(numbers.at(i), base).toUpper().toUtf8();
 			}
 			else
 			{
-				totalDiff += diff;
+				str = prefix + QString::number(numbers.at(i), base).toUtf8();
 			}
-			cmi[i]._selRpos += diff;
 		}
+		strs.push_back(str);
 	}
+
+	columnReplace(cmi, strs);
 }
 
 void ScintillaEditView::getVisibleStartAndEndPosition(int * startPos, int * endPos)
@@ -3341,13 +3485,14 @@ void ScintillaEditView::getVisibleStartAndEndPosition(int * startPos, int * endP
 	*endPos = static_cast<int32_t>(execute(SCI_GETLINEENDPOSITION, line));
 }
 
-bool isUrlSchemeStartChar(QChar const c)
+//下面的网址识别直接在UTF-8字节上进行，非ASCII字节都当作普通的网址字符
+bool isUrlSchemeStartChar(char const c)
 {
 	return ((c >= 'A') && (c <= 'Z'))
 		|| ((c >= 'a') && (c <= 'z'));
 }
 
-bool isUrlSchemeDelimiter(QChar const c)
+bool isUrlSchemeDelimiter(char const c)
 {
 	return   !(((c >= '0') && (c <= '9'))
 		|| ((c >= 'A') && (c <= 'Z'))
@@ -3355,7 +3500,7 @@ bool isUrlSchemeDelimiter(QChar const c)
 		|| (c == '_'));
 }
 
-bool scanToUrlStart(QString &text, int textLen, int start, int* distance, int* schemeLength)
+bool scanToUrlStart(const char* text, int textLen, int start, int* distance, int* schemeLength)
 {
 	int p = start;
 	int p0 = 0;
@@ -3390,10 +3535,10 @@ bool scanToUrlStart(QString &text, int textLen, int start, int* distance, int* s
 	return false;
 }
 
-bool isUrlTextChar(QChar const c)
+bool isUrlTextChar(char const c)
 {
-	if (c <= ' ') return false;
-	switch (c.digitValue())
+	if (static_cast<unsigned char>(c) <= ' ') return false;
+	switch (c)
 	{
 	case ('"'):
 	case ('#'):
@@ -3402,15 +3547,15 @@ bool isUrlTextChar(QChar const c)
 	case ('{'):
 	case ('}'):
 	case ('?'):
-	case ('\u007F'):
+	case ('\x7F'):
 		return false;
 	}
 	return true;
 }
 
-bool isUrlQueryDelimiter(QChar const c)
+bool isUrlQueryDelimiter(char const c)
 {
-	switch (c.digitValue())
+	switch (c)
 	{
 	case '&':
 	case '+':
@@ -3421,17 +3566,17 @@ bool isUrlQueryDelimiter(QChar const c)
 	return false;
 }
 
-void scanToUrlEnd(QString & text, int textLen, int start, int* distance)
+void scanToUrlEnd(const char* text, int textLen, int start, int* distance)
 {
 	int p = start;
-	QChar q = 0;
+	char q = 0;
 	enum { sHostAndPath, sQuery, sQueryAfterDelimiter, sQueryQuotes, sQueryAfterQuotes, sFragment } s = sHostAndPath;
 	while (p < textLen)
 	{
 		switch (s)
 		{
 		case sHostAndPath:
-			if (text[p] == QChar('?'))
+			if (text[p] == '?')
 				s = sQuery;
 			else if (text[p] == '#')
 				s = sFragment;
@@ -3485,7 +3630,7 @@ void scanToUrlEnd(QString & text, int textLen, int start, int* distance)
 			break;
 
 		case sQueryQuotes:
-			if (text[p] < ' ')
+			if (static_cast<unsigned char>(text[p]) < ' ')
 			{
 				*distance = p - start;
 				return;
@@ -3519,7 +3664,7 @@ void scanToUrlEnd(QString & text, int textLen, int start, int* distance)
 
 // removeUnwantedTrailingCharFromUrl removes a single unwanted trailing character from an URL.
 // It has to be called repeatedly, until it returns false, meaning that all unwanted characters are gone.
-bool removeUnwantedTrailingCharFromUrl(QChar const *text, int* length)
+bool removeUnwantedTrailingCharFromUrl(const char *text, int* length)
 {
 	int l = *length - 1;
 	if (l <= 0) return false;
@@ -3558,7 +3703,7 @@ bool removeUnwantedTrailingCharFromUrl(QChar const *text, int* length)
 	return false;
 }
 
-bool isUrl(QString& text, int textLen, int start, int* segmentLen)
+bool isUrl(const char* text, int textLen, int start, int* segmentLen)
 {
 	int dist = 0, schemeLen = 0;
 	if (scanToUrlStart(text, textLen, start, &dist, &schemeLen))
@@ -3574,16 +3719,15 @@ bool isUrl(QString& text, int textLen, int start, int* segmentLen)
 		{
 			len += schemeLen;
 
-			QString urlStr = text.mid(start, len);
-			if (urlStr.startsWith("http://") || urlStr.startsWith("https://"))
+			//只有http和https才需要QUrl校验，其它的字节不用转成QString
+			if ((len >= 7 && strncmp(text + start, "http://", 7) == 0) || (len >= 8 && strncmp(text + start, "https://", 8) == 0))
 			{
-
-				QUrl url(urlStr);
+				QUrl url(QString::fromUtf8(text + start, len));
 
 				bool r = url.isValid();
 				if (r)
 				{
-					while (removeUnwantedTrailingCharFromUrl(text.data() + start, &len));
+					while (removeUnwantedTrailingCharFromUrl(text + start, &len));
 					*segmentLen = len;
 					return true;
 				}
@@ -3591,7 +3735,7 @@ bool isUrl(QString& text, int textLen, int start, int* segmentLen)
 		}
 		len = 1;
 		int lMax = textLen - start;
-		while (isUrlSchemeStartChar(text[start + len]) && (len < lMax)) len++;
+		while ((len < lMax) && isUrlSchemeStartChar(text[start + len])) len++;
 		*segmentLen = len;
 		return false;
 	}
@@ -3645,46 +3789,134 @@ void ScintillaEditView::addHotSpot()
 		int indicFore = this->execute(SCI_STYLEGETFORE, STYLE_DEFAULT);
 		this->execute(SCI_SETINDICATORVALUE, indicFore);
 
-		QByteArray encodedText;
-		encodedText.resize(endPos - startPos);
-		this->getText(encodedText.data(), startPos, endPos);
-
-		QString encodedTextStr(encodedText);
+		//颜色变了，扫描过的行也要重新设置
+		if (indicFore != m_urlIndicFore)
+		{
+			m_urlScannedLines.clear();
+			m_urlIndicFore = indicFore;
+		}
 
-		int wideTextLen = encodedTextStr.size();
+		int lineCount = execute(SCI_GETLINECOUNT);
+		if (static_cast<int>(m_urlScannedLines.size()) < lineCount)
+		{
+			m_urlScannedLines.resize(lineCount, false);
+		}
 
+		int firstLine = execute(SCI_LINEFROMPOSITION, startPos);
+		int lastLine = execute(SCI_LINEFROMPOSITION, endPos);
 
-		if (wideTextLen > 0)
+		//网址不会跨行，只扫描还没有扫描过或者修改过的行
+		QByteArray lineText;
+		for (int line = firstLine; line <= lastLine; ++line)
 		{
-			int startWide = 0;
-			int lenWide = 0;
-			int startEncoded = 0;
-			int lenEncoded = 0;
-			while (true)
+			if (m_urlScannedLines[line])
 			{
-				bool r = isUrl(encodedTextStr, encodedTextStr.size(), startWide, &lenWide);
-				if (lenWide <= 0)
-					break;
+				continue;
+			}
+			m_urlScannedLines[line] = true;
 
-				lenEncoded = encodedTextStr.mid(startWide, lenWide).toUtf8().size();
+			int lineStart = execute(SCI_POSITIONFROMLINE, line);
+			int lineEnd = execute(SCI_GETLINEENDPOSITION, line);
+			if (lineEnd <= lineStart)
+			{
+				continue;
+			}
 
-				if (r)
-					this->execute(SCI_INDICATORFILLRANGE, startEncoded + startPos, lenEncoded);
-				else
-					this->execute(SCI_INDICATORCLEARRANGE, startEncoded + startPos, lenEncoded);
+			this->execute(SCI_INDICATORCLEARRANGE, lineStart, lineEnd - lineStart);
 
-				startWide += lenWide;
-				startEncoded += lenEncoded;
+			lineText.resize(lineEnd - lineStart);
+			this->getText(lineText.data(), lineStart, lineEnd);
 
-				if ((startWide >= wideTextLen) || ((startEncoded + startPos) >= endPos))
+			int textLen = lineText.size();
+			int start = 0;
+			int len = 0;
+			while (start < textLen)
+			{
+				bool r = isUrl(lineText.constData(), textLen, start, &len);
+				if (len <= 0)
 					break;
+
+				if (r)
+					this->execute(SCI_INDICATORFILLRANGE, lineStart + start, len);
+
+				start += len;
 			}
-			assert((startEncoded + startPos) == endPos);
-			assert(startWide == wideTextLen);
 		}
 	}
 }
 
+//修改涉及的行都需要重新扫描网址，后面的行按增删的行数同步移动
+void ScintillaEditView::slot_modifiedForUrl(int position, int modificationType, const char* /*text*/, int length, int linesAdded, int, int, int, int, int)
+{
+	if (m_urlScannedLines.empty() || !(modificationType & (SC_MOD_INSERTTEXT | SC_MOD_DELETETEXT)))
+	{
+		return;
+	}
+
+	size_t firstLine = execute(SCI_LINEFROMPOSITION, position);
+	if (firstLine >= m_urlScannedLines.size())
+	{
+		return;
+	}
+
+	//通知是在修改之后发出的，firstLine后面的记录属于修改前的行，先按增删的行数移动
+	auto next = m_urlScannedLines.begin() + firstLine + 1;
+	if (linesAdded > 0)
+	{
+		m_urlScannedLines.insert(next, linesAdded, false);
+	}
+	else if (linesAdded < 0)
+	{
+		size_t removeCount = std::min<size_t>(-linesAdded, m_urlScannedLines.end() - next);
+		m_urlScannedLines.erase(next, next + removeCount);
+	}
+
+	//插入的文本现在占[position, position + length)，删除后只剩下接合处的一行
+	size_t lastLine = firstLine;
+	if ((modificationType & SC_MOD_INSERTTEXT) && length > 0)
+	{
+		lastLine = execute(SCI_LINEFROMPOSITION, position + length);
+	}
+	lastLine = std::min(lastLine, m_urlScannedLines.size() - 1);
+
+	std::fill(m_urlScannedLines.begin() + firstLine, m_urlScannedLines.begin() + lastLine + 1, false);
+}
+
+//输入单词时从所有打开文档的单词索引中取前缀匹配的单词显示补全列表
+void ScintillaEditView::slot_charAddedForCompletion(int /*ch*/)
+{
+	if (m_wordIndex == nullptr || isReadOnly())
+	{
+		return;
+	}
+
+	qint64 pos = execute(SCI_GETCURRENTPOS);
+	if (pos != execute(SCI_GETANCHOR))
+	{
+		return;
+	}
+
+	QByteArray prefix = m_wordIndex->wordBefore(pos);
+	QList<QByteArray> words;
+	if (prefix.size() >= WordIndex::MIN_PREFIX_LENGTH)
+	{
+		WordIndex::getInstance().completions(prefix, WordIndex::MAX_COMPLETIONS, words);
+	}
+
+	if (words.isEmpty())
+	{
+		if (execute(SCI_AUTOCACTIVE))
+		{
+			execute(SCI_AUTOCCANCEL);
+		}
+		return;
+	}
+
+	//单词已经按字节序排好，与SCI_AUTOCSETORDER的默认值SC_ORDER_PRESORTED一致
+	QByteArray list = words.join(' ');
+	execute(SCI_AUTOCSHOW, prefix.size(), reinterpret_cast<sptr_t>(list.constData()));
+}
+
 void ScintillaEditView::setStyleOptions()
 {
 #if 0
@@ -4158,23 +4390,6 @@ bool ScintillaEditView::isFoldIndentBased() const
 	return false;
 }
 
-const int  MAX_FOLD_COLLAPSE_LEVEL = 8;
-
-struct FoldLevelStack
-{
-	int levelCount = 0;
-	intptr_t levelStack[MAX_FOLD_COLLAPSE_LEVEL]{};
-
-	void push(intptr_t level)
-	{
-		while (levelCount != 0 && level <= levelStack[levelCount - 1])
-		{
-			--levelCount;
-		}
-		levelStack[levelCount++] = level;
-	}
-};
-
 bool ScintillaEditView::isFolded(size_t line)
 {
 	return (0 != execute(SCI_GETFOLDEXPANDED, line));
@@ -4215,36 +4430,14 @@ void ScintillaEditView::fold(size_t line, bool mode)
 	}
 }
 
+//按缩进折叠的语言，折叠级别是缩进的列数，按嵌套在几层折叠头里面来折叠
 void ScintillaEditView::collapseFoldIndentBased(int level, bool mode)
 {
 	execute(SCI_COLOURISE, 0, -1);
-
-	FoldLevelStack levelStack;
-	++level;
-
-	const intptr_t maxLine = execute(SCI_GETLINECOUNT);
-	intptr_t line = 0;
-
-	while (line < maxLine)
-	{
-		intptr_t level = execute(SCI_GETFOLDLEVEL, line);
-		if (level & SC_FOLDLEVELHEADERFLAG)
-		{
-			level &= SC_FOLDLEVELNUMBERMASK;
-			levelStack.push(level);
-			if (level == levelStack.levelCount)
-			{
-				if (isFolded(line) != mode)
-				{
-					fold(line, mode);
-				}
-				line = execute(SCI_GETLASTCHILD, line, -1);
-			}
-		}
-		++line;
-	}
+	execute(SCI_FOLDATDEPTH, level, mode ? SC_FOLDACTION_EXPAND : SC_FOLDACTION_CONTRACT);
 }
 
+//一次消息折叠或展开该级别的所有折叠头，不再逐行切换、每次都刷新滚动条和窗口
 void ScintillaEditView::collapse(int level, bool mode)
 {
 	if (isFoldIndentBased())
@@ -4253,22 +4446,7 @@ void ScintillaEditView::collapse(int level, bool mode)
 	}
 
 	execute(SCI_COLOURISE, 0, -1);
-
-	intptr_t maxLine = execute(SCI_GETLINECOUNT);
-
-	for (int line = 0; line < maxLine; ++line)
-	{
-		intptr_t lineLevel = execute(SCI_GETFOLDLEVEL, line);
-		if (lineLevel & SC_FOLDLEVELHEADERFLAG)
-		{
-			lineLevel -= SC_FOLDLEVELBASE;
-			if (level == (lineLevel & SC_FOLDLEVELNUMBERMASK))
-				if (isFolded(line) != mode)
-				{
-					fold(line, mode);
-				}
-		}
-	}
+	execute(SCI_FOLDATLEVEL, level, mode ? SC_FOLDACTION_EXPAND : SC_FOLDACTION_CONTRACT);
 }
 
 void ScintillaEditView::comment(int type)
@@ -5,10 +5,14 @@
 #include <QMouseEvent>
 #include <QMimeData>
 #include <unordered_set>
+#include <vector>
 #include "common.h"
 #include "Sorters.h"
 #include "markdownview.h"
 
+class SmartHighlightCache;
+class DocWordIndex;
+
 
 typedef sptr_t(*SCINTILLA_FUNC) (sptr_t ptr, unsigned int, uptr_t, sptr_t);
 typedef sptr_t SCINTILLA_PTR;
@@ -116,6 +120,31 @@ class FindRecords;
 class CCNotePad;
 struct BigTextEditFileMgr;
 
+//一个编辑框各部分占用的内存，字节数。scintilla内部的部分由SCI_GETMEMORYUSAGE取得，其余按容器容量估算
+struct EditMemoryUsage {
+	qint64 text;
+	qint64 styles;
+	qint64 lines;
+	qint64 markers;
+	qint64 lineData;
+	qint64 indicators;
+	qint64 undo;
+	qint64 layout;
+	//查找标记的记录 m_curMarkList
+	qint64 findRecords;
+	qint64 smartHighlight;
+	qint64 wordIndex;
+
+	EditMemoryUsage() : text(0), styles(0), lines(0), markers(0), lineData(0), indicators(0), undo(0), layout(0), findRecords(0), smartHighlight(0), wordIndex(0)
+	{
+	}
+
+	qint64 total() const
+	{
+		return text + styles + lines + markers + lineData + indicators + undo + layout + findRecords + smartHighlight + wordIndex;
+	}
+};
+
 class ScintillaEditView : public QsciScintilla
 {
 	Q_OBJECT
@@ -188,17 +217,32 @@ public:
 	ColumnModeInfos getColumnModeSelectInfo();
 
 	void columnReplace(ColumnModeInfos& cmi, QByteArray& str);
+	void columnReplace(ColumnModeInfos& cmi, const std::vector<QByteArray>& strs);
 
 	void setMultiSelections(const ColumnModeInfos& cmi);
 
 	void columnReplace(ColumnModeInfos& cmi, int initial, int incr, int repeat, int format, bool isCapital, QByteArray& prefix);
 
 	void setBigTextMode(bool isBigText);
+	//开关单词自动补全，关闭时释放本文档的单词索引
+	void setWordComplete(bool enable);
+
+	quint64 docVersion() const
+	{
+		return m_docVersion;
+	}
+
+	quint64 docId() const
+	{
+		return m_docId;
+	}
+
 	void showBigTextLineAddr(qint64 fileOffset);
 	void showBigTextLineAddr(qint64 fileStartOffset, qint64 fileEndOffset);
 	void showBigTextRoLineNum(BigTextEditFileMgr* txtFile, int blockIndex);
 	void updateThemes();
 	void clearSuperBitLineCache();
+	void addSuperBigLineCache(qint64 fileOffset, quint32 lineNum);
 
 	//下面三个函数，是设置全局样式的接口。全局样式不同于每个语法中的样式
 	void setGlobalFgColor(int style);
@@ -218,6 +262,14 @@ public:
 
 	static ScintillaEditView* createEditForSearch();
 
+	EditMemoryUsage memoryUsage() const;
+	//释放布局缓存和缓冲区的空闲空间，不影响内容和撤销。isReleaseStyles为true时连样式一起释放，下次显示时重新着色
+	void trimMemory(bool isReleaseStyles = false);
+	//清空撤销历史，调用前由界面确认
+	void clearUndo();
+	//文本释放后能否从磁盘原样恢复：没有修改、撤销、书签、折叠和查找标记，也不是映射的大文件
+	bool canReleaseText() const;
+
 signals:
 	void delayWork();
 
@@ -296,6 +348,8 @@ private slots:
 	void slot_delayWork();
 	void slot_scrollYValueChange(int value);
 	void slot_clearHightWord();
+	void slot_modifiedForUrl(int position, int modificationType, const char* text, int length, int linesAdded, int line, int foldLevelNow, int foldLevelPrev, int token, int annotationLinesAdded);
+	void slot_charAddedForCompletion(int ch);
 
 	void slot_bookMarkClicked(int margin, int line, Qt::KeyboardModifiers state);
 	void on_viewMarkdown();
@@ -331,6 +385,21 @@ private:
 
 	QPointer<MarkdownView> m_markdownWin;
 
+	//选中单词高亮的全文匹配位置缓存
+	SmartHighlightCache* m_smartHighlight;
+
+	//自动补全用的本文档单词计数，大文本模式下没有
+	DocWordIndex* m_wordIndex;
+
+	//文档内容的修改次数，插件用来判断快照是否过期
+	quint64 m_docVersion;
+	//进程内唯一的文档编号，从1开始递增，不会重复
+	quint64 m_docId;
+
+	//addHotSpot已经扫描过网址的行，按行号索引。修改时失效
+	std::vector<bool> m_urlScannedLines;
+	int m_urlIndicFore;
+
 public:
 	static int s_tabLens;
 	static bool s_noUseTab;
@@ -0,0 +1,391 @@
+﻿#include "smarthighlightcache.h"
+#include "scintillaeditview.h"
+
+#include <QScrollBar>
+#include <QPainter>
+#include <QByteArrayMatcher>
+#include <QtConcurrent>
+#include <algorithm>
+
+//在文本中查找word的所有出现位置，允许重叠，这样修改后可以只在修改点附近增量查找。
+//超过MAX_CACHE_MATCHES个时提前结束
+static QVector<qint64> scanMatches(QByteArray text, QByteArray word)
+{
+	QVector<qint64> matches;
+	QByteArrayMatcher matcher(word);
+
+	int pos = matcher.indexIn(text, 0);
+	while (pos >= 0)
+	{
+		matches.append(pos);
+		if (matches.size() > SmartHighlightCache::MAX_CACHE_MATCHES)
+		{
+			break;
+		}
+		pos = matcher.indexIn(text, pos + 1);
+	}
+	return matches;
+}
+
+SmartHighlightMarks::SmartHighlightMarks(QScrollBar* parent) : QWidget(parent)
+{
+	setAttribute(Qt::WA_TransparentForMouseEvents);
+	hide();
+}
+
+SmartHighlightMarks::~SmartHighlightMarks()
+{
+}
+
+void SmartHighlightMarks::setDensity(const QVector<int>& density, QColor color)
+{
+	m_density = density;
+	m_color = color;
+	update();
+}
+
+void SmartHighlightMarks::paintEvent(QPaintEvent* /*event*/)
+{
+	QPainter painter(this);
+
+	int maxCount = 1;
+	for (int count : m_density)
+	{
+		maxCount = std::max(maxCount, count);
+	}
+
+	//匹配越密集颜色越深
+	int markWidth = std::max(width() / 2, 2);
+	for (int i = 0; i < m_density.size(); ++i)
+	{
+		if (m_density.at(i) > 0)
+		{
+			QColor c(m_color);
+			c.setAlpha(96 + 159 * m_density.at(i) / maxCount);
+			painter.fillRect(width() - markWidth, i, markWidth, 2, c);
+		}
+	}
+}
+
+SmartHighlightCache::SmartHighlightCache(ScintillaEditView* edit) : QObject(edit), m_edit(edit), m_shiftFrom(0), m_shift(0), m_ready(false), m_docLength(0), m_scanId(0), m_watchScanId(-1), m_scanStale(false)
+{
+	m_watcher = new QFutureWatcher<QVector<qint64>>(this);
+	connect(m_watcher, &QFutureWatcher<QVector<qint64>>::finished, this, &SmartHighlightCache::slot_scanFinished);
+
+	connect(m_edit, &QsciScintillaBase::SCN_MODIFIED, this, &SmartHighlightCache::slot_modified);
+
+	m_marks = new SmartHighlightMarks(m_edit->verticalScrollBar());
+	m_edit->verticalScrollBar()->installEventFilter(this);
+
+	//连续修改时合并起来更新一次滚动条标记
+	m_marksTimer.setSingleShot(true);
+	m_marksTimer.setInterval(100);
+	connect(&m_marksTimer, &QTimer::timeout, this, &SmartHighlightCache::slot_updateMarks);
+}
+
+SmartHighlightCache::~SmartHighlightCache()
+{
+	//只有局部拷贝的文本，不用等待后台查找结束
+	m_watcher->disconnect(this);
+}
+
+void SmartHighlightCache::setWord(const QByteArray& word)
+{
+	if (word == m_word)
+	{
+		return;
+	}
+	m_word = word;
+	startScan();
+}
+
+void SmartHighlightCache::clear()
+{
+	if (m_word.isEmpty())
+	{
+		return;
+	}
+	++m_scanId;
+	m_word.clear();
+	resetMatches();
+	m_ready = false;
+	m_scanStale = false;
+	m_marksTimer.stop();
+	m_marks->hide();
+}
+
+const QByteArray& SmartHighlightCache::word() const
+{
+	return m_word;
+}
+
+bool SmartHighlightCache::isReady() const
+{
+	return m_ready;
+}
+
+qint64 SmartHighlightCache::memoryUsage() const
+{
+	return m_matches.capacity() * (qint64)sizeof(qint64) + m_word.capacity();
+}
+
+void SmartHighlightCache::matchesInRange(qint64 startPos, qint64 endPos, QVector<qint64>& matches) const
+{
+	int first = lowerBound(startPos - m_word.size() + 1);
+	int last = lowerBound(endPos);
+	for (int i = first; i < last; ++i)
+	{
+		matches.append(matchAt(i));
+	}
+}
+
+qint64 SmartHighlightCache::matchAt(int index) const
+{
+	return m_matches.at(index) + ((index >= m_shiftFrom) ? m_shift : 0);
+}
+
+//第一个位置不小于pos的匹配的下标。加上偏移后仍然是有序的，可以二分查找
+int SmartHighlightCache::lowerBound(qint64 pos) const
+{
+	int low = 0;
+	int high = m_matches.size();
+	while (low < high)
+	{
+		int mid = low + (high - low) / 2;
+		if (matchAt(mid) < pos)
+		{
+			low = mid + 1;
+		}
+		else
+		{
+			high = mid;
+		}
+	}
+	return low;
+}
+
+//把偏移的起点移动到index，只改写两个起点之间的匹配。连续修改的位置接近时代价很小
+void SmartHighlightCache::moveShiftTo(int index)
+{
+	if (m_shift != 0)
+	{
+		for (int i = index; i < m_shiftFrom; ++i)
+		{
+			m_matches[i] -= m_shift;
+		}
+		for (int i = m_shiftFrom; i < index; ++i)
+		{
+			m_matches[i] += m_shift;
+		}
+	}
+	m_shiftFrom = index;
+}
+
+void SmartHighlightCache::resetMatches()
+{
+	m_matches.clear();
+	m_shiftFrom = 0;
+	m_shift = 0;
+}
+
+void SmartHighlightCache::startScan()
+{
+	++m_scanId;
+	resetMatches();
+	m_ready = false;
+	m_scanStale = false;
+	m_marks->hide();
+
+	if (m_word.isEmpty())
+	{
+		return;
+	}
+
+	//太大的文档不缓存，一直只查找可见行
+	qint64 length = m_edit->execute(SCI_GETLENGTH);
+	if (length > MAX_SCAN_LENGTH)
+	{
+		return;
+	}
+
+	//后台线程不能读编辑器的缓冲区，复制一份文本给它。
+	//按范围复制：SCI_GETCHARACTERPOINTER会移动间隙，映射的文档还会整个读入内存
+	m_docLength = length;
+	QByteArray textCopy = textRange(0, length);
+
+	m_watchScanId = m_scanId;
+	m_watcher->setFuture(QtConcurrent::run(scanMatches, textCopy, m_word));
+}
+
+void SmartHighlightCache::slot_scanFinished()
+{
+	if (m_watchScanId != m_scanId)
+	{
+		return;
+	}
+
+	if (m_scanStale)
+	{
+		startScan();
+		return;
+	}
+
+	resetMatches();
+	m_matches = m_watcher->result();
+
+	//太多了不缓存，仍然只查找可见行
+	if (m_matches.size() > MAX_CACHE_MATCHES)
+	{
+		resetMatches();
+		return;
+	}
+
+	m_ready = true;
+	emit matchesChanged();
+	slot_updateMarks();
+}
+
+QByteArray SmartHighlightCache::textRange(qint64 startPos, qint64 endPos) const
+{
+	QByteArray text;
+	if (endPos > startPos)
+	{
+		text.resize(endPos - startPos);
+		m_edit->getText(text.data(), startPos, endPos);
+	}
+	return text;
+}
+
+//在[startPos, endPos)中查找，插入找到的匹配。调用前这个范围里的旧匹配已经删除
+void SmartHighlightCache::rescanRange(qint64 startPos, qint64 endPos)
+{
+	startPos = std::max<qint64>(startPos, 0);
+	endPos = std::min<qint64>(endPos, m_edit->execute(SCI_GETLENGTH));
+
+	QVector<qint64> found = scanMatches(textRange(startPos, endPos), m_word);
+	if (found.isEmpty())
+	{
+		return;
+	}
+
+	//插入到偏移起点上，新的匹配减去偏移后保存
+	int index = lowerBound(startPos);
+	moveShiftTo(index);
+	for (int i = 0; i < found.size(); ++i)
+	{
+		m_matches.insert(index + i, startPos + found.at(i) - m_shift);
+	}
+}
+
+//修改后更新缓存：删除被修改破坏的匹配，移动后面的匹配，再只在修改点附近重新查找
+void SmartHighlightCache::slot_modified(qint64 position, int modificationType, const char* /*text*/, qint64 length, int, int, int, int, int, int)
+{
+	if (m_word.isEmpty() || !(modificationType & (SC_MOD_INSERTTEXT | SC_MOD_DELETETEXT)))
+	{
+		return;
+	}
+
+	if (!m_ready)
+	{
+		//后台查找的是修改前的文本
+		if (m_watchScanId == m_scanId && m_watcher->isRunning())
+		{
+			m_scanStale = true;
+		}
+		return;
+	}
+
+	const qint64 wordLen = m_word.size();
+	const qint64 pos = position;
+	const qint64 len = length;
+
+	//与[affectStart, affectEnd)有重叠的旧匹配已经不存在了
+	qint64 affectStart = pos - wordLen + 1;
+	qint64 affectEnd = (modificationType & SC_MOD_INSERTTEXT) ? pos : pos + len;
+	qint64 shift = (modificationType & SC_MOD_INSERTTEXT) ? len : -len;
+
+	int first = lowerBound(affectStart);
+	int last = lowerBound(affectEnd);
+
+	//后面的匹配整体移动，只记在偏移里
+	moveShiftTo(first);
+	m_matches.remove(first, last - first);
+	m_shift += shift;
+
+	m_docLength += shift;
+
+	//SCI_REPLACERANGES先通知删除再通知插入，删除通知时文档已经是插入后的内容，等插入通知时再查找
+	if (modificationType & SC_MOD_INSERTTEXT)
+	{
+		rescanRange(affectStart, pos + len + wordLen - 1);
+	}
+	else if (m_docLength == m_edit->execute(SCI_GETLENGTH))
+	{
+		rescanRange(affectStart, pos + wordLen - 1);
+	}
+
+	if (m_matches.size() > MAX_CACHE_MATCHES)
+	{
+		resetMatches();
+		m_ready = false;
+		m_marks->hide();
+		return;
+	}
+
+	emit matchesChanged();
+	m_marksTimer.start();
+}
+
+void SmartHighlightCache::slot_updateMarks()
+{
+	QScrollBar* bar = m_edit->verticalScrollBar();
+
+	//滑槽的两端是箭头按钮，大小大致等于滚动条的宽度
+	int arrow = bar->width();
+	int rows = bar->height() - 2 * arrow;
+
+	if (!m_ready || m_matches.isEmpty() || !bar->isVisible() || rows <= 0)
+	{
+		m_marks->hide();
+		return;
+	}
+
+	qint64 lineCount = m_edit->execute(SCI_GETLINECOUNT);
+	qint64 docLength = m_edit->execute(SCI_GETLENGTH);
+
+	QVector<int> density(rows, 0);
+	for (int i = 0; i < rows; ++i)
+	{
+		qint64 lineStart = lineCount * i / rows;
+		qint64 lineEnd = lineCount * (i + 1) / rows;
+		if (lineEnd <= lineStart)
+		{
+			continue;
+		}
+		qint64 startPos = m_edit->execute(SCI_POSITIONFROMLINE, lineStart);
+		qint64 endPos = (lineEnd >= lineCount) ? docLength : m_edit->execute(SCI_POSITIONFROMLINE, lineEnd);
+
+		density[i] = lowerBound(endPos) - lowerBound(startPos);
+	}
+
+	//指示器颜色是BGR
+	int fore = m_edit->execute(SCI_INDICGETFORE, SCE_UNIVERSAL_FOUND_STYLE_SMART);
+	QColor color(fore & 0xff, (fore >> 8) & 0xff, (fore >> 16) & 0xff);
+
+	m_marks->setGeometry(0, arrow, bar->width(), rows);
+	m_marks->setDensity(density, color);
+	m_marks->show();
+	m_marks->raise();
+}
+
+bool SmartHighlightCache::eventFilter(QObject* watched, QEvent* event)
+{
+	if (watched == m_edit->verticalScrollBar() && m_ready)
+	{
+		if (event->type() == QEvent::Resize || event->type() == QEvent::Show)
+		{
+			m_marksTimer.start();
+		}
+	}
+	return QObject::eventFilter(watched, event);
+}
@@ -0,0 +1,108 @@
+﻿#pragma once
+
+#include <QObject>
+#include <QWidget>
+#include <QColor>
+#include <QByteArray>
+#include <QVector>
+#include <QFutureWatcher>
+#include <QTimer>
+
+class ScintillaEditView;
+class QScrollBar;
+
+//画在垂直滚动条上的匹配分布标记，不接收鼠标事件
+class SmartHighlightMarks : public QWidget
+{
+	Q_OBJECT
+
+public:
+	SmartHighlightMarks(QScrollBar* parent);
+	virtual ~SmartHighlightMarks();
+
+	//每一个元素是滚动条上一个像素行里的匹配个数
+	void setDensity(const QVector<int>& density, QColor color);
+
+protected:
+	void paintEvent(QPaintEvent* event) override;
+
+private:
+	QVector<int> m_density;
+	QColor m_color;
+};
+
+//选中单词高亮（smart highlight）的匹配位置缓存。
+//后台在全文中查找一次，文档修改时根据修改通知增量更新，滚动时只从缓存中取可见范围的位置，不再重复查找
+class SmartHighlightCache : public QObject
+{
+	Q_OBJECT
+
+public:
+	SmartHighlightCache(ScintillaEditView* edit);
+	virtual ~SmartHighlightCache();
+
+	//开始缓存word的匹配，已经是这个单词则什么也不做
+	void setWord(const QByteArray& word);
+	void clear();
+
+	const QByteArray& word() const;
+	bool isReady() const;
+	//缓存占用的内存，字节数
+	qint64 memoryUsage() const;
+
+	//返回与[startPos, endPos)有重叠的匹配的开始位置
+	void matchesInRange(qint64 startPos, qint64 endPos, QVector<qint64>& matches) const;
+
+	//匹配太多时不缓存，退回到只查找可见行
+	static const int MAX_CACHE_MATCHES = 500000;
+	//超过这个长度的文档不在全文中查找，避免复制整个文档，也只查找可见行
+	static const qint64 MAX_SCAN_LENGTH = 64 * 1024 * 1024;
+
+signals:
+	//全文查找完成，或者修改后增量更新了匹配
+	void matchesChanged();
+
+private slots:
+	void slot_modified(qint64 position, int modificationType, const char* text, qint64 length, int linesAdded, int line, int foldLevelNow, int foldLevelPrev, int token, int annotationLinesAdded);
+	void slot_scanFinished();
+	void slot_updateMarks();
+
+protected:
+	bool eventFilter(QObject* watched, QEvent* event) override;
+
+private:
+	void startScan();
+	QByteArray textRange(qint64 startPos, qint64 endPos) const;
+	void rescanRange(qint64 startPos, qint64 endPos);
+
+	qint64 matchAt(int index) const;
+	int lowerBound(qint64 pos) const;
+	void moveShiftTo(int index);
+	void resetMatches();
+
+	SmartHighlightCache(const SmartHighlightCache&) = delete;
+	SmartHighlightCache& operator=(const SmartHighlightCache&) = delete;
+
+	ScintillaEditView* m_edit;
+	QByteArray m_word;
+
+	//匹配的开始位置，从小到大
+	QVector<qint64> m_matches;
+	//下标不小于m_shiftFrom的匹配，还要加上m_shift才是文档中的位置。
+	//连续在同一处输入时只修改这两个值，不用逐个移动后面的所有匹配
+	int m_shiftFrom;
+	qint64 m_shift;
+	bool m_ready;
+	//按修改通知推算的文档长度
+	qint64 m_docLength;
+
+	//每次开始查找或清除时加1，过滤掉过期的后台结果
+	int m_scanId;
+	int m_watchScanId;
+	//后台查找期间文档被修改了，结果作废，完成后重新查找
+	bool m_scanStale;
+	QFutureWatcher<QVector<qint64>>* m_watcher;
+
+	SmartHighlightMarks* m_marks;
+	QTimer m_marksTimer;
+};
@@ -0,0 +1,298 @@
+﻿#include "styletablecache.h"
+#include "styleset.h"
+
+#include <QCoreApplication>
+#include <QFileInfo>
+#include <QDateTime>
+#include <QDataStream>
+#include <QSaveFile>
+#include <QFile>
+#include <QDir>
+
+//二进制缓存文件的格式，改动后增加版本号，旧的缓存文件直接丢弃
+static const quint32 STYLE_CACHE_MAGIC = 0x4E535443;
+static const quint32 STYLE_CACHE_VERSION = 1;
+
+//字体只保存ini中的5项，读回来后与解析ini得到的字体完全一样
+static void writeFont(QDataStream& out, const QFont& font)
+{
+	out << font.family() << qint32(font.pointSize()) << font.bold() << font.italic() << font.underline();
+}
+
+static QFont readFont(QDataStream& in)
+{
+	QString family;
+	qint32 pointSize = 0;
+	bool bold = false, italic = false, underline = false;
+	in >> family >> pointSize >> bold >> italic >> underline;
+
+	QFont font;
+	font.setFamily(family);
+	font.setPointSize(pointSize);
+	font.setBold(bold);
+	font.setItalic(italic);
+	font.setUnderline(underline);
+	return font;
+}
+
+static void writeColor(QDataStream& out, const QColor& color)
+{
+	out << quint32(color.rgb());
+}
+
+static QColor readColor(QDataStream& in)
+{
+	quint32 rgb = 0;
+	in >> rgb;
+	return QColor(QRgb(rgb));
+}
+
+static void writeTable(QDataStream& out, const LexerStyleTable& table)
+{
+	const QsciLexer::StyleSettings& styles = table.styles;
+
+	out << table.filePath << table.fileTime << table.fileSize << table.hasProperties;
+	out << qint32(styles.defaultFlags);
+	writeColor(out, styles.defaultColor);
+	writeColor(out, styles.defaultPaper);
+	writeFont(out, styles.defaultFont);
+	out << styles.hasAutoIndentStyle << qint32(styles.autoIndentStyle) << styles.complete;
+
+	out << qint32(styles.styles.size());
+	for (const QsciLexer::StyleSettings::Style& style : styles.styles)
+	{
+		out << qint32(style.style) << qint32(style.flags);
+		writeColor(out, style.color);
+		out << style.eolFill;
+		writeFont(out, style.font);
+		writeColor(out, style.paper);
+	}
+}
+
+static bool readTable(QDataStream& in, LexerStyleTable& table)
+{
+	QsciLexer::StyleSettings& styles = table.styles;
+	qint32 num = 0;
+
+	in >> table.filePath >> table.fileTime >> table.fileSize >> table.hasProperties;
+	in >> num;
+	styles.defaultFlags = num;
+	styles.defaultColor = readColor(in);
+	styles.defaultPaper = readColor(in);
+	styles.defaultFont = readFont(in);
+	in >> styles.hasAutoIndentStyle >> num >> styles.complete;
+	styles.autoIndentStyle = num;
+
+	qint32 count = 0;
+	in >> count;
+	if (count < 0 || count > 256)
+	{
+		return false;
+	}
+
+	styles.styles.resize(count);
+	for (QsciLexer::StyleSettings::Style& style : styles.styles)
+	{
+		in >> num;
+		style.style = num;
+		in >> num;
+		style.flags = num;
+		style.color = readColor(in);
+		in >> style.eolFill;
+		style.font = readFont(in);
+		style.paper = readColor(in);
+	}
+	return in.status() == QDataStream::Ok;
+}
+
+StyleTableCache::StyleTableCache() : m_isLoaded(false), m_isChanged(false)
+{
+}
+
+StyleTableCache::~StyleTableCache()
+{
+}
+
+//QSettings用户配置的目录，与QSettings(QSettings::IniFormat, QSettings::UserScope, "notepad/...")的位置一致
+QString StyleTableCache::userStyleDir()
+{
+	if (m_userStyleDir.isEmpty())
+	{
+		QSettings qs(QSettings::IniFormat, QSettings::UserScope, "notepad", "stylecache");
+		m_userStyleDir = QFileInfo(qs.fileName()).absolutePath();
+	}
+	return m_userStyleDir;
+}
+
+bool StyleTableCache::readLexerSettings(QsciLexer* lexer, const QString& tag, int StyleId, bool isUserFirst)
+{
+	QString styleName = (StyleId == -1) ? StyleSet::getCurrentStyle() : StyleSet::getStyleName(StyleId);
+
+	QString filePath;
+	if (isUserFirst)
+	{
+		filePath = QString("%1/userstyle/%2/%3.ini").arg(userStyleDir()).arg(styleName).arg(tag);
+	}
+
+	if (filePath.isEmpty() || !QFile::exists(filePath))
+	{
+		//默认皮肤路径放在软件的同级目录下面的themes目录
+		filePath = QString("%1/themes/%2/%3.ini").arg(QCoreApplication::applicationDirPath()).arg(styleName).arg(tag);
+		if (!QFile::exists(filePath))
+		{
+			return false;
+		}
+	}
+
+	QSharedPointer<const LexerStyleTable> styleTable = table(lexer, filePath);
+
+	bool rc = lexer->applyStyleSettings(styleTable->styles);
+
+	//没有properties时QSettings读到的也都是lexer构造时的默认值
+	if (styleTable->hasProperties)
+	{
+		QString key = filePath + QChar('\n') + lexer->language();
+		QSharedPointer<QSettings> qs = m_propertySettings.value(key);
+		if (qs.isNull())
+		{
+			qs.reset(new QSettings(filePath, QSettings::IniFormat));
+			m_propertySettings.insert(key, qs);
+		}
+		if (!lexer->readPropertySettings(*qs))
+		{
+			rc = false;
+		}
+	}
+	else
+	{
+		lexer->refreshProperties();
+	}
+	return rc;
+}
+
+QSharedPointer<const LexerStyleTable> StyleTableCache::table(QsciLexer* lexer, const QString& filePath)
+{
+	load();
+
+	QFileInfo fi(filePath);
+	qint64 fileTime = fi.lastModified().toMSecsSinceEpoch();
+	qint64 fileSize = fi.size();
+
+	//同一个ini文件由不同语言的lexer读取时，有效的样式不同
+	QString key = filePath + QChar('\n') + lexer->language();
+
+	QSharedPointer<const LexerStyleTable> cached = m_tables.value(key);
+	if (!cached.isNull() && cached->fileTime == fileTime && cached->fileSize == fileSize)
+	{
+		return cached;
+	}
+
+	QSharedPointer<LexerStyleTable> styleTable(new LexerStyleTable());
+	styleTable->filePath = filePath;
+	styleTable->fileTime = fileTime;
+	styleTable->fileSize = fileSize;
+
+	QSettings qs(filePath, QSettings::IniFormat);
+	lexer->readStyleSettings(qs, styleTable->styles);
+
+	qs.beginGroup(QString("/Scintilla/%1/properties").arg(lexer->language()));
+	styleTable->hasProperties = !qs.childKeys().isEmpty();
+	qs.endGroup();
+
+	m_tables.insert(key, styleTable);
+	m_propertySettings.remove(key);
+	m_isChanged = true;
+	return styleTable;
+}
+
+void StyleTableCache::remove(const QString& filePath)
+{
+	QString prefix = filePath + QChar('\n');
+
+	for (auto it = m_tables.begin(); it != m_tables.end();)
+	{
+		if (it.key().startsWith(prefix))
+		{
+			m_propertySettings.remove(it.key());
+			it = m_tables.erase(it);
+			m_isChanged = true;
+		}
+		else
+		{
+			++it;
+		}
+	}
+}
+
+void StyleTableCache::load()
+{
+	if (m_isLoaded)
+	{
+		return;
+	}
+	m_isLoaded = true;
+
+	QFile file(userStyleDir() + "/stylecache.bin");
+	if (!file.open(QIODevice::ReadOnly))
+	{
+		return;
+	}
+
+	QDataStream in(&file);
+	in.setVersion(QDataStream::Qt_5_0);
+
+	quint32 magic = 0, version = 0;
+	qint32 count = 0;
+	in >> magic >> version >> count;
+	if (magic != STYLE_CACHE_MAGIC || version != STYLE_CACHE_VERSION || count < 0)
+	{
+		return;
+	}
+
+	for (qint32 i = 0; i < count; ++i)
+	{
+		QString key;
+		in >> key;
+
+		QSharedPointer<LexerStyleTable> styleTable(new LexerStyleTable());
+		if (!readTable(in, *styleTable))
+		{
+			//缓存文件损坏，全部丢弃，重新解析ini
+			m_tables.clear();
+			return;
+		}
+		m_tables.insert(key, styleTable);
+	}
+}
+
+//只在有新读取的样式表时写回
+void StyleTableCache::save()
+{
+	if (!m_isChanged)
+	{
+		return;
+	}
+
+	QDir().mkpath(userStyleDir());
+
+	QSaveFile file(userStyleDir() + "/stylecache.bin");
+	if (!file.open(QIODevice::WriteOnly))
+	{
+		return;
+	}
+
+	QDataStream out(&file);
+	out.setVersion(QDataStream::Qt_5_0);
+	out << STYLE_CACHE_MAGIC << STYLE_CACHE_VERSION << qint32(m_tables.size());
+
+	for (auto it = m_tables.constBegin(); it != m_tables.constEnd(); ++it)
+	{
+		out << it.key();
+		writeTable(out, *it.value());
+	}
+
+	if (file.commit())
+	{
+		m_isChanged = false;
+	}
+}
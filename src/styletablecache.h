@@ -0,0 +1,64 @@
+﻿#pragma once
+
+#include <QString>
+#include <QHash>
+#include <QSharedPointer>
+#include <QSettings>
+#include <qscilexer.h>
+
+//一种语言在一个主题下的样式表。从ini文件读取一次，之后同样语言的lexer都共享这一份，
+//不再每次逐个样式查找QSettings。读取后不再修改，ini文件变了就换成新读取的样式表
+struct LexerStyleTable
+{
+	QString filePath;
+	//读取时ini文件的修改时间和大小，不一致就重新读取
+	qint64 fileTime;
+	qint64 fileSize;
+	//ini中有语言的properties，要交给lexer自己读取
+	bool hasProperties;
+	QsciLexer::StyleSettings styles;
+
+	LexerStyleTable() : fileTime(0), fileSize(0), hasProperties(false)
+	{
+	}
+};
+
+//按ini文件和语言缓存样式表。内存中的样式表启动后在第一次使用时从二进制缓存文件中加载，
+//退出时把新读取的样式表写回去，下次启动不用再解析ini文件
+class StyleTableCache
+{
+public:
+	static StyleTableCache& getInstance() {
+		static StyleTableCache instance;
+		return instance;
+	};
+
+	//读取tag语言在StyleId主题下的样式，StyleId为-1时是当前主题。
+	//isUserFirst时优先使用用户修改过的样式，与QtLangSet::readLangSettings一致
+	bool readLexerSettings(QsciLexer* lexer, const QString& tag, int StyleId, bool isUserFirst);
+
+	//ini文件被保存或删除了，丢弃它的样式表
+	void remove(const QString& filePath);
+
+	void save();
+
+private:
+	StyleTableCache();
+	~StyleTableCache();
+
+	StyleTableCache(const StyleTableCache&) = delete;
+	StyleTableCache& operator=(const StyleTableCache&) = delete;
+
+	void load();
+	QString userStyleDir();
+	QSharedPointer<const LexerStyleTable> table(QsciLexer* lexer, const QString& filePath);
+
+	//key是ini文件路径加语言名称
+	QHash<QString, QSharedPointer<const LexerStyleTable>> m_tables;
+	//有properties的样式表对应的QSettings，读取一次后留在内存中
+	QHash<QString, QSharedPointer<QSettings>> m_propertySettings;
+
+	QString m_userStyleDir;
+	bool m_isLoaded;
+	bool m_isChanged;
+};
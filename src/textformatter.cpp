@@ -0,0 +1,697 @@
+﻿#include "textformatter.h"
+#include "nddtrace.h"
+
+#include <QtConcurrent>
+#include <QIODevice>
+#include <QXmlStreamReader>
+#include <QXmlStreamWriter>
+#include <QTextDecoder>
+#include <QTextCodec>
+#include <atomic>
+#include <vector>
+#include <cstring>
+#include <cctype>
+
+struct TextFormatTask {
+	int taskId;
+	QByteArray text;
+	int type;
+	int indent;
+	bool useTab;
+	QByteArray eol;
+	std::atomic<bool> isCancel;
+
+	TextFormatTask() :taskId(0), type(TextFormatter::JSON_PRETTY), indent(4), useTab(false), isCancel(false)
+	{
+	}
+};
+
+//攒够一块后发给界面，同时检查是否已经取消
+class FormatOutput
+{
+public:
+	FormatOutput(TextFormatTask* task, TextFormatter* formatter) :m_task(task), m_formatter(formatter), m_lastPercent(-1)
+	{
+		m_buf.reserve(TextFormatter::OUTPUT_CHUNK_SIZE + 1024);
+	}
+
+	void append(const char* data, qint64 len)
+	{
+		m_buf.append(data, (int)len);
+		if (m_buf.size() >= TextFormatter::OUTPUT_CHUNK_SIZE)
+		{
+			flush();
+		}
+	}
+
+	void append(char c)
+	{
+		m_buf.append(c);
+		if (m_buf.size() >= TextFormatter::OUTPUT_CHUNK_SIZE)
+		{
+			flush();
+		}
+	}
+
+	void flush()
+	{
+		if (!m_buf.isEmpty() && !m_task->isCancel)
+		{
+			emit m_formatter->signInnerOutput(m_task->taskId, m_buf);
+		}
+		m_buf.clear();
+	}
+
+	bool isCancel() const
+	{
+		return m_task->isCancel;
+	}
+
+	//已经处理了原文的done个字节
+	void progress(qint64 done)
+	{
+		int percent = (m_task->text.size() > 0) ? (int)(done * 100 / m_task->text.size()) : 100;
+		if (percent != m_lastPercent)
+		{
+			m_lastPercent = percent;
+			emit m_formatter->signInnerProgress(m_task->taskId, percent);
+		}
+	}
+
+private:
+	TextFormatTask* m_task;
+	TextFormatter* m_formatter;
+	QByteArray m_buf;
+	int m_lastPercent;
+};
+
+//JSON的流式格式化。只用一个容器栈，不递归，嵌套层数没有限制。
+//字符串、数字、字面量按原样输出，只改变它们之间的空白
+class JsonStreamFormatter
+{
+public:
+	JsonStreamFormatter(const TextFormatTask* task, FormatOutput* out) :
+		m_out(out), m_begin(task->text.constData()), m_end(task->text.constData() + task->text.size()), m_p(m_begin),
+		m_pretty(task->type != TextFormatter::JSON_MINIFY), m_useTab(task->useTab), m_indent(task->indent), m_eol(task->eol),
+		m_line(1), m_lineStart(m_begin), m_error(TextFormatter::FORMAT_OK), m_errPos(0)
+	{
+	}
+
+	bool run();
+
+	int error() const { return m_error; }
+	qint64 errPos() const { return m_errPos; }
+	qint64 errLine() const { return m_line; }
+	qint64 errColumn() const;
+
+private:
+	enum State {
+		EXPECT_VALUE,
+		EXPECT_VALUE_OR_END,//刚进入[
+		EXPECT_KEY_OR_END,//刚进入{
+		EXPECT_KEY,
+		EXPECT_COLON,
+		EXPECT_COMMA_OR_END,
+		EXPECT_NOTHING,//顶层的值已经结束
+	};
+
+	bool fail(int error, const char* pos)
+	{
+		m_error = error;
+		m_errPos = pos - m_begin;
+		return false;
+	}
+
+	void skipSpace();
+	void newLine(size_t depth);
+	bool copyString();
+	bool copyNumber();
+	bool copyLiteral();
+	bool beginValue();
+
+	FormatOutput* m_out;
+	const char* m_begin;
+	const char* m_end;
+	const char* m_p;
+	bool m_pretty;
+	bool m_useTab;
+	int m_indent;
+	QByteArray m_eol;
+
+	//容器栈，元素是'{'或'['
+	std::vector<char> m_stack;
+	//刚写了{或[，还不知道是否是空容器，等看到下一个记号再决定是否换行
+	bool m_openPending = false;
+	State m_state = EXPECT_VALUE;
+
+	qint64 m_line;
+	const char* m_lineStart;
+	int m_error;
+	qint64 m_errPos;
+	int m_tokens = 0;
+};
+
+//列号按UTF-8字符计算，续字节不计数
+qint64 JsonStreamFormatter::errColumn() const
+{
+	const char* pos = m_begin + m_errPos;
+	qint64 column = 1;
+	for (const char* s = m_lineStart; s < pos; ++s)
+	{
+		if ((static_cast<unsigned char>(*s) & 0xC0) != 0x80)
+		{
+			++column;
+		}
+	}
+	return column;
+}
+
+void JsonStreamFormatter::skipSpace()
+{
+	while (m_p < m_end)
+	{
+		char c = *m_p;
+		if (c == '\n')
+		{
+			++m_line;
+			m_lineStart = m_p + 1;
+		}
+		else if (c != ' ' && c != '\t' && c != '\r')
+		{
+			break;
+		}
+		++m_p;
+	}
+}
+
+void JsonStreamFormatter::newLine(size_t depth)
+{
+	if (!m_pretty)
+	{
+		return;
+	}
+	m_out->append(m_eol.constData(), m_eol.size());
+	for (size_t i = 0; i < depth; ++i)
+	{
+		if (m_useTab)
+		{
+			m_out->append('\t');
+		}
+		else
+		{
+			for (int j = 0; j < m_indent; ++j)
+			{
+				m_out->append(' ');
+			}
+		}
+	}
+}
+
+bool JsonStreamFormatter::copyString()
+{
+	const char* start = m_p;
+	const char* s = m_p + 1;
+	while (s < m_end)
+	{
+		unsigned char c = static_cast<unsigned char>(*s);
+		if (c == '"')
+		{
+			++s;
+			m_out->append(start, s - start);
+			m_p = s;
+			return true;
+		}
+		if (c < 0x20)
+		{
+			return fail(TextFormatter::FORMAT_CONTROL_CHAR_IN_STRING, s);
+		}
+		if (c == '\\')
+		{
+			if (s + 1 >= m_end)
+			{
+				break;
+			}
+			char e = s[1];
+			if (e == 'u')
+			{
+				for (int i = 2; i < 6; ++i)
+				{
+					if (s + i >= m_end || !isxdigit(static_cast<unsigned char>(s[i])))
+					{
+						return fail(TextFormatter::FORMAT_INVALID_ESCAPE, s);
+					}
+				}
+				s += 6;
+				continue;
+			}
+			if (e != '"' && e != '\\' && e != '/' && e != 'b' && e != 'f' && e != 'n' && e != 'r' && e != 't')
+			{
+				return fail(TextFormatter::FORMAT_INVALID_ESCAPE, s);
+			}
+			s += 2;
+			continue;
+		}
+		++s;
+	}
+	return fail(TextFormatter::FORMAT_UNTERMINATED_STRING, start);
+}
+
+//-?(0|[1-9][0-9]*)(.[0-9]+)?([eE][+-]?[0-9]+)?
+bool JsonStreamFormatter::copyNumber()
+{
+	const char* start = m_p;
+	const char* s = m_p;
+
+	auto digits = [&s, this]() {
+		const char* first = s;
+		while (s < m_end && *s >= '0' && *s <= '9')
+		{
+			++s;
+		}
+		return s > first;
+	};
+
+	if (*s == '-')
+	{
+		++s;
+	}
+	if (s < m_end && *s == '0')
+	{
+		++s;
+	}
+	else if (!digits())
+	{
+		return fail(TextFormatter::FORMAT_INVALID_NUMBER, start);
+	}
+	if (s < m_end && *s == '.')
+	{
+		++s;
+		if (!digits())
+		{
+			return fail(TextFormatter::FORMAT_INVALID_NUMBER, start);
+		}
+	}
+	if (s < m_end && (*s == 'e' || *s == 'E'))
+	{
+		++s;
+		if (s < m_end && (*s == '+' || *s == '-'))
+		{
+			++s;
+		}
+		if (!digits())
+		{
+			return fail(TextFormatter::FORMAT_INVALID_NUMBER, start);
+		}
+	}
+	m_out->append(start, s - start);
+	m_p = s;
+	return true;
+}
+
+bool JsonStreamFormatter::copyLiteral()
+{
+	static const char* const literals[] = { "true", "false", "null" };
+	for (const char* word : literals)
+	{
+		qint64 len = (qint64)strlen(word);
+		if (m_end - m_p >= len && memcmp(m_p, word, len) == 0)
+		{
+			m_out->append(m_p, len);
+			m_p += len;
+			return true;
+		}
+	}
+	return fail(TextFormatter::FORMAT_INVALID_LITERAL, m_p);
+}
+
+//当前字符开始一个值
+bool JsonStreamFormatter::beginValue()
+{
+	char c = *m_p;
+	if (c == '{' || c == '[')
+	{
+		m_out->append(c);
+		m_stack.push_back(c);
+		m_openPending = true;
+		m_state = (c == '{') ? EXPECT_KEY_OR_END : EXPECT_VALUE_OR_END;
+		++m_p;
+		return true;
+	}
+
+	bool ok;
+	if (c == '"')
+	{
+		ok = copyString();
+	}
+	else if (c == '-' || (c >= '0' && c <= '9'))
+	{
+		ok = copyNumber();
+	}
+	else if (c == 't' || c == 'f' || c == 'n')
+	{
+		ok = copyLiteral();
+	}
+	else
+	{
+		return fail(TextFormatter::FORMAT_UNEXPECTED_CHAR, m_p);
+	}
+	m_state = m_stack.empty() ? EXPECT_NOTHING : EXPECT_COMMA_OR_END;
+	return ok;
+}
+
+bool JsonStreamFormatter::run()
+{
+	for (;;)
+	{
+		skipSpace();
+
+		if ((++m_tokens & 0xFFFF) == 0)
+		{
+			if (m_out->isCancel())
+			{
+				return false;
+			}
+			m_out->progress(m_p - m_begin);
+		}
+
+		if (m_p >= m_end)
+		{
+			if (m_state != EXPECT_NOTHING)
+			{
+				return fail(TextFormatter::FORMAT_UNEXPECTED_END, m_end);
+			}
+			if (m_pretty)
+			{
+				m_out->append(m_eol.constData(), m_eol.size());
+			}
+			m_out->flush();
+			return true;
+		}
+
+		char c = *m_p;
+
+		//空容器写成{}、[]，不换行
+		if (m_openPending)
+		{
+			m_openPending = false;
+			if ((m_state == EXPECT_KEY_OR_END && c == '}') || (m_state == EXPECT_VALUE_OR_END && c == ']'))
+			{
+				m_out->append(c);
+				m_stack.pop_back();
+				m_state = m_stack.empty() ? EXPECT_NOTHING : EXPECT_COMMA_OR_END;
+				++m_p;
+				continue;
+			}
+			newLine(m_stack.size());
+		}
+
+		switch (m_state)
+		{
+		case EXPECT_VALUE:
+		case EXPECT_VALUE_OR_END:
+			if (!beginValue())
+			{
+				return false;
+			}
+			break;
+
+		case EXPECT_KEY_OR_END:
+		case EXPECT_KEY:
+			if (c != '"')
+			{
+				return fail(TextFormatter::FORMAT_UNEXPECTED_CHAR, m_p);
+			}
+			if (!copyString())
+			{
+				return false;
+			}
+			m_state = EXPECT_COLON;
+			break;
+
+		case EXPECT_COLON:
+			if (c != ':')
+			{
+				return fail(TextFormatter::FORMAT_UNEXPECTED_CHAR, m_p);
+			}
+			m_out->append(':');
+			if (m_pretty)
+			{
+				m_out->append(' ');
+			}
+			++m_p;
+			m_state = EXPECT_VALUE;
+			break;
+
+		case EXPECT_COMMA_OR_END:
+			if (c == ',')
+			{
+				m_out->append(',');
+				newLine(m_stack.size());
+				++m_p;
+				m_state = (m_stack.back() == '{') ? EXPECT_KEY : EXPECT_VALUE;
+			}
+			else if ((c == '}' && m_stack.back() == '{') || (c == ']' && m_stack.back() == '['))
+			{
+				m_stack.pop_back();
+				newLine(m_stack.size());
+				m_out->append(c);
+				++m_p;
+				m_state = m_stack.empty() ? EXPECT_NOTHING : EXPECT_COMMA_OR_END;
+			}
+			else
+			{
+				return fail(TextFormatter::FORMAT_UNEXPECTED_CHAR, m_p);
+			}
+			break;
+
+		case EXPECT_NOTHING:
+			return fail(TextFormatter::FORMAT_EXTRA_CONTENT, m_p);
+		}
+	}
+}
+
+//QXmlStreamWriter写入的设备，把输出交给FormatOutput。
+//自动格式化总是用\n换行，这里换成文档的换行符；解析器也已经把文本中的\r\n规范为\n
+class FormatOutputDevice : public QIODevice
+{
+public:
+	FormatOutputDevice(FormatOutput* out, const QByteArray& eol) :m_out(out), m_eol(eol)
+	{
+		open(QIODevice::WriteOnly);
+	}
+
+protected:
+	qint64 readData(char* /*data*/, qint64 /*maxSize*/) override
+	{
+		return -1;
+	}
+
+	qint64 writeData(const char* data, qint64 len) override
+	{
+		if (m_eol == "\n")
+		{
+			m_out->append(data, len);
+			return len;
+		}
+
+		const char* start = data;
+		const char* end = data + len;
+		for (const char* s = data; s < end; ++s)
+		{
+			if (*s == '\n')
+			{
+				m_out->append(start, s - start);
+				m_out->append(m_eol.constData(), m_eol.size());
+				start = s + 1;
+			}
+		}
+		m_out->append(start, end - start);
+		return len;
+	}
+
+private:
+	FormatOutput* m_out;
+	QByteArray m_eol;
+};
+
+//行号从1开始，列号是该行中的UTF-16字符数，换算为原文中的字节位置
+static qint64 xmlErrorPos(const QByteArray& text, qint64 line, qint64 column)
+{
+	int pos = 0;
+	for (qint64 i = 1; i < line; ++i)
+	{
+		int eolPos = text.indexOf('\n', pos);
+		if (eolPos < 0)
+		{
+			return text.size();
+		}
+		pos = eolPos + 1;
+	}
+
+	while (column > 0 && pos < text.size() && text.at(pos) != '\n')
+	{
+		uchar c = (uchar)text.at(pos);
+		int len = (c < 0x80) ? 1 : ((c >> 5) == 0x6) ? 2 : ((c >> 4) == 0xE) ? 3 : ((c >> 3) == 0x1E) ? 4 : 1;
+		column -= (len == 4) ? 2 : 1;
+		pos += len;
+	}
+	return qMin(pos, text.size());
+}
+
+//文档缓冲区总是UTF-8，不管XML声明中写的编码，所以自己分块解码后交给解析器。
+//解析器只保留还没有解析的输入，不需要把整个文档转换为QString
+static void formatXml(TextFormatTask* task, FormatOutput* out, int& error, QString& errMsg, qint64& errPos, qint64& errLine, qint64& errColumn)
+{
+	FormatOutputDevice device(out, task->eol);
+	QXmlStreamWriter writer(&device);
+	writer.setCodec("UTF-8");
+
+	bool pretty = (task->type == TextFormatter::XML_PRETTY);
+	writer.setAutoFormatting(pretty);
+	//负数表示用制表符缩进
+	writer.setAutoFormattingIndent(task->useTab ? -1 : task->indent);
+
+	QTextDecoder decoder(QTextCodec::codecForName("UTF-8"));
+	QXmlStreamReader reader;
+	int fed = 0;
+	const int total = task->text.size();
+
+	while (!task->isCancel)
+	{
+		reader.readNext();
+
+		if (reader.error() == QXmlStreamReader::PrematureEndOfDocumentError && fed < total)
+		{
+			int len = qMin(TextFormatter::INPUT_CHUNK_SIZE, total - fed);
+			reader.addData(decoder.toUnicode(task->text.constData() + fed, len));
+			fed += len;
+			out->progress(fed);
+			continue;
+		}
+
+		if (reader.hasError())
+		{
+			error = TextFormatter::FORMAT_XML_ERROR;
+			errMsg = reader.errorString();
+			errLine = reader.lineNumber();
+			errColumn = reader.columnNumber() + 1;
+			errPos = xmlErrorPos(task->text, reader.lineNumber(), reader.columnNumber());
+			return;
+		}
+
+		if (reader.atEnd())
+		{
+			break;
+		}
+
+		if (!reader.isWhitespace())
+		{
+			writer.writeCurrentToken(reader);
+		}
+	}
+
+	out->flush();
+}
+
+TextFormatter::TextFormatter(QObject* parent) : QObject(parent), m_taskId(0)
+{
+	//后台线程发出的信号排队到界面线程处理
+	connect(this, &TextFormatter::signInnerOutput, this, &TextFormatter::slot_innerOutput, Qt::QueuedConnection);
+	connect(this, &TextFormatter::signInnerProgress, this, &TextFormatter::slot_innerProgress, Qt::QueuedConnection);
+	connect(this, &TextFormatter::signInnerFinished, this, &TextFormatter::slot_innerFinished, Qt::QueuedConnection);
+}
+
+TextFormatter::~TextFormatter()
+{
+	cancel();
+	m_future.waitForFinished();
+}
+
+void TextFormatter::start(QByteArray text, int type, int indent, bool useTab, QByteArray eol)
+{
+	cancel();
+
+	QSharedPointer<TextFormatTask> task(new TextFormatTask());
+	task->taskId = ++m_taskId;
+	task->text = text;
+	task->type = type;
+	task->indent = indent;
+	task->useTab = useTab;
+	task->eol = eol;
+
+	m_task = task;
+	m_future = QtConcurrent::run(&TextFormatter::runFormat, task, this);
+}
+
+//取消后，已经排队的输出也不再发出
+void TextFormatter::cancel()
+{
+	if (!m_task.isNull())
+	{
+		m_task->isCancel = true;
+		m_task.clear();
+	}
+	++m_taskId;
+}
+
+bool TextFormatter::isRunning()
+{
+	return !m_task.isNull();
+}
+
+//后台线程中执行
+void TextFormatter::runFormat(QSharedPointer<TextFormatTask> task, TextFormatter* formatter)
+{
+	NDD_TRACE_SPAN("TextFormatter::runFormat");
+
+	FormatOutput out(task.data(), formatter);
+
+	int error = FORMAT_OK;
+	QString errMsg;
+	qint64 errPos = 0;
+	qint64 errLine = 0;
+	qint64 errColumn = 0;
+
+	if (task->type == XML_PRETTY || task->type == XML_MINIFY)
+	{
+		formatXml(task.data(), &out, error, errMsg, errPos, errLine, errColumn);
+	}
+	else
+	{
+		JsonStreamFormatter json(task.data(), &out);
+		if (!json.run() && json.error() != FORMAT_OK)
+		{
+			error = json.error();
+			errPos = json.errPos();
+			errLine = json.errLine();
+			errColumn = json.errColumn();
+		}
+	}
+
+	emit formatter->signInnerFinished(task->taskId, error, errMsg, errPos, errLine, errColumn, task->isCancel);
+}
+
+void TextFormatter::slot_innerOutput(int taskId, QByteArray data)
+{
+	if (taskId == m_taskId)
+	{
+		emit signOutput(data);
+	}
+}
+
+void TextFormatter::slot_innerProgress(int taskId, int percent)
+{
+	if (taskId == m_taskId)
+	{
+		emit signProgress(percent);
+	}
+}
+
+void TextFormatter::slot_innerFinished(int taskId, int error, QString errMsg, qint64 errPos, qint64 errLine, qint64 errColumn, bool isCancel)
+{
+	if (taskId == m_taskId)
+	{
+		m_task.clear();
+		emit signFinished(error, errMsg, errPos, errLine, errColumn, isCancel);
+	}
+}
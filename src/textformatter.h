@@ -0,0 +1,77 @@
+﻿#pragma once
+
+#include <QObject>
+#include <QByteArray>
+#include <QString>
+#include <QFuture>
+#include <QSharedPointer>
+
+struct TextFormatTask;
+
+//在后台线程中格式化或压缩文档的一份UTF-8拷贝。不建立DOM，边解析边输出：
+//JSON按字节解析，键的顺序、数字的原样写法都不变，也没有Qt JSON的大小限制；
+//XML分块交给QXmlStreamReader，不把整个文档转换为QString。输出分块发出，由界面追加到文档中
+class TextFormatter : public QObject
+{
+	Q_OBJECT
+
+public:
+	enum FormatType {
+		JSON_PRETTY = 0,
+		JSON_MINIFY,
+		XML_PRETTY,
+		XML_MINIFY,
+	};
+
+	enum FormatError {
+		FORMAT_OK = 0,
+		FORMAT_UNEXPECTED_CHAR,
+		FORMAT_UNEXPECTED_END,
+		FORMAT_UNTERMINATED_STRING,
+		FORMAT_CONTROL_CHAR_IN_STRING,
+		FORMAT_INVALID_ESCAPE,
+		FORMAT_INVALID_NUMBER,
+		FORMAT_INVALID_LITERAL,
+		FORMAT_EXTRA_CONTENT,
+		FORMAT_XML_ERROR,//原因在errMsg中
+	};
+
+	TextFormatter(QObject* parent = nullptr);
+	virtual ~TextFormatter();
+
+	//indent是每层缩进的空格数，useTab时每层一个制表符。eol是输出的换行符
+	void start(QByteArray text, int type, int indent, bool useTab, QByteArray eol);
+	void cancel();
+	bool isRunning();
+
+	//每次发出的输出块的大小
+	static const int OUTPUT_CHUNK_SIZE = 256 * 1024;
+	//每次交给XML解析器的输入块的大小
+	static const int INPUT_CHUNK_SIZE = 1024 * 1024;
+
+signals:
+	void signOutput(QByteArray data);
+	void signProgress(int percent);
+	//出错时errPos是原文中的字节位置，errLine、errColumn从1开始，列按字符计算
+	void signFinished(int error, QString errMsg, qint64 errPos, qint64 errLine, qint64 errColumn, bool isCancel);
+
+	//下面三个是后台线程内部使用的，带上任务序号，过滤掉已经取消的任务发过来的输出
+	void signInnerOutput(int taskId, QByteArray data);
+	void signInnerProgress(int taskId, int percent);
+	void signInnerFinished(int taskId, int error, QString errMsg, qint64 errPos, qint64 errLine, qint64 errColumn, bool isCancel);
+
+private slots:
+	void slot_innerOutput(int taskId, QByteArray data);
+	void slot_innerProgress(int taskId, int percent);
+	void slot_innerFinished(int taskId, int error, QString errMsg, qint64 errPos, qint64 errLine, qint64 errColumn, bool isCancel);
+
+private:
+	static void runFormat(QSharedPointer<TextFormatTask> task, TextFormatter* formatter);
+
+	TextFormatter(const TextFormatter&) = delete;
+	TextFormatter& operator=(const TextFormatter&) = delete;
+
+	QSharedPointer<TextFormatTask> m_task;
+	QFuture<void> m_future;
+	int m_taskId;
+};
@@ -0,0 +1,908 @@
+﻿#include "texttranscoder.h"
+#include "Encode.h"
+
+#include <string.h>
+#include <limits.h>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && (_M_IX86_FP >= 2))
+#include <emmintrin.h>
+#define NDD_TRANSCODE_SSE2 1
+#endif
+
+static const ushort REPLACEMENT_CHAR = 0xFFFD;
+
+//UTF8和未识别的编码，与Encode::tranStrToUNICODE一样按UTF8处理
+static TRANSCODE_SCHEME schemeOfCode(CODE_ID code)
+{
+	switch (code)
+	{
+	case UNICODE_LE:
+		return SCHEME_UTF16LE;
+	case UNICODE_BE:
+		return SCHEME_UTF16BE;
+	case GBK:
+	case EUC_JP:
+	case Shift_JIS:
+	case EUC_KR:
+	case KOI8_R:
+	case TSCII:
+	case TIS_620:
+	case BIG5:
+		return SCHEME_CODEC;
+	default:
+		return SCHEME_UTF8;
+	}
+}
+
+//这些编码中小于0x80的字节都是ASCII字符，而且多字节字符的前导字节都大于0x80。
+//日文编码的0x5C 0x7E可能按JIS-Roman映射为日元符号和上划线，不能跳过codec
+static bool isAsciiCompatibleCode(CODE_ID code)
+{
+	switch (code)
+	{
+	case GBK:
+	case EUC_KR:
+	case KOI8_R:
+	case TIS_620:
+	case BIG5:
+		return true;
+	default:
+		return false;
+	}
+}
+
+static QTextCodec* codecOfCode(CODE_ID code)
+{
+	return QTextCodec::codecForName(Encode::getQtCodecNameById(code).toUtf8());
+}
+
+//把p开头连续的ASCII字节扩展为UTF16写到dst，返回个数。dst至少要有length个位置
+static qint64 widenAsciiRun(const uchar* p, qint64 length, ushort* dst)
+{
+	qint64 i = 0;
+#ifdef NDD_TRANSCODE_SSE2
+	const __m128i zero = _mm_setzero_si128();
+	for (; i + 16 <= length; i += 16)
+	{
+		__m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p + i));
+		if (_mm_movemask_epi8(v) != 0)
+		{
+			break;
+		}
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i), _mm_unpacklo_epi8(v, zero));
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i + 8), _mm_unpackhi_epi8(v, zero));
+	}
+#endif
+	for (; i < length && p[i] < 0x80; ++i)
+	{
+		dst[i] = p[i];
+	}
+	return i;
+}
+
+//把p开头连续的ASCII字符压缩为单字节写到dst，返回个数。dst至少要有length个位置
+static qint64 narrowAsciiRun(const ushort* p, qint64 length, uchar* dst)
+{
+	qint64 i = 0;
+#ifdef NDD_TRANSCODE_SSE2
+	const __m128i nonAscii = _mm_set1_epi16((short)0xFF80);
+	const __m128i zero = _mm_setzero_si128();
+	for (; i + 16 <= length; i += 16)
+	{
+		__m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p + i));
+		__m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p + i + 8));
+		__m128i high = _mm_and_si128(_mm_or_si128(a, b), nonAscii);
+		if (_mm_movemask_epi8(_mm_cmpeq_epi16(high, zero)) != 0xFFFF)
+		{
+			break;
+		}
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i), _mm_packus_epi16(a, b));
+	}
+#endif
+	for (; i < length && p[i] < 0x80; ++i)
+	{
+		dst[i] = (uchar)p[i];
+	}
+	return i;
+}
+
+//解码一个UTF8字符，返回消耗的字节数。字节不够时返回0，等下一块。
+//无效时isValid为false，只消耗到出错的字节之前，出错的字节重新作为字符开头处理
+static int decodeUtf8Char(const uchar* p, qint64 length, uint& ucs, bool& isValid)
+{
+	uchar lead = p[0];
+	int need = 0;
+	uint minValue = 0;
+
+	isValid = false;
+
+	if (lead < 0x80)
+	{
+		ucs = lead;
+		isValid = true;
+		return 1;
+	}
+	else if (lead < 0xC2)
+	{
+		//单独的后续字节，或者C0 C1开头的超长编码
+		return 1;
+	}
+	else if (lead < 0xE0)
+	{
+		need = 1;
+		ucs = lead & 0x1F;
+		minValue = 0x80;
+	}
+	else if (lead < 0xF0)
+	{
+		need = 2;
+		ucs = lead & 0x0F;
+		minValue = 0x800;
+	}
+	else if (lead < 0xF5)
+	{
+		need = 3;
+		ucs = lead & 0x07;
+		minValue = 0x10000;
+	}
+	else
+	{
+		return 1;
+	}
+
+	for (int i = 1; i <= need; ++i)
+	{
+		if (i >= length)
+		{
+			return 0;
+		}
+		if ((p[i] & 0xC0) != 0x80)
+		{
+			return i;
+		}
+		ucs = (ucs << 6) | (p[i] & 0x3F);
+	}
+
+	isValid = (ucs >= minValue) && (ucs <= 0x10FFFF) && !(ucs >= 0xD800 && ucs <= 0xDFFF);
+	return need + 1;
+}
+
+static inline ushort* putUcs(ushort* dst, uint ucs)
+{
+	if (ucs >= 0x10000)
+	{
+		*dst++ = QChar::highSurrogate(ucs);
+		*dst++ = QChar::lowSurrogate(ucs);
+	}
+	else
+	{
+		*dst++ = (ushort)ucs;
+	}
+	return dst;
+}
+
+static inline uchar* putUtf8(uchar* dst, uint ucs)
+{
+	if (ucs < 0x80)
+	{
+		*dst++ = (uchar)ucs;
+	}
+	else if (ucs < 0x800)
+	{
+		*dst++ = (uchar)(0xC0 | (ucs >> 6));
+		*dst++ = (uchar)(0x80 | (ucs & 0x3F));
+	}
+	else if (ucs < 0x10000)
+	{
+		*dst++ = (uchar)(0xE0 | (ucs >> 12));
+		*dst++ = (uchar)(0x80 | ((ucs >> 6) & 0x3F));
+		*dst++ = (uchar)(0x80 | (ucs & 0x3F));
+	}
+	else
+	{
+		*dst++ = (uchar)(0xF0 | (ucs >> 18));
+		*dst++ = (uchar)(0x80 | ((ucs >> 12) & 0x3F));
+		*dst++ = (uchar)(0x80 | ((ucs >> 6) & 0x3F));
+		*dst++ = (uchar)(0x80 | (ucs & 0x3F));
+	}
+	return dst;
+}
+
+TextDecoder::TextDecoder(CODE_ID code, bool isSkipBom) :
+	m_code(code), m_scheme(schemeOfCode(code)), m_bomChecked(0), m_pendingLen(0),
+	m_codec(nullptr), m_state(nullptr), m_isAsciiCompatible(isAsciiCompatibleCode(code)), m_isAsciiBoundary(true), m_invalidChars(0)
+{
+	if (isSkipBom)
+	{
+		switch (m_scheme)
+		{
+		case SCHEME_UTF8:
+			m_bom = Encode::getEncodeStartFlagByte(CODE_ID::UTF8_BOM);
+			break;
+		case SCHEME_UTF16LE:
+			m_bom = Encode::getEncodeStartFlagByte(CODE_ID::UNICODE_LE);
+			break;
+		case SCHEME_UTF16BE:
+			m_bom = Encode::getEncodeStartFlagByte(CODE_ID::UNICODE_BE);
+			break;
+		default:
+			break;
+		}
+	}
+
+	if (m_scheme == SCHEME_CODEC)
+	{
+		m_codec = codecOfCode(code);
+		m_state = new QTextCodec::ConverterState();
+	}
+}
+
+TextDecoder::~TextDecoder()
+{
+	delete m_state;
+}
+
+qint64 TextDecoder::invalidChars() const
+{
+	return m_invalidChars + ((m_state != nullptr) ? m_state->invalidChars : 0);
+}
+
+void TextDecoder::decode(const char* data, qint64 length, QString& out)
+{
+	const uchar* p = reinterpret_cast<const uchar*>(data);
+
+	//BOM也可能被块边界截断，匹配完才能确定
+	if (!m_bom.isEmpty())
+	{
+		while (m_bomChecked < m_bom.size() && length > 0 && *p == (uchar)m_bom.at(m_bomChecked))
+		{
+			++m_bomChecked;
+			++p;
+			--length;
+		}
+
+		if (m_bomChecked == m_bom.size())
+		{
+			m_bom.clear();
+		}
+		else if (length > 0)
+		{
+			//不是BOM，已经匹配的字节是正文
+			QByteArray head = m_bom.left(m_bomChecked);
+			m_bom.clear();
+			decodeRaw(reinterpret_cast<const uchar*>(head.constData()), head.size(), out);
+		}
+		else
+		{
+			return;
+		}
+	}
+
+	if (length > 0)
+	{
+		decodeRaw(p, length, out);
+	}
+}
+
+void TextDecoder::decodeRaw(const uchar* p, qint64 length, QString& out)
+{
+	switch (m_scheme)
+	{
+	case SCHEME_UTF8:
+		decodeUtf8(p, length, out);
+		break;
+	case SCHEME_UTF16LE:
+	case SCHEME_UTF16BE:
+		decodeUtf16(p, length, out);
+		break;
+	default:
+		decodeCodec(p, length, out);
+		break;
+	}
+}
+
+void TextDecoder::finish(QString& out)
+{
+	//输入比BOM还短
+	if (!m_bom.isEmpty() && m_bomChecked > 0)
+	{
+		QByteArray head = m_bom.left(m_bomChecked);
+		m_bom.clear();
+		decodeRaw(reinterpret_cast<const uchar*>(head.constData()), head.size(), out);
+	}
+
+	switch (m_scheme)
+	{
+	case SCHEME_UTF8:
+		//截断的字符
+		if (m_pendingLen > 0)
+		{
+			out.append(QChar(REPLACEMENT_CHAR));
+			++m_invalidChars;
+		}
+		break;
+	case SCHEME_UTF16LE:
+		//单独的一个字节补0，与之前按行转换时的处理一样
+		if (m_pendingLen > 0)
+		{
+			out.append(QChar((ushort)m_pending[0]));
+		}
+		break;
+	case SCHEME_UTF16BE:
+		if (m_pendingLen > 0)
+		{
+			out.append(QChar((ushort)(m_pending[0] << 8)));
+		}
+		break;
+	default:
+		if (m_state != nullptr && m_state->remainingChars > 0)
+		{
+			out.append(QChar(REPLACEMENT_CHAR));
+			++m_invalidChars;
+		}
+		break;
+	}
+	m_pendingLen = 0;
+}
+
+//每个字节最多产生一个UTF16字符，4字节的字符产生两个，所以先按字节数扩大out，最后再截掉多余的
+void TextDecoder::decodeUtf8(const uchar* p, qint64 length, QString& out)
+{
+	int oldSize = out.size();
+	out.resize(oldSize + (int)length + 4);
+	ushort* begin = reinterpret_cast<ushort*>(out.data());
+	ushort* dst = begin + oldSize;
+
+	uint ucs = 0;
+	bool isValid = false;
+
+	//先用新块开头的字节补全上一块留下的字符
+	while (m_pendingLen > 0 && length > 0)
+	{
+		uchar buf[8];
+		memcpy(buf, m_pending, m_pendingLen);
+		int take = (int)qMin<qint64>(4 - m_pendingLen, length);
+		memcpy(buf + m_pendingLen, p, take);
+
+		int used = decodeUtf8Char(buf, m_pendingLen + take, ucs, isValid);
+		if (used == 0)
+		{
+			//新块太短，还是不完整
+			memcpy(m_pending + m_pendingLen, p, take);
+			m_pendingLen += take;
+			p += take;
+			length -= take;
+			break;
+		}
+
+		if (isValid)
+		{
+			dst = putUcs(dst, ucs);
+		}
+		else
+		{
+			*dst++ = REPLACEMENT_CHAR;
+			++m_invalidChars;
+		}
+
+		if (used >= m_pendingLen)
+		{
+			p += used - m_pendingLen;
+			length -= used - m_pendingLen;
+			m_pendingLen = 0;
+		}
+		else
+		{
+			//无效字符只消耗了部分留下的字节，剩下的重新处理
+			memmove(m_pending, m_pending + used, m_pendingLen - used);
+			m_pendingLen -= used;
+		}
+	}
+
+	qint64 i = 0;
+	while (i < length)
+	{
+		if (p[i] < 0x80)
+		{
+			qint64 run = widenAsciiRun(p + i, length - i, dst);
+			dst += run;
+			i += run;
+			continue;
+		}
+
+		int used = decodeUtf8Char(p + i, length - i, ucs, isValid);
+		if (used == 0)
+		{
+			m_pendingLen = (int)(length - i);
+			memcpy(m_pending, p + i, m_pendingLen);
+			break;
+		}
+
+		if (isValid)
+		{
+			dst = putUcs(dst, ucs);
+		}
+		else
+		{
+			*dst++ = REPLACEMENT_CHAR;
+			++m_invalidChars;
+		}
+		i += used;
+	}
+
+	out.resize((int)(dst - begin));
+}
+
+void TextDecoder::decodeUtf16(const uchar* p, qint64 length, QString& out)
+{
+	const bool isBe = (m_scheme == SCHEME_UTF16BE);
+
+	int oldSize = out.size();
+	out.resize(oldSize + (int)((m_pendingLen + length) / 2));
+	ushort* dst = reinterpret_cast<ushort*>(out.data()) + oldSize;
+
+	if (m_pendingLen > 0 && length > 0)
+	{
+		*dst++ = isBe ? (ushort)((m_pending[0] << 8) | p[0]) : (ushort)((p[0] << 8) | m_pending[0]);
+		m_pendingLen = 0;
+		++p;
+		--length;
+	}
+
+	qint64 units = length / 2;
+
+#if Q_BYTE_ORDER == Q_LITTLE_ENDIAN
+	if (!isBe)
+	{
+		memcpy(dst, p, units * 2);
+	}
+	else
+#endif
+	{
+		for (qint64 i = 0; i < units; ++i)
+		{
+			const uchar* u = p + i * 2;
+			dst[i] = isBe ? (ushort)((u[0] << 8) | u[1]) : (ushort)((u[1] << 8) | u[0]);
+		}
+	}
+
+	if (length & 1)
+	{
+		m_pending[0] = p[length - 1];
+		m_pendingLen = 1;
+	}
+}
+
+//codec对多字节编码是带状态的，截断的前导字节保存在m_state中。
+//ASCII兼容的编码中，前一个字节是ASCII时codec里没有残留，后面连续的ASCII直接扩展
+void TextDecoder::decodeCodec(const uchar* p, qint64 length, QString& out)
+{
+	if (m_codec == nullptr)
+	{
+		m_invalidChars += length;
+		return;
+	}
+
+	qint64 i = 0;
+	while (i < length)
+	{
+		if (m_isAsciiCompatible && m_isAsciiBoundary && p[i] < 0x80)
+		{
+			int oldSize = out.size();
+			out.resize(oldSize + (int)(length - i));
+			qint64 run = widenAsciiRun(p + i, length - i, reinterpret_cast<ushort*>(out.data()) + oldSize);
+			out.resize(oldSize + (int)run);
+			i += run;
+			continue;
+		}
+
+		//一直到前面也是ASCII字节的ASCII字节为止交给codec
+		qint64 end = length;
+		if (m_isAsciiCompatible)
+		{
+			end = i + 1;
+			while (end < length && !(p[end - 1] < 0x80 && p[end] < 0x80))
+			{
+				++end;
+			}
+		}
+
+		out.append(m_codec->toUnicode(reinterpret_cast<const char*>(p + i), end - i, m_state));
+		m_isAsciiBoundary = (p[end - 1] < 0x80);
+		i = end;
+	}
+}
+
+TextEncoder::TextEncoder(CODE_ID code, bool isWriteBom) :
+	m_code(code), m_scheme(schemeOfCode(code)), m_isBomWritten(!isWriteBom), m_highSurrogate(0),
+	m_codec(nullptr), m_state(nullptr), m_isAsciiCompatible(isAsciiCompatibleCode(code)), m_invalidChars(0)
+{
+	if (m_scheme == SCHEME_CODEC)
+	{
+		m_codec = codecOfCode(code);
+		m_state = new QTextCodec::ConverterState(QTextCodec::IgnoreHeader);
+	}
+}
+
+TextEncoder::~TextEncoder()
+{
+	delete m_state;
+}
+
+qint64 TextEncoder::invalidChars() const
+{
+	return m_invalidChars + ((m_state != nullptr) ? m_state->invalidChars : 0);
+}
+
+void TextEncoder::encode(const QChar* data, qint64 length, QByteArray& out)
+{
+	//只有UTF8_BOM和UNICODE_LE/BE有BOM
+	if (!m_isBomWritten)
+	{
+		out.append(Encode::getEncodeStartFlagByte(m_code));
+		m_isBomWritten = true;
+	}
+
+	const ushort* p = reinterpret_cast<const ushort*>(data);
+
+	switch (m_scheme)
+	{
+	case SCHEME_UTF8:
+		encodeUtf8(p, length, out);
+		break;
+	case SCHEME_UTF16LE:
+	case SCHEME_UTF16BE:
+		encodeUtf16(p, length, out);
+		break;
+	default:
+		encodeCodec(p, length, out);
+		break;
+	}
+}
+
+void TextEncoder::finish(QByteArray& out)
+{
+	//空文本也要有BOM
+	if (!m_isBomWritten)
+	{
+		out.append(Encode::getEncodeStartFlagByte(m_code));
+		m_isBomWritten = true;
+	}
+
+	if (m_highSurrogate == 0)
+	{
+		return;
+	}
+
+	if (m_scheme == SCHEME_CODEC && m_codec != nullptr)
+	{
+		out.append(m_codec->fromUnicode(reinterpret_cast<const QChar*>(&m_highSurrogate), 1, m_state));
+	}
+	else
+	{
+		out.append('?');
+		++m_invalidChars;
+	}
+	m_highSurrogate = 0;
+}
+
+//每个UTF16字符最多3个字节，代理对4个字节，先按最大扩大out，最后再截掉多余的
+void TextEncoder::encodeUtf8(const ushort* p, qint64 length, QByteArray& out)
+{
+	int oldSize = out.size();
+	out.resize(oldSize + (int)(length * 3) + 4);
+	uchar* begin = reinterpret_cast<uchar*>(out.data());
+	uchar* dst = begin + oldSize;
+
+	qint64 i = 0;
+
+	if (m_highSurrogate != 0 && length > 0)
+	{
+		if (QChar::isLowSurrogate(p[0]))
+		{
+			dst = putUtf8(dst, QChar::surrogateToUcs4(m_highSurrogate, p[0]));
+			i = 1;
+		}
+		else
+		{
+			*dst++ = '?';
+			++m_invalidChars;
+		}
+		m_highSurrogate = 0;
+	}
+
+	while (i < length)
+	{
+		ushort c = p[i];
+
+		if (c < 0x80)
+		{
+			qint64 run = narrowAsciiRun(p + i, length - i, dst);
+			dst += run;
+			i += run;
+			continue;
+		}
+
+		if (QChar::isHighSurrogate(c))
+		{
+			if (i + 1 == length)
+			{
+				m_highSurrogate = c;
+				break;
+			}
+			if (QChar::isLowSurrogate(p[i + 1]))
+			{
+				dst = putUtf8(dst, QChar::surrogateToUcs4(c, p[i + 1]));
+				i += 2;
+				continue;
+			}
+		}
+
+		//单独的代理与Qt一样输出'?'
+		if (QChar::isSurrogate(c))
+		{
+			*dst++ = '?';
+			++m_invalidChars;
+		}
+		else
+		{
+			dst = putUtf8(dst, c);
+		}
+		++i;
+	}
+
+	out.resize((int)(dst - begin));
+}
+
+void TextEncoder::encodeUtf16(const ushort* p, qint64 length, QByteArray& out)
+{
+	const bool isBe = (m_scheme == SCHEME_UTF16BE);
+
+	int oldSize = out.size();
+	out.resize(oldSize + (int)(length * 2));
+	uchar* dst = reinterpret_cast<uchar*>(out.data()) + oldSize;
+
+#if Q_BYTE_ORDER == Q_LITTLE_ENDIAN
+	if (!isBe)
+	{
+		memcpy(dst, p, length * 2);
+		return;
+	}
+#endif
+
+	for (qint64 i = 0; i < length; ++i)
+	{
+		ushort c = p[i];
+		dst[i * 2] = isBe ? (uchar)(c >> 8) : (uchar)c;
+		dst[i * 2 + 1] = isBe ? (uchar)c : (uchar)(c >> 8);
+	}
+}
+
+//块尾的高位代理自己留着，保证交给codec的每一段都不截断代理对，这样codec里没有残留，ASCII可以直接压缩
+void TextEncoder::encodeCodec(const ushort* p, qint64 length, QByteArray& out)
+{
+	if (m_codec == nullptr)
+	{
+		m_invalidChars += length;
+		return;
+	}
+
+	if (m_highSurrogate != 0 && length > 0)
+	{
+		ushort pair[2] = { m_highSurrogate, p[0] };
+		bool isPair = QChar::isLowSurrogate(p[0]);
+
+		out.append(m_codec->fromUnicode(reinterpret_cast<const QChar*>(pair), isPair ? 2 : 1, m_state));
+		m_highSurrogate = 0;
+
+		if (isPair)
+		{
+			++p;
+			--length;
+		}
+	}
+
+	if (length > 0 && QChar::isHighSurrogate(p[length - 1]))
+	{
+		m_highSurrogate = p[length - 1];
+		--length;
+	}
+
+	qint64 i = 0;
+	while (i < length)
+	{
+		if (m_isAsciiCompatible && p[i] < 0x80)
+		{
+			int oldSize = out.size();
+			out.resize(oldSize + (int)(length - i));
+			qint64 run = narrowAsciiRun(p + i, length - i, reinterpret_cast<uchar*>(out.data()) + oldSize);
+			out.resize(oldSize + (int)run);
+			i += run;
+			continue;
+		}
+
+		qint64 end = length;
+		if (m_isAsciiCompatible)
+		{
+			end = i + 1;
+			while (end < length && p[end] >= 0x80)
+			{
+				++end;
+			}
+		}
+
+		out.append(m_codec->fromUnicode(reinterpret_cast<const QChar*>(p + i), end - i, m_state));
+		i = end;
+	}
+}
+
+bool TextTranscoder::decodeDevice(QIODevice& in, CODE_ID code, QString& out, bool& existGrbledCode, bool isSkipBom)
+{
+	TextDecoder decoder(code, isSkipBom);
+
+	//按字节数预留，UTF16两个字节一个字符。超过QString上限的文件由调用者走大文本模式
+	if (!in.isSequential())
+	{
+		qint64 left = in.size() - in.pos();
+		if (code == UNICODE_LE || code == UNICODE_BE)
+		{
+			left /= 2;
+		}
+		if (left > 0 && left < INT_MAX / 2)
+		{
+			out.reserve(out.size() + (int)left);
+		}
+	}
+
+	QByteArray buf(CHUNK_SIZE, Qt::Uninitialized);
+
+	while (true)
+	{
+		qint64 n = in.read(buf.data(), CHUNK_SIZE);
+		if (n < 0)
+		{
+			return false;
+		}
+		if (n == 0)
+		{
+			break;
+		}
+		decoder.decode(buf.constData(), n, out);
+	}
+	decoder.finish(out);
+
+	existGrbledCode = (decoder.invalidChars() > 0);
+	return true;
+}
+
+bool TextTranscoder::transcode(QIODevice& in, CODE_ID srcCode, QIODevice& out, CODE_ID dstCode, bool& existGrbledCode)
+{
+	qint64 decodeInvalid = 0;
+	qint64 encodeInvalid = 0;
+	if (!transcode(in, srcCode, out, dstCode, decodeInvalid, encodeInvalid))
+	{
+		return false;
+	}
+
+	existGrbledCode = (decodeInvalid > 0) || (encodeInvalid > 0);
+	return true;
+}
+
+bool TextTranscoder::transcode(QIODevice& in, CODE_ID srcCode, QIODevice& out, CODE_ID dstCode, qint64& decodeInvalid, qint64& encodeInvalid)
+{
+	TextDecoder decoder(srcCode);
+	TextEncoder encoder(dstCode);
+
+	QByteArray buf(CHUNK_SIZE, Qt::Uninitialized);
+
+	//预留容量后resize(0)不会释放内存，每一块复用同一块缓冲
+	QString text;
+	text.reserve(CHUNK_SIZE + 8);
+	QByteArray bytes;
+	bytes.reserve(CHUNK_SIZE * 3 + 32);
+
+	auto flush = [&]()->bool {
+		encoder.encode(text.constData(), text.size(), bytes);
+		bool ok = bytes.isEmpty() || (out.write(bytes) == bytes.size());
+		text.resize(0);
+		bytes.resize(0);
+		return ok;
+	};
+
+	while (true)
+	{
+		qint64 n = in.read(buf.data(), CHUNK_SIZE);
+		if (n < 0)
+		{
+			return false;
+		}
+		if (n == 0)
+		{
+			break;
+		}
+
+		decoder.decode(buf.constData(), n, text);
+		if (!flush())
+		{
+			return false;
+		}
+	}
+
+	decoder.finish(text);
+	encoder.encode(text.constData(), text.size(), bytes);
+	encoder.finish(bytes);
+	if (!bytes.isEmpty() && out.write(bytes) != bytes.size())
+	{
+		return false;
+	}
+
+	decodeInvalid = decoder.invalidChars();
+	encodeInvalid = encoder.invalidChars();
+	return true;
+}
+
+bool TextTranscoder::compareText(QIODevice& a, CODE_ID codeA, QIODevice& b, CODE_ID codeB)
+{
+	TextDecoder decoderA(codeA);
+	TextDecoder decoderB(codeB);
+
+	QByteArray buf(CHUNK_SIZE, Qt::Uninitialized);
+	QString textA;
+	QString textB;
+	bool isEndA = false;
+	bool isEndB = false;
+
+	auto fill = [&buf](QIODevice& dev, TextDecoder& decoder, QString& text, bool& isEnd)->bool {
+		qint64 n = dev.read(buf.data(), CHUNK_SIZE);
+		if (n < 0)
+		{
+			return false;
+		}
+		if (n == 0)
+		{
+			decoder.finish(text);
+			isEnd = true;
+		}
+		else
+		{
+			decoder.decode(buf.constData(), n, text);
+		}
+		return true;
+	};
+
+	//每次给解码出来较少的一边读一块，比较两边都有的部分后丢掉
+	while (true)
+	{
+		if (!isEndA && (isEndB || textA.size() <= textB.size()))
+		{
+			if (!fill(a, decoderA, textA, isEndA))
+			{
+				return false;
+			}
+		}
+		else if (!isEndB)
+		{
+			if (!fill(b, decoderB, textB, isEndB))
+			{
+				return false;
+			}
+		}
+
+		int common = qMin(textA.size(), textB.size());
+		if (memcmp(textA.constData(), textB.constData(), common * sizeof(QChar)) != 0)
+		{
+			return false;
+		}
+		textA.remove(0, common);
+		textB.remove(0, common);
+
+		if ((isEndA && !textB.isEmpty()) || (isEndB && !textA.isEmpty()))
+		{
+			return false;
+		}
+		if (isEndA && isEndB)
+		{
+			return true;
+		}
+	}
+}
@@ -0,0 +1,122 @@
+﻿#pragma once
+
+#include <QString>
+#include <QByteArray>
+#include <QTextCodec>
+#include <QIODevice>
+
+#include "rcglobal.h"
+
+//UTF8和UTF16自己转换，有ASCII快速路径；其它编码交给QTextCodec，带状态逐块转换
+enum TRANSCODE_SCHEME {
+	SCHEME_UTF8 = 0,
+	SCHEME_UTF16LE,
+	SCHEME_UTF16BE,
+	SCHEME_CODEC,
+};
+
+//流式解码：原始字节分块输入，追加为UTF16文本。
+//多字节字符被块边界截断时，剩下的字节留到下一块，所以块可以在任意位置切开
+class TextDecoder
+{
+public:
+	//isSkipBom：输入开头是该编码的BOM时丢弃
+	explicit TextDecoder(CODE_ID code, bool isSkipBom = true);
+	~TextDecoder();
+
+	CODE_ID code() const { return m_code; }
+
+	void decode(const char* data, qint64 length, QString& out);
+
+	//输入结束，输出残留的不完整字符
+	void finish(QString& out);
+
+	//无法解码的字符个数，不为0说明编码不对
+	qint64 invalidChars() const;
+
+private:
+	TextDecoder(const TextDecoder&) = delete;
+	TextDecoder& operator=(const TextDecoder&) = delete;
+
+	void decodeRaw(const uchar* p, qint64 length, QString& out);
+	void decodeUtf8(const uchar* p, qint64 length, QString& out);
+	void decodeUtf16(const uchar* p, qint64 length, QString& out);
+	void decodeCodec(const uchar* p, qint64 length, QString& out);
+
+	CODE_ID m_code;
+	TRANSCODE_SCHEME m_scheme;
+
+	//还没有确定开头是不是BOM时，m_bom不为空，m_bomChecked是已经匹配的字节数
+	QByteArray m_bom;
+	int m_bomChecked;
+
+	//被块边界截断的字节
+	uchar m_pending[4];
+	int m_pendingLen;
+
+	QTextCodec* m_codec;
+	QTextCodec::ConverterState* m_state;
+	//ASCII字节在该编码中也是ASCII字符时，可以跳过codec直接扩展
+	bool m_isAsciiCompatible;
+	//上一个字节是ASCII时，codec里没有残留的前导字节
+	bool m_isAsciiBoundary;
+
+	qint64 m_invalidChars;
+};
+
+//流式编码：UTF16文本分块输入，追加为目标编码的字节。isWriteBom时第一次输出前写入BOM
+class TextEncoder
+{
+public:
+	explicit TextEncoder(CODE_ID code, bool isWriteBom = true);
+	~TextEncoder();
+
+	CODE_ID code() const { return m_code; }
+
+	void encode(const QChar* data, qint64 length, QByteArray& out);
+
+	//输入结束，输出残留的高位代理
+	void finish(QByteArray& out);
+
+	qint64 invalidChars() const;
+
+private:
+	TextEncoder(const TextEncoder&) = delete;
+	TextEncoder& operator=(const TextEncoder&) = delete;
+
+	void encodeUtf8(const ushort* p, qint64 length, QByteArray& out);
+	void encodeUtf16(const ushort* p, qint64 length, QByteArray& out);
+	void encodeCodec(const ushort* p, qint64 length, QByteArray& out);
+
+	CODE_ID m_code;
+	TRANSCODE_SCHEME m_scheme;
+	bool m_isBomWritten;
+
+	//块尾的高位代理，等下一块的低位代理
+	ushort m_highSurrogate;
+
+	QTextCodec* m_codec;
+	QTextCodec::ConverterState* m_state;
+	bool m_isAsciiCompatible;
+
+	qint64 m_invalidChars;
+};
+
+//按固定大小的块读写，内存占用与文件大小无关
+class TextTranscoder
+{
+public:
+	static const qint64 CHUNK_SIZE = 1024 * 1024;
+
+	//从in的当前位置读到结束，解码后追加到out。读失败返回false；existGrbledCode表示有无法解码的字符
+	static bool decodeDevice(QIODevice& in, CODE_ID code, QString& out, bool& existGrbledCode, bool isSkipBom = true);
+
+	//从in读出srcCode的文本，转换为dstCode写入out。读写失败返回false
+	static bool transcode(QIODevice& in, CODE_ID srcCode, QIODevice& out, CODE_ID dstCode, bool& existGrbledCode);
+
+	//同上，分别给出源文件中无法解码的字符个数，和目标编码中无法表示的字符个数
+	static bool transcode(QIODevice& in, CODE_ID srcCode, QIODevice& out, CODE_ID dstCode, qint64& decodeInvalid, qint64& encodeInvalid);
+
+	//两边各自按块解码后比较文本，用于转换后的校验。读失败或者内容不同返回false
+	static bool compareText(QIODevice& a, CODE_ID codeA, QIODevice& b, CODE_ID codeB);
+};
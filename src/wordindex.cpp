@@ -0,0 +1,352 @@
+﻿#include "wordindex.h"
+#include "scintillaeditview.h"
+
+#include <QtConcurrent>
+
+//把text中每个可以进索引的单词交给func
+template <typename Func>
+static void scanWords(const char* text, qint64 length, Func func)
+{
+	qint64 i = 0;
+	while (i < length)
+	{
+		if (!WordIndex::isWordByte(static_cast<unsigned char>(text[i])))
+		{
+			++i;
+			continue;
+		}
+
+		qint64 start = i;
+		while (i < length && WordIndex::isWordByte(static_cast<unsigned char>(text[i])))
+		{
+			++i;
+		}
+
+		qint64 wordLen = i - start;
+		if (wordLen >= WordIndex::MIN_WORD_LENGTH && wordLen <= WordIndex::MAX_WORD_LENGTH && !(text[start] >= '0' && text[start] <= '9'))
+		{
+			func(QByteArray(text + start, static_cast<int>(wordLen)));
+		}
+	}
+}
+
+//后台线程中统计整个文档的单词
+static QHash<QByteArray, int> countWords(QByteArray text)
+{
+	QHash<QByteArray, int> counts;
+	scanWords(text.constData(), text.size(), [&counts](const QByteArray& word) {
+		++counts[word];
+	});
+	return counts;
+}
+
+WordIndex::WordIndex() : m_memory(0)
+{
+}
+
+WordIndex::~WordIndex()
+{
+}
+
+//map的一个节点加上QByteArray的数据块
+qint64 WordIndex::wordMemory(const QByteArray& word)
+{
+	return sizeof(std::map<QByteArray, int>::value_type) + 4 * sizeof(void*) + sizeof(QByteArrayData) + ((word.size() + 8) & ~7);
+}
+
+void WordIndex::add(const QByteArray& word, int count)
+{
+	auto it = m_words.lower_bound(word);
+	if (it != m_words.end() && it->first == word)
+	{
+		it->second += count;
+	}
+	else
+	{
+		m_words.insert(it, std::make_pair(word, count));
+		m_memory += wordMemory(word);
+	}
+}
+
+void WordIndex::remove(const QByteArray& word, int count)
+{
+	auto it = m_words.find(word);
+	if (it == m_words.end())
+	{
+		return;
+	}
+
+	it->second -= count;
+	if (it->second <= 0)
+	{
+		m_memory -= wordMemory(word);
+		m_words.erase(it);
+	}
+}
+
+void WordIndex::completions(const QByteArray& prefix, int maxCount, QList<QByteArray>& words) const
+{
+	for (auto it = m_words.lower_bound(prefix); it != m_words.end() && words.size() < maxCount; ++it)
+	{
+		if (!it->first.startsWith(prefix))
+		{
+			break;
+		}
+		if (it->first.size() > prefix.size())
+		{
+			words.append(it->first);
+		}
+	}
+}
+
+qint64 WordIndex::wordCount() const
+{
+	return static_cast<qint64>(m_words.size());
+}
+
+qint64 WordIndex::memoryUsage() const
+{
+	return m_memory;
+}
+
+DocWordIndex::DocWordIndex(ScintillaEditView* edit) : QObject(edit), m_edit(edit), m_ready(false), m_buildStale(false)
+{
+	m_watcher = new QFutureWatcher<QHash<QByteArray, int>>(this);
+	connect(m_watcher, &QFutureWatcher<QHash<QByteArray, int>>::finished, this, &DocWordIndex::slot_buildFinished);
+
+	connect(m_edit, &QsciScintillaBase::SCN_MODIFIED, this, &DocWordIndex::slot_modified);
+
+	m_buildTimer.setSingleShot(true);
+	m_buildTimer.setInterval(500);
+	connect(&m_buildTimer, &QTimer::timeout, this, &DocWordIndex::slot_buildTimeout);
+	m_buildTimer.start();
+}
+
+DocWordIndex::~DocWordIndex()
+{
+	//只有局部拷贝的文本，不用等待后台统计结束
+	m_watcher->disconnect(this);
+	clear();
+}
+
+bool DocWordIndex::isReady() const
+{
+	return m_ready;
+}
+
+qint64 DocWordIndex::wordCount() const
+{
+	return m_counts.size();
+}
+
+//QHash的一个节点加上桶，单词内容计算在WordIndex中
+qint64 DocWordIndex::memoryUsage() const
+{
+	return m_counts.size() * (2 * sizeof(void*) + sizeof(uint) + sizeof(QByteArray) + sizeof(int)) + m_counts.capacity() * sizeof(void*);
+}
+
+QByteArray DocWordIndex::wordBefore(qint64 pos) const
+{
+	qint64 start = wordStart(pos);
+	if (start == pos || pos - start > WordIndex::MAX_WORD_LENGTH)
+	{
+		return QByteArray();
+	}
+	return textRange(start, pos);
+}
+
+void DocWordIndex::clear()
+{
+	if (!m_ready)
+	{
+		return;
+	}
+
+	WordIndex& index = WordIndex::getInstance();
+	for (auto it = m_counts.constBegin(); it != m_counts.constEnd(); ++it)
+	{
+		index.remove(it.key(), it.value());
+	}
+	m_counts.clear();
+	m_ready = false;
+}
+
+void DocWordIndex::scheduleBuild()
+{
+	if (m_watcher->isRunning())
+	{
+		m_buildStale = true;
+	}
+	else
+	{
+		m_buildTimer.start();
+	}
+}
+
+void DocWordIndex::slot_buildTimeout()
+{
+	if (m_watcher->isRunning())
+	{
+		m_buildStale = true;
+		return;
+	}
+	startBuild();
+}
+
+void DocWordIndex::startBuild()
+{
+	m_buildStale = false;
+
+	qint64 length = m_edit->execute(SCI_GETLENGTH);
+	if (length > MAX_INDEX_LENGTH)
+	{
+		return;
+	}
+
+	//后台线程不能读编辑器的缓冲区，复制一份文本给它。映射的文档按范围复制，不把整个文件读入内存
+	QByteArray textCopy;
+	if (m_edit->execute(SCI_GETTEXTMAPPED))
+	{
+		textCopy = textRange(0, length);
+	}
+	else
+	{
+		const char* text = reinterpret_cast<const char*>(m_edit->execute(SCI_GETCHARACTERPOINTER));
+		textCopy = QByteArray(text, length);
+	}
+
+	m_watcher->setFuture(QtConcurrent::run(countWords, textCopy));
+}
+
+void DocWordIndex::slot_buildFinished()
+{
+	if (m_buildStale)
+	{
+		startBuild();
+		return;
+	}
+
+	clear();
+	m_counts = m_watcher->result();
+
+	//与WordIndex共享单词内容
+	WordIndex& index = WordIndex::getInstance();
+	for (auto it = m_counts.constBegin(); it != m_counts.constEnd(); ++it)
+	{
+		index.add(it.key(), it.value());
+	}
+	m_ready = true;
+}
+
+QByteArray DocWordIndex::textRange(qint64 startPos, qint64 endPos) const
+{
+	QByteArray text;
+	if (endPos > startPos)
+	{
+		text.resize(endPos - startPos);
+		m_edit->getText(text.data(), startPos, endPos);
+	}
+	return text;
+}
+
+//pos所在单词的开始位置，pos前面不是单词时返回pos
+qint64 DocWordIndex::wordStart(qint64 pos) const
+{
+	while (pos > 0 && WordIndex::isWordByte(static_cast<unsigned char>(m_edit->execute(SCI_GETCHARAT, pos - 1))))
+	{
+		--pos;
+	}
+	return pos;
+}
+
+//pos所在单词的结束位置，pos处不是单词时返回pos
+qint64 DocWordIndex::wordEnd(qint64 pos) const
+{
+	qint64 length = m_edit->execute(SCI_GETLENGTH);
+	while (pos < length && WordIndex::isWordByte(static_cast<unsigned char>(m_edit->execute(SCI_GETCHARAT, pos))))
+	{
+		++pos;
+	}
+	return pos;
+}
+
+void DocWordIndex::addRange(qint64 startPos, qint64 endPos)
+{
+	QByteArray text = textRange(startPos, endPos);
+	WordIndex& index = WordIndex::getInstance();
+	scanWords(text.constData(), text.size(), [this, &index](const QByteArray& word) {
+		auto it = m_counts.find(word);
+		if (it == m_counts.end())
+		{
+			index.add(word, 1);
+			m_counts.insert(word, 1);
+		}
+		else
+		{
+			index.add(it.key(), 1);
+			++it.value();
+		}
+	});
+}
+
+void DocWordIndex::removeRange(qint64 startPos, qint64 endPos)
+{
+	QByteArray text = textRange(startPos, endPos);
+	WordIndex& index = WordIndex::getInstance();
+	scanWords(text.constData(), text.size(), [this, &index](const QByteArray& word) {
+		auto it = m_counts.find(word);
+		if (it == m_counts.end())
+		{
+			return;
+		}
+		index.remove(it.key(), 1);
+		if (--it.value() <= 0)
+		{
+			m_counts.erase(it);
+		}
+	});
+}
+
+//修改前减去被修改破坏的单词，修改后加上修改点附近的单词。修改点前后连着的单词也会变化，
+//所以范围扩展到两端单词的边界，其他地方的单词不用重新统计。
+//一次替换多处时，先通知删除再通知插入，删除和插入的通知发出时文档已经是替换后的内容，
+//这时删除后加上的单词和插入前减去的单词相同，结果仍然正确
+void DocWordIndex::slot_modified(int position, int modificationType, const char* /*text*/, int length, int, int, int, int, int, int)
+{
+	const int textModification = SC_MOD_BEFOREINSERT | SC_MOD_INSERTTEXT | SC_MOD_BEFOREDELETE | SC_MOD_DELETETEXT;
+	if (!(modificationType & textModification))
+	{
+		return;
+	}
+
+	if (!m_ready || length > MAX_INCREMENTAL_LENGTH)
+	{
+		//打开文档时的插入，或者太大的修改，停下来以后重新统计
+		clear();
+		if (modificationType & (SC_MOD_INSERTTEXT | SC_MOD_DELETETEXT))
+		{
+			scheduleBuild();
+		}
+		return;
+	}
+
+	const qint64 pos = position;
+	const qint64 len = length;
+
+	if (modificationType & SC_MOD_BEFOREINSERT)
+	{
+		removeRange(wordStart(pos), wordEnd(pos));
+	}
+	else if (modificationType & SC_MOD_INSERTTEXT)
+	{
+		addRange(wordStart(pos), wordEnd(pos + len));
+	}
+	else if (modificationType & SC_MOD_BEFOREDELETE)
+	{
+		removeRange(wordStart(pos), wordEnd(pos + len));
+	}
+	else
+	{
+		addRange(wordStart(pos), wordEnd(pos));
+	}
+}
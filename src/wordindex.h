@@ -0,0 +1,113 @@
+﻿#pragma once
+
+#include <QObject>
+#include <QByteArray>
+#include <QHash>
+#include <QList>
+#include <QFutureWatcher>
+#include <QTimer>
+#include <map>
+
+class ScintillaEditView;
+
+//所有打开文档的单词索引，自动补全从这里取前缀匹配的单词。
+//按字节序排好序，查找前缀只需要一次二分查找，再顺序取出前面若干个，与文档大小无关。只在界面线程中使用
+class WordIndex
+{
+public:
+	static WordIndex& getInstance() {
+		static WordIndex instance;
+		return instance;
+	};
+
+	//单词由字母、数字、下划线和非ASCII字节组成，不以数字开头
+	static bool isWordByte(unsigned char ch)
+	{
+		return (ch >= 0x80) || (ch >= 'a' && ch <= 'z') || (ch >= 'A' && ch <= 'Z') || (ch >= '0' && ch <= '9') || (ch == '_');
+	}
+
+	//count是这个单词在某个文档中新增或者减少的出现次数
+	void add(const QByteArray& word, int count);
+	void remove(const QByteArray& word, int count);
+
+	//按字节序返回最多maxCount个以prefix开头的单词，不包括prefix本身
+	void completions(const QByteArray& prefix, int maxCount, QList<QByteArray>& words) const;
+
+	qint64 wordCount() const;
+	//索引占用的内存，按节点和单词内容估算的字节数
+	qint64 memoryUsage() const;
+
+	//短于MIN_WORD_LENGTH或者长于MAX_WORD_LENGTH的单词不进索引
+	static const int MIN_WORD_LENGTH = 3;
+	static const int MAX_WORD_LENGTH = 64;
+	//输入了这么多个字符以后才显示补全列表，列表最多显示MAX_COMPLETIONS个单词
+	static const int MIN_PREFIX_LENGTH = 2;
+	static const int MAX_COMPLETIONS = 30;
+
+private:
+	WordIndex();
+	~WordIndex();
+
+	WordIndex(const WordIndex&) = delete;
+	WordIndex& operator=(const WordIndex&) = delete;
+
+	static qint64 wordMemory(const QByteArray& word);
+
+	//单词在所有文档中的总出现次数
+	std::map<QByteArray, int> m_words;
+	qint64 m_memory;
+};
+
+//一个文档的单词计数。打开文档后在后台线程中统计一次，之后根据修改通知只重新统计修改点所在的单词，
+//同时把增减的次数合并到WordIndex中。关闭文档时把它的单词全部从WordIndex中减去
+class DocWordIndex : public QObject
+{
+	Q_OBJECT
+
+public:
+	DocWordIndex(ScintillaEditView* edit);
+	virtual ~DocWordIndex();
+
+	bool isReady() const;
+	qint64 wordCount() const;
+	qint64 memoryUsage() const;
+
+	//光标前面正在输入的单词，不是单词或者太长时返回空
+	QByteArray wordBefore(qint64 pos) const;
+
+	//超过这个长度的文档不建索引，避免复制整个文档
+	static const qint64 MAX_INDEX_LENGTH = 64 * 1024 * 1024;
+	//一次修改超过这个长度时不增量更新，丢弃后在后台重新统计
+	static const qint64 MAX_INCREMENTAL_LENGTH = 1024 * 1024;
+
+private slots:
+	void slot_modified(int position, int modificationType, const char* text, int length, int linesAdded, int line, int foldLevelNow, int foldLevelPrev, int token, int annotationLinesAdded);
+	void slot_buildTimeout();
+	void slot_buildFinished();
+
+private:
+	void clear();
+	void scheduleBuild();
+	void startBuild();
+	QByteArray textRange(qint64 startPos, qint64 endPos) const;
+	qint64 wordStart(qint64 pos) const;
+	qint64 wordEnd(qint64 pos) const;
+	void addRange(qint64 startPos, qint64 endPos);
+	void removeRange(qint64 startPos, qint64 endPos);
+
+	DocWordIndex(const DocWordIndex&) = delete;
+	DocWordIndex& operator=(const DocWordIndex&) = delete;
+
+	ScintillaEditView* m_edit;
+
+	//单词在本文档中的出现次数，单词内容与WordIndex中的共享
+	QHash<QByteArray, int> m_counts;
+	bool m_ready;
+
+	//后台统计期间文档被修改了，结果作废，完成后重新统计
+	bool m_buildStale;
+	QFutureWatcher<QHash<QByteArray, int>>* m_watcher;
+
+	//打开文档和大量修改时会连续收到修改通知，停下来以后再统计
+	QTimer m_buildTimer;
+};